@@ -30,13 +30,27 @@
 #include "usb.h"
 #include "nxdt_devoptab.h"
 
-#define BLOCK_SIZE      USB_TRANSFER_BUFFER_SIZE
-#define WAIT_TIME_LIMIT 30
-#define OUTDIR          APP_TITLE
+#define BLOCK_SIZE                  USB_TRANSFER_BUFFER_SIZE
+#define WAIT_TIME_LIMIT             30
+#define OUTDIR                      APP_TITLE
+#define IMAGE_FILE_INPUT_DIR        DEVOPTAB_SDMC_DEVICE "/" OUTDIR "/Input"   /* The first NSP / XCI image file found here is used by the sd card image file menu. */
+
+#define NSP_PIPELINE_BLOCK_COUNT    4   /* Enough to keep the read, hash and write stages busy at the same time, plus one spare block. */
+#define NSP_PIPELINE_MAX_READS      (NSP_PIPELINE_BLOCK_COUNT - 2)  /* Outstanding NCA reads. At least one block must be left for the hash/write stages to make progress. */
+
+#define ROMFS_COALESCE_MAX_GAP      0x1000  /* Maximum distance between the data from two RomFS file entries for them to be read in a single go. */
+
+#define EXTRACTED_FS_WRITER_THREAD_COUNT        2                   /* The read thread runs on core 2, so we use the remaining ones. */
+#define EXTRACTED_FS_WRITER_QUEUE_SIZE          0x40                /* Per writer thread. */
+#define EXTRACTED_FS_WRITER_MAX_PENDING_SIZE    (BLOCK_SIZE * 4)    /* Upper bound for the amount of file data waiting to be written at any given time. */
+#define EXTRACTED_FS_COMMIT_FILE_COUNT          256                 /* Number of extracted files written to the SD card between filesystem commits. */
+
+#define XCI_DIGEST_WORKER_CORE_COUNT    2   /* The read thread runs on core 2, so digest workers are spread across the remaining ones. */
 
 /* Type definitions. */
 
 typedef struct _Menu Menu;
+typedef struct _ExtractedFsWriterPool ExtractedFsWriterPool;
 
 typedef u32  (*MenuElementOptionGetterFunction)(void);
 typedef void (*MenuElementOptionSetterFunction)(u32 idx);
@@ -83,7 +97,8 @@ typedef enum {
     MenuId_NcaFsSections        = 13,
     MenuId_NcaFsSectionsSubMenu = 14,
     MenuId_SystemTitles         = 15,
-    MenuId_Count                = 16
+    MenuId_ImageFile            = 16,
+    MenuId_Count                = 17
 } MenuId;
 
 typedef struct
@@ -96,11 +111,52 @@ typedef struct
     bool read_error;
     bool write_error;
     bool transfer_cancelled;
+    bool use_usb_file_stream;
+    u32 usb_file_stream_id;
 } SharedThreadData;
 
+typedef enum {
+    XciDigestType_Crc32  = 0,
+    XciDigestType_Sha1   = 1,
+    XciDigestType_Sha256 = 2,
+    XciDigestType_Count  = 3    ///< Total values supported by this enum. Each digest type gets its own worker thread.
+} XciDigestType;
+
+/// Digests for a single XCI image variant.
+typedef struct {
+    u32 crc32;
+    Sha1Context sha1_ctx;
+    Sha256Context sha256_ctx;
+} XciDigestState;
+
+/// XCI digest fan-out: each dumped block is submitted once and consumed by one worker thread per digest type.
+/// Workers only ever touch the state that belongs to their own digest type, so blocks don't need to be copied or locked while they're being processed.
+typedef struct {
+    Mutex mutex;
+    CondVar condvar;
+    Thread threads[XciDigestType_Count];
+    bool stop;
+
+    const void *data;                               ///< Current block. Must stay valid until xciDigestFanOutWait() returns.
+    u64 data_size;
+    u32 block_id;                                   ///< Incremented on each submission. Used by workers to detect new blocks.
+    u32 pending;                                    ///< Workers that haven't finished processing the current block yet.
+
+    bool prepend_key_area;
+    u32 key_area_crc;
+    XciDigestState xci;                             ///< XCI image as-is.
+    XciDigestState full_xci;                        ///< XCI image with the key area prepended. Only used if 'prepend_key_area' is true.
+} XciDigestFanOut;
+
+/// Worker thread argument. Holds the digest type handled by each worker.
+typedef struct {
+    XciDigestFanOut *fan_out;
+    u8 type;                                        ///< XciDigestType.
+} XciDigestWorker;
+
 typedef struct {
     SharedThreadData shared_thread_data;
-    u32 xci_crc, full_xci_crc;
+    XciDigestFanOut *digest_fan_out;                ///< Set to NULL if checksums shouldn't be calculated.
 } XciThreadData;
 
 typedef struct {
@@ -116,6 +172,107 @@ typedef struct {
     bool transfer_cancelled;
 } NspThreadData;
 
+/// Page-aligned data block passed between NSP dump pipeline stages.
+typedef struct {
+    u8 *data;
+    u64 size;
+    u64 offset;                                     ///< Relative to the start of the NCA content file.
+    ContentSourceReadGroup read_group;              ///< Used to wait for the asynchronous NCA read that fills this block.
+} NspPipelineBlock;
+
+/// Bounded FIFO holding NspPipelineBlock indexes. Protected by the pipeline mutex.
+typedef struct {
+    u32 items[NSP_PIPELINE_BLOCK_COUNT];
+    u32 head;
+    u32 count;
+    CondVar condvar;
+} NspPipelineQueue;
+
+/// NSP dump pipeline: read (dump thread) -> hash/patch (hash thread) -> write (write thread).
+/// Blocks always return to the free queue, so no queue can ever hold more than NSP_PIPELINE_BLOCK_COUNT items.
+typedef struct {
+    Mutex mutex;
+    NspPipelineBlock blocks[NSP_PIPELINE_BLOCK_COUNT];
+    NspPipelineQueue free_queue, hash_queue, write_queue;
+    Thread hash_thread, write_thread;
+    bool initialized;
+    bool stop;
+    bool error;
+    u32 usb_pending;                                ///< Blocks handed off to the USB write queue that haven't been given back yet.
+
+    NspThreadData *nsp_thread_data;
+    ContentMetaContext *cnmt_ctx;
+
+    ///< The following fields must only be modified by the dump thread while the pipeline is drained.
+    NcaContext *nca_ctx;
+    bool dirty_header;
+    Sha256Context clean_sha256_ctx, dirty_sha256_ctx;
+
+    /// Blocks with outstanding NCA reads, in submission order. Only used by the dump thread.
+    u32 read_queue[NSP_PIPELINE_BLOCK_COUNT];
+    u32 read_queue_head;
+    u32 read_queue_count;
+
+    bool use_usb;
+    FILE *fp;
+} NspPipeline;
+
+/// Reference counted file data buffer used by the extracted FS writer pool. Freed as soon as all of its references are dropped.
+/// A single buffer may hold data from multiple files (e.g. coalesced RomFS reads).
+typedef struct {
+    void *data;
+    u64 size;
+    u32 ref_count;                                  ///< Protected by the writer pool mutex.
+} ExtractedFsWriterBuffer;
+
+typedef enum {
+    ExtractedFsWriterJobType_OpenFile  = 0,
+    ExtractedFsWriterJobType_WriteData = 1,
+    ExtractedFsWriterJobType_CloseFile = 2
+} ExtractedFsWriterJobType;
+
+typedef struct {
+    u8 type;                                        ///< ExtractedFsWriterJobType.
+    char *path;                                     ///< OpenFile only. Owned by the job.
+    u64 file_size;                                  ///< OpenFile only.
+    ExtractedFsWriterBuffer *buffer;                ///< WriteData only. The job holds a reference to this buffer.
+    u64 data_offset;                                ///< WriteData only. Relative to the start of the buffer.
+    u64 data_size;                                  ///< WriteData only.
+} ExtractedFsWriterJob;
+
+/// Writer thread. Jobs are processed in FIFO order, and all jobs for a given file are sent to the same writer, which keeps writes within each file in order.
+typedef struct {
+    ExtractedFsWriterPool *pool;
+    Thread thread;
+    ExtractedFsWriterJob jobs[EXTRACTED_FS_WRITER_QUEUE_SIZE];
+    u32 head;
+    u32 count;
+    bool busy;                                      ///< Set while a job is being processed.
+    CondVar condvar;                                ///< Signaled when a job is queued, or when the pool is being stopped.
+    FILE *fp;                                       ///< Only ever accessed by the writer thread.
+} ExtractedFsWriter;
+
+/// Extracted FS writer pool: the read thread queues (open, write, close) jobs, while writer threads create and write different output files at the same time.
+/// The amount of queued file data is bounded by EXTRACTED_FS_WRITER_MAX_PENDING_SIZE.
+struct _ExtractedFsWriterPool {
+    Mutex mutex;
+    CondVar condvar;                                ///< Signaled whenever a job is completed or a buffer is freed.
+    ExtractedFsWriter writers[EXTRACTED_FS_WRITER_THREAD_COUNT];
+    u32 writer_count;                               ///< Number of writer threads that have been started.
+    bool initialized;
+    bool stop;
+    bool error;
+    u64 pending_size;                               ///< Total size of all allocated buffers.
+    u32 closed_file_count;
+
+    ///< The following fields must only be modified by the read thread.
+    u32 cur_writer;                                 ///< Writer handling the current file.
+    bool file_open;                                 ///< Set if a file is currently open.
+
+    u32 dev_idx;
+    SharedThreadData *shared_thread_data;
+};
+
 typedef struct {
     TitleInfo *title_info;
     u32 content_idx;
@@ -226,6 +383,8 @@ static bool saveNintendoContentArchive(void *userdata);
 static bool saveNintendoContentArchiveFsSection(void *userdata);
 static bool browseNintendoContentArchiveFsSection(void *userdata);
 
+static bool saveImageFileProgramRomFsSection(void *userdata);
+
 static bool fsBrowser(const char *mount_name, const char *base_out_path);
 static bool fsBrowserGetDirEntries(const char *dir_path, FsBrowserEntry **out_entries, u32 *out_entry_count);
 static bool fsBrowserDumpFile(const char *dir_path, const FsBrowserEntry *entry, const char *base_out_path);
@@ -241,6 +400,13 @@ static bool saveExtractedRomFsSection(RomFileSystemContext *romfs_ctx, bool use_
 
 static void xciReadThreadFunc(void *arg);
 
+static bool xciDigestFanOutInitialize(XciDigestFanOut *fan_out, XciDigestWorker *workers, const GameCardKeyArea *key_area);
+static void xciDigestFanOutFree(XciDigestFanOut *fan_out);
+static void xciDigestFanOutSubmit(XciDigestFanOut *fan_out, const void *data, u64 data_size);
+static void xciDigestFanOutWait(XciDigestFanOut *fan_out);
+static void xciDigestWorkerThreadFunc(void *arg);
+static bool saveXciDigestFile(XciDigestFanOut *fan_out, const char *filename);
+
 static void rawHfsReadThreadFunc(void *arg);
 static void extractedHfsReadThreadFunc(void *arg);
 
@@ -251,17 +417,50 @@ static void extractedPartitionFsReadThreadFunc(void *arg);
 
 static void rawRomFsReadThreadFunc(void *arg);
 static void extractedRomFsReadThreadFunc(void *arg);
+static RomFileSystemFileEntry **extractedRomFsGenerateReadPlan(RomFileSystemContext *romfs_ctx, u32 *out_count);
+static int extractedRomFsReadPlanSortFunction(const void *a, const void *b);
+static bool extractedRomFsCreateDirectoryTree(RomFileSystemContext *romfs_ctx, RomFileSystemFileEntry **read_plan, u32 read_plan_count, char *path, size_t path_size, size_t base_path_len, \
+                                              u8 illegal_char_replace_type);
+static u64 extractedRomFsGetCoalescedReadSize(RomFileSystemFileEntry **read_plan, u32 read_plan_count, u32 idx, u64 data_offset, u64 data_size);
 
 static void fsBrowserFileReadThreadFunc(void *arg);
 static void fsBrowserHighlightedEntriesReadThreadFunc(void *arg);
 static bool fsBrowserHighlightedEntriesReadThreadLoop(SharedThreadData *shared_thread_data, const char *dir_path, const FsBrowserEntry *entries, u32 entries_count, const char *base_out_path, void *buf1, void *buf2);
 
+static bool sendExtractedFileProperties(SharedThreadData *shared_thread_data, u64 file_size, const char *path);
 static void genericWriteThreadFunc(void *arg);
+static void extractedFsWriteThreadFunc(void *arg);
+
+static bool extractedFsWriterPoolInitialize(ExtractedFsWriterPool *pool, SharedThreadData *shared_thread_data, u32 dev_idx);
+static void extractedFsWriterPoolFree(ExtractedFsWriterPool *pool);
+static void extractedFsWriterPoolSetError(ExtractedFsWriterPool *pool);
+static bool extractedFsWriterPoolPushJob(ExtractedFsWriterPool *pool, u32 writer_idx, const ExtractedFsWriterJob *job);
+static bool extractedFsWriterPoolOpenFile(ExtractedFsWriterPool *pool, const char *path, u64 file_size);
+static bool extractedFsWriterPoolCloseFile(ExtractedFsWriterPool *pool);
+static ExtractedFsWriterBuffer *extractedFsWriterPoolAllocateBuffer(ExtractedFsWriterPool *pool, u64 size);
+static void extractedFsWriterPoolReleaseBuffer(ExtractedFsWriterPool *pool, ExtractedFsWriterBuffer *buffer);
+static void extractedFsWriterPoolDropBufferReference(ExtractedFsWriterPool *pool, ExtractedFsWriterBuffer *buffer);
+static bool extractedFsWriterPoolWriteData(ExtractedFsWriterPool *pool, ExtractedFsWriterBuffer *buffer, u64 data_offset, u64 data_size);
+static bool extractedFsWriterPoolFinish(ExtractedFsWriterPool *pool);
+static void extractedFsWriterThreadFunc(void *arg);
+static bool extractedFsWriterOpenFile(ExtractedFsWriter *writer, const char *path, u64 file_size);
 
 static bool spanDumpThreads(ThreadFunc read_func, ThreadFunc write_func, void *arg);
 
 static void nspThreadFunc(void *arg);
 
+static bool nspPipelineInitialize(NspPipeline *pipeline, NspThreadData *nsp_thread_data, ContentMetaContext *cnmt_ctx, bool use_usb, FILE *fp);
+static void nspPipelineFree(NspPipeline *pipeline);
+static void nspPipelineQueuePush(NspPipeline *pipeline, NspPipelineQueue *queue, u32 idx);
+static bool nspPipelineQueuePop(NspPipeline *pipeline, NspPipelineQueue *queue, u32 *out_idx);
+static void nspPipelineSetError(NspPipeline *pipeline);
+static bool nspPipelineDrain(NspPipeline *pipeline);
+static bool nspPipelineSubmitRead(NspPipeline *pipeline, u32 blk_idx);
+static bool nspPipelineCompleteRead(NspPipeline *pipeline, bool hand_over);
+static void nspPipelineHashThreadFunc(void *arg);
+static void nspPipelineWriteThreadFunc(void *arg);
+static void nspPipelineUsbTransferDoneCallback(void *data, bool success, void *callback_arg);
+
 static u32 getOutputStorageOption(void);
 static void setOutputStorageOption(u32 idx);
 
@@ -966,6 +1165,31 @@ static Menu g_systemTitlesMenu = {
     .elements = NULL
 };
 
+static MenuElement *g_imageFileMenuElements[] = {
+    &(MenuElement){
+        .str = "dump program nca romfs section from image file",
+        .child_menu = NULL,
+        .task_func = &saveImageFileProgramRomFsSection,
+        .element_options = NULL,
+        .userdata = NULL
+    },
+    &(MenuElement){
+        .str = "write raw section",
+        .child_menu = NULL,
+        .task_func = NULL,
+        .element_options = &(MenuElementOption){
+            .selected = 0,
+            .retrieved = false,
+            .getter_func = &getNcaFsWriteRawSectionOption,
+            .setter_func = &setNcaFsWriteRawSectionOption,
+            .options = g_noYesStrings
+        },
+        .userdata = NULL
+    },
+    &g_storageMenuElement,
+    NULL
+};
+
 static MenuElement *g_rootMenuElements[] = {
     &(MenuElement){
         .str = "gamecard menu",
@@ -994,6 +1218,19 @@ static MenuElement *g_rootMenuElements[] = {
         .element_options = NULL,
         .userdata = NULL
     },
+    &(MenuElement){
+        .str = "sd card image file menu",
+        .child_menu = &(Menu){
+            .id = MenuId_ImageFile,
+            .parent = NULL,
+            .selected = 0,
+            .scroll = 0,
+            .elements = g_imageFileMenuElements
+        },
+        .task_func = NULL,
+        .element_options = NULL,
+        .userdata = NULL
+    },
     &(MenuElement){
         .str = "reset settings",
         .child_menu = NULL,
@@ -1157,6 +1394,11 @@ int main(int argc, char *argv[])
         if (cur_menu->id == MenuId_GameCard) {
             consolePrint("For a full gamecard image: dump XCI, initial data, certificate, id set and uid.\n");
             consolePrint("______________________________\n\n");
+        } else
+        if (cur_menu->id == MenuId_ImageFile) {
+            consolePrint("The first NSP / XCI image file found in \"%s\" will be used.\n", IMAGE_FILE_INPUT_DIR);
+            consolePrint("Data is written to a LayeredFS directory, using the program ID from the NCA header.\n");
+            consolePrint("______________________________\n\n");
         }
 
         for(u32 i = cur_menu->scroll; i < element_count; i++)
@@ -2440,11 +2682,13 @@ static bool saveGameCardImage(void *userdata)
 
     u64 gc_size = 0, free_space = 0;
 
-    u32 key_area_crc = 0;
     GameCardKeyArea gc_key_area = {0};
     GameCardSecurityInformation gc_security_information = {0};
 
     XciThreadData xci_thread_data = {0};
+    XciDigestFanOut digest_fan_out = {0};
+    XciDigestWorker digest_workers[XciDigestType_Count] = {0};
+    bool digest_fan_out_started = false;
     SharedThreadData *shared_thread_data = &(xci_thread_data.shared_thread_data);
 
     char *filename = NULL;
@@ -2477,12 +2721,6 @@ static bool saveGameCardImage(void *userdata)
 
         memcpy(&(gc_key_area.initial_data), &(gc_security_information.initial_data), sizeof(GameCardInitialData));
 
-        if (calculate_checksum)
-        {
-            key_area_crc = crc32Calculate(&gc_key_area, sizeof(GameCardKeyArea));
-            xci_thread_data.full_xci_crc = key_area_crc;
-        }
-
         consolePrint("gamecard size (with key area): 0x%lX\n", gc_size);
     }
 
@@ -2550,6 +2788,18 @@ static bool saveGameCardImage(void *userdata)
         }
     }
 
+    if (calculate_checksum)
+    {
+        /* Digests are calculated by worker threads, so the read thread only needs to submit each block. */
+        if (!(digest_fan_out_started = xciDigestFanOutInitialize(&digest_fan_out, digest_workers, prepend_key_area ? &gc_key_area : NULL)))
+        {
+            consolePrint("failed to start xci digest workers!\n");
+            goto end;
+        }
+
+        xci_thread_data.digest_fan_out = &digest_fan_out;
+    }
+
     consoleRefresh();
 
     success = spanDumpThreads(xciReadThreadFunc, genericWriteThreadFunc, &xci_thread_data);
@@ -2560,9 +2810,9 @@ static bool saveGameCardImage(void *userdata)
 
         if (calculate_checksum)
         {
-            if (prepend_key_area) consolePrint("key area crc: %08X | ", key_area_crc);
-            consolePrint("xci crc: %08X", xci_thread_data.xci_crc);
-            if (prepend_key_area) consolePrint(" | xci crc (with key area): %08X", xci_thread_data.full_xci_crc);
+            if (prepend_key_area) consolePrint("key area crc: %08X | ", digest_fan_out.key_area_crc);
+            consolePrint("xci crc: %08X", digest_fan_out.xci.crc32);
+            if (prepend_key_area) consolePrint(" | xci crc (with key area): %08X", digest_fan_out.full_xci.crc32);
             consolePrint("\n");
         }
 
@@ -2570,6 +2820,9 @@ static bool saveGameCardImage(void *userdata)
     }
 
 end:
+    /* Workers must be stopped before the sidecar file is generated. */
+    if (digest_fan_out_started) xciDigestFanOutFree(&digest_fan_out);
+
     if (shared_thread_data->fp)
     {
         fclose(shared_thread_data->fp);
@@ -2587,6 +2840,9 @@ end:
         }
     }
 
+    /* Save digest sidecar file. This is done after the XCI has been closed, since it involves a separate file transfer. */
+    if (success && digest_fan_out_started && !saveXciDigestFile(&digest_fan_out, filename)) consolePrint("failed to save xci digest file!\n");
+
     if (filename) free(filename);
 
     return success;
@@ -2977,7 +3233,7 @@ static bool saveGameCardExtractedHfsPartition(HashFileSystemContext *hfs_ctx)
     consolePrint("extracted %s hfs partition size: 0x%lX\n", hfs_ctx->name, data_size);
     consoleRefresh();
 
-    success = spanDumpThreads(extractedHfsReadThreadFunc, genericWriteThreadFunc, &hfs_thread_data);
+    success = spanDumpThreads(extractedHfsReadThreadFunc, extractedFsWriteThreadFunc, &hfs_thread_data);
 
 end:
     return success;
@@ -3553,6 +3809,156 @@ end:
     return success;
 }
 
+static bool saveImageFileProgramRomFsSection(void *userdata)
+{
+    NX_IGNORE_ARG(userdata);
+
+    DIR *dp = NULL;
+    struct dirent *dt = NULL;
+    bool image_found = false;
+
+    ContentSource image_source = {0}, nca_source = {0};
+    char *entry_names = NULL, *entry_name = NULL;
+    u32 entry_count = 0;
+
+    NcmContentMetaKey meta_key = { .type = NcmContentMetaType_Application };
+    NcmContentInfo content_info = {0};
+
+    NcaContext *nca_ctx = NULL;
+    NcaFsSectionContext *nca_fs_ctx = NULL;
+    RomFileSystemContext romfs_ctx = {0};
+
+    bool write_raw_section = (bool)getNcaFsWriteRawSectionOption();
+    bool success = false;
+
+    /* Look for a NSP / XCI image file. */
+    dp = opendir(IMAGE_FILE_INPUT_DIR);
+    if (!dp)
+    {
+        consolePrint("failed to open dir \"%s\"\n", IMAGE_FILE_INPUT_DIR);
+        goto end;
+    }
+
+    while((dt = readdir(dp)))
+    {
+        const char *ext = strrchr(dt->d_name, '.');
+        if (dt->d_type != DT_REG || !ext || (strcasecmp(ext, ".nsp") != 0 && strcasecmp(ext, ".xci") != 0)) continue;
+
+        snprintf(path, MAX_ELEMENTS(path), "%s/%s", IMAGE_FILE_INPUT_DIR, dt->d_name);
+        image_found = true;
+        break;
+    }
+
+    closedir(dp);
+
+    if (!image_found)
+    {
+        consolePrint("no nsp / xci image files found in \"%s\"\n", IMAGE_FILE_INPUT_DIR);
+        goto end;
+    }
+
+    consolePrint("image file: \"%s\"\n", path);
+    consoleRefresh();
+
+    /* Open image file and get its entry names. */
+    if (!contentSourceInitializeFile(&image_source, path))
+    {
+        consolePrint("failed to open image file!\n");
+        goto end;
+    }
+
+    if (!contentSourceGetImageFileEntryNames(&image_source, &entry_names, &entry_count))
+    {
+        consolePrint("failed to get image file entries!\n");
+        goto end;
+    }
+
+    nca_ctx = calloc(1, sizeof(NcaContext));
+    if (!nca_ctx)
+    {
+        consolePrint("nca ctx alloc failed!\n");
+        goto end;
+    }
+
+    /* Look for the Program NCA. Content types are only known after parsing NCA headers, so all "<content id>.nca" entries are checked. */
+    /* Meta NCAs ("<content id>.cnmt.nca") are skipped. */
+    entry_name = entry_names;
+
+    for(u32 i = 0; i < entry_count; i++, entry_name += (strlen(entry_name) + 1))
+    {
+        size_t content_id_str_len = (sizeof(NcmContentId) * 2);
+        if (strlen(entry_name) != (content_id_str_len + 4) || strcasecmp(entry_name + content_id_str_len, ".nca") != 0 || \
+            !utilsParseHexString(content_info.content_id.c, sizeof(content_info.content_id.c), entry_name, content_id_str_len)) continue;
+
+        /* The image file handle is shared by both content sources. */
+        if (!contentSourceInitializeImageFileEntryFromSource(&nca_source, &image_source, entry_name)) continue;
+
+        /* Placeholder content type. It's checked against the NCA header below. */
+        content_info.content_type = NcmContentType_Program;
+        ncmU64ToContentInfoSize(nca_source.size, &content_info);
+
+        if (ncaInitializeContextFromContentSource(nca_ctx, &nca_source, &meta_key, &content_info, NULL) && nca_ctx->header.content_type == NcaContentType_Program)
+        {
+            consolePrint("program nca: \"%s\"\n", entry_name);
+            break;
+        }
+
+        contentSourceClose(&nca_source);
+    }
+
+    if (!contentSourceIsValid(&nca_source))
+    {
+        consolePrint("unable to find a valid program nca!\n");
+        goto end;
+    }
+
+    /* Titlekeys can only be retrieved from tickets installed on this console. */
+    if (nca_ctx->rights_id_available && !nca_ctx->titlekey_retrieved) consolePrint("ticket for rights id not available on this console!\n");
+
+    /* Local image files aren't tied to any title on this console. Use the program ID from the NCA header to generate output paths. */
+    nca_ctx->title_id = nca_ctx->header.program_id;
+
+    /* Look for a RomFS section. Patch RomFS sections and sparse sections need a base title, so they're not supported here. */
+    for(u8 i = 0; i < NCA_FS_HEADER_COUNT; i++)
+    {
+        NcaFsSectionContext *cur_nca_fs_ctx = &(nca_ctx->fs_ctx[i]);
+
+        if (cur_nca_fs_ctx->enabled && !cur_nca_fs_ctx->has_sparse_layer && \
+            (cur_nca_fs_ctx->section_type == NcaFsSectionType_RomFs || cur_nca_fs_ctx->section_type == NcaFsSectionType_Nca0RomFs))
+        {
+            nca_fs_ctx = cur_nca_fs_ctx;
+            break;
+        }
+    }
+
+    if (!nca_fs_ctx)
+    {
+        consolePrint("program nca doesn't have a usable romfs section!\n");
+        goto end;
+    }
+
+    if (!romfsInitializeContext(&romfs_ctx, nca_fs_ctx, NULL))
+    {
+        consolePrint("romfs initialize ctx failed!\n");
+        goto end;
+    }
+
+    /* Always use a LayeredFS directory, since there's no title info available to generate regular output paths. */
+    success = (write_raw_section ? saveRawRomFsSection(&romfs_ctx, true) : saveExtractedRomFsSection(&romfs_ctx, true));
+
+end:
+    romfsFreeContext(&romfs_ctx);
+
+    if (nca_ctx) free(nca_ctx);
+
+    contentSourceClose(&nca_source);
+    contentSourceClose(&image_source);
+
+    if (entry_names) free(entry_names);
+
+    return success;
+}
+
 static bool fsBrowser(const char *mount_name, const char *base_out_path)
 {
     char dir_path[FS_MAX_PATH] = {0};
@@ -4323,7 +4729,7 @@ static bool saveExtractedPartitionFsSection(PartitionFileSystemContext *pfs_ctx,
     consolePrint("extracted partitionfs section size: 0x%lX\n", data_size);
     consoleRefresh();
 
-    success = spanDumpThreads(extractedPartitionFsReadThreadFunc, genericWriteThreadFunc, &pfs_thread_data);
+    success = spanDumpThreads(extractedPartitionFsReadThreadFunc, extractedFsWriteThreadFunc, &pfs_thread_data);
 
 end:
     return success;
@@ -4479,7 +4885,7 @@ static bool saveExtractedRomFsSection(RomFileSystemContext *romfs_ctx, bool use_
     consolePrint("extracted romfs section size: 0x%lX\n", data_size);
     consoleRefresh();
 
-    success = spanDumpThreads(extractedRomFsReadThreadFunc, genericWriteThreadFunc, &romfs_thread_data);
+    success = spanDumpThreads(extractedRomFsReadThreadFunc, extractedFsWriteThreadFunc, &romfs_thread_data);
 
 end:
     return success;
@@ -4487,14 +4893,12 @@ end:
 
 static void xciReadThreadFunc(void *arg)
 {
-    void *buf1 = NULL, *buf2 = NULL;
     XciThreadData *xci_thread_data = (XciThreadData*)arg;
     SharedThreadData *shared_thread_data = &(xci_thread_data->shared_thread_data);
+    GameCardStreamChunk chunk = {0}, written_chunk = {0};
+    bool chunk_held = false, written_chunk_held = false, stream_started = false;
 
-    buf1 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
-    buf2 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
-
-    if (!shared_thread_data->total_size || !buf1 || !buf2)
+    if (!shared_thread_data->total_size)
     {
         shared_thread_data->read_error = true;
         goto end;
@@ -4503,14 +4907,19 @@ static void xciReadThreadFunc(void *arg)
     shared_thread_data->data = NULL;
     shared_thread_data->data_size = 0;
 
-    bool prepend_key_area = (bool)getGameCardPrependKeyAreaOption();
+    XciDigestFanOut *digest_fan_out = xci_thread_data->digest_fan_out;
     bool keep_certificate = (bool)getGameCardKeepCertificateOption();
-    bool calculate_checksum = (bool)getGameCardCalculateChecksumOption();
 
-    for(u64 offset = 0, blksize = BLOCK_SIZE; offset < shared_thread_data->total_size; offset += blksize)
+    /* Start gamecard read stream. Data is read ahead by a background thread while we process and write the current chunk. */
+    shared_thread_data->read_error = !(stream_started = gamecardStreamStart(0, shared_thread_data->total_size));
+    if (shared_thread_data->read_error)
     {
-        if (blksize > (shared_thread_data->total_size - offset)) blksize = (shared_thread_data->total_size - offset);
+        condvarWakeAll(&g_writeCondvar);
+        goto end;
+    }
 
+    for(u64 offset = 0; offset < shared_thread_data->total_size; offset += chunk.size)
+    {
         /* Check if the transfer has been cancelled by the user */
         if (shared_thread_data->transfer_cancelled)
         {
@@ -4518,8 +4927,8 @@ static void xciReadThreadFunc(void *arg)
             break;
         }
 
-        /* Read current data chunk */
-        shared_thread_data->read_error = !gamecardReadStorage(buf1, blksize, offset);
+        /* Retrieve current data chunk */
+        shared_thread_data->read_error = !(chunk_held = gamecardStreamRead(&chunk));
         if (shared_thread_data->read_error)
         {
             condvarWakeAll(&g_writeCondvar);
@@ -4527,14 +4936,7 @@ static void xciReadThreadFunc(void *arg)
         }
 
         /* Remove certificate */
-        if (!keep_certificate && offset == 0) memset((u8*)buf1 + GAMECARD_CERTIFICATE_OFFSET, 0xFF, sizeof(FsGameCardCertificate));
-
-        /* Update checksum */
-        if (calculate_checksum)
-        {
-            xci_thread_data->xci_crc = crc32CalculateWithSeed(xci_thread_data->xci_crc, buf1, blksize);
-            if (prepend_key_area) xci_thread_data->full_xci_crc = crc32CalculateWithSeed(xci_thread_data->full_xci_crc, buf1, blksize);
-        }
+        if (!keep_certificate && chunk.offset == 0) memset((u8*)chunk.data + GAMECARD_CERTIFICATE_OFFSET, 0xFF, sizeof(FsGameCardCertificate));
 
         /* Wait until the previous data chunk has been written */
         mutexLock(&g_fileMutex);
@@ -4547,86 +4949,287 @@ static void xciReadThreadFunc(void *arg)
             break;
         }
 
-        /* Update shared object. */
-        shared_thread_data->data = buf1;
-        shared_thread_data->data_size = blksize;
+        /* Wait until the digest workers are done with the previous data chunk, then give it back to the stream. */
+        if (digest_fan_out) xciDigestFanOutWait(digest_fan_out);
+        if (written_chunk_held) gamecardStreamReleaseChunk(&written_chunk);
 
-        /* Swap buffers. */
-        buf1 = buf2;
-        buf2 = shared_thread_data->data;
+        /* Hand the current data chunk off to the digest workers. They read it alongside the write thread. */
+        if (digest_fan_out) xciDigestFanOutSubmit(digest_fan_out, chunk.data, chunk.size);
+
+        /* Update shared object. No copies are made: the write thread takes the stream buffer as-is. */
+        shared_thread_data->data = chunk.data;
+        shared_thread_data->data_size = chunk.size;
+
+        written_chunk = chunk;
+        written_chunk_held = true;
+        chunk_held = false;
 
         /* Wake up the write thread to continue writing data. */
         mutexUnlock(&g_fileMutex);
         condvarWakeAll(&g_writeCondvar);
     }
 
+    /* Wait until the last data chunk has been written, since it points to a stream buffer. */
+    /* The write thread holds the file mutex while writing, so locking it is enough to make sure it's done with the buffer if the dump was interrupted. */
+    if (written_chunk_held)
+    {
+        mutexLock(&g_fileMutex);
+
+        if (shared_thread_data->data_size && !shared_thread_data->read_error && !shared_thread_data->write_error && !shared_thread_data->transfer_cancelled) condvarWait(&g_readCondvar, &g_fileMutex);
+
+        mutexUnlock(&g_fileMutex);
+    }
+
+    if (digest_fan_out) xciDigestFanOutWait(digest_fan_out);
+
 end:
-    if (buf2) free(buf2);
-    if (buf1) free(buf1);
+    if (chunk_held) gamecardStreamReleaseChunk(&chunk);
+    if (written_chunk_held) gamecardStreamReleaseChunk(&written_chunk);
+    if (stream_started) gamecardStreamEnd();
 
     threadExit();
 }
 
-static void rawHfsReadThreadFunc(void *arg)
+static bool xciDigestFanOutInitialize(XciDigestFanOut *fan_out, XciDigestWorker *workers, const GameCardKeyArea *key_area)
 {
-    void *buf1 = NULL, *buf2 = NULL;
-    HfsThreadData *hfs_thread_data = (HfsThreadData*)arg;
-    SharedThreadData *shared_thread_data = &(hfs_thread_data->shared_thread_data);
-    HashFileSystemContext *hfs_ctx = hfs_thread_data->hfs_ctx;
+    if (!fan_out || !workers) return false;
 
-    buf1 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
-    buf2 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
+    memset(fan_out, 0, sizeof(XciDigestFanOut));
 
-    if (!shared_thread_data->total_size || !hfs_ctx || !buf1 || !buf2)
-    {
-        shared_thread_data->read_error = true;
-        goto end;
-    }
+    mutexInit(&(fan_out->mutex));
+    condvarInit(&(fan_out->condvar));
 
-    shared_thread_data->data = NULL;
-    shared_thread_data->data_size = 0;
+    sha1ContextCreate(&(fan_out->xci.sha1_ctx));
+    sha256ContextCreate(&(fan_out->xci.sha256_ctx));
 
-    for(u64 offset = 0, blksize = BLOCK_SIZE; offset < shared_thread_data->total_size; offset += blksize)
+    /* The digests for the XCI image with the key area are seeded with the key area itself. */
+    if (key_area)
     {
-        if (blksize > (shared_thread_data->total_size - offset)) blksize = (shared_thread_data->total_size - offset);
-
-        /* Check if the transfer has been cancelled by the user */
-        if (shared_thread_data->transfer_cancelled)
-        {
-            condvarWakeAll(&g_writeCondvar);
-            break;
-        }
+        fan_out->prepend_key_area = true;
+        fan_out->key_area_crc = fan_out->full_xci.crc32 = crc32Calculate(key_area, sizeof(GameCardKeyArea));
 
-        /* Read current data chunk */
-        shared_thread_data->read_error = !hfsReadPartitionData(hfs_ctx, buf1, blksize, offset);
-        if (shared_thread_data->read_error)
-        {
-            condvarWakeAll(&g_writeCondvar);
-            break;
-        }
+        sha1ContextCreate(&(fan_out->full_xci.sha1_ctx));
+        sha1ContextUpdate(&(fan_out->full_xci.sha1_ctx), key_area, sizeof(GameCardKeyArea));
 
-        /* Wait until the previous data chunk has been written */
-        mutexLock(&g_fileMutex);
+        sha256ContextCreate(&(fan_out->full_xci.sha256_ctx));
+        sha256ContextUpdate(&(fan_out->full_xci.sha256_ctx), key_area, sizeof(GameCardKeyArea));
+    }
 
-        if (shared_thread_data->data_size && !shared_thread_data->write_error) condvarWait(&g_readCondvar, &g_fileMutex);
+    /* Start worker threads. */
+    for(u8 i = 0; i < XciDigestType_Count; i++)
+    {
+        workers[i].fan_out = fan_out;
+        workers[i].type = i;
 
-        if (shared_thread_data->write_error)
+        if (!utilsCreateThread(&(fan_out->threads[i]), xciDigestWorkerThreadFunc, &(workers[i]), i % XCI_DIGEST_WORKER_CORE_COUNT))
         {
-            mutexUnlock(&g_fileMutex);
-            break;
-        }
+            consolePrint("xci digest worker #%u start failed\n", i);
 
-        /* Update shared object. */
-        shared_thread_data->data = buf1;
-        shared_thread_data->data_size = blksize;
+            mutexLock(&(fan_out->mutex));
+            fan_out->stop = true;
+            condvarWakeAll(&(fan_out->condvar));
+            mutexUnlock(&(fan_out->mutex));
 
-        /* Swap buffers. */
-        buf1 = buf2;
-        buf2 = shared_thread_data->data;
+            for(u8 j = 0; j < i; j++) utilsJoinThread(&(fan_out->threads[j]));
 
-        /* Wake up the write thread to continue writing data. */
-        mutexUnlock(&g_fileMutex);
-        condvarWakeAll(&g_writeCondvar);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void xciDigestFanOutFree(XciDigestFanOut *fan_out)
+{
+    /* Digest state is kept around, since it's used after the workers have been stopped. */
+    mutexLock(&(fan_out->mutex));
+    fan_out->stop = true;
+    condvarWakeAll(&(fan_out->condvar));
+    mutexUnlock(&(fan_out->mutex));
+
+    for(u8 i = 0; i < XciDigestType_Count; i++) utilsJoinThread(&(fan_out->threads[i]));
+}
+
+static void xciDigestFanOutSubmit(XciDigestFanOut *fan_out, const void *data, u64 data_size)
+{
+    mutexLock(&(fan_out->mutex));
+
+    /* The previous block must have already been processed by all workers (see xciDigestFanOutWait()). */
+    fan_out->data = data;
+    fan_out->data_size = data_size;
+    fan_out->block_id++;
+    fan_out->pending = XciDigestType_Count;
+
+    condvarWakeAll(&(fan_out->condvar));
+    mutexUnlock(&(fan_out->mutex));
+}
+
+static void xciDigestFanOutWait(XciDigestFanOut *fan_out)
+{
+    mutexLock(&(fan_out->mutex));
+    while(fan_out->pending && !fan_out->stop) condvarWait(&(fan_out->condvar), &(fan_out->mutex));
+    mutexUnlock(&(fan_out->mutex));
+}
+
+static void xciDigestWorkerThreadFunc(void *arg)
+{
+    XciDigestWorker *worker = (XciDigestWorker*)arg;
+    XciDigestFanOut *fan_out = worker->fan_out;
+    u32 block_id = 0;
+
+    while(true)
+    {
+        const void *data = NULL;
+        u64 data_size = 0;
+
+        /* Wait for a new block. */
+        mutexLock(&(fan_out->mutex));
+
+        while(fan_out->block_id == block_id && !fan_out->stop) condvarWait(&(fan_out->condvar), &(fan_out->mutex));
+
+        if (fan_out->stop)
+        {
+            mutexUnlock(&(fan_out->mutex));
+            break;
+        }
+
+        block_id = fan_out->block_id;
+        data = fan_out->data;
+        data_size = fan_out->data_size;
+
+        mutexUnlock(&(fan_out->mutex));
+
+        /* Update the digests handled by this worker. */
+        switch(worker->type)
+        {
+            case XciDigestType_Crc32:
+                fan_out->xci.crc32 = crc32CalculateWithSeed(fan_out->xci.crc32, data, data_size);
+                if (fan_out->prepend_key_area) fan_out->full_xci.crc32 = crc32CalculateWithSeed(fan_out->full_xci.crc32, data, data_size);
+                break;
+            case XciDigestType_Sha1:
+                sha1ContextUpdate(&(fan_out->xci.sha1_ctx), data, data_size);
+                if (fan_out->prepend_key_area) sha1ContextUpdate(&(fan_out->full_xci.sha1_ctx), data, data_size);
+                break;
+            case XciDigestType_Sha256:
+                sha256ContextUpdate(&(fan_out->xci.sha256_ctx), data, data_size);
+                if (fan_out->prepend_key_area) sha256ContextUpdate(&(fan_out->full_xci.sha256_ctx), data, data_size);
+                break;
+            default:
+                break;
+        }
+
+        /* Let the read thread know we're done with this block. */
+        mutexLock(&(fan_out->mutex));
+        if (!--fan_out->pending) condvarWakeAll(&(fan_out->condvar));
+        mutexUnlock(&(fan_out->mutex));
+    }
+
+    threadExit();
+}
+
+static bool saveXciDigestFile(XciDigestFanOut *fan_out, const char *filename)
+{
+    char *digest_str = NULL, *digest_filename = NULL;
+    size_t digest_str_size = 0x400, digest_str_len = 0;
+    bool success = false;
+
+    XciDigestState *states[2] = { &(fan_out->xci), &(fan_out->full_xci) };
+    const char *labels[2] = { "xci", "xci (with key area)" };
+
+    /* The sidecar file is saved next to the XCI, using the same filename with a different extension. */
+    const char *ext = strrchr(filename, '.');
+    size_t filename_len = (ext ? (size_t)(ext - filename) : strlen(filename));
+
+    if (!(digest_str = calloc(digest_str_size, sizeof(char))) || !(digest_filename = calloc(filename_len + 8, sizeof(char)))) goto end;
+
+    snprintf(digest_filename, filename_len + 8, "%.*s.txt", (int)filename_len, filename);
+
+    if (fan_out->prepend_key_area) digest_str_len += snprintf(digest_str + digest_str_len, digest_str_size - digest_str_len, "key area crc32: %08X\n", fan_out->key_area_crc);
+
+    for(u8 i = 0; i < (fan_out->prepend_key_area ? 2 : 1); i++)
+    {
+        u8 sha1_hash[SHA1_HASH_SIZE] = {0}, sha256_hash[SHA256_HASH_SIZE] = {0};
+        char sha1_str[(SHA1_HASH_SIZE * 2) + 1] = {0}, sha256_str[(SHA256_HASH_SIZE * 2) + 1] = {0};
+
+        sha1ContextGetHash(&(states[i]->sha1_ctx), sha1_hash);
+        sha256ContextGetHash(&(states[i]->sha256_ctx), sha256_hash);
+
+        utilsGenerateHexString(sha1_str, sizeof(sha1_str), sha1_hash, sizeof(sha1_hash), false);
+        utilsGenerateHexString(sha256_str, sizeof(sha256_str), sha256_hash, sizeof(sha256_hash), false);
+
+        digest_str_len += snprintf(digest_str + digest_str_len, digest_str_size - digest_str_len, "%s crc32: %08X\n%s sha1: %s\n%s sha256: %s\n", labels[i], states[i]->crc32, labels[i], sha1_str, labels[i], \
+                                   sha256_str);
+    }
+
+    success = saveFileData(digest_filename, digest_str, digest_str_len);
+
+end:
+    if (digest_filename) free(digest_filename);
+    if (digest_str) free(digest_str);
+
+    return success;
+}
+
+static void rawHfsReadThreadFunc(void *arg)
+{
+    void *buf1 = NULL, *buf2 = NULL;
+    HfsThreadData *hfs_thread_data = (HfsThreadData*)arg;
+    SharedThreadData *shared_thread_data = &(hfs_thread_data->shared_thread_data);
+    HashFileSystemContext *hfs_ctx = hfs_thread_data->hfs_ctx;
+
+    buf1 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
+    buf2 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
+
+    if (!shared_thread_data->total_size || !hfs_ctx || !buf1 || !buf2)
+    {
+        shared_thread_data->read_error = true;
+        goto end;
+    }
+
+    shared_thread_data->data = NULL;
+    shared_thread_data->data_size = 0;
+
+    for(u64 offset = 0, blksize = BLOCK_SIZE; offset < shared_thread_data->total_size; offset += blksize)
+    {
+        if (blksize > (shared_thread_data->total_size - offset)) blksize = (shared_thread_data->total_size - offset);
+
+        /* Check if the transfer has been cancelled by the user */
+        if (shared_thread_data->transfer_cancelled)
+        {
+            condvarWakeAll(&g_writeCondvar);
+            break;
+        }
+
+        /* Read current data chunk */
+        shared_thread_data->read_error = !hfsReadPartitionData(hfs_ctx, buf1, blksize, offset);
+        if (shared_thread_data->read_error)
+        {
+            condvarWakeAll(&g_writeCondvar);
+            break;
+        }
+
+        /* Wait until the previous data chunk has been written */
+        mutexLock(&g_fileMutex);
+
+        if (shared_thread_data->data_size && !shared_thread_data->write_error) condvarWait(&g_readCondvar, &g_fileMutex);
+
+        if (shared_thread_data->write_error)
+        {
+            mutexUnlock(&g_fileMutex);
+            break;
+        }
+
+        /* Update shared object. */
+        shared_thread_data->data = buf1;
+        shared_thread_data->data_size = blksize;
+
+        /* Swap buffers. */
+        buf1 = buf2;
+        buf2 = shared_thread_data->data;
+
+        /* Wake up the write thread to continue writing data. */
+        mutexUnlock(&g_fileMutex);
+        condvarWakeAll(&g_writeCondvar);
     }
 
 end:
@@ -4654,14 +5257,20 @@ static void extractedHfsReadThreadFunc(void *arg)
     u64 free_space = 0;
     u32 dev_idx = g_storageMenuElementOption.selected;
 
-    buf1 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
-    buf2 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
+    ExtractedFsWriterPool writer_pool = {0};
+
+    /* Transfer buffers are only needed if we're dealing with a USB host. */
+    if (dev_idx == 1)
+    {
+        buf1 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
+        buf2 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
+    }
 
     snprintf(hfs_path, MAX_ELEMENTS(hfs_path), "/%s", hfs_ctx->name);
     filename = generateOutputGameCardFileName("HFS/Extracted", hfs_path, true);
     filename_len = (filename ? strlen(filename) : 0);
 
-    if (!shared_thread_data->total_size || !hfs_entry_count || !buf1 || !buf2 || !filename)
+    if (!shared_thread_data->total_size || !hfs_entry_count || (dev_idx == 1 && (!buf1 || !buf2)) || !filename)
     {
         shared_thread_data->read_error = true;
         goto end;
@@ -4688,12 +5297,22 @@ static void extractedHfsReadThreadFunc(void *arg)
         }
     }
 
+    /* Start writer threads. */
+    if (!shared_thread_data->read_error && dev_idx != 1 && !extractedFsWriterPoolInitialize(&writer_pool, shared_thread_data, dev_idx))
+    {
+        consolePrint("failed to start writer threads\n");
+        shared_thread_data->read_error = true;
+    }
+
     if (shared_thread_data->read_error)
     {
         condvarWakeAll(&g_writeCondvar);
         goto end;
     }
 
+    /* Create output directory. */
+    if (dev_idx != 1) utilsCreateDirectoryTree(filename, true);
+
     /* Loop through all file entries. */
     for(u32 i = 0; i < hfs_entry_count; i++)
     {
@@ -4704,24 +5323,6 @@ static void extractedHfsReadThreadFunc(void *arg)
             break;
         }
 
-        if (dev_idx != 1)
-        {
-            /* Wait until the previous data chunk has been written */
-            mutexLock(&g_fileMutex);
-            if (shared_thread_data->data_size && !shared_thread_data->write_error) condvarWait(&g_readCondvar, &g_fileMutex);
-            mutexUnlock(&g_fileMutex);
-
-            if (shared_thread_data->write_error) break;
-
-            /* Close file. */
-            if (shared_thread_data->fp)
-            {
-                fclose(shared_thread_data->fp);
-                shared_thread_data->fp = NULL;
-                if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
-            }
-        }
-
         /* Retrieve Hash FS file entry information. */
         shared_thread_data->read_error = ((hfs_entry = hfsGetEntryByIndex(hfs_ctx, i)) == NULL || (hfs_entry_name = hfsGetEntryName(hfs_ctx, hfs_entry)) == NULL);
         if (shared_thread_data->read_error)
@@ -4744,41 +5345,17 @@ static void extractedHfsReadThreadFunc(void *arg)
             if (shared_thread_data->write_error) break;
 
             /* Send current file properties */
-            shared_thread_data->read_error = !usbSendFileProperties(hfs_entry->size, hfs_path);
+            shared_thread_data->read_error = !sendExtractedFileProperties(shared_thread_data, hfs_entry->size, hfs_path);
         } else {
-            /* Create directory tree. */
-            utilsCreateDirectoryTree(hfs_path, false);
-
-            if (dev_idx == 0)
+            /* Don't handle file chunks on FAT12/FAT16/FAT32 formatted UMS devices. */
+            if (dev_idx > 1 && g_umsDevices[dev_idx - 2].fs_type < UsbHsFsDeviceFileSystemType_exFAT && hfs_entry->size > FAT32_FILESIZE_LIMIT)
             {
-                /* Create ConcatenationFile if we're dealing with a big file + SD card as the output storage. */
-                if (hfs_entry->size > FAT32_FILESIZE_LIMIT && !utilsCreateConcatenationFile(hfs_path))
-                {
-                    consolePrint("failed to create concatenation file for \"%s\"!\n", hfs_path);
-                    shared_thread_data->read_error = true;
-                }
-            } else {
-                /* Don't handle file chunks on FAT12/FAT16/FAT32 formatted UMS devices. */
-                if (g_umsDevices[dev_idx - 2].fs_type < UsbHsFsDeviceFileSystemType_exFAT && hfs_entry->size > FAT32_FILESIZE_LIMIT)
-                {
-                    consolePrint("split dumps not supported for FAT12/16/32 volumes in UMS devices (yet)\n");
-                    shared_thread_data->read_error = true;
-                }
+                consolePrint("split dumps not supported for FAT12/16/32 volumes in UMS devices (yet)\n");
+                shared_thread_data->read_error = true;
             }
 
-            if (!shared_thread_data->read_error)
-            {
-                /* Open output file. */
-                shared_thread_data->read_error = ((shared_thread_data->fp = fopen(hfs_path, "wb")) == NULL);
-                if (!shared_thread_data->read_error)
-                {
-                    /* Set file size. */
-                    setvbuf(shared_thread_data->fp, NULL, _IONBF, 0);
-                    ftruncate(fileno(shared_thread_data->fp), (off_t)hfs_entry->size);
-                } else {
-                    consolePrint("failed to open \"%s\" for writing!\n", hfs_path);
-                }
-            }
+            /* Queue output file creation. The writer pool takes care of closing the previous file. */
+            if (!shared_thread_data->read_error && !extractedFsWriterPoolOpenFile(&writer_pool, hfs_path, hfs_entry->size)) break;
         }
 
         if (shared_thread_data->read_error)
@@ -4798,6 +5375,22 @@ static void extractedHfsReadThreadFunc(void *arg)
                 break;
             }
 
+            if (dev_idx != 1)
+            {
+                /* Read current file data chunk into a writer pool buffer, then queue it. */
+                ExtractedFsWriterBuffer *buffer = extractedFsWriterPoolAllocateBuffer(&writer_pool, blksize);
+                if (!buffer) break;
+
+                shared_thread_data->read_error = !hfsReadEntryData(hfs_ctx, hfs_entry, buffer->data, blksize, offset);
+                if (!shared_thread_data->read_error) extractedFsWriterPoolWriteData(&writer_pool, buffer, 0, blksize);
+
+                extractedFsWriterPoolReleaseBuffer(&writer_pool, buffer);
+
+                if (shared_thread_data->read_error || shared_thread_data->write_error) break;
+
+                continue;
+            }
+
             /* Read current file data chunk. */
             shared_thread_data->read_error = !hfsReadEntryData(hfs_ctx, hfs_entry, buf1, blksize, offset);
             if (shared_thread_data->read_error)
@@ -4835,28 +5428,40 @@ static void extractedHfsReadThreadFunc(void *arg)
 
     if (!shared_thread_data->read_error && !shared_thread_data->write_error && !shared_thread_data->transfer_cancelled)
     {
-        /* Wait until the previous file data chunk has been written. */
-        mutexLock(&g_fileMutex);
-        if (shared_thread_data->data_size) condvarWait(&g_readCondvar, &g_fileMutex);
-        mutexUnlock(&g_fileMutex);
+        if (dev_idx == 1)
+        {
+            /* Wait until the previous file data chunk has been written. */
+            mutexLock(&g_fileMutex);
+            if (shared_thread_data->data_size) condvarWait(&g_readCondvar, &g_fileMutex);
+            mutexUnlock(&g_fileMutex);
 
-        if (dev_idx == 1) usbEndExtractedFsDump();
+            if (!usbEndExtractedFsDump())
+            {
+                consolePrint("failed to send pending data to host\n");
+                shared_thread_data->write_error = true;
+            }
+        } else {
+            /* Wait until all queued file data chunks have been written. The writer pool flags write errors on its own. */
+            extractedFsWriterPoolFinish(&writer_pool);
+        }
 
-        consolePrint("successfully saved extracted hfs partition data to \"%s\"\n", filename);
-        consoleRefresh();
+        if (!shared_thread_data->write_error)
+        {
+            consolePrint("successfully saved extracted hfs partition data to \"%s\"\n", filename);
+            consoleRefresh();
+        }
     }
 
 end:
-    if (shared_thread_data->fp)
+    if (writer_pool.initialized)
     {
-        fclose(shared_thread_data->fp);
-        shared_thread_data->fp = NULL;
+        /* Stop writer threads. This also closes all output files. */
+        extractedFsWriterPoolFree(&writer_pool);
 
-        if ((shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) && dev_idx != 1)
-        {
-            utilsDeleteDirectoryRecursively(filename);
-            if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
-        }
+        if (shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) utilsDeleteDirectoryRecursively(filename);
+
+        /* Commit pending SD card filesystem changes. */
+        if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
     }
 
     if (filename) free(filename);
@@ -5029,8 +5634,14 @@ static void extractedPartitionFsReadThreadFunc(void *arg)
     u64 free_space = 0;
     u32 dev_idx = g_storageMenuElementOption.selected;
 
-    buf1 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
-    buf2 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
+    ExtractedFsWriterPool writer_pool = {0};
+
+    /* Transfer buffers are only needed if we're dealing with a USB host. */
+    if (dev_idx == 1)
+    {
+        buf1 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
+        buf2 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
+    }
 
     if (pfs_thread_data->use_layeredfs_dir)
     {
@@ -5049,7 +5660,7 @@ static void extractedPartitionFsReadThreadFunc(void *arg)
 
     filename_len = (filename ? strlen(filename) : 0);
 
-    if (!shared_thread_data->total_size || !pfs_entry_count || !buf1 || !buf2 || !filename)
+    if (!shared_thread_data->total_size || !pfs_entry_count || (dev_idx == 1 && (!buf1 || !buf2)) || !filename)
     {
         shared_thread_data->read_error = true;
         goto end;
@@ -5076,12 +5687,22 @@ static void extractedPartitionFsReadThreadFunc(void *arg)
         }
     }
 
+    /* Start writer threads. */
+    if (!shared_thread_data->read_error && dev_idx != 1 && !extractedFsWriterPoolInitialize(&writer_pool, shared_thread_data, dev_idx))
+    {
+        consolePrint("failed to start writer threads\n");
+        shared_thread_data->read_error = true;
+    }
+
     if (shared_thread_data->read_error)
     {
         condvarWakeAll(&g_writeCondvar);
         goto end;
     }
 
+    /* Create output directory. */
+    if (dev_idx != 1) utilsCreateDirectoryTree(filename, true);
+
     /* Loop through all file entries. */
     for(u32 i = 0; i < pfs_entry_count; i++)
     {
@@ -5092,24 +5713,6 @@ static void extractedPartitionFsReadThreadFunc(void *arg)
             break;
         }
 
-        if (dev_idx != 1)
-        {
-            /* Wait until the previous data chunk has been written */
-            mutexLock(&g_fileMutex);
-            if (shared_thread_data->data_size && !shared_thread_data->write_error) condvarWait(&g_readCondvar, &g_fileMutex);
-            mutexUnlock(&g_fileMutex);
-
-            if (shared_thread_data->write_error) break;
-
-            /* Close file. */
-            if (shared_thread_data->fp)
-            {
-                fclose(shared_thread_data->fp);
-                shared_thread_data->fp = NULL;
-                if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
-            }
-        }
-
         /* Retrieve Partition FS file entry information. */
         shared_thread_data->read_error = ((pfs_entry = pfsGetEntryByIndex(pfs_ctx, i)) == NULL || (pfs_entry_name = pfsGetEntryName(pfs_ctx, pfs_entry)) == NULL);
         if (shared_thread_data->read_error)
@@ -5132,41 +5735,17 @@ static void extractedPartitionFsReadThreadFunc(void *arg)
             if (shared_thread_data->write_error) break;
 
             /* Send current file properties */
-            shared_thread_data->read_error = !usbSendFileProperties(pfs_entry->size, pfs_path);
+            shared_thread_data->read_error = !sendExtractedFileProperties(shared_thread_data, pfs_entry->size, pfs_path);
         } else {
-            /* Create directory tree. */
-            utilsCreateDirectoryTree(pfs_path, false);
-
-            if (dev_idx == 0)
+            /* Don't handle file chunks on FAT12/FAT16/FAT32 formatted UMS devices. */
+            if (dev_idx > 1 && g_umsDevices[dev_idx - 2].fs_type < UsbHsFsDeviceFileSystemType_exFAT && pfs_entry->size > FAT32_FILESIZE_LIMIT)
             {
-                /* Create ConcatenationFile if we're dealing with a big file + SD card as the output storage. */
-                if (pfs_entry->size > FAT32_FILESIZE_LIMIT && !utilsCreateConcatenationFile(pfs_path))
-                {
-                    consolePrint("failed to create concatenation file for \"%s\"!\n", pfs_path);
-                    shared_thread_data->read_error = true;
-                }
-            } else {
-                /* Don't handle file chunks on FAT12/FAT16/FAT32 formatted UMS devices. */
-                if (g_umsDevices[dev_idx - 2].fs_type < UsbHsFsDeviceFileSystemType_exFAT && pfs_entry->size > FAT32_FILESIZE_LIMIT)
-                {
-                    consolePrint("split dumps not supported for FAT12/16/32 volumes in UMS devices (yet)\n");
-                    shared_thread_data->read_error = true;
-                }
+                consolePrint("split dumps not supported for FAT12/16/32 volumes in UMS devices (yet)\n");
+                shared_thread_data->read_error = true;
             }
 
-            if (!shared_thread_data->read_error)
-            {
-                /* Open output file. */
-                shared_thread_data->read_error = ((shared_thread_data->fp = fopen(pfs_path, "wb")) == NULL);
-                if (!shared_thread_data->read_error)
-                {
-                    /* Set file size. */
-                    setvbuf(shared_thread_data->fp, NULL, _IONBF, 0);
-                    ftruncate(fileno(shared_thread_data->fp), (off_t)pfs_entry->size);
-                } else {
-                    consolePrint("failed to open \"%s\" for writing!\n", pfs_path);
-                }
-            }
+            /* Queue output file creation. The writer pool takes care of closing the previous file. */
+            if (!shared_thread_data->read_error && !extractedFsWriterPoolOpenFile(&writer_pool, pfs_path, pfs_entry->size)) break;
         }
 
         if (shared_thread_data->read_error)
@@ -5186,6 +5765,22 @@ static void extractedPartitionFsReadThreadFunc(void *arg)
                 break;
             }
 
+            if (dev_idx != 1)
+            {
+                /* Read current file data chunk into a writer pool buffer, then queue it. */
+                ExtractedFsWriterBuffer *buffer = extractedFsWriterPoolAllocateBuffer(&writer_pool, blksize);
+                if (!buffer) break;
+
+                shared_thread_data->read_error = !pfsReadEntryData(pfs_ctx, pfs_entry, buffer->data, blksize, offset);
+                if (!shared_thread_data->read_error) extractedFsWriterPoolWriteData(&writer_pool, buffer, 0, blksize);
+
+                extractedFsWriterPoolReleaseBuffer(&writer_pool, buffer);
+
+                if (shared_thread_data->read_error || shared_thread_data->write_error) break;
+
+                continue;
+            }
+
             /* Read current file data chunk. */
             shared_thread_data->read_error = !pfsReadEntryData(pfs_ctx, pfs_entry, buf1, blksize, offset);
             if (shared_thread_data->read_error)
@@ -5223,28 +5818,40 @@ static void extractedPartitionFsReadThreadFunc(void *arg)
 
     if (!shared_thread_data->read_error && !shared_thread_data->write_error && !shared_thread_data->transfer_cancelled)
     {
-        /* Wait until the previous file data chunk has been written. */
-        mutexLock(&g_fileMutex);
-        if (shared_thread_data->data_size) condvarWait(&g_readCondvar, &g_fileMutex);
-        mutexUnlock(&g_fileMutex);
+        if (dev_idx == 1)
+        {
+            /* Wait until the previous file data chunk has been written. */
+            mutexLock(&g_fileMutex);
+            if (shared_thread_data->data_size) condvarWait(&g_readCondvar, &g_fileMutex);
+            mutexUnlock(&g_fileMutex);
 
-        if (dev_idx == 1) usbEndExtractedFsDump();
+            if (!usbEndExtractedFsDump())
+            {
+                consolePrint("failed to send pending data to host\n");
+                shared_thread_data->write_error = true;
+            }
+        } else {
+            /* Wait until all queued file data chunks have been written. The writer pool flags write errors on its own. */
+            extractedFsWriterPoolFinish(&writer_pool);
+        }
 
-        consolePrint("successfully saved extracted partitionfs section data to \"%s\"\n", filename);
-        consoleRefresh();
+        if (!shared_thread_data->write_error)
+        {
+            consolePrint("successfully saved extracted partitionfs section data to \"%s\"\n", filename);
+            consoleRefresh();
+        }
     }
 
 end:
-    if (shared_thread_data->fp)
+    if (writer_pool.initialized)
     {
-        fclose(shared_thread_data->fp);
-        shared_thread_data->fp = NULL;
+        /* Stop writer threads. This also closes all output files. */
+        extractedFsWriterPoolFree(&writer_pool);
 
-        if ((shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) && dev_idx != 1)
-        {
-            utilsDeleteDirectoryRecursively(filename);
-            if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
-        }
+        if (shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) utilsDeleteDirectoryRecursively(filename);
+
+        /* Commit pending SD card filesystem changes. */
+        if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
     }
 
     if (filename) free(filename);
@@ -5331,8 +5938,9 @@ static void extractedRomFsReadThreadFunc(void *arg)
     SharedThreadData *shared_thread_data = &(romfs_thread_data->shared_thread_data);
 
     RomFileSystemContext *romfs_ctx = romfs_thread_data->romfs_ctx;
-    RomFileSystemFileEntry *romfs_file_entry = NULL;
-    u64 cur_entry_offset = 0;
+    RomFileSystemFileEntry *romfs_file_entry = NULL, **read_plan = NULL;
+    u32 read_plan_count = 0;
+    u64 cached_offset = 0, cached_size = 0;
 
     char romfs_path[FS_MAX_PATH] = {0}, subdir[0x20] = {0}, *filename = NULL;
     size_t filename_len = 0;
@@ -5347,8 +5955,15 @@ static void extractedRomFsReadThreadFunc(void *arg)
     u32 dev_idx = g_storageMenuElementOption.selected;
     u8 romfs_illegal_char_replace_type = (dev_idx != 0 ? RomFileSystemPathIllegalCharReplaceType_IllegalFsChars : RomFileSystemPathIllegalCharReplaceType_KeepAsciiCharsOnly);
 
-    buf1 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
-    buf2 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
+    ExtractedFsWriterPool writer_pool = {0};
+    ExtractedFsWriterBuffer *cached_buffer = NULL;
+
+    /* Transfer buffers are only needed if we're dealing with a USB host. */
+    if (dev_idx == 1)
+    {
+        buf1 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
+        buf2 = usbAllocatePageAlignedBuffer(BLOCK_SIZE);
+    }
 
     if (romfs_thread_data->use_layeredfs_dir)
     {
@@ -5367,7 +5982,7 @@ static void extractedRomFsReadThreadFunc(void *arg)
 
     filename_len = (filename ? strlen(filename) : 0);
 
-    if (!shared_thread_data->total_size || !buf1 || !buf2 || !filename)
+    if (!shared_thread_data->total_size || (dev_idx == 1 && (!buf1 || !buf2)) || !filename)
     {
         shared_thread_data->read_error = true;
         goto end;
@@ -5396,6 +6011,28 @@ static void extractedRomFsReadThreadFunc(void *arg)
         }
     }
 
+    /* Generate a read plan with all file entries sorted by data offset, so the RomFS data gets read sequentially. */
+    if (!shared_thread_data->read_error && !(read_plan = extractedRomFsGenerateReadPlan(romfs_ctx, &read_plan_count)))
+    {
+        consolePrint("failed to generate romfs read plan\n");
+        shared_thread_data->read_error = true;
+    }
+
+    /* Start writer threads. */
+    if (!shared_thread_data->read_error && dev_idx != 1 && !extractedFsWriterPoolInitialize(&writer_pool, shared_thread_data, dev_idx))
+    {
+        consolePrint("failed to start writer threads\n");
+        shared_thread_data->read_error = true;
+    }
+
+    /* Create the output directory tree beforehand. Each directory is only created once. */
+    if (!shared_thread_data->read_error && dev_idx != 1 && !extractedRomFsCreateDirectoryTree(romfs_ctx, read_plan, read_plan_count, romfs_path, sizeof(romfs_path), filename_len, \
+                                                                                            romfs_illegal_char_replace_type))
+    {
+        consolePrint("failed to create romfs directory tree\n");
+        shared_thread_data->read_error = true;
+    }
+
     if (shared_thread_data->read_error)
     {
         condvarWakeAll(&g_writeCondvar);
@@ -5403,8 +6040,10 @@ static void extractedRomFsReadThreadFunc(void *arg)
     }
 
     /* Loop through all file entries. */
-    while(shared_thread_data->data_written < shared_thread_data->total_size && cur_entry_offset < romfs_ctx->file_table_size)
+    for(u32 i = 0; i < read_plan_count && shared_thread_data->data_written < shared_thread_data->total_size; i++)
     {
+        romfs_file_entry = read_plan[i];
+
         /* Check if the transfer has been cancelled by the user. */
         if (shared_thread_data->transfer_cancelled)
         {
@@ -5412,27 +6051,8 @@ static void extractedRomFsReadThreadFunc(void *arg)
             break;
         }
 
-        if (dev_idx != 1)
-        {
-            /* Wait until the previous data chunk has been written */
-            mutexLock(&g_fileMutex);
-            if (shared_thread_data->data_size && !shared_thread_data->write_error) condvarWait(&g_readCondvar, &g_fileMutex);
-            mutexUnlock(&g_fileMutex);
-
-            if (shared_thread_data->write_error) break;
-
-            /* Close file. */
-            if (shared_thread_data->fp)
-            {
-                fclose(shared_thread_data->fp);
-                shared_thread_data->fp = NULL;
-                if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
-            }
-        }
-
-        /* Retrieve RomFS file entry information and generate output path. */
-        shared_thread_data->read_error = (!(romfs_file_entry = romfsGetFileEntryByOffset(romfs_ctx, cur_entry_offset)) || \
-                                           !romfsGeneratePathFromFileEntry(romfs_ctx, romfs_file_entry, romfs_path + filename_len, sizeof(romfs_path) - filename_len, romfs_illegal_char_replace_type));
+        /* Generate output path. */
+        shared_thread_data->read_error = !romfsGeneratePathFromFileEntry(romfs_ctx, romfs_file_entry, romfs_path + filename_len, sizeof(romfs_path) - filename_len, romfs_illegal_char_replace_type);
         if (shared_thread_data->read_error)
         {
             condvarWakeAll(&g_writeCondvar);
@@ -5449,41 +6069,17 @@ static void extractedRomFsReadThreadFunc(void *arg)
             if (shared_thread_data->write_error) break;
 
             /* Send current file properties */
-            shared_thread_data->read_error = !usbSendFileProperties(romfs_file_entry->size, romfs_path);
+            shared_thread_data->read_error = !sendExtractedFileProperties(shared_thread_data, romfs_file_entry->size, romfs_path);
         } else {
-            /* Create directory tree. */
-            utilsCreateDirectoryTree(romfs_path, false);
-
-            if (dev_idx == 0)
+            /* Don't handle file chunks on FAT12/FAT16/FAT32 formatted UMS devices. */
+            if (dev_idx > 1 && g_umsDevices[dev_idx - 2].fs_type < UsbHsFsDeviceFileSystemType_exFAT && romfs_file_entry->size > FAT32_FILESIZE_LIMIT)
             {
-                /* Create ConcatenationFile if we're dealing with a big file + SD card as the output storage. */
-                if (romfs_file_entry->size > FAT32_FILESIZE_LIMIT && !utilsCreateConcatenationFile(romfs_path))
-                {
-                    consolePrint("failed to create concatenation file for \"%s\"!\n", romfs_path);
-                    shared_thread_data->read_error = true;
-                }
-            } else {
-                /* Don't handle file chunks on FAT12/FAT16/FAT32 formatted UMS devices. */
-                if (g_umsDevices[dev_idx - 2].fs_type < UsbHsFsDeviceFileSystemType_exFAT && romfs_file_entry->size > FAT32_FILESIZE_LIMIT)
-                {
-                    consolePrint("split dumps not supported for FAT12/16/32 volumes in UMS devices (yet)\n");
-                    shared_thread_data->read_error = true;
-                }
+                consolePrint("split dumps not supported for FAT12/16/32 volumes in UMS devices (yet)\n");
+                shared_thread_data->read_error = true;
             }
 
-            if (!shared_thread_data->read_error)
-            {
-                /* Open output file. */
-                shared_thread_data->read_error = ((shared_thread_data->fp = fopen(romfs_path, "wb")) == NULL);
-                if (!shared_thread_data->read_error)
-                {
-                    /* Set file size. */
-                    setvbuf(shared_thread_data->fp, NULL, _IONBF, 0);
-                    ftruncate(fileno(shared_thread_data->fp), (off_t)romfs_file_entry->size);
-                } else {
-                    consolePrint("failed to open \"%s\" for writing!\n", romfs_path);
-                }
-            }
+            /* Queue output file creation. The writer pool takes care of closing the previous file. */
+            if (!shared_thread_data->read_error && !extractedFsWriterPoolOpenFile(&writer_pool, romfs_path, romfs_file_entry->size)) break;
         }
 
         if (shared_thread_data->read_error)
@@ -5503,12 +6099,43 @@ static void extractedRomFsReadThreadFunc(void *arg)
                 break;
             }
 
-            /* Read current file data chunk. */
-            shared_thread_data->read_error = !romfsReadFileEntryData(romfs_ctx, romfs_file_entry, buf1, blksize, offset);
-            if (shared_thread_data->read_error)
+            /* Check if the current file data chunk is already available from a previous coalesced read. */
+            u64 data_offset = (romfs_file_entry->offset + offset);
+            bool cached = (cached_size && data_offset >= cached_offset && (data_offset + blksize) <= (cached_offset + cached_size));
+
+            if (!cached)
             {
-                condvarWakeAll(&g_writeCondvar);
-                break;
+                /* Read current file data chunk, along with the data from as many of the following file entries as possible. */
+                u64 read_size = extractedRomFsGetCoalescedReadSize(read_plan, read_plan_count, i, data_offset, blksize);
+                void *read_buf = buf1;
+
+                if (dev_idx != 1)
+                {
+                    /* Drop our reference to the previous coalesced buffer. Queued jobs keep it alive until its data has been written. */
+                    extractedFsWriterPoolReleaseBuffer(&writer_pool, cached_buffer);
+                    cached_size = 0;
+
+                    if (!(cached_buffer = extractedFsWriterPoolAllocateBuffer(&writer_pool, read_size))) break;
+
+                    read_buf = cached_buffer->data;
+                }
+
+                shared_thread_data->read_error = !romfsReadFileSystemData(romfs_ctx, read_buf, read_size, romfs_ctx->body_offset + data_offset);
+                if (shared_thread_data->read_error)
+                {
+                    condvarWakeAll(&g_writeCondvar);
+                    break;
+                }
+
+                cached_offset = data_offset;
+                cached_size = read_size;
+            }
+
+            if (dev_idx != 1)
+            {
+                /* Queue current file data chunk. */
+                if (!extractedFsWriterPoolWriteData(&writer_pool, cached_buffer, data_offset - cached_offset, blksize)) break;
+                continue;
             }
 
             /* Wait until the previous file data chunk has been written. */
@@ -5523,12 +6150,20 @@ static void extractedRomFsReadThreadFunc(void *arg)
             }
 
             /* Update shared object. */
-            shared_thread_data->data = buf1;
-            shared_thread_data->data_size = blksize;
+            if (cached)
+            {
+                /* Coalesced data always lives in the buffer that was last handed off to the write thread. */
+                /* It's only ever read from while cached, so there's no need to swap buffers. */
+                shared_thread_data->data = ((u8*)buf2 + (data_offset - cached_offset));
+            } else {
+                shared_thread_data->data = buf1;
 
-            /* Swap buffers. */
-            buf1 = buf2;
-            buf2 = shared_thread_data->data;
+                /* Swap buffers. */
+                buf1 = buf2;
+                buf2 = shared_thread_data->data;
+            }
+
+            shared_thread_data->data_size = blksize;
 
             /* Wake up the write thread to continue writing data. */
             mutexUnlock(&g_fileMutex);
@@ -5536,37 +6171,53 @@ static void extractedRomFsReadThreadFunc(void *arg)
         }
 
         if (shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) break;
-
-        /* Get the offset for the next file entry. */
-        cur_entry_offset += ALIGN_UP(sizeof(RomFileSystemFileEntry) + romfs_file_entry->name_length, ROMFS_TABLE_ENTRY_ALIGNMENT);
     }
 
     if (!shared_thread_data->read_error && !shared_thread_data->write_error && !shared_thread_data->transfer_cancelled)
     {
-        /* Wait until the previous file data chunk has been written. */
-        mutexLock(&g_fileMutex);
-        if (shared_thread_data->data_size) condvarWait(&g_readCondvar, &g_fileMutex);
-        mutexUnlock(&g_fileMutex);
+        if (dev_idx == 1)
+        {
+            /* Wait until the previous file data chunk has been written. */
+            mutexLock(&g_fileMutex);
+            if (shared_thread_data->data_size) condvarWait(&g_readCondvar, &g_fileMutex);
+            mutexUnlock(&g_fileMutex);
+
+            if (!usbEndExtractedFsDump())
+            {
+                consolePrint("failed to send pending data to host\n");
+                shared_thread_data->write_error = true;
+            }
+        } else {
+            /* Wait until all queued file data chunks have been written. The writer pool flags write errors on its own. */
+            extractedFsWriterPoolReleaseBuffer(&writer_pool, cached_buffer);
+            cached_buffer = NULL;
 
-        if (dev_idx == 1) usbEndExtractedFsDump();
+            extractedFsWriterPoolFinish(&writer_pool);
+        }
 
-        consolePrint("successfully saved extracted romfs section data to \"%s\"\n", filename);
-        consoleRefresh();
+        if (!shared_thread_data->write_error)
+        {
+            consolePrint("successfully saved extracted romfs section data to \"%s\"\n", filename);
+            consoleRefresh();
+        }
     }
 
 end:
-    if (shared_thread_data->fp)
+    if (writer_pool.initialized)
     {
-        fclose(shared_thread_data->fp);
-        shared_thread_data->fp = NULL;
+        extractedFsWriterPoolReleaseBuffer(&writer_pool, cached_buffer);
 
-        if ((shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) && dev_idx != 1)
-        {
-            utilsDeleteDirectoryRecursively(filename);
-            if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
-        }
+        /* Stop writer threads. This also closes all output files. */
+        extractedFsWriterPoolFree(&writer_pool);
+
+        if (shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) utilsDeleteDirectoryRecursively(filename);
+
+        /* Commit pending SD card filesystem changes. */
+        if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
     }
 
+    if (read_plan) free(read_plan);
+
     if (filename) free(filename);
 
     if (buf2) free(buf2);
@@ -5575,6 +6226,106 @@ end:
     threadExit();
 }
 
+static RomFileSystemFileEntry **extractedRomFsGenerateReadPlan(RomFileSystemContext *romfs_ctx, u32 *out_count)
+{
+    RomFileSystemFileEntry *romfs_file_entry = NULL, **read_plan = NULL;
+    u64 cur_entry_offset = 0;
+    u32 count = 0;
+
+    /* Count file entries. */
+    while(cur_entry_offset < romfs_ctx->file_table_size)
+    {
+        if (!(romfs_file_entry = romfsGetFileEntryByOffset(romfs_ctx, cur_entry_offset))) return NULL;
+        cur_entry_offset += ALIGN_UP(sizeof(RomFileSystemFileEntry) + romfs_file_entry->name_length, ROMFS_TABLE_ENTRY_ALIGNMENT);
+        count++;
+    }
+
+    if (!count || !(read_plan = calloc(count, sizeof(RomFileSystemFileEntry*)))) return NULL;
+
+    /* Fill read plan. */
+    cur_entry_offset = 0;
+
+    for(u32 i = 0; i < count; i++)
+    {
+        read_plan[i] = romfs_file_entry = romfsGetFileEntryByOffset(romfs_ctx, cur_entry_offset);
+        cur_entry_offset += ALIGN_UP(sizeof(RomFileSystemFileEntry) + romfs_file_entry->name_length, ROMFS_TABLE_ENTRY_ALIGNMENT);
+    }
+
+    /* Sort file entries by data offset. */
+    qsort(read_plan, count, sizeof(RomFileSystemFileEntry*), &extractedRomFsReadPlanSortFunction);
+
+    *out_count = count;
+
+    return read_plan;
+}
+
+static int extractedRomFsReadPlanSortFunction(const void *a, const void *b)
+{
+    const RomFileSystemFileEntry *file_entry_1 = *((const RomFileSystemFileEntry**)a);
+    const RomFileSystemFileEntry *file_entry_2 = *((const RomFileSystemFileEntry**)b);
+
+    if (file_entry_1->offset != file_entry_2->offset) return (file_entry_1->offset < file_entry_2->offset ? -1 : 1);
+
+    /* Keep file table order for entries that share the same data offset. */
+    return (file_entry_1 < file_entry_2 ? -1 : (file_entry_1 > file_entry_2 ? 1 : 0));
+}
+
+static bool extractedRomFsCreateDirectoryTree(RomFileSystemContext *romfs_ctx, RomFileSystemFileEntry **read_plan, u32 read_plan_count, char *path, size_t path_size, size_t base_path_len, \
+                                              u8 illegal_char_replace_type)
+{
+    RomFileSystemDirectoryEntry *romfs_dir_entry = NULL;
+    u64 dir_count = (romfs_ctx->dir_table_size / ROMFS_TABLE_ENTRY_ALIGNMENT);
+    u8 *dir_bitmap = NULL;
+    bool success = false;
+
+    /* Directory entries are always aligned to a ROMFS_TABLE_ENTRY_ALIGNMENT boundary, so we can use a single bit per aligned offset to keep track of the directories we have already created. */
+    /* Only directories that hold at least one file entry get created. */
+    if (!(dir_bitmap = calloc(ALIGN_UP(dir_count, 8) / 8, sizeof(u8)))) goto end;
+
+    for(u32 i = 0; i < read_plan_count; i++)
+    {
+        u64 dir_idx = (read_plan[i]->parent_offset / ROMFS_TABLE_ENTRY_ALIGNMENT);
+        if (dir_idx >= dir_count) goto end;
+
+        if (dir_bitmap[dir_idx / 8] & (1U << (dir_idx % 8))) continue;
+
+        /* Generate directory path and create it. */
+        if (!(romfs_dir_entry = romfsGetDirectoryEntryByOffset(romfs_ctx, read_plan[i]->parent_offset)) || \
+            !romfsGeneratePathFromDirectoryEntry(romfs_ctx, romfs_dir_entry, path + base_path_len, path_size - base_path_len, illegal_char_replace_type)) goto end;
+
+        utilsCreateDirectoryTree(path, true);
+
+        dir_bitmap[dir_idx / 8] |= (u8)(1U << (dir_idx % 8));
+    }
+
+    success = true;
+
+end:
+    if (dir_bitmap) free(dir_bitmap);
+
+    return success;
+}
+
+static u64 extractedRomFsGetCoalescedReadSize(RomFileSystemFileEntry **read_plan, u32 read_plan_count, u32 idx, u64 data_offset, u64 data_size)
+{
+    u64 data_end = (data_offset + data_size);
+
+    /* Extend the read with data from the following file entries, as long as they're close enough and everything fits within a single block. */
+    for(u32 i = (idx + 1); i < read_plan_count; i++)
+    {
+        RomFileSystemFileEntry *romfs_file_entry = read_plan[i];
+        u64 file_end = (romfs_file_entry->offset + romfs_file_entry->size);
+
+        if (!romfs_file_entry->size) continue;
+
+        if (romfs_file_entry->offset > (data_end + ROMFS_COALESCE_MAX_GAP) || romfs_file_entry->offset < data_offset || file_end > (data_offset + BLOCK_SIZE)) break;
+
+        if (file_end > data_end) data_end = file_end;
+    }
+
+    return (data_end - data_offset);
+}
+
 static void fsBrowserFileReadThreadFunc(void *arg)
 {
     void *buf1 = NULL, *buf2 = NULL;
@@ -5696,10 +6447,14 @@ static void fsBrowserHighlightedEntriesReadThreadFunc(void *arg)
 
         if (!shared_thread_data->read_error && !shared_thread_data->write_error && !shared_thread_data->transfer_cancelled)
         {
-            if (dev_idx == 1) usbEndExtractedFsDump();
-
-            consolePrint("successfully saved dumped data to \"%s\"\n", base_out_path);
-            consoleRefresh();
+            if (dev_idx == 1 && !usbEndExtractedFsDump())
+            {
+                consolePrint("failed to send pending data to host\n");
+                shared_thread_data->write_error = true;
+            } else {
+                consolePrint("successfully saved dumped data to \"%s\"\n", base_out_path);
+                consoleRefresh();
+            }
         }
     } else {
         condvarWakeAll(&g_writeCondvar);
@@ -5809,7 +6564,7 @@ static bool fsBrowserHighlightedEntriesReadThreadLoop(SharedThreadData *shared_t
             if (shared_thread_data->write_error) break;
 
             /* Send current file properties */
-            shared_thread_data->read_error = !usbSendFileProperties(entry->size, tmp_path);
+            shared_thread_data->read_error = !sendExtractedFileProperties(shared_thread_data, entry->size, tmp_path);
         } else {
             /* Create directory tree. */
             utilsCreateDirectoryTree(tmp_path, false);
@@ -5914,67 +6669,444 @@ static bool fsBrowserHighlightedEntriesReadThreadLoop(SharedThreadData *shared_t
 end:
     if (shared_thread_data->fp)
     {
-        fclose(shared_thread_data->fp);
-        shared_thread_data->fp = NULL;
+        fclose(shared_thread_data->fp);
+        shared_thread_data->fp = NULL;
+
+        if ((shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) && dev_idx != 1)
+        {
+            utilsDeleteDirectoryRecursively(base_out_path);
+            if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
+        }
+    }
+
+    if (src) fclose(src);
+
+    if (!is_topmost && entries) free((FsBrowserEntry*)entries);
+
+    if (tmp_path) free(tmp_path);
+
+    return !shared_thread_data->read_error;
+}
+
+static bool sendExtractedFileProperties(SharedThreadData *shared_thread_data, u64 file_size, const char *path)
+{
+    /* Small files are sent through file streams, which get packed together and acknowledged in batches by the host. */
+    /* This avoids a full command round-trip per file. Bigger files still use regular file transfers. */
+    shared_thread_data->use_usb_file_stream = (file_size < BLOCK_SIZE);
+
+    if (shared_thread_data->use_usb_file_stream) return usbOpenFileStream(file_size, path, &(shared_thread_data->usb_file_stream_id));
+
+    return usbSendFileProperties(file_size, path);
+}
+
+static void genericWriteThreadFunc(void *arg)
+{
+    SharedThreadData *shared_thread_data = (SharedThreadData*)arg; // UB but we don't care
+
+    while(shared_thread_data->data_written < shared_thread_data->total_size)
+    {
+        /* Wait until the current file data chunk has been read */
+        mutexLock(&g_fileMutex);
+
+        if (!shared_thread_data->data_size && !shared_thread_data->read_error) condvarWait(&g_writeCondvar, &g_fileMutex);
+
+        if (shared_thread_data->read_error || shared_thread_data->transfer_cancelled || (!useUsbHost() && !shared_thread_data->fp))
+        {
+            if (useUsbHost() && shared_thread_data->transfer_cancelled) usbCancelFileTransfer();
+            mutexUnlock(&g_fileMutex);
+            break;
+        }
+
+        /* Write current file data chunk */
+        if (useUsbHost() && shared_thread_data->use_usb_file_stream)
+        {
+            shared_thread_data->write_error = !usbSendFileStreamData(shared_thread_data->usb_file_stream_id, shared_thread_data->data, shared_thread_data->data_size);
+        } else
+        if (useUsbHost())
+        {
+            shared_thread_data->write_error = !usbSendFileData(shared_thread_data->data, shared_thread_data->data_size);
+        } else {
+            shared_thread_data->write_error = (fwrite(shared_thread_data->data, 1, shared_thread_data->data_size, shared_thread_data->fp) != shared_thread_data->data_size);
+        }
+
+        if (!shared_thread_data->write_error)
+        {
+            shared_thread_data->data_written += shared_thread_data->data_size;
+            shared_thread_data->data_size = 0;
+        }
+
+        /* Wake up the read thread to continue reading data */
+        mutexUnlock(&g_fileMutex);
+        condvarWakeAll(&g_readCondvar);
+
+        if (shared_thread_data->write_error) break;
+    }
+
+    threadExit();
+}
+
+static void extractedFsWriteThreadFunc(void *arg)
+{
+    /* Extracted filesystem dumps are only sent through the shared thread data object if we're dealing with a USB host. */
+    /* Otherwise, file data is written by the writer pool owned by the read thread. */
+    if (useUsbHost()) genericWriteThreadFunc(arg);
+
+    threadExit();
+}
+
+static bool extractedFsWriterPoolInitialize(ExtractedFsWriterPool *pool, SharedThreadData *shared_thread_data, u32 dev_idx)
+{
+    if (!pool || !shared_thread_data) return false;
+
+    memset(pool, 0, sizeof(ExtractedFsWriterPool));
+
+    pool->shared_thread_data = shared_thread_data;
+    pool->dev_idx = dev_idx;
+    pool->initialized = true;
+
+    /* Start writer threads. The read thread runs on core 2, so we use the remaining ones. */
+    for(u32 i = 0; i < EXTRACTED_FS_WRITER_THREAD_COUNT; i++)
+    {
+        ExtractedFsWriter *writer = &(pool->writers[i]);
+        writer->pool = pool;
+
+        if (!utilsCreateThread(&(writer->thread), extractedFsWriterThreadFunc, writer, (int)(i % 2)))
+        {
+            consolePrint("failed to create writer thread #%u\n", i);
+            extractedFsWriterPoolFree(pool);
+            return false;
+        }
+
+        pool->writer_count++;
+    }
+
+    return true;
+}
+
+static void extractedFsWriterPoolFree(ExtractedFsWriterPool *pool)
+{
+    if (!pool || !pool->initialized) return;
+
+    /* Stop writer threads. Jobs left in their queues are still processed in order to drop buffer references, but no data is written if the dump failed or was cancelled. */
+    mutexLock(&(pool->mutex));
+    pool->stop = true;
+    for(u32 i = 0; i < pool->writer_count; i++) condvarWakeAll(&(pool->writers[i].condvar));
+    mutexUnlock(&(pool->mutex));
+
+    for(u32 i = 0; i < pool->writer_count; i++) utilsJoinThread(&(pool->writers[i].thread));
+
+    memset(pool, 0, sizeof(ExtractedFsWriterPool));
+}
+
+static void extractedFsWriterPoolSetError(ExtractedFsWriterPool *pool)
+{
+    mutexLock(&(pool->mutex));
+
+    pool->error = pool->shared_thread_data->write_error = true;
+    condvarWakeAll(&(pool->condvar));
+
+    mutexUnlock(&(pool->mutex));
+}
+
+static bool extractedFsWriterPoolPushJob(ExtractedFsWriterPool *pool, u32 writer_idx, const ExtractedFsWriterJob *job)
+{
+    ExtractedFsWriter *writer = &(pool->writers[writer_idx]);
+    bool ret = false;
+
+    mutexLock(&(pool->mutex));
+
+    /* Wait until there's a free slot in the writer queue. */
+    while(writer->count >= EXTRACTED_FS_WRITER_QUEUE_SIZE && !pool->error) condvarWait(&(pool->condvar), &(pool->mutex));
+
+    if (!pool->error)
+    {
+        writer->jobs[(writer->head + writer->count) % EXTRACTED_FS_WRITER_QUEUE_SIZE] = *job;
+        writer->count++;
+
+        if (job->type == ExtractedFsWriterJobType_WriteData) job->buffer->ref_count++;
+
+        condvarWakeAll(&(writer->condvar));
+
+        ret = true;
+    }
+
+    mutexUnlock(&(pool->mutex));
+
+    return ret;
+}
+
+static bool extractedFsWriterPoolOpenFile(ExtractedFsWriterPool *pool, const char *path, u64 file_size)
+{
+    ExtractedFsWriterJob job = { .type = ExtractedFsWriterJobType_OpenFile, .file_size = file_size };
+    u32 writer_idx = 0;
+
+    /* Close the previous file. */
+    if (!extractedFsWriterPoolCloseFile(pool)) return false;
+
+    if (!(job.path = strdup(path)))
+    {
+        consolePrint("failed to duplicate output path\n");
+        extractedFsWriterPoolSetError(pool);
+        return false;
+    }
+
+    /* Pick the least busy writer, starting right after the one that handled the previous file. */
+    /* This lets the creation of this file overlap with data writes for the previous ones. */
+    mutexLock(&(pool->mutex));
+
+    writer_idx = ((pool->cur_writer + 1) % pool->writer_count);
+
+    for(u32 i = 1; i < pool->writer_count; i++)
+    {
+        u32 idx = ((writer_idx + i) % pool->writer_count);
+        if ((pool->writers[idx].count + pool->writers[idx].busy) < (pool->writers[writer_idx].count + pool->writers[writer_idx].busy)) writer_idx = idx;
+    }
+
+    mutexUnlock(&(pool->mutex));
+
+    if (!extractedFsWriterPoolPushJob(pool, writer_idx, &job))
+    {
+        free(job.path);
+        return false;
+    }
+
+    pool->cur_writer = writer_idx;
+    pool->file_open = true;
+
+    return true;
+}
+
+static bool extractedFsWriterPoolCloseFile(ExtractedFsWriterPool *pool)
+{
+    ExtractedFsWriterJob job = { .type = ExtractedFsWriterJobType_CloseFile };
+
+    if (!pool->file_open) return true;
+
+    pool->file_open = false;
+
+    return extractedFsWriterPoolPushJob(pool, pool->cur_writer, &job);
+}
+
+static ExtractedFsWriterBuffer *extractedFsWriterPoolAllocateBuffer(ExtractedFsWriterPool *pool, u64 size)
+{
+    ExtractedFsWriterBuffer *buffer = NULL;
+    bool reserved = false;
+
+    mutexLock(&(pool->mutex));
+
+    /* Wait until there's enough room for this buffer. A single buffer is always allowed, regardless of its size. */
+    while(pool->pending_size && (pool->pending_size + size) > EXTRACTED_FS_WRITER_MAX_PENDING_SIZE && !pool->error) condvarWait(&(pool->condvar), &(pool->mutex));
+
+    if (!pool->error)
+    {
+        pool->pending_size += size;
+        reserved = true;
+    }
+
+    mutexUnlock(&(pool->mutex));
+
+    if (!reserved) return NULL;
+
+    if (!(buffer = calloc(1, sizeof(ExtractedFsWriterBuffer))) || !(buffer->data = malloc(size)))
+    {
+        consolePrint("failed to allocate 0x%lX-byte long writer buffer\n", size);
+
+        if (buffer) free(buffer);
+
+        mutexLock(&(pool->mutex));
+        pool->pending_size -= size;
+        mutexUnlock(&(pool->mutex));
+
+        extractedFsWriterPoolSetError(pool);
+
+        return NULL;
+    }
+
+    buffer->size = size;
+    buffer->ref_count = 1;
+
+    return buffer;
+}
+
+static void extractedFsWriterPoolReleaseBuffer(ExtractedFsWriterPool *pool, ExtractedFsWriterBuffer *buffer)
+{
+    if (!buffer) return;
+
+    mutexLock(&(pool->mutex));
+    extractedFsWriterPoolDropBufferReference(pool, buffer);
+    mutexUnlock(&(pool->mutex));
+}
+
+static void extractedFsWriterPoolDropBufferReference(ExtractedFsWriterPool *pool, ExtractedFsWriterBuffer *buffer)
+{
+    /* The pool mutex must be held by the caller. */
+    if (--buffer->ref_count) return;
+
+    pool->pending_size -= buffer->size;
+
+    free(buffer->data);
+    free(buffer);
+
+    condvarWakeAll(&(pool->condvar));
+}
+
+static bool extractedFsWriterPoolWriteData(ExtractedFsWriterPool *pool, ExtractedFsWriterBuffer *buffer, u64 data_offset, u64 data_size)
+{
+    ExtractedFsWriterJob job = { .type = ExtractedFsWriterJobType_WriteData, .buffer = buffer, .data_offset = data_offset, .data_size = data_size };
+
+    if (!pool->file_open || !buffer || (data_offset + data_size) > buffer->size)
+    {
+        extractedFsWriterPoolSetError(pool);
+        return false;
+    }
+
+    return extractedFsWriterPoolPushJob(pool, pool->cur_writer, &job);
+}
+
+static bool extractedFsWriterPoolFinish(ExtractedFsWriterPool *pool)
+{
+    bool ret = false;
+
+    /* Close the last file. */
+    if (!extractedFsWriterPoolCloseFile(pool)) return false;
+
+    mutexLock(&(pool->mutex));
+
+    /* Wait until all queued jobs have been processed. */
+    while(!pool->error)
+    {
+        u32 i = 0;
 
-        if ((shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled) && dev_idx != 1)
+        for(i = 0; i < pool->writer_count; i++)
         {
-            utilsDeleteDirectoryRecursively(base_out_path);
-            if (dev_idx == 0) utilsCommitSdCardFileSystemChanges();
+            if (pool->writers[i].count || pool->writers[i].busy) break;
         }
-    }
 
-    if (src) fclose(src);
+        if (i >= pool->writer_count) break;
 
-    if (!is_topmost && entries) free((FsBrowserEntry*)entries);
+        condvarWait(&(pool->condvar), &(pool->mutex));
+    }
 
-    if (tmp_path) free(tmp_path);
+    ret = !pool->error;
 
-    return !shared_thread_data->read_error;
+    mutexUnlock(&(pool->mutex));
+
+    return ret;
 }
 
-static void genericWriteThreadFunc(void *arg)
+static void extractedFsWriterThreadFunc(void *arg)
 {
-    SharedThreadData *shared_thread_data = (SharedThreadData*)arg; // UB but we don't care
+    ExtractedFsWriter *writer = (ExtractedFsWriter*)arg;
+    ExtractedFsWriterPool *pool = writer->pool;
+    SharedThreadData *shared_thread_data = pool->shared_thread_data;
+    ExtractedFsWriterJob job = {0};
 
-    while(shared_thread_data->data_written < shared_thread_data->total_size)
+    while(true)
     {
-        /* Wait until the current file data chunk has been read */
-        mutexLock(&g_fileMutex);
+        bool skip = false, success = true, commit = false;
 
-        if (!shared_thread_data->data_size && !shared_thread_data->read_error) condvarWait(&g_writeCondvar, &g_fileMutex);
+        mutexLock(&(pool->mutex));
 
-        if (shared_thread_data->read_error || shared_thread_data->transfer_cancelled || (!useUsbHost() && !shared_thread_data->fp))
+        while(!writer->count && !pool->stop) condvarWait(&(writer->condvar), &(pool->mutex));
+
+        /* Only bail out once the queue is empty, so that buffer references held by queued jobs are always dropped. */
+        if (!writer->count)
         {
-            if (useUsbHost() && shared_thread_data->transfer_cancelled) usbCancelFileTransfer();
-            mutexUnlock(&g_fileMutex);
+            mutexUnlock(&(pool->mutex));
             break;
         }
 
-        /* Write current file data chunk */
-        if (useUsbHost())
+        job = writer->jobs[writer->head];
+        writer->head = ((writer->head + 1) % EXTRACTED_FS_WRITER_QUEUE_SIZE);
+        writer->count--;
+        writer->busy = true;
+
+        /* Don't bother with file I/O if the dump has already failed or been cancelled. */
+        skip = (pool->error || shared_thread_data->read_error || shared_thread_data->write_error || shared_thread_data->transfer_cancelled);
+
+        mutexUnlock(&(pool->mutex));
+
+        switch(job.type)
         {
-            shared_thread_data->write_error = !usbSendFileData(shared_thread_data->data, shared_thread_data->data_size);
-        } else {
-            shared_thread_data->write_error = (fwrite(shared_thread_data->data, 1, shared_thread_data->data_size, shared_thread_data->fp) != shared_thread_data->data_size);
+            case ExtractedFsWriterJobType_OpenFile:
+                if (!skip) success = extractedFsWriterOpenFile(writer, job.path, job.file_size);
+                free(job.path);
+                break;
+            case ExtractedFsWriterJobType_WriteData:
+                if (!skip)
+                {
+                    success = (writer->fp && fwrite((u8*)job.buffer->data + job.data_offset, 1, job.data_size, writer->fp) == job.data_size);
+                    if (!success) consolePrint("fwrite failed\n");
+                }
+
+                break;
+            case ExtractedFsWriterJobType_CloseFile:
+                if (writer->fp)
+                {
+                    fclose(writer->fp);
+                    writer->fp = NULL;
+                }
+
+                break;
+            default:
+                break;
         }
 
-        if (!shared_thread_data->write_error)
+        mutexLock(&(pool->mutex));
+
+        if (!success) pool->error = shared_thread_data->write_error = true;
+
+        if (job.type == ExtractedFsWriterJobType_WriteData)
         {
-            shared_thread_data->data_written += shared_thread_data->data_size;
-            shared_thread_data->data_size = 0;
+            if (!skip && success) shared_thread_data->data_written += job.data_size;
+            extractedFsWriterPoolDropBufferReference(pool, job.buffer);
+        } else
+        if (job.type == ExtractedFsWriterJobType_CloseFile)
+        {
+            /* SD card filesystem changes are committed in batches. */
+            commit = (pool->dev_idx == 0 && !(++pool->closed_file_count % EXTRACTED_FS_COMMIT_FILE_COUNT));
         }
 
-        /* Wake up the read thread to continue reading data */
-        mutexUnlock(&g_fileMutex);
-        condvarWakeAll(&g_readCondvar);
+        writer->busy = false;
+        condvarWakeAll(&(pool->condvar));
 
-        if (shared_thread_data->write_error) break;
+        mutexUnlock(&(pool->mutex));
+
+        if (commit) utilsCommitSdCardFileSystemChanges();
+    }
+
+    if (writer->fp)
+    {
+        fclose(writer->fp);
+        writer->fp = NULL;
     }
 
     threadExit();
 }
 
+static bool extractedFsWriterOpenFile(ExtractedFsWriter *writer, const char *path, u64 file_size)
+{
+    /* Create ConcatenationFile if we're dealing with a big file + SD card as the output storage. */
+    if (writer->pool->dev_idx == 0 && file_size > FAT32_FILESIZE_LIMIT && !utilsCreateConcatenationFile(path))
+    {
+        consolePrint("failed to create concatenation file for \"%s\"!\n", path);
+        return false;
+    }
+
+    /* Open output file. */
+    if (!(writer->fp = fopen(path, "wb")))
+    {
+        consolePrint("failed to open \"%s\" for writing!\n", path);
+        return false;
+    }
+
+    /* Set file size. */
+    setvbuf(writer->fp, NULL, _IONBF, 0);
+    ftruncate(fileno(writer->fp), (off_t)file_size);
+
+    return true;
+}
+
 static bool spanDumpThreads(ThreadFunc read_func, ThreadFunc write_func, void *arg)
 {
     SharedThreadData *shared_thread_data = (SharedThreadData*)arg; // UB but we don't care
@@ -6126,7 +7258,7 @@ static void nspThreadFunc(void *arg)
     u64 nsp_header_size = 0, nsp_size = 0, nsp_offset = 0;
     char *tmp_name = NULL;
 
-    Sha256Context clean_sha256_ctx = {0}, dirty_sha256_ctx = {0};
+    NspPipeline pipeline = {0};
     u8 clean_sha256_hash[SHA256_HASH_SIZE] = {0}, dirty_sha256_hash[SHA256_HASH_SIZE] = {0};
 
     if (!nsp_thread_data || !(title_info = (TitleInfo*)nsp_thread_data->data) || !title_info->content_count || !title_info->content_infos) goto end;
@@ -6557,6 +7689,13 @@ static void nspThreadFunc(void *arg)
         fwrite(buf, 1, nsp_header_size, fp);
     }
 
+    // start read -> hash/patch -> write pipeline
+    if (!nspPipelineInitialize(&pipeline, nsp_thread_data, &cnmt_ctx, dev_idx == 1, fp))
+    {
+        consolePrint("nsp pipeline initialize failed\n");
+        goto end;
+    }
+
     consolePrint("dump process started, please wait. hold b to cancel.\n");
     consoleRefresh();
 
@@ -6570,9 +7709,7 @@ static void nspThreadFunc(void *arg)
     {
         NcaContext *cur_nca_ctx = &(nca_ctx[i]);
         u64 blksize = BLOCK_SIZE;
-
-        sha256ContextCreate(&clean_sha256_ctx);
-        sha256ContextCreate(&dirty_sha256_ctx);
+        u32 max_reads = MIN(NSP_PIPELINE_MAX_READS, contentSourceGetReadEngineQueueDepth());
 
         if (cur_nca_ctx->content_type == NcmContentType_Meta && (!cnmtGenerateNcaPatch(&cnmt_ctx) || !ncaEncryptHeader(cur_nca_ctx)))
         {
@@ -6580,8 +7717,6 @@ static void nspThreadFunc(void *arg)
             goto end;
         }
 
-        bool dirty_header = ncaIsHeaderDirty(cur_nca_ctx);
-
         if (dev_idx == 1)
         {
             tmp_name = pfsGetEntryNameByIndexFromImageContext(&pfs_img_ctx, i);
@@ -6592,7 +7727,13 @@ static void nspThreadFunc(void *arg)
             }
         }
 
-        for(u64 offset = 0; offset < cur_nca_ctx->content_size; offset += blksize, nsp_offset += blksize, nsp_thread_data->data_written += blksize)
+        // the pipeline is drained at this point, so it's safe to update its per-nca state
+        pipeline.nca_ctx = cur_nca_ctx;
+        pipeline.dirty_header = ncaIsHeaderDirty(cur_nca_ctx);
+        sha256ContextCreate(&(pipeline.clean_sha256_ctx));
+        sha256ContextCreate(&(pipeline.dirty_sha256_ctx));
+
+        for(u64 offset = 0; offset < cur_nca_ctx->content_size; offset += blksize, nsp_offset += blksize)
         {
             mutexLock(&g_fileMutex);
             bool cancelled = nsp_thread_data->transfer_cancelled;
@@ -6602,72 +7743,55 @@ static void nspThreadFunc(void *arg)
 
             if ((cur_nca_ctx->content_size - offset) < blksize) blksize = (cur_nca_ctx->content_size - offset);
 
-            // read nca chunk
-            if (!ncaReadContentFile(cur_nca_ctx, buf, blksize, offset))
+            // keep a bounded number of nca reads in flight. blocks are handed over to the hash/patch stage in order
+            if (pipeline.read_queue_count >= max_reads && !nspPipelineCompleteRead(&pipeline, true)) goto end;
+
+            // wait for a free block
+            u32 blk_idx = 0;
+            if (!nspPipelineQueuePop(&pipeline, &(pipeline.free_queue), &blk_idx))
             {
-                consolePrint("nca read failed at 0x%lX for \"%s\"\n", offset, cur_nca_ctx->content_id_str);
+                consolePrint("nsp pipeline failed while processing \"%s\"\n", cur_nca_ctx->content_id_str);
                 goto end;
             }
 
-            // update clean hash calculation
-            sha256ContextUpdate(&clean_sha256_ctx, buf, blksize);
+            NspPipelineBlock *blk = &(pipeline.blocks[blk_idx]);
 
-            if ((offset + blksize) >= cur_nca_ctx->content_size)
-            {
-                // get clean hash
-                sha256ContextGetHash(&clean_sha256_ctx, clean_sha256_hash);
-
-                // validate clean hash
-                if (!cnmtVerifyContentHash(&cnmt_ctx, cur_nca_ctx, clean_sha256_hash))
-                {
-                    consolePrint("sha256 checksum mismatch for nca \"%s\"\n", cur_nca_ctx->content_id_str);
-                    goto end;
-                }
-            }
+            blk->size = blksize;
+            blk->offset = offset;
 
-            if (dirty_header)
+            // submit nca chunk read
+            if (!nspPipelineSubmitRead(&pipeline, blk_idx))
             {
-                // write re-encrypted headers
-                if (!cur_nca_ctx->header_written) ncaWriteEncryptedHeaderDataToMemoryBuffer(cur_nca_ctx, buf, blksize, offset);
+                consolePrint("nca read failed at 0x%lX for \"%s\"\n", offset, cur_nca_ctx->content_id_str);
+                goto end;
+            }
+        }
 
-                if (cur_nca_ctx->content_type_ctx_patch)
-                {
-                    // write content type context patch
-                    switch(cur_nca_ctx->content_type)
-                    {
-                        case NcmContentType_Meta:
-                            cnmtWriteNcaPatch(&cnmt_ctx, buf, blksize, offset);
-                            break;
-                        case NcmContentType_Control:
-                            nacpWriteNcaPatch((NacpContext*)cur_nca_ctx->content_type_ctx, buf, blksize, offset);
-                            break;
-                        default:
-                            break;
-                    }
-                }
+        // hand the remaining blocks over to the hash/patch stage
+        while(pipeline.read_queue_count)
+        {
+            if (!nspPipelineCompleteRead(&pipeline, true)) goto end;
+        }
 
-                // update flag to avoid entering this code block if it's not needed anymore
-                dirty_header = (!cur_nca_ctx->header_written || cur_nca_ctx->content_type_ctx_patch);
-            }
+        // wait until all blocks from this nca have been hashed and written
+        if (!nspPipelineDrain(&pipeline))
+        {
+            consolePrint("nsp pipeline failed while processing \"%s\"\n", cur_nca_ctx->content_id_str);
+            goto end;
+        }
 
-            // update dirty hash calculation
-            sha256ContextUpdate(&dirty_sha256_ctx, buf, blksize);
+        // get clean hash
+        sha256ContextGetHash(&(pipeline.clean_sha256_ctx), clean_sha256_hash);
 
-            // write nca chunk
-            if (dev_idx == 1)
-            {
-                if (!usbSendFileData(buf, blksize))
-                {
-                    consolePrint("send file data failed\n");
-                    goto end;
-                }
-            } else {
-                fwrite(buf, 1, blksize, fp);
-            }
+        // validate clean hash
+        if (!cnmtVerifyContentHash(&cnmt_ctx, cur_nca_ctx, clean_sha256_hash))
+        {
+            consolePrint("sha256 checksum mismatch for nca \"%s\"\n", cur_nca_ctx->content_id_str);
+            goto end;
         }
 
         // get dirty hash
-        sha256ContextGetHash(&dirty_sha256_ctx, dirty_sha256_hash);
+        sha256ContextGetHash(&(pipeline.dirty_sha256_ctx), dirty_sha256_hash);
 
         if (memcmp(clean_sha256_hash, dirty_sha256_hash, SHA256_HASH_SIZE) != 0)
         {
@@ -6875,6 +7999,9 @@ static void nspThreadFunc(void *arg)
 end:
     consoleRefresh();
 
+    // stop pipeline threads before closing the output file
+    nspPipelineFree(&pipeline);
+
     mutexLock(&g_fileMutex);
     if (!success && !nsp_thread_data->transfer_cancelled) nsp_thread_data->error = true;
     mutexUnlock(&g_fileMutex);
@@ -6930,6 +8057,305 @@ end:
     threadExit();
 }
 
+static bool nspPipelineInitialize(NspPipeline *pipeline, NspThreadData *nsp_thread_data, ContentMetaContext *cnmt_ctx, bool use_usb, FILE *fp)
+{
+    if (!pipeline || !nsp_thread_data || !cnmt_ctx || (!use_usb && !fp)) return false;
+
+    memset(pipeline, 0, sizeof(NspPipeline));
+
+    pipeline->nsp_thread_data = nsp_thread_data;
+    pipeline->cnmt_ctx = cnmt_ctx;
+    pipeline->use_usb = use_usb;
+    pipeline->fp = fp;
+
+    /* Allocate page-aligned blocks and place them all in the free queue. */
+    for(u32 i = 0; i < NSP_PIPELINE_BLOCK_COUNT; i++)
+    {
+        if (!(pipeline->blocks[i].data = usbAllocatePageAlignedBuffer(BLOCK_SIZE)))
+        {
+            consolePrint("nsp pipeline block #%u alloc failed\n", i);
+            goto fail;
+        }
+
+        pipeline->free_queue.items[i] = i;
+    }
+
+    pipeline->free_queue.count = NSP_PIPELINE_BLOCK_COUNT;
+
+    for(u32 i = 0; i < NSP_PIPELINE_BLOCK_COUNT; i++) contentSourceReadGroupInitialize(&(pipeline->blocks[i].read_group));
+
+    /* Start stage threads. The dump thread runs on core 2, so we use the remaining ones. */
+    if (!utilsCreateThread(&(pipeline->hash_thread), nspPipelineHashThreadFunc, pipeline, 1)) goto fail;
+
+    if (!utilsCreateThread(&(pipeline->write_thread), nspPipelineWriteThreadFunc, pipeline, 0))
+    {
+        nspPipelineSetError(pipeline);
+        utilsJoinThread(&(pipeline->hash_thread));
+        goto fail;
+    }
+
+    pipeline->initialized = true;
+
+    return true;
+
+fail:
+    for(u32 i = 0; i < NSP_PIPELINE_BLOCK_COUNT; i++)
+    {
+        if (pipeline->blocks[i].data) free(pipeline->blocks[i].data);
+    }
+
+    memset(pipeline, 0, sizeof(NspPipeline));
+
+    return false;
+}
+
+static void nspPipelineFree(NspPipeline *pipeline)
+{
+    if (!pipeline || !pipeline->initialized) return;
+
+    /* Wait for outstanding NCA reads, since they're still writing to our blocks. */
+    while(pipeline->read_queue_count) nspPipelineCompleteRead(pipeline, false);
+
+    /* Stop stage threads. */
+    mutexLock(&(pipeline->mutex));
+    pipeline->stop = true;
+    condvarWakeAll(&(pipeline->hash_queue.condvar));
+    condvarWakeAll(&(pipeline->write_queue.condvar));
+    condvarWakeAll(&(pipeline->free_queue.condvar));
+    mutexUnlock(&(pipeline->mutex));
+
+    utilsJoinThread(&(pipeline->hash_thread));
+    utilsJoinThread(&(pipeline->write_thread));
+
+    /* Wait for the USB write queue to give back all the blocks we handed off. */
+    mutexLock(&(pipeline->mutex));
+    while(pipeline->usb_pending) condvarWait(&(pipeline->free_queue.condvar), &(pipeline->mutex));
+    mutexUnlock(&(pipeline->mutex));
+
+    for(u32 i = 0; i < NSP_PIPELINE_BLOCK_COUNT; i++)
+    {
+        if (pipeline->blocks[i].data) free(pipeline->blocks[i].data);
+    }
+
+    memset(pipeline, 0, sizeof(NspPipeline));
+}
+
+static void nspPipelineQueuePush(NspPipeline *pipeline, NspPipelineQueue *queue, u32 idx)
+{
+    mutexLock(&(pipeline->mutex));
+
+    queue->items[(queue->head + queue->count) % NSP_PIPELINE_BLOCK_COUNT] = idx;
+    queue->count++;
+
+    condvarWakeAll(&(queue->condvar));
+
+    mutexUnlock(&(pipeline->mutex));
+}
+
+static bool nspPipelineQueuePop(NspPipeline *pipeline, NspPipelineQueue *queue, u32 *out_idx)
+{
+    bool ret = false;
+
+    mutexLock(&(pipeline->mutex));
+
+    while(!queue->count && !pipeline->stop) condvarWait(&(queue->condvar), &(pipeline->mutex));
+
+    /* Bail out right away if the pipeline is being stopped, even if there are still blocks left in the queue. */
+    if (queue->count && !pipeline->stop)
+    {
+        *out_idx = queue->items[queue->head];
+        queue->head = ((queue->head + 1) % NSP_PIPELINE_BLOCK_COUNT);
+        queue->count--;
+        ret = true;
+    }
+
+    mutexUnlock(&(pipeline->mutex));
+
+    return ret;
+}
+
+static void nspPipelineSetError(NspPipeline *pipeline)
+{
+    mutexLock(&(pipeline->mutex));
+
+    pipeline->error = pipeline->stop = true;
+
+    condvarWakeAll(&(pipeline->hash_queue.condvar));
+    condvarWakeAll(&(pipeline->write_queue.condvar));
+    condvarWakeAll(&(pipeline->free_queue.condvar));
+
+    mutexUnlock(&(pipeline->mutex));
+}
+
+static bool nspPipelineSubmitRead(NspPipeline *pipeline, u32 blk_idx)
+{
+    NspPipelineBlock *blk = &(pipeline->blocks[blk_idx]);
+
+    /* The read engine fills the block in the background. */
+    if (!contentSourceReadGroupSubmit(&(blk->read_group), &(pipeline->nca_ctx->source), blk->data, blk->size, blk->offset)) return false;
+
+    pipeline->read_queue[(pipeline->read_queue_head + pipeline->read_queue_count) % NSP_PIPELINE_BLOCK_COUNT] = blk_idx;
+    pipeline->read_queue_count++;
+
+    return true;
+}
+
+static bool nspPipelineCompleteRead(NspPipeline *pipeline, bool hand_over)
+{
+    if (!pipeline->read_queue_count) return true;
+
+    /* Wait for the oldest outstanding read. */
+    u32 blk_idx = pipeline->read_queue[pipeline->read_queue_head];
+    NspPipelineBlock *blk = &(pipeline->blocks[blk_idx]);
+
+    pipeline->read_queue_head = ((pipeline->read_queue_head + 1) % NSP_PIPELINE_BLOCK_COUNT);
+    pipeline->read_queue_count--;
+
+    if (!contentSourceReadGroupWait(&(blk->read_group)))
+    {
+        consolePrint("nca read failed at 0x%lX for \"%s\"\n", blk->offset, pipeline->nca_ctx->content_id_str);
+        return false;
+    }
+
+    /* Hand the block over to the hash/patch stage. */
+    if (hand_over) nspPipelineQueuePush(pipeline, &(pipeline->hash_queue), blk_idx);
+
+    return true;
+}
+
+static bool nspPipelineDrain(NspPipeline *pipeline)
+{
+    bool ret = false;
+
+    mutexLock(&(pipeline->mutex));
+
+    /* All blocks end up back in the free queue once they have been hashed and written. */
+    while(pipeline->free_queue.count < NSP_PIPELINE_BLOCK_COUNT && !pipeline->stop) condvarWait(&(pipeline->free_queue.condvar), &(pipeline->mutex));
+    ret = !pipeline->error;
+
+    mutexUnlock(&(pipeline->mutex));
+
+    return ret;
+}
+
+static void nspPipelineHashThreadFunc(void *arg)
+{
+    NspPipeline *pipeline = (NspPipeline*)arg;
+    u32 blk_idx = 0;
+
+    while(nspPipelineQueuePop(pipeline, &(pipeline->hash_queue), &blk_idx))
+    {
+        NspPipelineBlock *blk = &(pipeline->blocks[blk_idx]);
+        NcaContext *nca_ctx = pipeline->nca_ctx;
+
+        /* Update clean hash calculation. */
+        sha256ContextUpdate(&(pipeline->clean_sha256_ctx), blk->data, blk->size);
+
+        if (pipeline->dirty_header)
+        {
+            /* Write re-encrypted headers. */
+            if (!nca_ctx->header_written) ncaWriteEncryptedHeaderDataToMemoryBuffer(nca_ctx, blk->data, blk->size, blk->offset);
+
+            if (nca_ctx->content_type_ctx_patch)
+            {
+                /* Write content type context patch. */
+                switch(nca_ctx->content_type)
+                {
+                    case NcmContentType_Meta:
+                        cnmtWriteNcaPatch(pipeline->cnmt_ctx, blk->data, blk->size, blk->offset);
+                        break;
+                    case NcmContentType_Control:
+                        nacpWriteNcaPatch((NacpContext*)nca_ctx->content_type_ctx, blk->data, blk->size, blk->offset);
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            /* Update flag to avoid entering this code block if it's not needed anymore. */
+            pipeline->dirty_header = (!nca_ctx->header_written || nca_ctx->content_type_ctx_patch);
+        }
+
+        /* Update dirty hash calculation. */
+        sha256ContextUpdate(&(pipeline->dirty_sha256_ctx), blk->data, blk->size);
+
+        /* Hand the block over to the write stage. */
+        nspPipelineQueuePush(pipeline, &(pipeline->write_queue), blk_idx);
+    }
+
+    threadExit();
+}
+
+static void nspPipelineWriteThreadFunc(void *arg)
+{
+    NspPipeline *pipeline = (NspPipeline*)arg;
+    u32 blk_idx = 0;
+
+    while(nspPipelineQueuePop(pipeline, &(pipeline->write_queue), &blk_idx))
+    {
+        NspPipelineBlock *blk = &(pipeline->blocks[blk_idx]);
+
+        if (pipeline->use_usb)
+        {
+            /* Hand the block off to the USB write queue. It'll be returned to the free queue by the completion callback. */
+            mutexLock(&(pipeline->mutex));
+            pipeline->usb_pending++;
+            mutexUnlock(&(pipeline->mutex));
+
+            /* The last chunk may fail after the completion callback has already reported success (e.g. if the host device doesn't reply). */
+            if (!usbSendFileDataAsync(blk->data, blk->size, nspPipelineUsbTransferDoneCallback, pipeline))
+            {
+                consolePrint("send file data failed\n");
+                nspPipelineSetError(pipeline);
+                break;
+            }
+
+            continue;
+        }
+
+        /* Write NCA chunk. */
+        if (fwrite(blk->data, 1, blk->size, pipeline->fp) != blk->size)
+        {
+            consolePrint("fwrite failed\n");
+            nspPipelineSetError(pipeline);
+            break;
+        }
+
+        pipeline->nsp_thread_data->data_written += blk->size;
+
+        /* Return the block to the free queue. */
+        nspPipelineQueuePush(pipeline, &(pipeline->free_queue), blk_idx);
+    }
+
+    threadExit();
+}
+
+static void nspPipelineUsbTransferDoneCallback(void *data, bool success, void *callback_arg)
+{
+    NspPipeline *pipeline = (NspPipeline*)callback_arg;
+    u32 blk_idx = 0;
+
+    for(blk_idx = 0; blk_idx < NSP_PIPELINE_BLOCK_COUNT; blk_idx++)
+    {
+        if (pipeline->blocks[blk_idx].data == data) break;
+    }
+
+    if (success && blk_idx < NSP_PIPELINE_BLOCK_COUNT)
+    {
+        pipeline->nsp_thread_data->data_written += pipeline->blocks[blk_idx].size;
+
+        /* Return the block to the free queue. */
+        nspPipelineQueuePush(pipeline, &(pipeline->free_queue), blk_idx);
+    } else {
+        nspPipelineSetError(pipeline);
+    }
+
+    mutexLock(&(pipeline->mutex));
+    pipeline->usb_pending--;
+    condvarWakeAll(&(pipeline->free_queue.condvar));
+    mutexUnlock(&(pipeline->mutex));
+}
+
 static u32 getOutputStorageOption(void)
 {
     return (u32)configGetInteger("output_storage");
@@ -97,8 +97,8 @@ USB_TRANSFER_THRESHOLD = (USB_TRANSFER_BLOCK_SIZE * 4)
 USB_MAGIC_WORD = b'NXDT'
 
 # Supported USB ABI version.
-USB_ABI_VERSION_MAJOR = 1
-USB_ABI_VERSION_MINOR = 2
+USB_ABI_VERSION_MAJOR = 2
+USB_ABI_VERSION_MINOR = 0
 
 # USB command header size.
 USB_CMD_HEADER_SIZE = 0x10
@@ -111,12 +111,23 @@ USB_CMD_SEND_NSP_HEADER         = 3
 USB_CMD_END_SESSION             = 4
 USB_CMD_START_EXTRACTED_FS_DUMP = 5
 USB_CMD_END_EXTRACTED_FS_DUMP   = 6
+USB_CMD_SEND_FILE_STREAM_BATCH  = 7
 
 # USB command block sizes.
 USB_CMD_BLOCK_SIZE_START_SESSION           = 0x10
 USB_CMD_BLOCK_SIZE_SEND_FILE_PROPERTIES    = 0x320
 USB_CMD_BLOCK_SIZE_START_EXTRACTED_FS_DUMP = 0x310
 
+# USB file stream packet types.
+USB_FILE_STREAM_PACKET_OPEN_FILE = 0
+USB_FILE_STREAM_PACKET_FILE_DATA = 1
+
+# USB file stream packet header size.
+USB_FILE_STREAM_PACKET_HEADER_SIZE = 0x10
+
+# USB file stream OpenFile packet payload header size. Followed by the filename.
+USB_FILE_STREAM_OPEN_FILE_SIZE = 0x10
+
 # Max filename length (file properties).
 USB_FILE_PROPERTIES_MAX_NAME_LENGTH = 0x300
 
@@ -353,6 +364,9 @@ g_nspRemainingSize: int = 0
 g_nspFile: BufferedWriter | None = None
 g_nspFilePath: str = ''
 
+# Open file streams, indexed by stream ID. Each value holds a (file, fullpath, remaining_size) tuple.
+g_fileStreams: dict[int, tuple[BufferedWriter, str, int]] = {}
+
 # Reference: https://beenje.github.io/blog/posts/logging-to-a-tkinter-scrolledtext-widget.
 class LogQueueHandler(logging.Handler):
     def __init__(self, log_queue: queue.Queue) -> None:
@@ -593,6 +607,16 @@ def utilsResetNspInfo(delete: bool = False) -> None:
     g_nspFile = None
     g_nspFilePath = ''
 
+def utilsResetFileStreams(delete: bool = False) -> None:
+    global g_fileStreams
+
+    for (file, fullpath, _) in g_fileStreams.values():
+        file.close()
+        if delete:
+            os.remove(fullpath)
+
+    g_fileStreams = {}
+
 def utilsGetSizeUnitAndDivisor(size: int) -> tuple[str, int]:
     size_suffixes = [ 'B', 'KiB', 'MiB', 'GiB' ]
     size_suffixes_count = len(size_suffixes)
@@ -980,6 +1004,10 @@ def usbHandleCancelFileTransfer(cmd_block: bytes) -> int:
         utilsResetNspInfo(True)
         g_logger.warning('Transfer cancelled.')
         return USB_STATUS_SUCCESS
+    elif g_fileStreams:
+        utilsResetFileStreams(True)
+        g_logger.warning('Transfer cancelled.')
+        return USB_STATUS_SUCCESS
     else:
         g_logger.error('Unexpected transfer cancellation.')
         return USB_STATUS_MALFORMED_CMD
@@ -1043,10 +1071,124 @@ def usbHandleStartExtractedFsDump(cmd_block: bytes) -> int:
 
 def usbHandleEndExtractedFsDump(cmd_block: bytes) -> int:
     assert g_logger is not None
+
     g_logger.debug(f'Received EndExtractedFsDump ({USB_CMD_END_EXTRACTED_FS_DUMP:02X}) command.')
+
+    if g_fileStreams:
+        g_logger.error(f'EndExtractedFsDump received with {len(g_fileStreams)} file stream(s) still open.\n')
+        utilsResetFileStreams(True)
+        return USB_STATUS_MALFORMED_CMD
+
     g_logger.info(f'Finished extracted FS dump.')
     return USB_STATUS_SUCCESS
 
+def usbProcessFileStreamPacket(stream_id: int, packet_type: int, payload: memoryview) -> int:
+    global g_fileStreams
+
+    assert g_logger is not None
+
+    if packet_type == USB_FILE_STREAM_PACKET_OPEN_FILE:
+        if stream_id in g_fileStreams:
+            g_logger.error(f'File stream #{stream_id} is already open!\n')
+            return USB_STATUS_MALFORMED_CMD
+
+        if len(payload) < USB_FILE_STREAM_OPEN_FILE_SIZE:
+            g_logger.error(f'Invalid OpenFile packet size for file stream #{stream_id}! (0x{len(payload):X}).\n')
+            return USB_STATUS_MALFORMED_CMD
+
+        (file_size, filename_length) = struct.unpack_from('<QI4x', payload, 0)
+
+        if (not filename_length) or (filename_length > USB_FILE_PROPERTIES_MAX_NAME_LENGTH) or (filename_length != (len(payload) - USB_FILE_STREAM_OPEN_FILE_SIZE)):
+            g_logger.error(f'Invalid filename length for file stream #{stream_id}!\n')
+            return USB_STATUS_MALFORMED_CMD
+
+        filename = bytes(payload[USB_FILE_STREAM_OPEN_FILE_SIZE:]).decode('utf-8')
+
+        # Generate full, absolute path to the destination file.
+        fullpath = os.path.abspath(g_outputDir + os.path.sep + filename)
+        printable_fullpath = (fullpath[4:] if g_isWindows else fullpath)
+
+        # Create full directory tree.
+        os.makedirs(os.path.dirname(fullpath), exist_ok=True)
+
+        # Make sure the output filepath doesn't point to an existing directory.
+        if os.path.exists(fullpath) and (not os.path.isfile(fullpath)):
+            g_logger.error(f'Output filepath points to an existing directory! ("{printable_fullpath}").\n')
+            return USB_STATUS_HOST_IO_ERROR
+
+        g_logger.debug(f'Receiving file stream #{stream_id}: "{printable_fullpath}" (0x{file_size:X} bytes).')
+
+        # Empty files are closed right away.
+        file = open(fullpath, 'wb')
+        if file_size:
+            g_fileStreams[stream_id] = (file, fullpath, file_size)
+        else:
+            file.close()
+    elif packet_type == USB_FILE_STREAM_PACKET_FILE_DATA:
+        stream = g_fileStreams.get(stream_id, None)
+        if stream is None:
+            g_logger.error(f'Received FileData packet for unknown file stream #{stream_id}!\n')
+            return USB_STATUS_MALFORMED_CMD
+
+        (file, fullpath, remaining_size) = stream
+
+        if (not len(payload)) or (len(payload) > remaining_size):
+            g_logger.error(f'Invalid FileData packet size for file stream #{stream_id}! (0x{len(payload):X}, 0x{remaining_size:X} byte[s] remaining).\n')
+            return USB_STATUS_MALFORMED_CMD
+
+        file.write(payload)
+        remaining_size -= len(payload)
+
+        # Close the file stream once all of its data has been received.
+        if remaining_size:
+            g_fileStreams[stream_id] = (file, fullpath, remaining_size)
+        else:
+            file.close()
+            del g_fileStreams[stream_id]
+    else:
+        g_logger.error(f'Received unsupported packet type {packet_type:02X} for file stream #{stream_id}!\n')
+        return USB_STATUS_MALFORMED_CMD
+
+    return USB_STATUS_SUCCESS
+
+def usbHandleSendFileStreamBatch(cmd_block: bytes) -> int:
+    assert g_logger is not None
+
+    batch_size = len(cmd_block)
+    batch_view = memoryview(cmd_block)
+    offset = 0
+
+    g_logger.debug(f'Received SendFileStreamBatch ({USB_CMD_SEND_FILE_STREAM_BATCH:02X}) command (0x{batch_size:X} bytes).')
+
+    if g_nspTransferMode:
+        g_logger.error('SendFileStreamBatch received mid NSP transfer.')
+        return USB_STATUS_MALFORMED_CMD
+
+    # Process all packets in this batch. Packets from different file streams may be interleaved.
+    # A single status response is sent for the whole batch.
+    while offset < batch_size:
+        if (batch_size - offset) < USB_FILE_STREAM_PACKET_HEADER_SIZE:
+            g_logger.error(f'Truncated file stream packet header at batch offset 0x{offset:X}!\n')
+            utilsResetFileStreams(True)
+            return USB_STATUS_MALFORMED_CMD
+
+        (stream_id, packet_type, payload_size) = struct.unpack_from('<IB3xI4x', cmd_block, offset)
+        offset += USB_FILE_STREAM_PACKET_HEADER_SIZE
+
+        if payload_size > (batch_size - offset):
+            g_logger.error(f'Truncated file stream packet payload at batch offset 0x{offset:X}!\n')
+            utilsResetFileStreams(True)
+            return USB_STATUS_MALFORMED_CMD
+
+        status = usbProcessFileStreamPacket(stream_id, packet_type, batch_view[offset:offset + payload_size])
+        if status != USB_STATUS_SUCCESS:
+            utilsResetFileStreams(True)
+            return status
+
+        offset += payload_size
+
+    return USB_STATUS_SUCCESS
+
 def usbCommandHandler() -> None:
     assert g_logger is not None
 
@@ -1057,7 +1199,8 @@ def usbCommandHandler() -> None:
         USB_CMD_SEND_NSP_HEADER:         usbHandleSendNspHeader,
         USB_CMD_END_SESSION:             usbHandleEndSession,
         USB_CMD_START_EXTRACTED_FS_DUMP: usbHandleStartExtractedFsDump,
-        USB_CMD_END_EXTRACTED_FS_DUMP:   usbHandleEndExtractedFsDump
+        USB_CMD_END_EXTRACTED_FS_DUMP:   usbHandleEndExtractedFsDump,
+        USB_CMD_SEND_FILE_STREAM_BATCH:  usbHandleSendFileStreamBatch
     }
 
     # Get device endpoints.
@@ -1074,8 +1217,9 @@ def usbCommandHandler() -> None:
         g_tkCanvas.itemconfigure(g_tkTipMessage, state='normal', text=SERVER_STOP_MSG)
         g_tkServerButton.configure(state='disabled')
 
-    # Reset NSP info.
+    # Reset NSP info and file streams.
     utilsResetNspInfo()
+    utilsResetFileStreams()
 
     while True:
         # Read command header.
@@ -1119,6 +1263,7 @@ def usbCommandHandler() -> None:
         if (cmd_id == USB_CMD_START_SESSION and cmd_block_size != USB_CMD_BLOCK_SIZE_START_SESSION) or \
            (cmd_id == USB_CMD_SEND_FILE_PROPERTIES and cmd_block_size != USB_CMD_BLOCK_SIZE_SEND_FILE_PROPERTIES) or \
            (cmd_id == USB_CMD_SEND_NSP_HEADER and not cmd_block_size) or \
+           (cmd_id == USB_CMD_SEND_FILE_STREAM_BATCH and not cmd_block_size) or \
            (cmd_id == USB_CMD_START_EXTRACTED_FS_DUMP and cmd_block_size != USB_CMD_BLOCK_SIZE_START_EXTRACTED_FS_DUMP):
             g_logger.error(f'Invalid command block size for command ID {cmd_id:02X}! (0x{cmd_block_size:X}).\n')
             usbSendStatus(USB_STATUS_MALFORMED_CMD)
@@ -1130,6 +1275,9 @@ def usbCommandHandler() -> None:
         if (status is None) or (not usbSendStatus(status)) or (cmd_id == USB_CMD_END_SESSION) or (status == USB_STATUS_UNSUPPORTED_ABI_VERSION):
             break
 
+    # Get rid of incomplete files from any file streams that may still be open.
+    utilsResetFileStreams(True)
+
     g_logger.info('\nStopping server.')
 
     if not g_cliMode:
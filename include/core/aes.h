@@ -36,6 +36,7 @@ void aes128EcbCrypt(void *dst, const void *src, const void *key, bool encrypt);
 /// Performs an AES-128-XTS crypto operation using the non-standard Nintendo XTS tweak.
 /// The Aes128XtsContext element should have been previously initialized with aes128XtsContextCreate(). 'encrypt' should match the value of 'is_encryptor' used with that call.
 /// 'dst' and 'src' can both point to the same address.
+/// Multiple sectors are processed at the same time using ARMv8 Crypto Extensions, so callers should pass as many contiguous sectors as possible in a single call.
 size_t aes128XtsNintendoCrypt(Aes128XtsContext *ctx, void *dst, const void *src, size_t size, u64 sector, size_t sector_size, bool encrypt);
 
 /// Initializes an output AES partial counter using an initial CTR value and an offset.
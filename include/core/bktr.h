@@ -50,6 +50,13 @@ extern "C" {
 
 #define BKTR_MAX_SUBSTORAGE_COUNT           2
 
+#define BKTR_LZ4_CACHE_ENTRY_COUNT          8
+#define BKTR_LZ4_CACHE_MAX_BLOCK_SIZE       0x80000                     /* 512 KiB. Bigger LZ4 blocks are decompressed without being cached. */
+
+#define BKTR_LZ4_WORKER_THREAD_COUNT        2                           /* Persistent helper threads used to decompress LZ4 blocks alongside the calling thread. */
+
+#define BKTR_VISITOR_CURSOR_MAX_STEPS       4                           /* Max number of entries the visitor cursor may be moved forward before falling back to a full tree lookup. */
+
 /// Used as the header for both BucketTreeOffsetNode and BucketTreeEntryNode.
 typedef struct {
     u32 index;  ///< BucketTreeOffsetNode / BucketTreeEntryNode index.
@@ -187,6 +194,11 @@ struct _BucketTreeContext {
     u64 start_offset;                                               ///< Virtual storage start offset.
     u64 end_offset;                                                 ///< Virtual storage end offset.
     BucketTreeSubStorage substorages[BKTR_MAX_SUBSTORAGE_COUNT];    ///< Substorages required for this BucketTree storage. May be set after initializing this context.
+    u32 lz4_cache_id;                                               ///< Unique ID used to look up decompressed LZ4 blocks. Only used by BucketTreeStorageType_Compressed.
+    Mutex cursor_mutex;                                             ///< Protects the visitor cursor.
+    bool cursor_valid;                                              ///< Set to true if the visitor cursor holds the position of a previously visited entry.
+    u32 cursor_entry_set_index;                                     ///< Entry node index for the last entry visited by bktrReadStorage().
+    u32 cursor_entry_index;                                         ///< Entry index within the entry node for the last entry visited by bktrReadStorage().
 };
 
 /// Initializes a Bucket Tree context using the provided NCA FS section context and a storage type.
@@ -212,6 +224,16 @@ bool bktrReadStorage(BucketTreeContext *ctx, void *out, u64 read_size, u64 offse
 /// The storage type from the provided BucketTreeContext may only be BucketTreeStorageType_Indirect or BucketTreeStorageType_Compressed (with an underlying Indirect substorage).
 bool bktrIsBlockWithinIndirectStorageRange(BucketTreeContext *ctx, u64 offset, u64 size, bool *out);
 
+/// Starts the helper threads used by bktrReadStorage() to decompress LZ4 blocks from BucketTreeStorageType_Compressed contexts in parallel. Must be called at startup.
+/// If the helper threads aren't running, LZ4 blocks are decompressed on the calling thread.
+bool bktrStartLz4DecompressionWorkers(void);
+
+/// Stops the LZ4 decompression helper threads.
+void bktrStopLz4DecompressionWorkers(void);
+
+/// Frees all decompressed LZ4 blocks cached by bktrReadStorage() calls on BucketTreeStorageType_Compressed contexts.
+void bktrFreeLz4BlockCache(void);
+
 /// Helper inline functions.
 
 NX_INLINE void bktrFreeContext(BucketTreeContext *ctx)
@@ -0,0 +1,167 @@
+/*
+ * content_source.h
+ *
+ * Copyright (c) 2020-2023, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#ifndef __CONTENT_SOURCE_H__
+#define __CONTENT_SOURCE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CONTENT_SOURCE_READ_ENGINE_MAX_QUEUE_DEPTH      8       /* Maximum number of in-flight asynchronous reads. */
+#define CONTENT_SOURCE_READ_ENGINE_DEFAULT_QUEUE_DEPTH  4
+#define CONTENT_SOURCE_READ_ENGINE_QUEUE_SIZE           0x20    /* Submitted reads that haven't been picked up yet. Submitting more than this blocks the caller. */
+
+#define CONTENT_SOURCE_FILE_HANDLE_COUNT                CONTENT_SOURCE_READ_ENGINE_MAX_QUEUE_DEPTH
+
+typedef enum {
+    ContentSourceType_None     = 0,
+    ContentSourceType_Ncm      = 1, ///< NCA read from eMMC/SD using a NcmContentStorage instance.
+    ContentSourceType_GameCard = 2, ///< NCA read from the secure Hash FS partition of the inserted gamecard.
+    ContentSourceType_File     = 3, ///< NCA read from a standalone local file, or from an entry within a PFS0 (NSP) / HFS0 (XCI) image file.
+    ContentSourceType_Count    = 4  ///< Total values supported by this enum.
+} ContentSourceType;
+
+typedef struct _ContentSource ContentSource;
+
+/// Invoked by contentSourceReadAsync() once the read operation has been completed. This may be invoked from a background thread.
+/// Callbacks invoked by the read engine must not submit new asynchronous reads nor block for long periods of time.
+typedef void (*ContentSourceReadCallback)(void *out, u64 read_size, u64 offset, bool success, void *callback_arg);
+
+/// Backend interface used by content sources. All offsets are relative to the start of the content file.
+typedef struct {
+    const char *name;                                                                                                                       ///< Used in log messages.
+    bool (*read)(ContentSource *source, void *out, u64 read_size, u64 offset);
+    bool (*read_async)(ContentSource *source, void *out, u64 read_size, u64 offset, ContentSourceReadCallback callback, void *callback_arg);  ///< Optional. May be NULL.
+    void (*close)(ContentSource *source);                                                                                                   ///< Optional. May be NULL.
+} ContentSourceInterface;
+
+/// Shared local file. Used by file-based content sources, which may point to different entries within the same image file.
+/// Each read operation leases its own stdio handle, which means concurrent reads from the same file don't block each other.
+typedef struct {
+    char *path;
+    FILE *fp[CONTENT_SOURCE_FILE_HANDLE_COUNT];         ///< Only the first handle is opened right away. The rest are opened on demand by concurrent reads.
+    bool fp_leased[CONTENT_SOURCE_FILE_HANDLE_COUNT];
+    Mutex mutex;
+    CondVar condvar;                                    ///< Signaled each time a handle is returned.
+    u64 size;
+    u32 ref_count;
+} ContentSourceFile;
+
+/// Tracks a set of asynchronous read operations submitted through contentSourceReadGroupSubmit().
+typedef struct {
+    Mutex mutex;
+    CondVar condvar;
+    u32 pending;
+    bool failed;
+} ContentSourceReadGroup;
+
+struct _ContentSource {
+    u8 type;                                ///< ContentSourceType.
+    const ContentSourceInterface *iface;
+    u64 size;                               ///< Content file size.
+    union {
+        struct {
+            NcmContentStorage *storage;
+            NcmContentId content_id;
+        } ncm;
+        struct {
+            u64 offset;                     ///< Relative to the start of the gamecard image.
+        } gamecard;
+        struct {
+            ContentSourceFile *file;
+            u64 offset;                     ///< Relative to the start of the local file. Always zero for standalone NCA files.
+        } file;
+    };
+};
+
+/// Initializes a content source that reads data from a NCA stored in eMMC/SD using ncmContentStorageReadContentIdFile().
+bool contentSourceInitializeNcm(ContentSource *out, NcmContentStorage *ncm_storage, const NcmContentId *content_id, u64 size);
+
+/// Initializes a content source that reads data from a NCA stored in the inserted gamecard using gamecardReadStorage().
+/// 'offset' must be relative to the start of the gamecard image (e.g. retrieved through gamecardGetHashFileSystemEntryInfoByName()).
+bool contentSourceInitializeGameCard(ContentSource *out, u64 offset, u64 size);
+
+/// Initializes a content source that reads data from a standalone NCA file stored in the provided path.
+/// Doesn't depend on any console services, which means NCA dumps can be processed offline.
+bool contentSourceInitializeFile(ContentSource *out, const char *path);
+
+/// Initializes a content source that reads data from an entry within a PFS0 (NSP) or HFS0 (XCI) image file stored in the provided path.
+/// XCI images are parsed from their root Hash FS partition, and all of its child partitions are looked up. XCI images with a prepended key area are supported.
+/// Doesn't depend on any console services, which means NCA dumps can be processed offline.
+bool contentSourceInitializeImageFileEntry(ContentSource *out, const char *path, const char *entry_name);
+
+/// Initializes a content source that reads data from an entry within the same image file used by an already initialized file-based content source.
+/// The local file handle is shared by both content sources, so the image file doesn't need to be opened more than once.
+bool contentSourceInitializeImageFileEntryFromSource(ContentSource *out, ContentSource *image_source, const char *entry_name);
+
+/// Retrieves the names of all entries within an image file, using a content source initialized through contentSourceInitializeFile(). XCI entries are retrieved from all child Hash FS partitions.
+/// Entry names are stored one after another in a single buffer, each one with its own NULL terminator. The buffer must be freed by the caller.
+bool contentSourceGetImageFileEntryNames(ContentSource *image_source, char **out_names, u32 *out_count);
+
+/// Reads raw data from a content source. Input offset must be relative to the start of the content file.
+bool contentSourceRead(ContentSource *source, void *out, u64 read_size, u64 offset);
+
+/// Submits an asynchronous read operation to a content source. 'callback' is invoked exactly once per successful call.
+/// If the backend doesn't support asynchronous reads, the read operation is handed off to the read engine (see contentSourceStartReadEngine()).
+/// If the read engine isn't running, the read operation is carried out synchronously and 'callback' is invoked before this function returns.
+/// The content source is copied, but both the content source and the output buffer must remain valid until 'callback' is invoked.
+/// Blocks the calling thread if CONTENT_SOURCE_READ_ENGINE_QUEUE_SIZE reads are already waiting to be picked up.
+bool contentSourceReadAsync(ContentSource *source, void *out, u64 read_size, u64 offset, ContentSourceReadCallback callback, void *callback_arg);
+
+/// Starts the read engine used by contentSourceReadAsync(). 'queue_depth' sets the maximum number of in-flight reads, and must be within [1, CONTENT_SOURCE_READ_ENGINE_MAX_QUEUE_DEPTH].
+/// Each in-flight read is carried out by its own worker thread. Optional: contentSourceReadAsync() falls back to synchronous reads if the read engine isn't running.
+bool contentSourceStartReadEngine(u32 queue_depth);
+
+/// Stops the read engine. Reads that have already been submitted are completed before this function returns.
+void contentSourceStopReadEngine(void);
+
+/// Returns the maximum number of in-flight reads supported by the read engine, or 1 if it isn't running.
+u32 contentSourceGetReadEngineQueueDepth(void);
+
+/// Read group functions. Read groups are useful to wait for a number of asynchronous reads without having to provide a custom callback.
+/// contentSourceReadGroupWait() waits until all reads submitted to the group have been completed, and returns false if any of them failed. The group may be reused afterwards.
+void contentSourceReadGroupInitialize(ContentSourceReadGroup *group);
+bool contentSourceReadGroupSubmit(ContentSourceReadGroup *group, ContentSource *source, void *out, u64 read_size, u64 offset);
+bool contentSourceReadGroupWait(ContentSourceReadGroup *group);
+
+/// Closes a content source. Local file handles are only closed once all content sources that share them have been closed.
+void contentSourceClose(ContentSource *source);
+
+/// Helper inline functions.
+
+NX_INLINE bool contentSourceIsValid(const ContentSource *source)
+{
+    return (source && source->type > ContentSourceType_None && source->type < ContentSourceType_Count && source->iface && source->iface->read && source->size > 0);
+}
+
+NX_INLINE const char *contentSourceGetName(const ContentSource *source)
+{
+    return ((source && source->iface && source->iface->name) ? source->iface->name : "unknown");
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CONTENT_SOURCE_H__ */
@@ -40,6 +40,8 @@ extern "C" {
 
 #define GAMECARD_CERTIFICATE_OFFSET 0x7000
 
+#define GAMECARD_STREAM_CHUNK_SIZE  0x800000                        /* 8 MiB. */
+
 /// Encrypted using AES-128-ECB with the common titlekek generator key (stored in the .rodata segment from the Lotus firmware).
 typedef struct {
     union {
@@ -270,6 +272,14 @@ typedef struct {
 
 NXDT_ASSERT(LotusAsicFirmwareBlob, 0x7800);
 
+/// Data chunk retrieved from a gamecard read stream. Must be given back using gamecardStreamReleaseChunk() once it's no longer needed.
+typedef struct {
+    void *data;                     ///< Points to data within an internal, page-aligned stream buffer. May be modified by the caller.
+    u64 size;                       ///< Chunk size. Never exceeds GAMECARD_STREAM_CHUNK_SIZE.
+    u64 offset;                     ///< Gamecard storage offset for this chunk.
+    u32 buffer_idx;                 ///< Internal stream buffer index.
+} GameCardStreamChunk;
+
 /// Initializes data needed to access raw gamecard storage areas.
 /// Also spans a background thread to automatically detect gamecard status changes and to cache data from the inserted gamecard.
 bool gamecardInitialize(void);
@@ -302,6 +312,23 @@ bool gamecardGetLotusAsicFirmwareBlob(LotusAsicFirmwareBlob *out_lafw_blob, u64
 /// 'offset' + 'read_size' must not exceed the value returned by gamecardGetTotalSize().
 bool gamecardReadStorage(void *out, u64 read_size, u64 offset);
 
+/// Starts a sequential read stream for the provided gamecard storage range. Only a single stream may be active at any given time.
+/// A background thread reads the range ahead of the caller, using page-aligned reads into a set of rotating internal buffers. This keeps the next read queued while the caller processes the current chunk.
+/// Reads never span both the normal and secure storage areas, which means a stream only switches storage areas once.
+/// 'offset' + 'size' must not exceed the value returned by gamecardGetTotalSize().
+bool gamecardStreamStart(u64 offset, u64 size);
+
+/// Retrieves the next chunk from the active gamecard read stream. Chunk data isn't copied: it points straight into an internal stream buffer.
+/// Chunks are handed out in order, and the stream thread only reuses a buffer once its chunk has been released. Up to two chunks may be held by the caller at the same time without stalling the stream.
+/// Returns false if a read error occurred, or if the whole range has already been handed out.
+bool gamecardStreamRead(GameCardStreamChunk *out_chunk);
+
+/// Gives back a chunk retrieved with gamecardStreamRead(), which lets the stream thread reuse its buffer.
+void gamecardStreamReleaseChunk(const GameCardStreamChunk *chunk);
+
+/// Stops the active gamecard read stream and frees its buffers. Pointers from previously retrieved chunks become invalid.
+void gamecardStreamEnd(void);
+
 /// Fills the provided GameCardHeader pointer.
 /// This area can also be read using gamecardReadStorage(), starting at offset 0.
 bool gamecardGetHeader(GameCardHeader *out);
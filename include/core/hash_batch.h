@@ -0,0 +1,67 @@
+/*
+ * hash_batch.h
+ *
+ * Copyright (c) 2020-2023, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#ifndef __HASH_BATCH_H__
+#define __HASH_BATCH_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HASH_BATCH_WORKER_THREAD_COUNT      2           /* Persistent helper threads used to calculate hashes alongside the calling thread. */
+#define HASH_BATCH_PARALLEL_MIN_SIZE        0x20000     /* Batches with less data than this are processed on the calling thread. */
+#define HASH_BATCH_PARALLEL_MIN_JOB_COUNT   4           /* Batches with fewer jobs than this are processed on the calling thread. */
+
+typedef enum {
+    HashBatchAlgorithm_Sha256  = 0,
+    HashBatchAlgorithm_Sha3256 = 1,
+    HashBatchAlgorithm_Count   = 2  ///< Total values supported by this enum.
+} HashBatchAlgorithm;
+
+/// Used to define a single hash calculation job within a batch.
+typedef struct {
+    const void *src;                ///< Input data.
+    size_t size;                    ///< Input data size.
+    size_t padded_size;             ///< If greater than 'size', input data is hashed as if it was followed by ('padded_size' - 'size') zeroes. Ignored otherwise.
+    u8 hash[SHA256_HASH_SIZE];      ///< Output hash. Filled by hashBatchCalculate().
+} HashBatchJob;
+
+/// One-shot function to calculate a single hash using a HashBatchAlgorithm value. 'dst' must have a size of at least SHA256_HASH_SIZE bytes.
+/// If 'padded_size' is greater than 'size', input data is hashed as if it was followed by ('padded_size' - 'size') zeroes.
+void hashBatchCalculateHash(void *dst, const void *src, size_t size, size_t padded_size, u8 algorithm);
+
+/// Calculates hashes for all the provided independent jobs using the same HashBatchAlgorithm value.
+/// Jobs are spread across helper threads running on other CPU cores if there are enough jobs and the total amount of input data is big enough. Output hashes are the same as the ones from single calls.
+bool hashBatchCalculate(HashBatchJob *jobs, u32 job_count, u8 algorithm);
+
+/// Starts the helper threads used by hashBatchCalculate(). Must be called at startup. If the helper threads aren't running, all jobs are processed on the calling thread.
+bool hashBatchStartWorkers(void);
+
+/// Stops the helper threads used by hashBatchCalculate().
+void hashBatchStopWorkers(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HASH_BATCH_H__ */
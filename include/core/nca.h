@@ -25,6 +25,7 @@
 #define __NCA_H__
 
 #include "tik.h"
+#include "content_source.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -60,6 +61,9 @@ extern "C" {
 
 #define NCA_SIGNATURE_AREA_SIZE                     0x200                       /* Signature is calculated starting at the NCA header magic word. */
 
+#define NCA_READ_V_MAX_GAP_SIZE                     0x4000                      /* Read requests separated by less than this are merged into a single span by vectored reads. */
+#define NCA_READ_V_MAX_SPAN_SIZE                    0x400000                    /* Merged spans are never bigger than this. Bigger requests are read on their own. */
+
 typedef enum {
     NcaDistributionType_Download = 0,
     NcaDistributionType_GameCard = 1,
@@ -409,6 +413,7 @@ typedef struct {
     Aes128CtrContext ctr_ctx;           ///< Used internally by NCA functions to perform AES-128-CTR crypto.
     Aes128XtsContext xts_decrypt_ctx;   ///< Used internally by NCA functions to perform AES-128-XTS decryption.
     Aes128XtsContext xts_encrypt_ctx;   ///< Used internally by NCA functions to perform AES-128-XTS encryption.
+    Mutex crypto_mutex;                 ///< Used internally by NCA functions to serialize access to the crypto state from this FS section.
 
     ///< NSP-related fields.
     bool header_written;                ///< Set to true after this FS section header has been written to an output dump.
@@ -438,6 +443,7 @@ struct _NcaContext {
     u8 storage_id;                                      ///< NcmStorageId.
     NcmContentStorage *ncm_storage;                     ///< Pointer to a NcmContentStorage instance. Used to read NCA data from eMMC/SD.
     u64 gamecard_offset;                                ///< Used to read NCA data from a gamecard using a FsStorage instance when storage_id == NcmStorageId_GameCard.
+    ContentSource source;                               ///< Content source used to read raw NCA data. All NCA reads go through this.
     u64 title_id;                                       ///< ID from the title that owns this NCA. Retrieved from NcmContentMetaKey. Placed here for convenience.
     Version title_version;                              ///< Version from the title that owns this NCA. Retrieved from NcmContentMetaKey. Placed here for convenience.
     u8 title_type;                                      ///< NcmContentMetaType. Retrieved from NcmContentMetaKey. Placed here for convenience.
@@ -489,11 +495,26 @@ typedef struct {
     NcaHashDataPatch hash_level_patch[NCA_IVFC_LEVEL_COUNT];
 } NcaHierarchicalIntegrityPatch;
 
-/// Functions to control the internal heap buffer used by NCA FS section crypto operations.
+/// Used to define a single read request from a scatter-gather list. Offset semantics depend on the function the request is passed to.
+typedef struct {
+    void *out;
+    u64 size;
+    u64 offset;
+} NcaReadRequest;
+
+/// Used by ncaProcessReadRequests() to read a single merged span.
+typedef bool (*NcaReadSpanFunction)(void *arg, void *out, u64 read_size, u64 offset);
+
+/// Functions to control the internal heap buffer pool used by NCA FS section crypto operations.
+/// Each read operation leases its own buffer from the pool, which means concurrent reads from different NCA FS sections don't block each other.
 /// Must be called at startup.
 bool ncaAllocateCryptoBuffer(void);
 void ncaFreeCryptoBuffer(void);
 
+/// Writes the persistent NCA header cache to the SD card (if it has been modified) and frees it.
+/// The cache holds raw NCA headers that have already been read and validated by ncaInitializeContext(), keyed by content ID and content size.
+void ncaCloseHeaderCache(void);
+
 /// Initializes a NCA context.
 /// If 'storage_id' == NcmStorageId_GameCard, the 'hfs_partition_type' argument must be a valid HashFileSystemPartitionType value.
 /// If the NCA holds a populated Rights ID field, ticket data will need to be retrieved.
@@ -502,10 +523,20 @@ void ncaFreeCryptoBuffer(void);
 /// If ticket data can't be retrieved, the context will still be initialized, but anything that involves working with encrypted NCA FS section blocks won't be possible (e.g. ncaReadFsSection()).
 bool ncaInitializeContext(NcaContext *out, u8 storage_id, u8 hfs_partition_type, const NcmContentMetaKey *meta_key, const NcmContentInfo *content_info, Ticket *tik);
 
+/// Same as ncaInitializeContext(), but uses a caller-provided content source (e.g. a local NCA file, or a NCA within a NSP / XCI image file) to read NCA data.
+/// The content source is copied to the NCA context, but it isn't owned by it: it must remain open for as long as the NCA context is being used, and closed by the caller afterwards.
+/// 'content_info' must match the content source size. Storage ID is set to NcmStorageId_None.
+/// Since no console services are used, ticket data can only be used if 'tik' points to a Ticket element that has already been retrieved.
+bool ncaInitializeContextFromContentSource(NcaContext *out, const ContentSource *source, const NcmContentMetaKey *meta_key, const NcmContentInfo *content_info, Ticket *tik);
+
 /// Reads raw encrypted data from a NCA using an input context, previously initialized by ncaInitializeContext().
 /// Input offset must be relative to the start of the NCA content file.
 bool ncaReadContentFile(NcaContext *ctx, void *out, u64 read_size, u64 offset);
 
+/// Same as ncaReadContentFile(), but the read operation is submitted to the content source read engine (see contentSourceReadAsync()).
+/// Both the NCA context and the output buffer must remain valid until 'callback' is invoked.
+bool ncaReadContentFileAsync(NcaContext *ctx, void *out, u64 read_size, u64 offset, ContentSourceReadCallback callback, void *callback_arg);
+
 /// Retrieves the FS section's hierarchical hash target layer extents.
 /// Output offset is relative to the start of the FS section.
 /// Either 'out_offset' or 'out_size' can be NULL, but at least one of them must be a valid pointer.
@@ -516,6 +547,15 @@ bool ncaGetFsSectionHashTargetExtents(NcaFsSectionContext *ctx, u64 *out_offset,
 /// If dealing with Patch RomFS sections, this function should only be used when *not* reading AesCtrEx storage data. Use ncaReadAesCtrExStorage() for that.
 bool ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset);
 
+/// Reads decrypted data from a NCA FS section using a scatter-gather list of read requests. Input offsets must be relative to the start of the NCA FS section.
+/// Requests are sorted by offset, and overlapping or nearby requests are merged into larger spans. Each span is read and decrypted once, then scattered to the output buffers.
+/// The FS section crypto state is only locked once for the whole list. The same restrictions from ncaReadFsSection() apply.
+bool ncaReadFsSectionV(NcaFsSectionContext *ctx, const NcaReadRequest *requests, u32 request_count);
+
+/// Sorts and merges the provided read requests (see NCA_READ_V_MAX_GAP_SIZE and NCA_READ_V_MAX_SPAN_SIZE), then calls 'read_func' once per merged span.
+/// Spans that only hold a single request are read straight into its output buffer. Used by ncaReadFsSectionV() and ncaStorageReadV().
+bool ncaProcessReadRequests(const NcaReadRequest *requests, u32 request_count, NcaReadSpanFunction read_func, void *read_arg);
+
 /// Reads plaintext AesCtrEx storage data from a NCA Patch RomFS section using an input context and an AesCtrEx CTR value.
 /// Input offset must be relative to the start of the NCA FS section.
 bool ncaReadAesCtrExStorage(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u32 ctr_val, bool decrypt);
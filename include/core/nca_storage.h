@@ -30,6 +30,10 @@
 extern "C" {
 #endif
 
+#define NCA_STORAGE_MAX_HASH_LAYER_COUNT            NCA_IVFC_LEVEL_COUNT
+
+#define NCA_STORAGE_HASH_BLOCK_CACHE_ENTRY_COUNT    16
+
 typedef enum {
     NcaStorageBaseStorageType_Invalid    = 0,   ///< Placeholder.
     NcaStorageBaseStorageType_Regular    = 1,
@@ -39,14 +43,44 @@ typedef enum {
     NcaStorageBaseStorageType_Count      = 5    ///< Total values supported by this enum.
 } NcaStorageBaseStorageType;
 
+/// Holds the properties from a single hierarchical hash layer. Offsets are relative to the start of the NCA FS section.
+typedef struct {
+    u64 offset;
+    u64 size;
+    u64 block_size;
+} NcaStorageHashLayer;
+
+/// Holds a hash layer block that has already been verified against its parent layer.
+typedef struct {
+    u8 *data;           ///< Verified block data. NULL if this entry is unused.
+    u64 data_size;      ///< Size of the allocated block buffer. The last block from a layer may be smaller than this.
+    u32 layer_index;    ///< Set to UINT32_MAX while the block is being verified.
+    u64 block_index;
+    u64 last_used;      ///< Used to evict the least recently used entry.
+} NcaStorageHashBlockCacheEntry;
+
+/// Used to verify data read from the hash target layer against the hierarchical hash layers from a NCA FS section.
+typedef struct {
+    u8 hash_algorithm;                                                                  ///< HashBatchAlgorithm.
+    bool zero_pad_blocks;                                                               ///< HierarchicalIntegrity: partial blocks are hashed as if they were zero-padded to the full block size.
+    u32 layer_count;
+    NcaStorageHashLayer layers[NCA_STORAGE_MAX_HASH_LAYER_COUNT];                       ///< The last valid entry represents the hash target layer.
+    u8 master_hash[SHA256_HASH_SIZE];                                                   ///< Copied from the NCA FS section header. Used to verify the master layer.
+    u8 *master_layer;                                                                   ///< Verified master layer data. Only read and verified once.
+    Mutex cache_mutex;
+    NcaStorageHashBlockCacheEntry cache[NCA_STORAGE_HASH_BLOCK_CACHE_ENTRY_COUNT];
+    u64 cache_tick;
+} NcaStorageHashVerificationContext;
+
 /// Used to perform multi-layered reads within a single NCA FS section.
 typedef struct {
-    u8 base_storage_type;                   ///< NcaStorageBaseStorageType.
-    NcaFsSectionContext *nca_fs_ctx;        ///< NCA FS section context used to initialize this context.
-    BucketTreeContext *sparse_storage;      ///< Sparse storage context.
-    BucketTreeContext *aes_ctr_ex_storage;  ///< AesCtrEx storage context.
-    BucketTreeContext *indirect_storage;    ///< Indirect storage context.
-    BucketTreeContext *compressed_storage;  ///< Compressed storage context.
+    u8 base_storage_type;                                       ///< NcaStorageBaseStorageType.
+    NcaFsSectionContext *nca_fs_ctx;                            ///< NCA FS section context used to initialize this context.
+    BucketTreeContext *sparse_storage;                          ///< Sparse storage context.
+    BucketTreeContext *aes_ctr_ex_storage;                      ///< AesCtrEx storage context.
+    BucketTreeContext *indirect_storage;                        ///< Indirect storage context.
+    BucketTreeContext *compressed_storage;                      ///< Compressed storage context.
+    NcaStorageHashVerificationContext *hash_verification_ctx;   ///< Hash verification context. Only allocated if hash verification has been enabled.
 } NcaStorageContext;
 
 /// Initializes a NCA storage context using a NCA FS section context, optionally providing a pointer to a base NcaStorageContext.
@@ -60,8 +94,19 @@ bool ncaStorageInitializeContext(NcaStorageContext *out, NcaFsSectionContext *nc
 bool ncaStorageGetHashTargetExtents(NcaStorageContext *ctx, u64 *out_offset, u64 *out_size);
 
 /// Reads data from the NCA storage using a previously initialized NcaStorageContext.
+/// If hash verification has been enabled, data from the hash target layer is checked against the hierarchical hash layers before returning.
 bool ncaStorageRead(NcaStorageContext *ctx, void *out, u64 read_size, u64 offset);
 
+/// Reads data from the NCA storage using a scatter-gather list of read requests. Same offset semantics as ncaStorageRead().
+/// Requests are sorted and merged (see ncaProcessReadRequests()), so each merged span is only read, decrypted and verified once.
+/// Regular base storages without hash verification are read through ncaReadFsSectionV(), which locks the FS section crypto state once for the whole list.
+bool ncaStorageReadV(NcaStorageContext *ctx, const NcaReadRequest *requests, u32 request_count);
+
+/// Enables or disables hash verification for ncaStorageRead() calls that involve the hash target layer.
+/// Each data block is checked against its parent hash layer, all the way up to the master hash from the NCA FS section header. Verified hash layer blocks are cached.
+/// Only supported by Regular and Indirect base storages from NCA FS sections with HierarchicalSha256 or HierarchicalIntegrity hash layers.
+bool ncaStorageSetHashVerification(NcaStorageContext *ctx, bool enable);
+
 /// Checks if the provided block extents are within the provided Patch NcaStorageContext's Indirect Storage.
 bool ncaStorageIsBlockWithinPatchStorageRange(NcaStorageContext *ctx, u64 offset, u64 size, bool *out);
 
@@ -94,6 +94,7 @@ void logWriteStringToLogFile(const char *src);
 
 /// Writes a formatted log string to the logfile.
 /// If the logfile hasn't been created and/or opened, this function takes care of it.
+/// Messages are pushed to a lock-free ring buffer and moved to the log buffer by a background flusher thread. Messages that don't fit in a ring buffer slot are written synchronously.
 __attribute__((format(printf, 5, 6))) void logWriteFormattedStringToLogFile(u8 level, const char *file_name, int line, const char *func_name, const char *fmt, ...);
 
 /// Writes a formatted log string to the provided buffer.
@@ -102,12 +103,14 @@ __attribute__((format(printf, 7, 8))) void logWriteFormattedStringToBuffer(char
 
 /// Writes a formatted log string + a hex string representation of the provided binary data to the logfile.
 /// If the logfile hasn't been created and/or opened, this function takes care of it.
+/// The hex string representation is generated by the background flusher thread whenever possible.
 __attribute__((format(printf, 7, 8))) void logWriteBinaryDataToLogFile(const void *data, size_t data_size, u8 level, const char *file_name, int line, const char *func_name, const char *fmt, ...);
 
 /// Forces a flush operation on the logfile.
 void logFlushLogFile(void);
 
 /// Write any pending data to the logfile, flushes it and then closes it.
+/// The asynchronous logging backend isn't restarted afterwards: any messages logged past this point are synchronously written.
 void logCloseLogFile(void);
 
 /// Returns a pointer to a dynamically allocated buffer that holds the last error message string, or NULL if there's none.
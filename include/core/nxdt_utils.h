@@ -64,6 +64,14 @@ typedef struct {
     const char *download_url;   ///< Pointer to the download URL string, referenced by obj.
 } UtilsGitHubReleaseJsonData;
 
+/// Growable string buffer. Keeps track of its own length, so appending data doesn't involve scanning the whole string.
+/// Must be zero-initialized before its first use, and freed using utilsStringBuilderFree() unless its string is taken over by the caller.
+typedef struct {
+    char *str;                  ///< NULL-terminated string. Dynamically allocated. Set to NULL until the first append operation.
+    size_t len;                 ///< String length, excluding the NULL terminator.
+    size_t size;                ///< Allocated buffer size.
+} UtilsStringBuilder;
+
 /// Resource initialization.
 /// Called at program startup.
 bool utilsInitializeResources(void);
@@ -113,6 +121,13 @@ void utilsJoinThread(Thread *thread);
 /// If the buffer isn't big enough to hold both its current contents and the new formatted string, it will be resized.
 __attribute__((format(printf, 3, 4))) bool utilsAppendFormattedStringToBuffer(char **dst, size_t *dst_size, const char *fmt, ...);
 
+/// Formats a string and appends it to the provided string builder.
+/// The buffer grows geometrically, so the cost of appending data doesn't depend on the current string length. No locks are taken.
+__attribute__((format(printf, 2, 3))) bool utilsStringBuilderAppendFormatted(UtilsStringBuilder *sb, const char *fmt, ...);
+
+/// Frees the string from the provided string builder and resets it.
+void utilsStringBuilderFree(UtilsStringBuilder *sb);
+
 /// Replaces illegal FAT characters in the provided UTF-8 string with underscores.
 /// If 'ascii_only' is set to true, all codepoints outside the [0x20,0x7F) range will also be replaced with underscores.
 /// Replacements are performed on a per-codepoint basis, which means the string length can be reduced by this function.
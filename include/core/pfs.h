@@ -80,6 +80,10 @@ bool pfsReadPartitionData(PartitionFileSystemContext *ctx, void *out, u64 read_s
 /// Input offset must be relative to the start of the Partition FS entry.
 bool pfsReadEntryData(PartitionFileSystemContext *ctx, PartitionFileSystemEntry *fs_entry, void *out, u64 read_size, u64 offset);
 
+/// Same as pfsReadEntryData(), but takes a scatter-gather list of read requests. See ncaStorageReadV().
+/// Input offsets must be relative to the start of the Partition FS entry.
+bool pfsReadEntryDataV(PartitionFileSystemContext *ctx, PartitionFileSystemEntry *fs_entry, const NcaReadRequest *requests, u32 request_count);
+
 /// Retrieves a Partition FS entry index by its name.
 bool pfsGetEntryIndexByName(PartitionFileSystemContext *ctx, const char *name, u32 *out_idx);
 
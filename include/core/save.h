@@ -38,6 +38,10 @@ extern "C" {
 #define SAVE_FS_LIST_MAX_NAME_LENGTH    0x40
 #define SAVE_FS_LIST_ENTRY_SIZE         0x60
 
+#define SAVE_BLOCK_CACHE_BLOCK_SIZE     0x4000  /* Savefile data is read from the BIS System partition in blocks this big. */
+#define SAVE_BLOCK_CACHE_BLOCK_COUNT    32
+#define SAVE_IVFC_HASH_BUFFER_SIZE      0x1000  /* Holds the hashes for up to 128 sectors, which are verified in a single run. */
+
 #define MAGIC_DISF                      0x46534944
 #define MAGIC_DPFS                      0x53465044
 #define MAGIC_JNGL                      0x4C474E4A
@@ -225,6 +229,21 @@ enum base_storage_type {
     STORAGE_JOURNAL = 3
 };
 
+typedef struct {
+    u64 offset;
+    u32 size;
+    u64 last_use;
+    bool valid;
+} save_block_cache_entry_t;
+
+/* LRU cache for savefile blocks. Used by all the storages that read data straight from the savefile (remap, journal and IVFC levels). */
+typedef struct {
+    FIL *file;
+    u8 *data;
+    save_block_cache_entry_t entries[SAVE_BLOCK_CACHE_BLOCK_COUNT];
+    u64 use_counter;
+} save_block_cache_t;
+
 typedef struct {
     remap_header_t *header;
     remap_entry_ctx_t *map_entries;
@@ -233,6 +252,7 @@ typedef struct {
     u64 base_storage_offset;
     duplex_storage_ctx_t *duplex;
     FIL *file;
+    save_block_cache_t *block_cache;
 } remap_storage_ctx_t;
 
 typedef struct {
@@ -363,6 +383,8 @@ struct integrity_verification_storage_ctx_t {
     u32 sector_count;
     u64 _length;
     integrity_verification_storage_ctx_t *next_level;
+    u8 *sector_buffer;          /* Scratch buffer used to verify partially read sectors. */
+    u8 *hash_buffer;            /* Scratch buffer used to hold parent level hashes. SAVE_IVFC_HASH_BUFFER_SIZE bytes long. */
 };
 
 typedef struct {
@@ -471,6 +493,7 @@ typedef struct {
 struct save_ctx_t {
     save_header_t header;
     FIL *file;
+    save_block_cache_t block_cache;
     struct {
         FIL *file;
         u32 action;
@@ -187,8 +187,13 @@ typedef struct {
 /// Retrieves a ticket from either the ES ticket system savedata file (eMMC BIS System partition) or the secure Hash FS partition from an inserted gamecard.
 /// Both the input rights ID and key generation values must have been retrieved from a NCA that depends on the desired ticket.
 /// Titlekey is also RSA-OAEP unwrapped (if needed) and titlekek-decrypted right away.
+/// ES ticket system savefiles are kept open across calls, along with a rights ID index built from their ticket_list.bin files.
 bool tikRetrieveTicketByRightsId(Ticket *dst, const FsRightsId *id, u8 key_generation, bool use_gamecard);
 
+/// Closes the ES ticket system savefiles kept open by tikRetrieveTicketByRightsId() and frees their indexes.
+/// Must be called before unmounting the eMMC BIS System partition.
+void tikCloseEsSystemSavefiles(void);
+
 /// Converts a TikTitleKeyType_Personalized ticket into a TikTitleKeyType_Common ticket and optionally generates a raw certificate chain for the new signature issuer.
 /// Bear in mind the 'size' member from the Ticket parameter will be updated by this function to remove any possible references to ESV1/ESV2 records.
 /// If both 'out_raw_cert_chain' and 'out_raw_cert_chain_size' pointers are provided, raw certificate chain data will be saved to them.
@@ -42,10 +42,15 @@ typedef enum {
     UsbHostSpeed_Count      = 4     ///< Total values supported by this enum.
 } UsbHostSpeed;
 
-/// Initializes the USB interface, input and output endpoints and allocates an internal transfer buffer.
+/// Used by usbSendFileDataAsync() to give buffer ownership back to the caller once the corresponding USB transfer has been retired.
+/// 'success' is false if the transfer failed or was cancelled. This may be invoked from a background thread.
+typedef void (*UsbTransferDoneCallback)(void *data, bool success, void *callback_arg);
+
+/// Initializes the USB interface, input and output endpoints and allocates internal transfer buffers.
+/// File data chunks are posted to the input endpoint through a write queue, which allows multiple transfers to be in flight at the same time.
 bool usbInitialize(void);
 
-/// Closes the USB interface, input and output endpoints and frees the transfer buffer.
+/// Closes the USB interface, input and output endpoints and frees the transfer buffers.
 void usbExit(void);
 
 /// Returns a pointer to a dynamically allocated, page aligned memory buffer that's suitable for USB transfers.
@@ -71,8 +76,16 @@ bool usbSendNspProperties(u64 nsp_size, const char *filename, u32 nsp_header_siz
 /// Data chunk size must not exceed USB_TRANSFER_BUFFER_SIZE.
 /// If the last file data chunk is aligned to the endpoint max packet size, the host device should expect a Zero Length Termination (ZLT) packet.
 /// Calling this function if there's no remaining data to transfer will result in an error.
+/// Data chunks that aren't page aligned are copied to an internal buffer and queued, so this function may return before they reach the host device.
+/// Page aligned data chunks are transferred as-is, in which case this function only returns after the transfer has been completed.
+/// Errors from previously queued chunks are reported by subsequent calls.
 bool usbSendFileData(void *data, u64 data_size);
 
+/// Same as usbSendFileData(), but 'data' must be page aligned (see usbAllocatePageAlignedBuffer()) and its ownership is handed off to the write queue.
+/// This function returns as soon as the transfer has been queued. 'callback' is invoked exactly once per call, after which the buffer may be reused or freed.
+/// If this is the last file data chunk, this function returns after all queued transfers have been completed and the host device has replied.
+bool usbSendFileDataAsync(void *data, u64 data_size, UsbTransferDoneCallback callback, void *callback_arg);
+
 /// Used to gracefully cancel an ongoing file transfer. The current USB session is kept alive.
 void usbCancelFileTransfer(void);
 
@@ -86,7 +99,18 @@ bool usbStartExtractedFsDump(u64 extracted_fs_size, const char *extracted_fs_roo
 
 /// Informs the host device that a previously started filesystem dump (via usbStartExtractedFsDump()) has finished.
 /// This is only issued after all extracted file entries have been successfully transferred to the host device.
-void usbEndExtractedFsDump(void);
+/// Pending file stream packets are sent to the host device before the command itself. Returns false if any of them couldn't be delivered.
+bool usbEndExtractedFsDump(void);
+
+/// Opens a new file stream for an extracted filesystem entry. Only available after a successful usbStartExtractedFsDump() call.
+/// File streams don't require a full command round-trip per file: OpenFile and FileData packets from multiple file streams are packed together and sent in batches, which the host device acknowledges with a single status block.
+/// Batches are sent whenever they fill up, right before a regular command is issued and by usbEndExtractedFsDump().
+/// 'file_size' may be zero, in which case no usbSendFileStreamData() calls are needed. The returned stream ID is only valid until all file data has been sent.
+bool usbOpenFileStream(u64 file_size, const char *filename, u32 *out_stream_id);
+
+/// Queues file data for a file stream opened with usbOpenFileStream(). The file stream is closed once all of its data has been queued.
+/// Since data is only sent in batches, errors may be reported by a later call.
+bool usbSendFileStreamData(u32 stream_id, const void *data, u64 data_size);
 
 #ifdef __cplusplus
 }
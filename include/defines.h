@@ -101,6 +101,7 @@
 #define LOG_FILE_NAME                   APP_TITLE ".log"
 #define LOG_BUF_SIZE                    0x400000                                                        /* 4 MiB. */
 #define LOG_FORCE_FLUSH                 0                                                               /* Forces a log buffer flush each time the logfile is written to. */
+#define LOG_FLUSH_INTERVAL              100000000                                                       /* 100 milliseconds. Used by the background log flusher thread to drain the log ring buffer. */
 
 #define BIS_SYSTEM_PARTITION_MOUNT_NAME "sys:"
 
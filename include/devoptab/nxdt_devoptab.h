@@ -34,6 +34,12 @@ extern "C" {
 
 #define DEVOPTAB_MOUNT_NAME_LENGTH                  32  // Including NULL terminator.
 
+#define DEVOPTAB_READAHEAD_MIN_SIZE                 0x20000     /* 128 KiB. Initial readahead window size for sequential reads. */
+#define DEVOPTAB_READAHEAD_MAX_SIZE                 0x200000    /* 2 MiB. The readahead window is doubled on each sequential read until it reaches this size. */
+
+#define DEVOPTAB_BLOCK_CACHE_ENTRY_COUNT            8
+#define DEVOPTAB_BLOCK_CACHE_MAX_SIZE               0x800000    /* 8 MiB. Shared by all mounted devices. */
+
 #define DEVOPTAB_DECL_ERROR_STATE                   int _errno = 0
 #define DEVOPTAB_DECL_DEV_CTX                       DevoptabDeviceContext *dev_ctx = (DevoptabDeviceContext*)r->deviceData
 #define DEVOPTAB_DECL_FS_CTX(type)                  type *fs_ctx = (type*)dev_ctx->fs_ctx
@@ -56,10 +62,10 @@ do { \
 #define DEVOPTAB_RETURN_UNSUPPORTED_OP              r->_errno = ENOSYS; \
                                                     return -1;
 
-#define DEVOPTAB_INIT_VARS(type)                    devoptabControlMutex(true); \
-                                                    DEVOPTAB_DECL_ERROR_STATE; \
+#define DEVOPTAB_INIT_VARS(type)                    DEVOPTAB_DECL_ERROR_STATE; \
                                                     DEVOPTAB_DECL_DEV_CTX; \
-                                                    if (!dev_ctx->initialized) DEVOPTAB_SET_ERROR_AND_EXIT(ENODEV);
+                                                    bool _dev_acquired = devoptabAcquireDevice(dev_ctx); \
+                                                    if (!_dev_acquired) DEVOPTAB_SET_ERROR_AND_EXIT(ENODEV);
 
 #define DEVOPTAB_INIT_FILE_VARS(fs_type, file_type) DEVOPTAB_INIT_VARS(fs_type); \
                                                     DEVOPTAB_DECL_FILE_STATE(file_type)
@@ -67,16 +73,29 @@ do { \
 #define DEVOPTAB_INIT_DIR_VARS(fs_type, dir_type)   DEVOPTAB_INIT_VARS(fs_type); \
                                                     DEVOPTAB_DECL_DIR_STATE(dir_type)
 
-#define DEVOPTAB_DEINIT_VARS                        devoptabControlMutex(false)
+#define DEVOPTAB_DEINIT_VARS                        if (_dev_acquired) devoptabReleaseDevice(dev_ctx)
 
 typedef struct {
     bool initialized;                       ///< Device initialization flag.
+    Mutex ref_mutex;                        ///< Protects 'initialized' and 'ref_count'. Never cleared.
+    CondVar ref_condvar;                    ///< Signaled when 'ref_count' drops to zero. Never cleared.
+    u32 ref_count;                          ///< Number of filesystem operations currently in flight. The device can't be unmounted until it drops to zero.
     char name[DEVOPTAB_MOUNT_NAME_LENGTH];  ///< Mount name string, without a trailing colon (:).
     time_t mount_time;                      ///< Mount time.
     devoptab_t device;                      ///< Devoptab virtual device interface. Provides a way to use libcstd I/O calls on the mounted filesystem.
     void *fs_ctx;                           ///< Pointer to actual type-specific filesystem context (PartitionFileSystemContext, HashFileSystemContext, RomFileSystemContext).
 } DevoptabDeviceContext;
 
+/// Used by filesystem-specific devoptab interfaces to detect sequential access on a per-open-file basis.
+/// Must be cleared when a file is opened.
+typedef struct {
+    u64 next_offset;    ///< Offset right after the last read. Reads starting at this offset are considered sequential.
+    u64 window_size;    ///< Current readahead window size. Set to zero if no sequential access has been detected.
+} DevoptabReadAheadState;
+
+/// Used by devoptabReadFileEntryData() to read data from a filesystem-specific entry.
+typedef bool (*DevoptabReadEntryDataFunction)(void *fs_ctx, void *fs_entry, void *out, u64 read_size, u64 offset);
+
 /// Mounts a virtual Partition FS device using the provided Partition FS context and a mount name.
 bool devoptabMountPartitionFileSystemDevice(PartitionFileSystemContext *pfs_ctx, const char *name);
 
@@ -92,8 +111,18 @@ void devoptabUnmountDevice(const char *name);
 /// Unmounts all previously mounted virtual devices.
 void devoptabUnmountAllDevices(void);
 
-/// (Un)locks the devoptab mutex. Used by filesystem-specific devoptab interfaces.
-void devoptabControlMutex(bool lock);
+/// Takes a reference to a mounted device. Used by filesystem-specific devoptab interfaces at the start of each filesystem operation.
+/// Returns false if the device isn't mounted (anymore). Operations on different devices, as well as concurrent operations on the same device, don't block each other.
+bool devoptabAcquireDevice(DevoptabDeviceContext *dev_ctx);
+
+/// Drops a reference previously taken with devoptabAcquireDevice(). Used by filesystem-specific devoptab interfaces at the end of each filesystem operation.
+void devoptabReleaseDevice(DevoptabDeviceContext *dev_ctx);
+
+/// Reads data from a filesystem entry that belongs to a mounted device. Used by filesystem-specific devoptab interfaces.
+/// Small sequential reads are served from readahead windows stored in a shared, size-bounded block cache. Random and large reads bypass the cache.
+/// 'fs_entry_size' is used to clamp readahead windows. The provided read extents must not exceed it.
+bool devoptabReadFileEntryData(DevoptabDeviceContext *dev_ctx, DevoptabReadAheadState *readahead, void *fs_entry, u64 fs_entry_size, DevoptabReadEntryDataFunction read_func, \
+                               void *out, u64 read_size, u64 offset);
 
 #ifdef __cplusplus
 }
@@ -19,8 +19,25 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <arm_neon.h>
+
 #include "nxdt_utils.h"
 
+#define AES_XTS_INTERLEAVE_COUNT    4   /* Number of sectors processed at the same time by the multi-sector AES-XTS kernel. */
+
+/* Global variables. */
+
+static atomic_int g_aesXtsKernelState = 0;  /* Zero if the multi-sector AES-XTS kernel hasn't been checked yet, positive if it's usable, negative otherwise. */
+
+/* Function prototypes. */
+
+static size_t aes128XtsNintendoCryptPerSector(Aes128XtsContext *ctx, void *dst, const void *src, size_t size, u64 sector, size_t sector_size, bool encrypt);
+static void aes128XtsNintendoCryptMultiSector(Aes128XtsContext *ctx, void *dst, const void *src, size_t sector_count, u64 sector, size_t sector_size, bool encrypt);
+static bool aes128XtsIsMultiSectorKernelAvailable(void);
+
+NX_INLINE void aes128CryptBlocks(const Aes128Context *ctx, uint8x16_t *blocks, u32 count, bool encrypt);
+NX_INLINE uint8x16_t aes128XtsMultiplyTweak(uint8x16_t tweak);
+
 void aes128EcbCrypt(void *dst, const void *src, const void *key, bool encrypt)
 {
     if (!dst || !src || !key) return;
@@ -44,6 +61,18 @@ size_t aes128XtsNintendoCrypt(Aes128XtsContext *ctx, void *dst, const void *src,
         return 0;
     }
 
+    /* Process multiple sectors at once, if possible. */
+    if (size > sector_size && (sector_size % AES_BLOCK_SIZE) == 0 && aes128XtsIsMultiSectorKernelAvailable())
+    {
+        aes128XtsNintendoCryptMultiSector(ctx, dst, src, size / sector_size, sector, sector_size, encrypt);
+        return size;
+    }
+
+    return aes128XtsNintendoCryptPerSector(ctx, dst, src, size, sector, sector_size, encrypt);
+}
+
+static size_t aes128XtsNintendoCryptPerSector(Aes128XtsContext *ctx, void *dst, const void *src, size_t size, u64 sector, size_t sector_size, bool encrypt)
+{
     size_t i, crypt_res = 0;
     u64 cur_sector = sector;
 
@@ -60,3 +89,111 @@ size_t aes128XtsNintendoCrypt(Aes128XtsContext *ctx, void *dst, const void *src,
 
     return i;
 }
+
+static void aes128XtsNintendoCryptMultiSector(Aes128XtsContext *ctx, void *dst, const void *src, size_t sector_count, u64 sector, size_t sector_size, bool encrypt)
+{
+    const size_t block_count = (sector_size / AES_BLOCK_SIZE);
+
+    u8 *dst_u8 = (u8*)dst;
+    const u8 *src_u8 = (const u8*)src;
+
+    uint8x16_t tweaks[AES_XTS_INTERLEAVE_COUNT] = {0}, blocks[AES_XTS_INTERLEAVE_COUNT] = {0};
+
+    for(size_t i = 0; i < sector_count; i += AES_XTS_INTERLEAVE_COUNT)
+    {
+        u32 count = (u32)MIN(AES_XTS_INTERLEAVE_COUNT, sector_count - i);
+
+        /* Calculate the tweaks for all sectors in this group at once. The Nintendo tweak stores the sector number in big endian at the end of the block. */
+        for(u32 j = 0; j < count; j++) tweaks[j] = vreinterpretq_u8_u64(vcombine_u64(vcreate_u64(0), vcreate_u64(__builtin_bswap64(sector + i + j))));
+        aes128CryptBlocks(&(ctx->tweak_ctx), tweaks, count, true);
+
+        /* Process a single AES block from each sector at a time. This keeps the AES pipeline busy, since these blocks don't depend on each other. */
+        for(size_t k = 0; k < block_count; k++)
+        {
+            for(u32 j = 0; j < count; j++) blocks[j] = veorq_u8(vld1q_u8(src_u8 + ((i + j) * sector_size) + (k * AES_BLOCK_SIZE)), tweaks[j]);
+
+            aes128CryptBlocks(&(ctx->aes_ctx), blocks, count, encrypt);
+
+            for(u32 j = 0; j < count; j++)
+            {
+                vst1q_u8(dst_u8 + ((i + j) * sector_size) + (k * AES_BLOCK_SIZE), veorq_u8(blocks[j], tweaks[j]));
+                tweaks[j] = aes128XtsMultiplyTweak(tweaks[j]);
+            }
+        }
+    }
+}
+
+static bool aes128XtsIsMultiSectorKernelAvailable(void)
+{
+    int state = atomic_load(&g_aesXtsKernelState);
+    if (state) return (state > 0);
+
+    /* Make sure the multi-sector kernel yields the same output as libnx. This guards us against changes to the layout of libnx's AES round keys. */
+    /* Worst case scenario, multiple threads run this check at the same time and reach the same result. */
+    u8 key[AES_128_KEY_SIZE * 2] = {0}, plain[0x140] = {0}, enc_ref[0x140] = {0}, enc[0x140] = {0}, dec[0x140] = {0};
+    Aes128XtsContext enc_ctx = {0}, dec_ctx = {0};
+    const u64 sector = 0x123456789ABCULL;
+    const size_t sector_size = 0x40;
+    bool available = false;
+
+    for(size_t i = 0; i < sizeof(key); i++) key[i] = (u8)((i * 0x1D) + 0x5A);
+    for(size_t i = 0; i < sizeof(plain); i++) plain[i] = (u8)((i * 0x3B) ^ 0xA5);
+
+    aes128XtsContextCreate(&enc_ctx, key, key + AES_128_KEY_SIZE, true);
+    aes128XtsContextCreate(&dec_ctx, key, key + AES_128_KEY_SIZE, false);
+
+    aes128XtsNintendoCryptPerSector(&enc_ctx, enc_ref, plain, sizeof(plain), sector, sector_size, true);
+    aes128XtsNintendoCryptMultiSector(&enc_ctx, enc, plain, sizeof(plain) / sector_size, sector, sector_size, true);
+    aes128XtsNintendoCryptMultiSector(&dec_ctx, dec, enc_ref, sizeof(plain) / sector_size, sector, sector_size, false);
+
+    available = (!memcmp(enc, enc_ref, sizeof(enc)) && !memcmp(dec, plain, sizeof(dec)));
+    if (!available) LOG_MSG_WARNING("Multi-sector AES-XTS kernel output mismatch! Falling back to per-sector libnx calls.");
+
+    atomic_store(&g_aesXtsKernelState, available ? 1 : -1);
+
+    return available;
+}
+
+NX_INLINE void aes128CryptBlocks(const Aes128Context *ctx, uint8x16_t *blocks, u32 count, bool encrypt)
+{
+    uint8x16_t round_key = {0};
+
+    if (encrypt)
+    {
+        for(u32 i = 0; i < (AES_128_NUM_ROUNDS - 1); i++)
+        {
+            round_key = vld1q_u8(ctx->round_keys[i]);
+            for(u32 j = 0; j < count; j++) blocks[j] = vaesmcq_u8(vaeseq_u8(blocks[j], round_key));
+        }
+
+        round_key = vld1q_u8(ctx->round_keys[AES_128_NUM_ROUNDS - 1]);
+        for(u32 j = 0; j < count; j++) blocks[j] = vaeseq_u8(blocks[j], round_key);
+    } else {
+        /* libnx stores decryption round keys in encryption order, with InvMixColumns already applied to the inner ones. */
+        for(u32 i = AES_128_NUM_ROUNDS; i > 1; i--)
+        {
+            round_key = vld1q_u8(ctx->round_keys[i]);
+            for(u32 j = 0; j < count; j++) blocks[j] = vaesimcq_u8(vaesdq_u8(blocks[j], round_key));
+        }
+
+        round_key = vld1q_u8(ctx->round_keys[1]);
+        for(u32 j = 0; j < count; j++) blocks[j] = vaesdq_u8(blocks[j], round_key);
+    }
+
+    /* Last round key. */
+    round_key = vld1q_u8(ctx->round_keys[encrypt ? AES_128_NUM_ROUNDS : 0]);
+    for(u32 j = 0; j < count; j++) blocks[j] = veorq_u8(blocks[j], round_key);
+}
+
+NX_INLINE uint8x16_t aes128XtsMultiplyTweak(uint8x16_t tweak)
+{
+    /* Multiply the tweak by x in GF(2^128). The tweak is treated as a little endian 128-bit value. */
+    uint64x2_t tweak_u64 = vreinterpretq_u64_u8(tweak);
+    u64 lo = vgetq_lane_u64(tweak_u64, 0), hi = vgetq_lane_u64(tweak_u64, 1);
+    u64 carry = (hi >> 63);
+
+    hi = ((hi << 1) | (lo >> 63));
+    lo = ((lo << 1) ^ (carry * 0x87));
+
+    return vreinterpretq_u8_u64(vcombine_u64(vcreate_u64(lo), vcreate_u64(hi)));
+}
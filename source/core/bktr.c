@@ -61,6 +61,35 @@ typedef struct {
     u8 parent_storage_type; ///< BucketTreeStorageType.
 } BucketTreeSubStorageReadParams;
 
+typedef struct {
+    u32 lz4_cache_id;       ///< Matches the lz4_cache_id field from the BucketTreeContext this block belongs to. Zero if this entry is unused.
+    u64 physical_offset;    ///< Physical offset for the compressed LZ4 block.
+    u64 size;               ///< Decompressed block size.
+    u8 *buffer;             ///< Dynamically allocated buffer. Decompressed data is always stored at its start.
+    u64 buffer_size;        ///< Allocated buffer size. Always big enough to perform in-place decompression of 'size' bytes.
+    u64 last_use;           ///< LRU tick value.
+} BucketTreeLz4CacheEntry;
+
+typedef struct {
+    u64 src_offset;         ///< Compressed data offset within the staging buffer.
+    u64 src_size;           ///< Compressed data size.
+    u8 *dst;                ///< Output buffer slice for this block.
+    u64 dst_size;           ///< Decompressed block size.
+} BucketTreeLz4DecompressionJob;
+
+typedef struct _BucketTreeLz4DecompressionBatch {
+    u8 *staging_buf;                                ///< Dynamically allocated buffer that holds the compressed data for all jobs.
+    u64 staging_buf_size;                           ///< Used staging buffer size.
+    u64 staging_buf_capacity;                       ///< Allocated staging buffer size. Grown geometrically.
+    BucketTreeLz4DecompressionJob *jobs;            ///< Dynamically allocated job array.
+    u32 job_count;                                  ///< Number of jobs.
+    u32 job_capacity;                               ///< Allocated job array element count. Grown geometrically.
+    u32 next_job;                                   ///< Index of the next job to be picked up. Protected by the worker mutex.
+    u32 active_jobs;                                ///< Jobs currently being processed by worker threads. Protected by the worker mutex.
+    bool error;                                     ///< Set to true if any of the jobs fails. Protected by the worker mutex.
+    struct _BucketTreeLz4DecompressionBatch *next;  ///< Next batch in the worker thread list.
+} BucketTreeLz4DecompressionBatch;
+
 /* Global variables. */
 
 #if LOG_LEVEL <= LOG_LEVEL_ERROR
@@ -72,6 +101,18 @@ static const char *g_bktrStorageTypeNames[] = {
 };
 #endif
 
+static Mutex g_bktrLz4CacheMutex = 0;
+static BucketTreeLz4CacheEntry g_bktrLz4CacheEntries[BKTR_LZ4_CACHE_ENTRY_COUNT] = {0};
+static u64 g_bktrLz4CacheTick = 0;
+static u32 g_bktrLz4CacheNextId = 1;
+
+static Mutex g_bktrLz4WorkerMutex = 0;
+static CondVar g_bktrLz4WorkerJobCondVar = 0, g_bktrLz4WorkerDoneCondVar = 0;
+static Thread g_bktrLz4WorkerThreads[BKTR_LZ4_WORKER_THREAD_COUNT] = {0};
+static u32 g_bktrLz4WorkerThreadCount = 0;
+static bool g_bktrLz4WorkersRunning = false, g_bktrLz4WorkersStop = false;
+static BucketTreeLz4DecompressionBatch *g_bktrLz4WorkerBatches = NULL;
+
 /* Function prototypes. */
 
 #if LOG_LEVEL <= LOG_LEVEL_ERROR
@@ -88,6 +129,16 @@ static bool bktrReadAesCtrExStorage(BucketTreeVisitor *visitor, void *out, u64 r
 
 static bool bktrGetCompressedStorageEntryExtents(BucketTreeVisitor *visitor, u64 offset, BucketTreeCompressedStorageEntry *out_cur_entry, u64 *out_next_entry_offset);
 static bool bktrReadCompressedStorage(BucketTreeVisitor *visitor, void *out, u64 read_size, u64 offset);
+static bool bktrReadCompressedStorageLz4Block(BucketTreeContext *ctx, const BucketTreeCompressedStorageEntry *entry, u64 decompressed_data_size, void *out, u64 read_size, u64 offset);
+static bool bktrGetLz4CachedBlock(u32 lz4_cache_id, u64 physical_offset, u64 decompressed_data_size, void *out, u64 read_size, u64 offset);
+static u8 *bktrTakeLz4CacheBuffer(u64 *out_buffer_size);
+static void bktrAddLz4CachedBlock(u32 lz4_cache_id, u64 physical_offset, u64 decompressed_data_size, u8 *buffer, u64 buffer_size);
+
+static bool bktrAddLz4DecompressionJob(BucketTreeContext *ctx, BucketTreeLz4DecompressionBatch *batch, const BucketTreeCompressedStorageEntry *entry, void *out, u64 decompressed_data_size);
+static bool bktrRunLz4DecompressionBatch(BucketTreeLz4DecompressionBatch *batch);
+static void bktrProcessLz4DecompressionJobs(BucketTreeLz4DecompressionBatch *batch);
+static bool bktrDecompressLz4Job(BucketTreeLz4DecompressionBatch *batch, BucketTreeLz4DecompressionJob *job);
+static void bktrLz4DecompressionWorkerThreadFunc(void *arg);
 
 static bool bktrReadSubStorage(BucketTreeSubStorage *substorage, BucketTreeSubStorageReadParams *params);
 NX_INLINE void bktrInitializeSubStorageReadParams(BucketTreeSubStorageReadParams *out, void *buffer, u64 offset, u64 size, u64 virtual_offset, u32 ctr_val, bool aes_ctr_ex_crypt, u8 parent_storage_type);
@@ -110,6 +161,8 @@ NX_INLINE const u64 *bktrGetOffsetNodeBegin(const BucketTreeOffsetNode *offset_n
 NX_INLINE const u64 *bktrGetOffsetNodeEnd(const BucketTreeOffsetNode *offset_node);
 
 static bool bktrFindStorageEntry(BucketTreeContext *ctx, u64 virtual_offset, BucketTreeVisitor *out_visitor);
+static bool bktrFindStorageEntryFromCursor(BucketTreeContext *ctx, u64 virtual_offset, BucketTreeVisitor *out_visitor);
+static void bktrUpdateVisitorCursor(BucketTreeContext *ctx, BucketTreeVisitor *visitor, u64 virtual_offset);
 static bool bktrGetTreeNodeEntryIndex(const u64 *start_ptr, const u64 *end_ptr, u64 virtual_offset, u32 *out_index);
 static bool bktrGetEntryNodeEntryIndex(const BucketTreeNodeHeader *node_header, u64 entry_size, u64 virtual_offset, u32 *out_index);
 
@@ -241,6 +294,13 @@ bool bktrInitializeCompressedStorageContext(BucketTreeContext *out, BucketTreeSu
 
     memcpy(&(out->substorages[0]), substorage, sizeof(BucketTreeSubStorage));
 
+    /* Assign a new LZ4 cache ID to this context. Blocks cached using IDs from previous contexts will never be matched again, and will eventually be evicted. */
+    SCOPED_LOCK(&g_bktrLz4CacheMutex)
+    {
+        out->lz4_cache_id = g_bktrLz4CacheNextId++;
+        if (!g_bktrLz4CacheNextId) g_bktrLz4CacheNextId = 1;
+    }
+
     /* Update return value. */
     success = true;
 
@@ -342,7 +402,13 @@ bool bktrReadStorage(BucketTreeContext *ctx, void *out, u64 read_size, u64 offse
             break;
     }
 
-    if (!success) LOG_MSG_ERROR("Failed to read 0x%lX-byte long block at offset 0x%lX from %s storage!", read_size, offset, bktrGetStorageTypeName(ctx->storage_type));
+    if (success)
+    {
+        /* Save the visitor position, so the next sequential read can skip the tree lookup. */
+        bktrUpdateVisitorCursor(ctx, &visitor, offset + read_size);
+    } else {
+        LOG_MSG_ERROR("Failed to read 0x%lX-byte long block at offset 0x%lX from %s storage!", read_size, offset, bktrGetStorageTypeName(ctx->storage_type));
+    }
 
 end:
     return success;
@@ -1051,6 +1117,8 @@ static bool bktrReadCompressedStorage(BucketTreeVisitor *visitor, void *out, u64
     BucketTreeSubStorageReadParams params = {0};
     u64 cur_entry_offset = 0, next_entry_offset = 0, accum = 0;
 
+    BucketTreeLz4DecompressionBatch batch = {0};
+
     bool success = false;
 
     if (!out || !bktrIsValidSubStorage(&(ctx->substorages[0])) || ctx->substorages[0].type == BucketTreeSubStorageType_AesCtrEx || \
@@ -1061,6 +1129,7 @@ static bool bktrReadCompressedStorage(BucketTreeVisitor *visitor, void *out, u64
     }
 
     /* Perform Compressed Storage reads until we reach the requested size. */
+    /* LZ4 blocks that are fully covered by this read are only gathered here, and decompressed straight into the output buffer afterwards. */
     while(accum < read_size)
     {
         u8 *out_ptr = ((u8*)out + accum);
@@ -1109,49 +1178,27 @@ static bool bktrReadCompressedStorage(BucketTreeVisitor *visitor, void *out, u64
             case BucketTreeCompressedStorageCompressionType_LZ4:
             {
                 /* We can't randomly access data that's compressed. */
-                /* Let's be lazy and allocate memory for the full entry, read it and then decompress it. */
-                compressed_block_read_offset = (compressed_storage_base_offset + (u64)cur_entry.physical_offset);
-
-                const u64 compressed_data_size = (u64)cur_entry.physical_size;
                 const u64 decompressed_data_size = (next_entry_offset - cur_entry_offset);
-                const u64 buffer_size = LZ4_DECOMPRESS_INPLACE_BUFFER_SIZE(decompressed_data_size);
-
-                u8 *buffer = NULL, *read_ptr = NULL;
 
-                buffer = calloc(1, buffer_size);
-                if (!buffer)
+                if (compressed_block_offset == cur_entry_offset && compressed_block_read_size == decompressed_data_size)
                 {
-                    LOG_MSG_ERROR("Failed to allocate 0x%lX-byte long buffer for data decompression! (0x%lX).", buffer_size, decompressed_data_size);
-                    goto end;
+                    /* Read the full compressed block and queue it for decompression. */
+                    if (!bktrAddLz4DecompressionJob(ctx, &batch, &cur_entry, out_ptr, decompressed_data_size))
+                    {
+                        LOG_MSG_ERROR("Failed to gather 0x%lX-byte long LZ4 compressed entry at offset 0x%lX!", decompressed_data_size, compressed_block_offset);
+                        goto end;
+                    }
+
+                    break;
                 }
 
-                /* Adjust read pointer. This will let us use the same buffer for storing read data and decompressing it. */
-                read_ptr = (buffer + (buffer_size - compressed_data_size));
-                bktrInitializeSubStorageReadParams(&params, read_ptr, compressed_block_read_offset, compressed_data_size, 0, 0, false, ctx->storage_type);
-
-                /* Read compressed LZ4 block. */
-                if (!bktrReadSubStorage(&(ctx->substorages[0]), &params))
+                /* Decompress the full block (or retrieve it from the LZ4 block cache) and copy the data we need. */
+                if (!bktrReadCompressedStorageLz4Block(ctx, &cur_entry, decompressed_data_size, out_ptr, compressed_block_read_size, compressed_block_offset - cur_entry_offset))
                 {
-                    LOG_MSG_ERROR("Failed to read 0x%lX-byte long compressed block from offset 0x%lX!", compressed_data_size, compressed_block_read_offset);
-                    free(buffer);
+                    LOG_MSG_ERROR("Failed to read 0x%lX-byte long chunk from offset 0x%lX in LZ4 compressed entry!", compressed_block_read_size, compressed_block_offset);
                     goto end;
                 }
 
-                /* Decompress LZ4 block. */
-                int lz4_res = LZ4_decompress_safe((char*)read_ptr, (char*)buffer, (int)compressed_data_size, (int)buffer_size);
-                if (lz4_res != (int)decompressed_data_size)
-                {
-                    LOG_MSG_ERROR("Failed to decompress 0x%lX-byte long compressed block! (%d).", compressed_data_size, lz4_res);
-                    free(buffer);
-                    goto end;
-                }
-
-                /* Copy the data we need. */
-                memcpy(out_ptr, buffer + (compressed_block_offset - cur_entry_offset), compressed_block_read_size);
-
-                /* Free allocated buffer. */
-                free(buffer);
-
                 break;
             }
             default:
@@ -1162,13 +1209,431 @@ static bool bktrReadCompressedStorage(BucketTreeVisitor *visitor, void *out, u64
         accum += compressed_block_read_size;
     }
 
+    /* Decompress all gathered LZ4 blocks. */
+    if (batch.job_count && !bktrRunLz4DecompressionBatch(&batch))
+    {
+        LOG_MSG_ERROR("Failed to decompress %u LZ4 compressed block(s)!", batch.job_count);
+        goto end;
+    }
+
     /* Update flag. */
     success = true;
 
 end:
+    if (batch.jobs) free(batch.jobs);
+    if (batch.staging_buf) free(batch.staging_buf);
+
+    return success;
+}
+
+static bool bktrReadCompressedStorageLz4Block(BucketTreeContext *ctx, const BucketTreeCompressedStorageEntry *entry, u64 decompressed_data_size, void *out, u64 read_size, u64 offset)
+{
+    const u64 physical_offset = (u64)entry->physical_offset;
+    const u64 compressed_block_read_offset = (ctx->nca_fs_ctx->hash_region.size + physical_offset);
+    const u64 compressed_data_size = (u64)entry->physical_size;
+    const u64 buffer_size = LZ4_DECOMPRESS_INPLACE_BUFFER_SIZE(decompressed_data_size);
+
+    /* Blocks that are too big to be cached are decompressed using a temporary buffer. */
+    const bool cacheable = (ctx->lz4_cache_id && buffer_size <= LZ4_DECOMPRESS_INPLACE_BUFFER_SIZE(BKTR_LZ4_CACHE_MAX_BLOCK_SIZE));
+
+    BucketTreeSubStorageReadParams params = {0};
+    u8 *buffer = NULL, *tmp_buffer = NULL, *read_ptr = NULL;
+    u64 cur_buffer_size = 0;
+    int lz4_res = 0;
+    bool success = false;
+
+    /* Check if this block has already been decompressed. If not, take over the buffer from the least recently used cache entry if the cache is full. */
+    /* The cache lock isn't held while reading and decompressing the block, so other threads can keep using the cache in the meantime. */
+    SCOPED_LOCK(&g_bktrLz4CacheMutex)
+    {
+        success = (ctx->lz4_cache_id && bktrGetLz4CachedBlock(ctx->lz4_cache_id, physical_offset, decompressed_data_size, out, read_size, offset));
+        if (!success && cacheable) buffer = bktrTakeLz4CacheBuffer(&cur_buffer_size);
+    }
+
+    if (success) return true;
+
+    /* Make sure our buffer is big enough to hold the compressed block and decompress it in-place. */
+    if (buffer_size > cur_buffer_size)
+    {
+        tmp_buffer = realloc(buffer, buffer_size);
+        if (!tmp_buffer)
+        {
+            LOG_MSG_ERROR("Failed to allocate 0x%lX-byte long buffer for data decompression! (0x%lX).", buffer_size, decompressed_data_size);
+            goto end;
+        }
+
+        buffer = tmp_buffer;
+        tmp_buffer = NULL;
+
+        cur_buffer_size = buffer_size;
+    }
+
+    /* Adjust read pointer. This will let us use the same buffer for storing read data and decompressing it. */
+    read_ptr = (buffer + (buffer_size - compressed_data_size));
+    bktrInitializeSubStorageReadParams(&params, read_ptr, compressed_block_read_offset, compressed_data_size, 0, 0, false, ctx->storage_type);
+
+    /* Read compressed LZ4 block. */
+    if (!bktrReadSubStorage(&(ctx->substorages[0]), &params))
+    {
+        LOG_MSG_ERROR("Failed to read 0x%lX-byte long compressed block from offset 0x%lX!", compressed_data_size, compressed_block_read_offset);
+        goto end;
+    }
+
+    /* Decompress LZ4 block. */
+    lz4_res = LZ4_decompress_safe((char*)read_ptr, (char*)buffer, (int)compressed_data_size, (int)buffer_size);
+    if (lz4_res != (int)decompressed_data_size)
+    {
+        LOG_MSG_ERROR("Failed to decompress 0x%lX-byte long compressed block! (%d).", compressed_data_size, lz4_res);
+        goto end;
+    }
+
+    /* Copy the data we need. */
+    memcpy(out, buffer + offset, read_size);
+
+    /* Hand the buffer over to the cache. */
+    if (cacheable)
+    {
+        SCOPED_LOCK(&g_bktrLz4CacheMutex) bktrAddLz4CachedBlock(ctx->lz4_cache_id, physical_offset, decompressed_data_size, buffer, cur_buffer_size);
+        buffer = NULL;
+    }
+
+    success = true;
+
+end:
+    if (buffer) free(buffer);
+
     return success;
 }
 
+/* Must be called with the cache mutex held. */
+static bool bktrGetLz4CachedBlock(u32 lz4_cache_id, u64 physical_offset, u64 decompressed_data_size, void *out, u64 read_size, u64 offset)
+{
+    for(u32 i = 0; i < BKTR_LZ4_CACHE_ENTRY_COUNT; i++)
+    {
+        BucketTreeLz4CacheEntry *cache_entry = &(g_bktrLz4CacheEntries[i]);
+        if (cache_entry->lz4_cache_id != lz4_cache_id || cache_entry->physical_offset != physical_offset || cache_entry->size != decompressed_data_size) continue;
+
+        /* Copy the data we need. */
+        memcpy(out, cache_entry->buffer + offset, read_size);
+        cache_entry->last_use = ++g_bktrLz4CacheTick;
+
+        return true;
+    }
+
+    return false;
+}
+
+/* Must be called with the cache mutex held. */
+static u8 *bktrTakeLz4CacheBuffer(u64 *out_buffer_size)
+{
+    BucketTreeLz4CacheEntry *cache_entry = NULL;
+    u8 *buffer = NULL;
+
+    *out_buffer_size = 0;
+
+    /* Don't evict anything if there's still room in the cache. A new buffer will be allocated instead. */
+    for(u32 i = 0; i < BKTR_LZ4_CACHE_ENTRY_COUNT; i++)
+    {
+        BucketTreeLz4CacheEntry *cur_entry = &(g_bktrLz4CacheEntries[i]);
+        if (!cur_entry->lz4_cache_id) return NULL;
+        if (!cache_entry || cur_entry->last_use < cache_entry->last_use) cache_entry = cur_entry;
+    }
+
+    /* Take ownership of the buffer and invalidate the cache entry. */
+    buffer = cache_entry->buffer;
+    *out_buffer_size = cache_entry->buffer_size;
+    memset(cache_entry, 0, sizeof(BucketTreeLz4CacheEntry));
+
+    return buffer;
+}
+
+/* Must be called with the cache mutex held. Takes ownership of the provided buffer. */
+static void bktrAddLz4CachedBlock(u32 lz4_cache_id, u64 physical_offset, u64 decompressed_data_size, u8 *buffer, u64 buffer_size)
+{
+    BucketTreeLz4CacheEntry *cache_entry = NULL;
+
+    /* Another thread may have decompressed this very same block in the meantime, in which case its cache entry is replaced. */
+    /* Otherwise, pick an unused cache entry or evict the least recently used one. */
+    for(u32 i = 0; i < BKTR_LZ4_CACHE_ENTRY_COUNT; i++)
+    {
+        BucketTreeLz4CacheEntry *cur_entry = &(g_bktrLz4CacheEntries[i]);
+
+        if (cur_entry->lz4_cache_id == lz4_cache_id && cur_entry->physical_offset == physical_offset)
+        {
+            cache_entry = cur_entry;
+            break;
+        }
+
+        if (cache_entry && !cache_entry->lz4_cache_id) continue;
+
+        if (!cache_entry || !cur_entry->lz4_cache_id || cur_entry->last_use < cache_entry->last_use) cache_entry = cur_entry;
+    }
+
+    if (cache_entry->buffer) free(cache_entry->buffer);
+
+    cache_entry->lz4_cache_id = lz4_cache_id;
+    cache_entry->physical_offset = physical_offset;
+    cache_entry->size = decompressed_data_size;
+    cache_entry->buffer = buffer;
+    cache_entry->buffer_size = buffer_size;
+    cache_entry->last_use = ++g_bktrLz4CacheTick;
+}
+
+static bool bktrAddLz4DecompressionJob(BucketTreeContext *ctx, BucketTreeLz4DecompressionBatch *batch, const BucketTreeCompressedStorageEntry *entry, void *out, u64 decompressed_data_size)
+{
+    const u64 compressed_block_read_offset = (ctx->nca_fs_ctx->hash_region.size + (u64)entry->physical_offset);
+    const u64 compressed_data_size = (u64)entry->physical_size;
+
+    BucketTreeLz4DecompressionJob *tmp_jobs = NULL, *job = NULL;
+    BucketTreeSubStorageReadParams params = {0};
+    u8 *tmp_staging_buf = NULL;
+    u32 job_capacity = 0;
+    u64 staging_buf_capacity = 0;
+
+    /* Grow job array, if needed. */
+    if (batch->job_count >= batch->job_capacity)
+    {
+        job_capacity = (batch->job_capacity ? (batch->job_capacity * 2) : 8);
+
+        tmp_jobs = realloc(batch->jobs, job_capacity * sizeof(BucketTreeLz4DecompressionJob));
+        if (!tmp_jobs)
+        {
+            LOG_MSG_ERROR("Failed to reallocate LZ4 decompression job array!");
+            return false;
+        }
+
+        batch->jobs = tmp_jobs;
+        tmp_jobs = NULL;
+
+        batch->job_capacity = job_capacity;
+    }
+
+    /* Grow staging buffer, if needed. Jobs store offsets, so they don't need to be updated. */
+    if ((batch->staging_buf_size + compressed_data_size) > batch->staging_buf_capacity)
+    {
+        staging_buf_capacity = MAX(batch->staging_buf_capacity * 2, batch->staging_buf_size + compressed_data_size);
+
+        tmp_staging_buf = realloc(batch->staging_buf, staging_buf_capacity);
+        if (!tmp_staging_buf)
+        {
+            LOG_MSG_ERROR("Failed to reallocate LZ4 decompression staging buffer! (0x%lX).", staging_buf_capacity);
+            return false;
+        }
+
+        batch->staging_buf = tmp_staging_buf;
+        tmp_staging_buf = NULL;
+
+        batch->staging_buf_capacity = staging_buf_capacity;
+    }
+
+    /* Read compressed LZ4 block. */
+    bktrInitializeSubStorageReadParams(&params, batch->staging_buf + batch->staging_buf_size, compressed_block_read_offset, compressed_data_size, 0, 0, false, ctx->storage_type);
+
+    if (!bktrReadSubStorage(&(ctx->substorages[0]), &params))
+    {
+        LOG_MSG_ERROR("Failed to read 0x%lX-byte long compressed block from offset 0x%lX!", compressed_data_size, compressed_block_read_offset);
+        return false;
+    }
+
+    /* Fill job. */
+    job = &(batch->jobs[batch->job_count++]);
+    job->src_offset = batch->staging_buf_size;
+    job->src_size = compressed_data_size;
+    job->dst = out;
+    job->dst_size = decompressed_data_size;
+
+    batch->staging_buf_size += compressed_data_size;
+
+    return true;
+}
+
+static bool bktrRunLz4DecompressionBatch(BucketTreeLz4DecompressionBatch *batch)
+{
+    bool use_workers = false, ret = false;
+
+    batch->next_job = batch->active_jobs = 0;
+    batch->error = false;
+    batch->next = NULL;
+
+    /* Let the worker threads pick up jobs from this batch. There's no point in doing so if there's a single block to decompress. */
+    SCOPED_LOCK(&g_bktrLz4WorkerMutex)
+    {
+        use_workers = (g_bktrLz4WorkersRunning && batch->job_count > 1);
+        if (!use_workers) break;
+
+        batch->next = g_bktrLz4WorkerBatches;
+        g_bktrLz4WorkerBatches = batch;
+
+        condvarWakeAll(&g_bktrLz4WorkerJobCondVar);
+    }
+
+    /* Decompress blocks on the calling thread as well. */
+    bktrProcessLz4DecompressionJobs(batch);
+
+    SCOPED_LOCK(&g_bktrLz4WorkerMutex)
+    {
+        if (use_workers)
+        {
+            /* Wait until the worker threads are done with the jobs they picked up. */
+            while(batch->active_jobs) condvarWait(&g_bktrLz4WorkerDoneCondVar, &g_bktrLz4WorkerMutex);
+
+            /* Remove this batch from the list. */
+            for(BucketTreeLz4DecompressionBatch **cur = &g_bktrLz4WorkerBatches; *cur; cur = &((*cur)->next))
+            {
+                if (*cur != batch) continue;
+                *cur = batch->next;
+                break;
+            }
+        }
+
+        ret = !batch->error;
+    }
+
+    return ret;
+}
+
+static void bktrProcessLz4DecompressionJobs(BucketTreeLz4DecompressionBatch *batch)
+{
+    BucketTreeLz4DecompressionJob *job = NULL;
+
+    while(true)
+    {
+        job = NULL;
+
+        /* Pick up the next job. */
+        SCOPED_LOCK(&g_bktrLz4WorkerMutex)
+        {
+            if (!batch->error && batch->next_job < batch->job_count) job = &(batch->jobs[batch->next_job++]);
+        }
+
+        if (!job) break;
+
+        if (!bktrDecompressLz4Job(batch, job))
+        {
+            SCOPED_LOCK(&g_bktrLz4WorkerMutex) batch->error = true;
+            break;
+        }
+    }
+}
+
+static bool bktrDecompressLz4Job(BucketTreeLz4DecompressionBatch *batch, BucketTreeLz4DecompressionJob *job)
+{
+    /* Decompress LZ4 block straight into the output buffer. */
+    int lz4_res = LZ4_decompress_safe((char*)(batch->staging_buf + job->src_offset), (char*)job->dst, (int)job->src_size, (int)job->dst_size);
+    if (lz4_res != (int)job->dst_size)
+    {
+        LOG_MSG_ERROR("Failed to decompress 0x%lX-byte long compressed block! (%d).", job->src_size, lz4_res);
+        return false;
+    }
+
+    return true;
+}
+
+static void bktrLz4DecompressionWorkerThreadFunc(void *arg)
+{
+    NX_IGNORE_ARG(arg);
+
+    BucketTreeLz4DecompressionBatch *batch = NULL;
+    BucketTreeLz4DecompressionJob *job = NULL;
+    bool success = false;
+
+    while(true)
+    {
+        job = NULL;
+
+        SCOPED_LOCK(&g_bktrLz4WorkerMutex)
+        {
+            while(true)
+            {
+                /* Look for a batch with jobs that haven't been picked up yet. */
+                for(batch = g_bktrLz4WorkerBatches; batch && (batch->error || batch->next_job >= batch->job_count); batch = batch->next);
+                if (batch || g_bktrLz4WorkersStop) break;
+
+                condvarWait(&g_bktrLz4WorkerJobCondVar, &g_bktrLz4WorkerMutex);
+            }
+
+            if (!batch) break;
+
+            job = &(batch->jobs[batch->next_job++]);
+            batch->active_jobs++;
+        }
+
+        if (!job) break;
+
+        success = bktrDecompressLz4Job(batch, job);
+
+        SCOPED_LOCK(&g_bktrLz4WorkerMutex)
+        {
+            if (!success) batch->error = true;
+            if (!--batch->active_jobs) condvarWakeAll(&g_bktrLz4WorkerDoneCondVar);
+        }
+    }
+
+    threadExit();
+}
+
+bool bktrStartLz4DecompressionWorkers(void)
+{
+    bool ret = false;
+
+    SCOPED_LOCK(&g_bktrLz4WorkerMutex)
+    {
+        ret = g_bktrLz4WorkersRunning;
+        if (ret) break;
+
+        g_bktrLz4WorkersStop = false;
+
+        /* Core 3 is reserved for HOS. */
+        for(g_bktrLz4WorkerThreadCount = 0; g_bktrLz4WorkerThreadCount < BKTR_LZ4_WORKER_THREAD_COUNT; g_bktrLz4WorkerThreadCount++)
+        {
+            if (!utilsCreateThread(&(g_bktrLz4WorkerThreads[g_bktrLz4WorkerThreadCount]), bktrLz4DecompressionWorkerThreadFunc, NULL, (int)(g_bktrLz4WorkerThreadCount % 3)))
+            {
+                LOG_MSG_ERROR("Failed to create LZ4 decompression worker thread #%u!", g_bktrLz4WorkerThreadCount);
+                break;
+            }
+        }
+
+        ret = g_bktrLz4WorkersRunning = (g_bktrLz4WorkerThreadCount == BKTR_LZ4_WORKER_THREAD_COUNT);
+    }
+
+    /* Stop worker threads that have already been created if something went wrong. */
+    if (!ret) bktrStopLz4DecompressionWorkers();
+
+    return ret;
+}
+
+void bktrStopLz4DecompressionWorkers(void)
+{
+    u32 thread_count = 0;
+
+    SCOPED_LOCK(&g_bktrLz4WorkerMutex)
+    {
+        thread_count = g_bktrLz4WorkerThreadCount;
+
+        g_bktrLz4WorkersRunning = false;
+        g_bktrLz4WorkersStop = true;
+        g_bktrLz4WorkerThreadCount = 0;
+
+        condvarWakeAll(&g_bktrLz4WorkerJobCondVar);
+    }
+
+    /* Batches that are still being processed are completed by their calling threads. */
+    for(u32 i = 0; i < thread_count; i++) utilsJoinThread(&(g_bktrLz4WorkerThreads[i]));
+}
+
+void bktrFreeLz4BlockCache(void)
+{
+    SCOPED_LOCK(&g_bktrLz4CacheMutex)
+    {
+        for(u32 i = 0; i < BKTR_LZ4_CACHE_ENTRY_COUNT; i++)
+        {
+            BucketTreeLz4CacheEntry *cache_entry = &(g_bktrLz4CacheEntries[i]);
+            if (cache_entry->buffer) free(cache_entry->buffer);
+            memset(cache_entry, 0, sizeof(BucketTreeLz4CacheEntry));
+        }
+    }
+}
+
 static bool bktrReadSubStorage(BucketTreeSubStorage *substorage, BucketTreeSubStorageReadParams *params)
 {
     if (!bktrIsValidSubStorage(substorage) || !params || !params->buffer || !params->size)
@@ -1188,11 +1653,15 @@ static bool bktrReadSubStorage(BucketTreeSubStorage *substorage, BucketTreeSubSt
             /* Perform a read on the target NCA using AesCtrEx crypto. */
             success = ncaReadAesCtrExStorage(nca_fs_ctx, params->buffer, params->size, params->offset, params->ctr_val, params->aes_ctr_ex_crypt);
         } else {
-            /* Make sure to handle Sparse virtual offsets if we need to. */
-            if (params->parent_storage_type == BucketTreeStorageType_Sparse && params->virtual_offset) nca_fs_ctx->cur_sparse_virtual_offset = params->virtual_offset;
+            /* Hold the crypto lock from the NCA FS section context to make sure the Sparse virtual offset isn't modified by another thread before we issue our read. */
+            SCOPED_LOCK(&(nca_fs_ctx->crypto_mutex))
+            {
+                /* Make sure to handle Sparse virtual offsets if we need to. */
+                if (params->parent_storage_type == BucketTreeStorageType_Sparse && params->virtual_offset) nca_fs_ctx->cur_sparse_virtual_offset = params->virtual_offset;
 
-            /* Perform a read on the target NCA. */
-            success = ncaReadFsSection(nca_fs_ctx, params->buffer, params->size, params->offset);
+                /* Perform a read on the target NCA. */
+                success = ncaReadFsSection(nca_fs_ctx, params->buffer, params->size, params->offset);
+            }
         }
     } else {
         /* Perform a read on the target BucketTree storage. */
@@ -1348,6 +1817,9 @@ static bool bktrFindStorageEntry(BucketTreeContext *ctx, u64 virtual_offset, Buc
         return false;
     }
 
+    /* Try to resume from the last visited entry before performing a full tree lookup. */
+    if (bktrFindStorageEntryFromCursor(ctx, virtual_offset, out_visitor)) return true;
+
     /* Get the node. */
     const BucketTreeOffsetNode *offset_node = &(ctx->storage_table->offset_node);
 
@@ -1402,6 +1874,72 @@ end:
     return success;
 }
 
+static bool bktrFindStorageEntryFromCursor(BucketTreeContext *ctx, u64 virtual_offset, BucketTreeVisitor *out_visitor)
+{
+    u32 entry_set_index = 0, entry_index = 0;
+    bool cursor_valid = false;
+
+    SCOPED_LOCK(&(ctx->cursor_mutex))
+    {
+        cursor_valid = ctx->cursor_valid;
+        entry_set_index = ctx->cursor_entry_set_index;
+        entry_index = ctx->cursor_entry_index;
+    }
+
+    if (!cursor_valid) return false;
+
+    /* Get entry node header. */
+    const BucketTreeNodeHeader *entry_set_header = bktrGetEntryNodeHeader(ctx, entry_set_index);
+    if (!entry_set_header || entry_index >= entry_set_header->count) return false;
+
+    /* Get entry offset. This was already validated by the lookup that set the cursor. */
+    const u64 entry_offset = (ctx->node_storage_size + bktrGetEntryNodeEntryOffsetByIndex(entry_set_index, ctx->node_size, ctx->entry_size, entry_index));
+
+    /* Update output visitor. */
+    memset(out_visitor, 0, sizeof(BucketTreeVisitor));
+
+    out_visitor->bktr_ctx = ctx;
+    memcpy(&(out_visitor->entry_set), entry_set_header, sizeof(BucketTreeEntrySetHeader));
+    out_visitor->entry_index = entry_index;
+    out_visitor->entry = ((u8*)ctx->storage_table + entry_offset);
+
+    /* We can only move forward. */
+    if (virtual_offset < *((u64*)out_visitor->entry)) return false;
+
+    for(u32 i = 0; i < BKTR_VISITOR_CURSOR_MAX_STEPS; i++)
+    {
+        /* Get the virtual offset at which the current entry ends. */
+        u64 next_entry_offset = ((out_visitor->entry_index + 1) < out_visitor->entry_set.header.count ? *((u64*)((u8*)out_visitor->entry + ctx->entry_size)) : \
+                                 out_visitor->entry_set.header.offset);
+
+        /* Check if we have found the right entry. */
+        if (virtual_offset < next_entry_offset) return true;
+
+        /* Move onto the next entry. */
+        if (!bktrVisitorCanMoveNext(out_visitor) || !bktrVisitorMoveNext(out_visitor)) break;
+    }
+
+    return false;
+}
+
+static void bktrUpdateVisitorCursor(BucketTreeContext *ctx, BucketTreeVisitor *visitor, u64 virtual_offset)
+{
+    if (!bktrVisitorIsValid(visitor)) return;
+
+    u32 entry_index = visitor->entry_index;
+
+    /* Storage readers leave the visitor pointing to the entry that follows the last one they processed. */
+    /* Step back if the next read would start before it. */
+    if (virtual_offset < *((u64*)visitor->entry) && entry_index > 0) entry_index--;
+
+    SCOPED_LOCK(&(ctx->cursor_mutex))
+    {
+        ctx->cursor_valid = true;
+        ctx->cursor_entry_set_index = visitor->entry_set.header.index;
+        ctx->cursor_entry_index = entry_index;
+    }
+}
+
 static bool bktrGetTreeNodeEntryIndex(const u64 *start_ptr, const u64 *end_ptr, u64 virtual_offset, u32 *out_index)
 {
     if (!start_ptr || !end_ptr || start_ptr >= end_ptr || !out_index)
@@ -1410,26 +1948,27 @@ static bool bktrGetTreeNodeEntryIndex(const u64 *start_ptr, const u64 *end_ptr,
         return false;
     }
 
-    u64 *pos = (u64*)start_ptr;
-    u32 index = 0;
+    /* Perform a binary search. The first offset node entry is skipped. */
+    /* The output index is the number of entries after it with a virtual offset lower than or equal to the provided one. */
+    const u64 *base = (start_ptr + 1);
+    u32 low = 0, high = (u32)(end_ptr - base);
 
-    while(pos < end_ptr)
+    while(low < high)
     {
-        if (start_ptr < pos)
-        {
-            /* Stop looking if we have found the right offset node. */
-            if (*pos > virtual_offset) break;
+        u32 half = (low + ((high - low) / 2));
 
-            /* Increment index. */
-            index++;
+        if (base[half] > virtual_offset)
+        {
+            /* Update our upper limit. */
+            high = half;
+        } else {
+            /* Update our lower limit. */
+            low = (half + 1);
         }
-
-        /* Increment offset node pointer. */
-        pos++;
     }
 
     /* Update output index. */
-    *out_index = index;
+    *out_index = low;
 
     return true;
 }
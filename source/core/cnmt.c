@@ -26,7 +26,7 @@
 /* Helper macros. */
 
 #define CNMT_MINIMUM_FILENAME_LENGTH    23  /* Content Meta Type + "_" + Title ID + ".cnmt". */
-#define CNMT_ADD_FMT_STR(fmt, ...)      utilsAppendFormattedStringToBuffer(&xml_buf, &xml_buf_size, fmt, ##__VA_ARGS__)
+#define CNMT_ADD_FMT_STR(fmt, ...)      utilsStringBuilderAppendFormatted(&xml_sb, fmt, ##__VA_ARGS__)
 
 /* Global variables. */
 
@@ -46,7 +46,7 @@ static const char *cnmtGetRequiredTitleTypeString(u8 content_meta_type);
 bool cnmtInitializeContext(ContentMetaContext *out, NcaContext *nca_ctx)
 {
     if (!out || !nca_ctx || !*(nca_ctx->content_id_str) || nca_ctx->content_type != NcmContentType_Meta || nca_ctx->content_size < NCA_FULL_HEADER_LENGTH || \
-        (nca_ctx->storage_id != NcmStorageId_GameCard && !nca_ctx->ncm_storage) || (nca_ctx->storage_id == NcmStorageId_GameCard && !nca_ctx->gamecard_offset) || \
+        !contentSourceIsValid(&(nca_ctx->source)) || \
         nca_ctx->header.content_type != NcaContentType_Meta || nca_ctx->content_type_ctx || !out)
     {
         LOG_MSG_ERROR("Invalid parameters!");
@@ -417,8 +417,7 @@ bool cnmtGenerateAuthoringToolXml(ContentMetaContext *cnmt_ctx, NcaContext *nca_
     }
 
     u32 i, j;
-    char *xml_buf = NULL;
-    u64 xml_buf_size = 0;
+    UtilsStringBuilder xml_sb = {0};
     char digest_str[SHA256_HASH_STR_SIZE] = {0};
     u8 count = 0, content_meta_type = cnmt_ctx->packaged_header->content_meta_type;
     bool success = false, invalid_nca = false;
@@ -541,13 +540,13 @@ bool cnmtGenerateAuthoringToolXml(ContentMetaContext *cnmt_ctx, NcaContext *nca_
     if (!(success = CNMT_ADD_FMT_STR("</ContentMeta>"))) goto end;
 
     /* Update CNMT context. */
-    cnmt_ctx->authoring_tool_xml = xml_buf;
-    cnmt_ctx->authoring_tool_xml_size = strlen(xml_buf);
+    cnmt_ctx->authoring_tool_xml = xml_sb.str;
+    cnmt_ctx->authoring_tool_xml_size = xml_sb.len;
 
 end:
     if (!success)
     {
-        if (xml_buf) free(xml_buf);
+        utilsStringBuilderFree(&xml_sb);
         LOG_MSG_ERROR("Failed to generate CNMT AuthoringTool XML!");
     }
 
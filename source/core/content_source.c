@@ -0,0 +1,848 @@
+/*
+ * content_source.c
+ *
+ * Copyright (c) 2020-2023, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "nxdt_utils.h"
+#include "content_source.h"
+#include "gamecard.h"
+#include "pfs.h"
+#include "hfs.h"
+
+#define CONTENT_SOURCE_MAX_PARTITION_HEADER_SIZE    0x100000    /* Sanity check for PFS0 / HFS0 headers read from image files. */
+
+/* Type definitions. */
+
+/// Read operation submitted to the read engine.
+typedef struct {
+    ContentSource source;
+    void *out;
+    u64 read_size;
+    u64 offset;
+    ContentSourceReadCallback callback;
+    void *callback_arg;
+} ContentSourceReadEngineRequest;
+
+/// Invoked for each entry found within an image file. Returns true if the iteration should be stopped.
+typedef bool (*ContentSourceImageFileEntryVisitor)(const char *entry_name, u64 entry_offset, u64 entry_size, void *arg);
+
+/// Used by contentSourceFindImageFileEntry().
+typedef struct {
+    const char *entry_name;
+    u64 entry_offset;
+    u64 entry_size;
+    bool found;
+} ContentSourceImageFileEntryLookup;
+
+/// Used by contentSourceGetImageFileEntryNames().
+typedef struct {
+    char *names;
+    size_t names_size;
+    u32 count;
+    bool failed;
+} ContentSourceImageFileEntryNameList;
+
+/* Function prototypes. */
+
+static bool contentSourceNcmRead(ContentSource *source, void *out, u64 read_size, u64 offset);
+static bool contentSourceGameCardRead(ContentSource *source, void *out, u64 read_size, u64 offset);
+static bool contentSourceFileRead(ContentSource *source, void *out, u64 read_size, u64 offset);
+static void contentSourceFileClose(ContentSource *source);
+
+static ContentSourceFile *contentSourceOpenFile(const char *path);
+static void contentSourceReleaseFile(ContentSourceFile *file);
+static u32 contentSourceLeaseFileHandle(ContentSourceFile *file);
+static void contentSourceReturnFileHandle(ContentSourceFile *file, u32 idx);
+static bool contentSourceReadFileData(ContentSourceFile *file, void *out, u64 read_size, u64 offset);
+
+static bool contentSourceSubmitReadEngineRequest(ContentSource *source, void *out, u64 read_size, u64 offset, ContentSourceReadCallback callback, void *callback_arg);
+static void contentSourceReadEngineThreadFunc(void *arg);
+static void contentSourceReadGroupCallback(void *out, u64 read_size, u64 offset, bool success, void *callback_arg);
+
+static bool contentSourceFindImageFileEntry(ContentSourceFile *file, const char *entry_name, u64 *out_offset, u64 *out_size);
+static bool contentSourceFindImageFileEntryVisitor(const char *entry_name, u64 entry_offset, u64 entry_size, void *arg);
+static bool contentSourceAddImageFileEntryNameVisitor(const char *entry_name, u64 entry_offset, u64 entry_size, void *arg);
+
+static bool contentSourceIterateImageFileEntries(ContentSourceFile *file, ContentSourceImageFileEntryVisitor visitor, void *arg);
+static bool contentSourceIteratePartitionEntries(ContentSourceFile *file, u64 partition_offset, bool is_hfs, ContentSourceImageFileEntryVisitor visitor, void *arg, bool *out_stop);
+static u8 *contentSourceReadPartitionHeader(ContentSourceFile *file, u64 partition_offset, bool is_hfs, u32 *out_entry_count, u64 *out_header_size);
+
+/* Global variables. */
+
+static const ContentSourceInterface g_contentSourceNcmInterface = {
+    .name = "ncm",
+    .read = contentSourceNcmRead,
+    .read_async = NULL,
+    .close = NULL
+};
+
+static const ContentSourceInterface g_contentSourceGameCardInterface = {
+    .name = "gamecard",
+    .read = contentSourceGameCardRead,
+    .read_async = NULL,
+    .close = NULL
+};
+
+static const ContentSourceInterface g_contentSourceFileInterface = {
+    .name = "file",
+    .read = contentSourceFileRead,
+    .read_async = NULL,
+    .close = contentSourceFileClose
+};
+
+static Mutex g_contentSourceReadEngineMutex = 0;
+static CondVar g_contentSourceReadEngineRequestCondvar = 0, g_contentSourceReadEngineSpaceCondvar = 0;
+
+static Thread g_contentSourceReadEngineThreads[CONTENT_SOURCE_READ_ENGINE_MAX_QUEUE_DEPTH] = {0};
+static u32 g_contentSourceReadEngineQueueDepth = 0;
+static bool g_contentSourceReadEngineRunning = false, g_contentSourceReadEngineStop = false;
+
+static ContentSourceReadEngineRequest g_contentSourceReadEngineQueue[CONTENT_SOURCE_READ_ENGINE_QUEUE_SIZE] = {0};
+static u32 g_contentSourceReadEngineQueueHead = 0, g_contentSourceReadEngineQueueCount = 0;
+
+bool contentSourceInitializeNcm(ContentSource *out, NcmContentStorage *ncm_storage, const NcmContentId *content_id, u64 size)
+{
+    if (!out || !ncm_storage || !content_id || !size)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    memset(out, 0, sizeof(ContentSource));
+
+    out->type = ContentSourceType_Ncm;
+    out->iface = &g_contentSourceNcmInterface;
+    out->size = size;
+    out->ncm.storage = ncm_storage;
+    memcpy(&(out->ncm.content_id), content_id, sizeof(NcmContentId));
+
+    return true;
+}
+
+bool contentSourceInitializeGameCard(ContentSource *out, u64 offset, u64 size)
+{
+    if (!out || !offset || !size)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    memset(out, 0, sizeof(ContentSource));
+
+    out->type = ContentSourceType_GameCard;
+    out->iface = &g_contentSourceGameCardInterface;
+    out->size = size;
+    out->gamecard.offset = offset;
+
+    return true;
+}
+
+bool contentSourceInitializeFile(ContentSource *out, const char *path)
+{
+    if (!out || !path || !*path)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    ContentSourceFile *file = contentSourceOpenFile(path);
+    if (!file) return false;
+
+    if (!file->size)
+    {
+        LOG_MSG_ERROR("File \"%s\" is empty!", path);
+        contentSourceReleaseFile(file);
+        return false;
+    }
+
+    memset(out, 0, sizeof(ContentSource));
+
+    out->type = ContentSourceType_File;
+    out->iface = &g_contentSourceFileInterface;
+    out->size = file->size;
+    out->file.file = file;
+    out->file.offset = 0;
+
+    return true;
+}
+
+bool contentSourceInitializeImageFileEntry(ContentSource *out, const char *path, const char *entry_name)
+{
+    if (!out || !path || !*path || !entry_name || !*entry_name)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    ContentSource image_source = {0};
+    bool ret = false;
+
+    /* Open image file. */
+    if (!contentSourceInitializeFile(&image_source, path)) return false;
+
+    /* Initialize content source. This takes its own reference to the local file handle. */
+    ret = contentSourceInitializeImageFileEntryFromSource(out, &image_source, entry_name);
+    if (!ret) LOG_MSG_ERROR("Unable to locate entry \"%s\" in image file \"%s\"!", entry_name, path);
+
+    contentSourceClose(&image_source);
+
+    return ret;
+}
+
+bool contentSourceInitializeImageFileEntryFromSource(ContentSource *out, ContentSource *image_source, const char *entry_name)
+{
+    if (!out || !contentSourceIsValid(image_source) || image_source->type != ContentSourceType_File || !image_source->file.file || !entry_name || !*entry_name)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    ContentSourceFile *file = image_source->file.file;
+    u64 entry_offset = 0, entry_size = 0;
+
+    /* Look for the entry within the image file. */
+    if (!contentSourceFindImageFileEntry(file, entry_name, &entry_offset, &entry_size)) return false;
+
+    /* Take a reference to the local file handle. */
+    SCOPED_LOCK(&(file->mutex)) file->ref_count++;
+
+    memset(out, 0, sizeof(ContentSource));
+
+    out->type = ContentSourceType_File;
+    out->iface = &g_contentSourceFileInterface;
+    out->size = entry_size;
+    out->file.file = file;
+    out->file.offset = entry_offset;
+
+    return true;
+}
+
+bool contentSourceGetImageFileEntryNames(ContentSource *image_source, char **out_names, u32 *out_count)
+{
+    if (!contentSourceIsValid(image_source) || image_source->type != ContentSourceType_File || !image_source->file.file || image_source->file.offset || !out_names || !out_count)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    ContentSourceImageFileEntryNameList list = {0};
+
+    if (!contentSourceIterateImageFileEntries(image_source->file.file, contentSourceAddImageFileEntryNameVisitor, &list) || list.failed || !list.count)
+    {
+        if (!list.failed && !list.count) LOG_MSG_ERROR("Image file \"%s\" holds no entries!", image_source->file.file->path);
+        if (list.names) free(list.names);
+        return false;
+    }
+
+    *out_names = list.names;
+    *out_count = list.count;
+
+    return true;
+}
+
+bool contentSourceRead(ContentSource *source, void *out, u64 read_size, u64 offset)
+{
+    if (!contentSourceIsValid(source) || !out || !read_size || (offset + read_size) > source->size)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    return source->iface->read(source, out, read_size, offset);
+}
+
+bool contentSourceReadAsync(ContentSource *source, void *out, u64 read_size, u64 offset, ContentSourceReadCallback callback, void *callback_arg)
+{
+    if (!contentSourceIsValid(source) || !out || !read_size || (offset + read_size) > source->size || !callback)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    if (source->iface->read_async) return source->iface->read_async(source, out, read_size, offset, callback, callback_arg);
+
+    /* Hand the read operation off to the read engine. */
+    if (contentSourceSubmitReadEngineRequest(source, out, read_size, offset, callback, callback_arg)) return true;
+
+    /* Fallback to a synchronous read if the read engine isn't running. */
+    bool success = source->iface->read(source, out, read_size, offset);
+    callback(out, read_size, offset, success, callback_arg);
+
+    return true;
+}
+
+bool contentSourceStartReadEngine(u32 queue_depth)
+{
+    if (!queue_depth || queue_depth > CONTENT_SOURCE_READ_ENGINE_MAX_QUEUE_DEPTH)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    bool ret = false;
+
+    SCOPED_LOCK(&g_contentSourceReadEngineMutex)
+    {
+        ret = g_contentSourceReadEngineRunning;
+        if (ret) break;
+
+        g_contentSourceReadEngineStop = false;
+        g_contentSourceReadEngineQueueHead = g_contentSourceReadEngineQueueCount = 0;
+
+        /* Create worker threads. Each one of them carries out a single read operation at a time. */
+        for(g_contentSourceReadEngineQueueDepth = 0; g_contentSourceReadEngineQueueDepth < queue_depth; g_contentSourceReadEngineQueueDepth++)
+        {
+            if (!utilsCreateThread(&(g_contentSourceReadEngineThreads[g_contentSourceReadEngineQueueDepth]), contentSourceReadEngineThreadFunc, NULL, \
+                                   (int)(g_contentSourceReadEngineQueueDepth % 3)))
+            {
+                LOG_MSG_ERROR("Failed to create read engine worker thread #%u!", g_contentSourceReadEngineQueueDepth);
+                break;
+            }
+        }
+
+        ret = g_contentSourceReadEngineRunning = (g_contentSourceReadEngineQueueDepth == queue_depth);
+    }
+
+    /* Stop worker threads that have already been created if something went wrong. */
+    if (!ret) contentSourceStopReadEngine();
+
+    return ret;
+}
+
+void contentSourceStopReadEngine(void)
+{
+    u32 thread_count = 0;
+
+    SCOPED_LOCK(&g_contentSourceReadEngineMutex)
+    {
+        thread_count = g_contentSourceReadEngineQueueDepth;
+
+        g_contentSourceReadEngineRunning = false;
+        g_contentSourceReadEngineStop = true;
+        g_contentSourceReadEngineQueueDepth = 0;
+
+        condvarWakeAll(&g_contentSourceReadEngineRequestCondvar);
+        condvarWakeAll(&g_contentSourceReadEngineSpaceCondvar);
+    }
+
+    /* Wait for the worker threads to complete all submitted reads. This must be done without holding the read engine mutex. */
+    for(u32 i = 0; i < thread_count; i++) utilsJoinThread(&(g_contentSourceReadEngineThreads[i]));
+}
+
+u32 contentSourceGetReadEngineQueueDepth(void)
+{
+    u32 ret = 1;
+
+    SCOPED_LOCK(&g_contentSourceReadEngineMutex)
+    {
+        if (g_contentSourceReadEngineRunning) ret = g_contentSourceReadEngineQueueDepth;
+    }
+
+    return ret;
+}
+
+void contentSourceReadGroupInitialize(ContentSourceReadGroup *group)
+{
+    if (!group) return;
+    memset(group, 0, sizeof(ContentSourceReadGroup));
+    mutexInit(&(group->mutex));
+    condvarInit(&(group->condvar));
+}
+
+bool contentSourceReadGroupSubmit(ContentSourceReadGroup *group, ContentSource *source, void *out, u64 read_size, u64 offset)
+{
+    if (!group)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    /* This must be done beforehand, since the callback may be invoked before contentSourceReadAsync() returns. */
+    SCOPED_LOCK(&(group->mutex)) group->pending++;
+
+    bool ret = contentSourceReadAsync(source, out, read_size, offset, contentSourceReadGroupCallback, group);
+    if (!ret)
+    {
+        SCOPED_LOCK(&(group->mutex))
+        {
+            group->pending--;
+            group->failed = true;
+            if (!group->pending) condvarWakeAll(&(group->condvar));
+        }
+    }
+
+    return ret;
+}
+
+bool contentSourceReadGroupWait(ContentSourceReadGroup *group)
+{
+    if (!group) return false;
+
+    bool ret = false;
+
+    SCOPED_LOCK(&(group->mutex))
+    {
+        while(group->pending) condvarWait(&(group->condvar), &(group->mutex));
+
+        /* Reset failure flag, so the group can be reused. */
+        ret = !group->failed;
+        group->failed = false;
+    }
+
+    return ret;
+}
+
+void contentSourceClose(ContentSource *source)
+{
+    if (!source) return;
+    if (source->iface && source->iface->close) source->iface->close(source);
+    memset(source, 0, sizeof(ContentSource));
+}
+
+static bool contentSourceNcmRead(ContentSource *source, void *out, u64 read_size, u64 offset)
+{
+    /* Retrieve NCA data normally. */
+    /* This strips NAX0 crypto from SD card NCAs (not used on eMMC NCAs). */
+    Result rc = ncmContentStorageReadContentIdFile(source->ncm.storage, out, read_size, &(source->ncm.content_id), offset);
+    if (R_FAILED(rc)) LOG_MSG_ERROR("ncmContentStorageReadContentIdFile failed! (0x%X).", rc);
+    return R_SUCCEEDED(rc);
+}
+
+static bool contentSourceGameCardRead(ContentSource *source, void *out, u64 read_size, u64 offset)
+{
+    /* Retrieve NCA data using raw gamecard reads. */
+    /* Fixes NCA read issues with gamecards under HOS < 4.0.0 when using ncmContentStorageReadContentIdFile(). */
+    return gamecardReadStorage(out, read_size, source->gamecard.offset + offset);
+}
+
+static bool contentSourceFileRead(ContentSource *source, void *out, u64 read_size, u64 offset)
+{
+    return contentSourceReadFileData(source->file.file, out, read_size, source->file.offset + offset);
+}
+
+static void contentSourceFileClose(ContentSource *source)
+{
+    contentSourceReleaseFile(source->file.file);
+}
+
+static ContentSourceFile *contentSourceOpenFile(const char *path)
+{
+    ContentSourceFile *file = NULL;
+    off_t file_size = 0;
+
+    file = calloc(1, sizeof(ContentSourceFile));
+    if (!file)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for local file!");
+        return NULL;
+    }
+
+    file->path = strdup(path);
+    if (!file->path)
+    {
+        LOG_MSG_ERROR("Failed to duplicate path string!");
+        goto end;
+    }
+
+    file->fp[0] = fopen(path, "rb");
+    if (!file->fp[0])
+    {
+        LOG_MSG_ERROR("Failed to open \"%s\"! (%d).", path, errno);
+        goto end;
+    }
+
+    /* Get file size. */
+    if (fseeko(file->fp[0], 0, SEEK_END) != 0 || (file_size = ftello(file->fp[0])) < 0)
+    {
+        LOG_MSG_ERROR("Failed to retrieve size for \"%s\"! (%d).", path, errno);
+        goto end;
+    }
+
+    file->size = (u64)file_size;
+    file->ref_count = 1;
+    mutexInit(&(file->mutex));
+    condvarInit(&(file->condvar));
+
+end:
+    if (!file->ref_count)
+    {
+        if (file->fp[0]) fclose(file->fp[0]);
+        if (file->path) free(file->path);
+        free(file);
+        file = NULL;
+    }
+
+    return file;
+}
+
+static void contentSourceReleaseFile(ContentSourceFile *file)
+{
+    if (!file) return;
+
+    bool close_file = false;
+
+    SCOPED_LOCK(&(file->mutex)) close_file = (file->ref_count && --file->ref_count == 0);
+
+    if (close_file)
+    {
+        for(u32 i = 0; i < CONTENT_SOURCE_FILE_HANDLE_COUNT; i++)
+        {
+            if (file->fp[i]) fclose(file->fp[i]);
+        }
+
+        free(file->path);
+        free(file);
+    }
+}
+
+static u32 contentSourceLeaseFileHandle(ContentSourceFile *file)
+{
+    u32 idx = CONTENT_SOURCE_FILE_HANDLE_COUNT;
+
+    SCOPED_LOCK(&(file->mutex))
+    {
+        while(true)
+        {
+            u32 closed_idx = CONTENT_SOURCE_FILE_HANDLE_COUNT;
+
+            for(u32 i = 0; i < CONTENT_SOURCE_FILE_HANDLE_COUNT; i++)
+            {
+                if (file->fp[i] && !file->fp_leased[i])
+                {
+                    idx = i;
+                    break;
+                }
+
+                if (!file->fp[i] && closed_idx == CONTENT_SOURCE_FILE_HANDLE_COUNT) closed_idx = i;
+            }
+
+            /* Open an additional handle if all of the current ones are busy. */
+            if (idx == CONTENT_SOURCE_FILE_HANDLE_COUNT && closed_idx < CONTENT_SOURCE_FILE_HANDLE_COUNT && (file->fp[closed_idx] = fopen(file->path, "rb")) != NULL) idx = closed_idx;
+
+            if (idx < CONTENT_SOURCE_FILE_HANDLE_COUNT) break;
+
+            /* Wait until another read operation returns its handle. */
+            condvarWait(&(file->condvar), &(file->mutex));
+        }
+
+        file->fp_leased[idx] = true;
+    }
+
+    return idx;
+}
+
+static void contentSourceReturnFileHandle(ContentSourceFile *file, u32 idx)
+{
+    SCOPED_LOCK(&(file->mutex))
+    {
+        file->fp_leased[idx] = false;
+        condvarWakeOne(&(file->condvar));
+    }
+}
+
+static bool contentSourceReadFileData(ContentSourceFile *file, void *out, u64 read_size, u64 offset)
+{
+    if ((offset + read_size) > file->size)
+    {
+        LOG_MSG_ERROR("Read request exceeds file boundaries! (0x%lX, 0x%lX, 0x%lX).", read_size, offset, file->size);
+        return false;
+    }
+
+    u32 idx = contentSourceLeaseFileHandle(file);
+    FILE *fp = file->fp[idx];
+    bool ret = false;
+
+    if (fseeko(fp, (off_t)offset, SEEK_SET) != 0)
+    {
+        LOG_MSG_ERROR("Failed to seek to offset 0x%lX! (%d).", offset, errno);
+        goto end;
+    }
+
+    ret = (fread(out, 1, read_size, fp) == read_size);
+    if (!ret) LOG_MSG_ERROR("Failed to read 0x%lX bytes block at offset 0x%lX! (%d).", read_size, offset, errno);
+
+end:
+    contentSourceReturnFileHandle(file, idx);
+
+    return ret;
+}
+
+static bool contentSourceSubmitReadEngineRequest(ContentSource *source, void *out, u64 read_size, u64 offset, ContentSourceReadCallback callback, void *callback_arg)
+{
+    bool ret = false;
+
+    SCOPED_LOCK(&g_contentSourceReadEngineMutex)
+    {
+        /* Wait until there's room in the request queue. */
+        while(g_contentSourceReadEngineRunning && g_contentSourceReadEngineQueueCount >= CONTENT_SOURCE_READ_ENGINE_QUEUE_SIZE) condvarWait(&g_contentSourceReadEngineSpaceCondvar, &g_contentSourceReadEngineMutex);
+
+        if (!g_contentSourceReadEngineRunning) break;
+
+        ContentSourceReadEngineRequest *request = &(g_contentSourceReadEngineQueue[(g_contentSourceReadEngineQueueHead + g_contentSourceReadEngineQueueCount) % CONTENT_SOURCE_READ_ENGINE_QUEUE_SIZE]);
+
+        memcpy(&(request->source), source, sizeof(ContentSource));
+        request->out = out;
+        request->read_size = read_size;
+        request->offset = offset;
+        request->callback = callback;
+        request->callback_arg = callback_arg;
+
+        g_contentSourceReadEngineQueueCount++;
+        condvarWakeOne(&g_contentSourceReadEngineRequestCondvar);
+
+        ret = true;
+    }
+
+    return ret;
+}
+
+static void contentSourceReadEngineThreadFunc(void *arg)
+{
+    NX_IGNORE_ARG(arg);
+
+    ContentSourceReadEngineRequest request = {0};
+    bool dequeued = false, success = false;
+
+    while(true)
+    {
+        dequeued = false;
+
+        SCOPED_LOCK(&g_contentSourceReadEngineMutex)
+        {
+            /* Submitted reads are always completed, even if we've been asked to stop. */
+            while(!g_contentSourceReadEngineQueueCount && !g_contentSourceReadEngineStop) condvarWait(&g_contentSourceReadEngineRequestCondvar, &g_contentSourceReadEngineMutex);
+
+            if (!g_contentSourceReadEngineQueueCount) break;
+
+            memcpy(&request, &(g_contentSourceReadEngineQueue[g_contentSourceReadEngineQueueHead]), sizeof(ContentSourceReadEngineRequest));
+
+            g_contentSourceReadEngineQueueHead = ((g_contentSourceReadEngineQueueHead + 1) % CONTENT_SOURCE_READ_ENGINE_QUEUE_SIZE);
+            g_contentSourceReadEngineQueueCount--;
+            condvarWakeOne(&g_contentSourceReadEngineSpaceCondvar);
+
+            dequeued = true;
+        }
+
+        if (!dequeued) break;
+
+        /* Carry out the read operation without holding the read engine mutex. */
+        success = request.source.iface->read(&(request.source), request.out, request.read_size, request.offset);
+        request.callback(request.out, request.read_size, request.offset, success, request.callback_arg);
+    }
+
+    threadExit();
+}
+
+static void contentSourceReadGroupCallback(void *out, u64 read_size, u64 offset, bool success, void *callback_arg)
+{
+    NX_IGNORE_ARG(out);
+    NX_IGNORE_ARG(read_size);
+    NX_IGNORE_ARG(offset);
+
+    ContentSourceReadGroup *group = (ContentSourceReadGroup*)callback_arg;
+
+    SCOPED_LOCK(&(group->mutex))
+    {
+        if (!success) group->failed = true;
+        if (!--group->pending) condvarWakeAll(&(group->condvar));
+    }
+}
+
+static bool contentSourceFindImageFileEntry(ContentSourceFile *file, const char *entry_name, u64 *out_offset, u64 *out_size)
+{
+    ContentSourceImageFileEntryLookup lookup = { .entry_name = entry_name };
+
+    if (!contentSourceIterateImageFileEntries(file, contentSourceFindImageFileEntryVisitor, &lookup) || !lookup.found) return false;
+
+    *out_offset = lookup.entry_offset;
+    *out_size = lookup.entry_size;
+
+    if (!lookup.entry_size || (lookup.entry_offset + lookup.entry_size) > file->size)
+    {
+        LOG_MSG_ERROR("Invalid properties for entry \"%s\"! (0x%lX, 0x%lX).", entry_name, lookup.entry_offset, lookup.entry_size);
+        return false;
+    }
+
+    return true;
+}
+
+static bool contentSourceFindImageFileEntryVisitor(const char *entry_name, u64 entry_offset, u64 entry_size, void *arg)
+{
+    ContentSourceImageFileEntryLookup *lookup = (ContentSourceImageFileEntryLookup*)arg;
+
+    if (strcmp(entry_name, lookup->entry_name) != 0) return false;
+
+    lookup->entry_offset = entry_offset;
+    lookup->entry_size = entry_size;
+    lookup->found = true;
+
+    return true;
+}
+
+static bool contentSourceAddImageFileEntryNameVisitor(const char *entry_name, u64 entry_offset, u64 entry_size, void *arg)
+{
+    NX_IGNORE_ARG(entry_offset);
+    NX_IGNORE_ARG(entry_size);
+
+    ContentSourceImageFileEntryNameList *list = (ContentSourceImageFileEntryNameList*)arg;
+    size_t entry_name_len = strlen(entry_name);
+    char *tmp_names = NULL;
+
+    /* Names are stored one after another, each one with its own NULL terminator. */
+    tmp_names = realloc(list->names, list->names_size + entry_name_len + 1);
+    if (!tmp_names)
+    {
+        LOG_MSG_ERROR("Failed to reallocate image file entry names buffer!");
+        list->failed = true;
+        return true;
+    }
+
+    list->names = tmp_names;
+    memcpy(list->names + list->names_size, entry_name, entry_name_len + 1);
+    list->names_size += (entry_name_len + 1);
+    list->count++;
+
+    return false;
+}
+
+static bool contentSourceIterateImageFileEntries(ContentSourceFile *file, ContentSourceImageFileEntryVisitor visitor, void *arg)
+{
+    GameCardHeader gc_header = {0};
+    u64 gc_header_offset = 0;
+    u32 magic = 0;
+
+    u8 *root_header = NULL;
+    u32 root_entry_count = 0;
+    u64 root_header_size = 0;
+
+    bool ret = false, stop = false;
+
+    /* Check if we're dealing with a PFS0 image (NSP). */
+    if (!contentSourceReadFileData(file, &magic, sizeof(u32), 0)) return false;
+    if (__builtin_bswap32(magic) == PFS0_MAGIC) return contentSourceIteratePartitionEntries(file, 0, false, visitor, arg, &stop);
+
+    /* Check if we're dealing with a gamecard image (XCI), with or without a prepended key area. */
+    for(u8 i = 0; i < 2; i++)
+    {
+        gc_header_offset = (i == 0 ? 0 : sizeof(GameCardKeyArea));
+        if ((gc_header_offset + sizeof(GameCardHeader)) > file->size) break;
+
+        if (contentSourceReadFileData(file, &gc_header, sizeof(GameCardHeader), gc_header_offset) && __builtin_bswap32(gc_header.magic) == GAMECARD_HEAD_MAGIC)
+        {
+            ret = true;
+            break;
+        }
+    }
+
+    if (!ret)
+    {
+        LOG_MSG_ERROR("Unsupported image file format!");
+        return false;
+    }
+
+    ret = false;
+
+    /* Read root Hash FS partition header. */
+    u64 root_offset = (gc_header_offset + gc_header.partition_fs_header_address);
+
+    root_header = contentSourceReadPartitionHeader(file, root_offset, true, &root_entry_count, &root_header_size);
+    if (!root_header) return false;
+
+    /* Iterate over the entries from each child Hash FS partition. Child partitions with invalid headers are skipped. */
+    for(u32 i = 0; i < root_entry_count && !stop; i++)
+    {
+        HashFileSystemEntry *root_entry = (HashFileSystemEntry*)(root_header + sizeof(HashFileSystemHeader) + (i * sizeof(HashFileSystemEntry)));
+        if (!root_entry->size) continue;
+
+        if (contentSourceIteratePartitionEntries(file, root_offset + root_header_size + root_entry->offset, true, visitor, arg, &stop)) ret = true;
+    }
+
+    free(root_header);
+
+    return ret;
+}
+
+static bool contentSourceIteratePartitionEntries(ContentSourceFile *file, u64 partition_offset, bool is_hfs, ContentSourceImageFileEntryVisitor visitor, void *arg, bool *out_stop)
+{
+    u8 *header = NULL;
+    u32 entry_count = 0;
+    u64 header_size = 0, entry_size = (is_hfs ? sizeof(HashFileSystemEntry) : sizeof(PartitionFileSystemEntry));
+
+    header = contentSourceReadPartitionHeader(file, partition_offset, is_hfs, &entry_count, &header_size);
+    if (!header) return false;
+
+    u64 name_table_offset = (sizeof(PartitionFileSystemHeader) + (entry_count * entry_size));
+    const char *name_table = (const char*)(header + name_table_offset);
+    u64 name_table_size = (header_size - name_table_offset);
+
+    for(u32 i = 0; i < entry_count && !*out_stop; i++)
+    {
+        /* Both PartitionFileSystemEntry and HashFileSystemEntry start with the same fields. */
+        PartitionFileSystemEntry *entry = (PartitionFileSystemEntry*)(header + sizeof(PartitionFileSystemHeader) + (i * entry_size));
+        if (entry->name_offset >= name_table_size || !name_table[entry->name_offset]) continue;
+
+        *out_stop = visitor(name_table + entry->name_offset, partition_offset + header_size + entry->offset, entry->size, arg);
+    }
+
+    free(header);
+
+    return true;
+}
+
+static u8 *contentSourceReadPartitionHeader(ContentSourceFile *file, u64 partition_offset, bool is_hfs, u32 *out_entry_count, u64 *out_header_size)
+{
+    PartitionFileSystemHeader fs_header = {0};
+    u64 header_size = 0;
+    u8 *header = NULL;
+
+    /* PartitionFileSystemHeader and HashFileSystemHeader share the same layout. */
+    if ((partition_offset + sizeof(PartitionFileSystemHeader)) > file->size || !contentSourceReadFileData(file, &fs_header, sizeof(PartitionFileSystemHeader), partition_offset)) return NULL;
+
+    if (__builtin_bswap32(fs_header.magic) != (is_hfs ? HFS0_MAGIC : PFS0_MAGIC) || !fs_header.name_table_size)
+    {
+        LOG_MSG_ERROR("Invalid %s header at offset 0x%lX!", is_hfs ? "HFS0" : "PFS0", partition_offset);
+        return NULL;
+    }
+
+    header_size = (sizeof(PartitionFileSystemHeader) + ((u64)fs_header.entry_count * (is_hfs ? sizeof(HashFileSystemEntry) : sizeof(PartitionFileSystemEntry))) + fs_header.name_table_size);
+    if (header_size > CONTENT_SOURCE_MAX_PARTITION_HEADER_SIZE || (partition_offset + header_size) > file->size)
+    {
+        LOG_MSG_ERROR("Invalid %s header size at offset 0x%lX! (0x%lX).", is_hfs ? "HFS0" : "PFS0", partition_offset, header_size);
+        return NULL;
+    }
+
+    /* Add an extra byte to make sure the name table is always NULL terminated. */
+    header = calloc(header_size + 1, sizeof(u8));
+    if (!header)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for %s header!", is_hfs ? "HFS0" : "PFS0");
+        return NULL;
+    }
+
+    if (!contentSourceReadFileData(file, header, header_size, partition_offset))
+    {
+        free(header);
+        return NULL;
+    }
+
+    *out_entry_count = fs_header.entry_count;
+    *out_header_size = header_size;
+
+    return header;
+}
@@ -26,6 +26,9 @@
 
 #define GAMECARD_READ_BUFFER_SIZE               0x800000                /* 8 MiB. */
 
+#define GAMECARD_STREAM_BUFFER_COUNT            3                       /* Two chunks held by the caller (e.g. one being processed, one being written), plus one being read. */
+#define GAMECARD_STREAM_BUFFER_ALIGNMENT        0x1000
+
 #define GAMECARD_ACCESS_DELAY                   3                       /* Seconds. */
 
 #define GAMECARD_UNUSED_AREA_BLOCK_SIZE         0x24
@@ -43,6 +46,33 @@ typedef enum {
     GameCardStorageArea_Secure = 2
 } GameCardStorageArea;
 
+typedef enum {
+    GameCardStreamBufferState_Free    = 0,
+    GameCardStreamBufferState_Reading = 1,
+    GameCardStreamBufferState_Ready   = 2,
+    GameCardStreamBufferState_InUse   = 3
+} GameCardStreamBufferState;
+
+typedef struct {
+    u8 *data;
+    u64 offset;                         ///< Page-aligned gamecard storage offset.
+    u64 size;
+    u8 state;                           ///< GameCardStreamBufferState.
+} GameCardStreamBuffer;
+
+typedef struct {
+    bool active;
+    bool stop;
+    bool error;
+    u64 end_offset;                     ///< End of the requested range.
+    u64 read_offset;                    ///< Next page-aligned offset to be read by the stream thread.
+    u64 consume_offset;                 ///< Next offset to be handed out to the caller.
+    u64 normal_area_size;               ///< Snapshot taken under the gamecard mutex when the stream is started.
+    GameCardStreamBuffer buffers[GAMECARD_STREAM_BUFFER_COUNT];
+    Thread thread;
+    CondVar condvar;                    ///< Signaled whenever a buffer changes state, or when the stream is being stopped.
+} GameCardStream;
+
 typedef enum {
     GameCardCapacity_1GiB  = BITL(30),
     GameCardCapacity_2GiB  = BITL(31),
@@ -84,6 +114,9 @@ static u64 g_gameCardCapacity = 0;
 static u32 g_gameCardHfsCount = 0;
 static HashFileSystemContext **g_gameCardHfsCtx = NULL;
 
+static Mutex g_gameCardStreamMutex = 0;
+static GameCardStream g_gameCardStream = {0};
+
 static MemoryLocation g_fsProgramMemory = {
     .program_id = FS_SYSMODULE_TID,
     .mask = 0,
@@ -137,6 +170,9 @@ static bool gamecardOpenStorageArea(u8 area);
 static bool gamecardReadStorageArea(void *out, u64 read_size, u64 offset);
 static void gamecardCloseStorageArea(void);
 
+static void gamecardStreamThreadFunc(void *arg);
+static void gamecardStreamFreeBuffers(void);
+
 static bool gamecardGetStorageAreasSizes(void);
 NX_INLINE u64 gamecardGetCapacityFromRomSizeValue(u8 rom_size);
 
@@ -212,6 +248,9 @@ bool gamecardInitialize(void)
 
 void gamecardExit(void)
 {
+    /* Stop the active read stream, if any. This must be done before locking the gamecard mutex, since the stream thread needs it. */
+    gamecardStreamEnd();
+
     SCOPED_LOCK(&g_gameCardMutex)
     {
         /* Destroy gamecard detection thread. */
@@ -344,6 +383,163 @@ bool gamecardReadStorage(void *out, u64 read_size, u64 offset)
     return ret;
 }
 
+bool gamecardStreamStart(u64 offset, u64 size)
+{
+    GameCardStream *stream = &g_gameCardStream;
+    bool ret = false;
+
+    SCOPED_LOCK(&g_gameCardStreamMutex)
+    {
+        u64 total_size = 0, normal_area_size = 0;
+        int cur_core = (int)svcGetCurrentProcessorNumber();
+
+        if (stream->active)
+        {
+            LOG_MSG_ERROR("A gamecard read stream is already active!");
+            break;
+        }
+
+        SCOPED_LOCK(&g_gameCardMutex)
+        {
+            if (g_gameCardStatus != GameCardStatus_InsertedAndInfoLoaded) break;
+            total_size = g_gameCardTotalSize;
+            normal_area_size = g_gameCardNormalAreaSize;
+        }
+
+        if (!size || (offset + size) > total_size)
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
+
+        memset(stream, 0, sizeof(GameCardStream));
+
+        /* Allocate stream buffers. */
+        for(u32 i = 0; i < GAMECARD_STREAM_BUFFER_COUNT; i++)
+        {
+            if (!(stream->buffers[i].data = memalign(GAMECARD_STREAM_BUFFER_ALIGNMENT, GAMECARD_STREAM_CHUNK_SIZE)))
+            {
+                LOG_MSG_ERROR("Unable to allocate memory for gamecard stream buffer #%u!", i);
+                goto end;
+            }
+        }
+
+        stream->end_offset = (offset + size);
+        stream->read_offset = ALIGN_DOWN(offset, GAMECARD_PAGE_SIZE);
+        stream->consume_offset = offset;
+        stream->normal_area_size = normal_area_size;
+
+        /* Start stream thread on the core right after ours. Core 3 is reserved for HOS. */
+        if (!utilsCreateThread(&(stream->thread), gamecardStreamThreadFunc, stream, (cur_core + 1) % 3))
+        {
+            LOG_MSG_ERROR("Failed to create gamecard stream thread!");
+            goto end;
+        }
+
+        ret = stream->active = true;
+
+end:
+        if (!ret) gamecardStreamFreeBuffers();
+    }
+
+    return ret;
+}
+
+bool gamecardStreamRead(GameCardStreamChunk *out_chunk)
+{
+    GameCardStream *stream = &g_gameCardStream;
+    bool ret = false;
+
+    if (!out_chunk)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    SCOPED_LOCK(&g_gameCardStreamMutex)
+    {
+        GameCardStreamBuffer *buffer = NULL;
+        u32 buffer_idx = 0;
+
+        if (!stream->active || stream->consume_offset >= stream->end_offset) break;
+
+        /* Wait until the buffer holding the data at the current offset is ready. */
+        while(!stream->error)
+        {
+            for(buffer_idx = 0; buffer_idx < GAMECARD_STREAM_BUFFER_COUNT; buffer_idx++)
+            {
+                buffer = &(stream->buffers[buffer_idx]);
+                if (buffer->state == GameCardStreamBufferState_Ready && stream->consume_offset >= buffer->offset && stream->consume_offset < (buffer->offset + buffer->size)) break;
+            }
+
+            if (buffer_idx < GAMECARD_STREAM_BUFFER_COUNT) break;
+
+            condvarWait(&(stream->condvar), &g_gameCardStreamMutex);
+        }
+
+        if (stream->error)
+        {
+            LOG_MSG_ERROR("Gamecard read stream failed at offset 0x%lX!", stream->consume_offset);
+            break;
+        }
+
+        /* Hand out a view into this buffer. Its data is never copied. */
+        u64 data_offset = (stream->consume_offset - buffer->offset);
+        u64 data_size = (MIN(buffer->offset + buffer->size, stream->end_offset) - stream->consume_offset);
+
+        out_chunk->data = (buffer->data + data_offset);
+        out_chunk->size = data_size;
+        out_chunk->offset = stream->consume_offset;
+        out_chunk->buffer_idx = buffer_idx;
+
+        buffer->state = GameCardStreamBufferState_InUse;
+        stream->consume_offset += data_size;
+
+        ret = true;
+    }
+
+    return ret;
+}
+
+void gamecardStreamReleaseChunk(const GameCardStreamChunk *chunk)
+{
+    GameCardStream *stream = &g_gameCardStream;
+
+    if (!chunk || chunk->buffer_idx >= GAMECARD_STREAM_BUFFER_COUNT) return;
+
+    SCOPED_LOCK(&g_gameCardStreamMutex)
+    {
+        GameCardStreamBuffer *buffer = &(stream->buffers[chunk->buffer_idx]);
+        if (!stream->active || buffer->state != GameCardStreamBufferState_InUse) break;
+
+        /* Let the stream thread reuse this buffer. */
+        buffer->state = GameCardStreamBufferState_Free;
+        condvarWakeAll(&(stream->condvar));
+    }
+}
+
+void gamecardStreamEnd(void)
+{
+    GameCardStream *stream = &g_gameCardStream;
+
+    SCOPED_LOCK(&g_gameCardStreamMutex)
+    {
+        if (!stream->active) break;
+
+        /* Stop stream thread. */
+        stream->stop = true;
+        condvarWakeAll(&(stream->condvar));
+    }
+
+    /* The stream thread is joined without holding the stream mutex, since it needs it. */
+    /* The 'active' flag is still set at this point, which keeps other threads from starting a new stream. */
+    if (!stream->stop) return;
+
+    utilsJoinThread(&(stream->thread));
+
+    SCOPED_LOCK(&g_gameCardStreamMutex) gamecardStreamFreeBuffers();
+}
+
 bool gamecardGetHeader(GameCardHeader *out)
 {
     bool ret = false;
@@ -1053,71 +1249,62 @@ static bool gamecardReadStorageArea(void *out, u64 read_size, u64 offset)
 
     Result rc = 0;
     u8 *out_u8 = (u8*)out;
-    u8 area = (offset < g_gameCardNormalAreaSize ? GameCardStorageArea_Normal : GameCardStorageArea_Secure);
-    bool success = false;
 
-    /* Handle reads that span both the normal and secure gamecard storage areas. */
-    if (area == GameCardStorageArea_Normal && (offset + read_size) > g_gameCardNormalAreaSize)
+    while(read_size)
     {
-        /* Calculate normal storage area size difference. */
-        u64 diff_size = (g_gameCardNormalAreaSize - offset);
+        u8 area = (offset < g_gameCardNormalAreaSize ? GameCardStorageArea_Normal : GameCardStorageArea_Secure);
 
-        /* Read normal storage area data. */
-        if (!gamecardReadStorageArea(out_u8, diff_size, offset)) goto end;
+        /* Reads that span both the normal and secure gamecard storage areas are split at the area boundary. */
+        u64 area_read_size = ((area == GameCardStorageArea_Normal && (offset + read_size) > g_gameCardNormalAreaSize) ? (g_gameCardNormalAreaSize - offset) : read_size);
+        u64 chunk_size = 0;
 
-        /* Adjust variables to read right from the start of the secure storage area. */
-        read_size -= diff_size;
-        offset = g_gameCardNormalAreaSize;
-        out_u8 += diff_size;
-        area = GameCardStorageArea_Secure;
-    }
-
-    /* Open a storage area if needed. */
-    /* If the right storage area has already been opened, this will return true. */
-    if (!gamecardOpenStorageArea(area))
-    {
-        LOG_MSG_ERROR("Failed to open %s storage area!", GAMECARD_STORAGE_AREA_NAME(area));
-        goto end;
-    }
+        /* Open a storage area if needed. */
+        /* If the right storage area has already been opened, this will return true. */
+        if (!gamecardOpenStorageArea(area))
+        {
+            LOG_MSG_ERROR("Failed to open %s storage area!", GAMECARD_STORAGE_AREA_NAME(area));
+            return false;
+        }
 
-    /* Calculate proper storage area offset. */
-    u64 base_offset = (area == GameCardStorageArea_Normal ? offset : (offset - g_gameCardNormalAreaSize));
+        /* Calculate proper storage area offset. */
+        u64 base_offset = (area == GameCardStorageArea_Normal ? offset : (offset - g_gameCardNormalAreaSize));
 
-    if (!(base_offset % GAMECARD_PAGE_SIZE) && !(read_size % GAMECARD_PAGE_SIZE))
-    {
-        /* Optimization for reads that are already aligned to a GAMECARD_PAGE_SIZE boundary. */
-        rc = fsStorageRead(&g_gameCardStorage, base_offset, out_u8, read_size);
-        if (R_FAILED(rc))
+        if (IS_ALIGNED(base_offset, GAMECARD_PAGE_SIZE) && area_read_size >= GAMECARD_PAGE_SIZE)
         {
-            LOG_MSG_ERROR("fsStorageRead failed to read 0x%lX bytes at offset 0x%lX from %s storage area! (0x%X) (aligned).", read_size, base_offset, GAMECARD_STORAGE_AREA_NAME(area), rc);
-            goto end;
-        }
+            /* Read as many full pages as possible straight into the output buffer. */
+            chunk_size = ALIGN_DOWN(area_read_size, GAMECARD_PAGE_SIZE);
 
-        success = true;
-    } else {
-        /* Fix offset and/or size to avoid unaligned reads. */
-        u64 block_start_offset = ALIGN_DOWN(base_offset, GAMECARD_PAGE_SIZE);
-        u64 block_end_offset = ALIGN_UP(base_offset + read_size, GAMECARD_PAGE_SIZE);
-        u64 block_size = (block_end_offset - block_start_offset);
+            rc = fsStorageRead(&g_gameCardStorage, base_offset, out_u8, chunk_size);
+            if (R_FAILED(rc))
+            {
+                LOG_MSG_ERROR("fsStorageRead failed to read 0x%lX bytes at offset 0x%lX from %s storage area! (0x%X) (aligned).", chunk_size, base_offset, GAMECARD_STORAGE_AREA_NAME(area), rc);
+                return false;
+            }
+        } else {
+            /* Fix offset and/or size to avoid unaligned reads. Data is read into our internal buffer, then copied. */
+            u64 block_start_offset = ALIGN_DOWN(base_offset, GAMECARD_PAGE_SIZE);
+            u64 block_end_offset = ALIGN_UP(base_offset + area_read_size, GAMECARD_PAGE_SIZE);
+            u64 block_size = MIN(block_end_offset - block_start_offset, GAMECARD_READ_BUFFER_SIZE);
+            u64 data_start_offset = (base_offset - block_start_offset);
 
-        u64 data_start_offset = (base_offset - block_start_offset);
-        u64 chunk_size = (block_size > GAMECARD_READ_BUFFER_SIZE ? GAMECARD_READ_BUFFER_SIZE : block_size);
-        u64 out_chunk_size = (block_size > GAMECARD_READ_BUFFER_SIZE ? (GAMECARD_READ_BUFFER_SIZE - data_start_offset) : read_size);
+            chunk_size = MIN(area_read_size, block_size - data_start_offset);
 
-        rc = fsStorageRead(&g_gameCardStorage, block_start_offset, g_gameCardReadBuf, chunk_size);
-        if (R_FAILED(rc))
-        {
-            LOG_MSG_ERROR("fsStorageRead failed to read 0x%lX bytes at offset 0x%lX from %s storage area! (0x%X) (unaligned).", chunk_size, block_start_offset, GAMECARD_STORAGE_AREA_NAME(area), rc);
-            goto end;
-        }
+            rc = fsStorageRead(&g_gameCardStorage, block_start_offset, g_gameCardReadBuf, block_size);
+            if (R_FAILED(rc))
+            {
+                LOG_MSG_ERROR("fsStorageRead failed to read 0x%lX bytes at offset 0x%lX from %s storage area! (0x%X) (unaligned).", block_size, block_start_offset, GAMECARD_STORAGE_AREA_NAME(area), rc);
+                return false;
+            }
 
-        memcpy(out_u8, g_gameCardReadBuf + data_start_offset, out_chunk_size);
+            memcpy(out_u8, g_gameCardReadBuf + data_start_offset, chunk_size);
+        }
 
-        success = (block_size > GAMECARD_READ_BUFFER_SIZE ? gamecardReadStorageArea(out_u8 + out_chunk_size, read_size - out_chunk_size, offset + out_chunk_size) : true);
+        out_u8 += chunk_size;
+        read_size -= chunk_size;
+        offset += chunk_size;
     }
 
-end:
-    return success;
+    return true;
 }
 
 static void gamecardCloseStorageArea(void)
@@ -1135,6 +1322,80 @@ static void gamecardCloseStorageArea(void)
     g_gameCardCurrentStorageArea = GameCardStorageArea_None;
 }
 
+static void gamecardStreamThreadFunc(void *arg)
+{
+    GameCardStream *stream = (GameCardStream*)arg;
+    u64 end_offset = ALIGN_UP(stream->end_offset, GAMECARD_PAGE_SIZE);
+
+    while(true)
+    {
+        GameCardStreamBuffer *buffer = NULL;
+        bool success = false;
+
+        SCOPED_LOCK(&g_gameCardStreamMutex)
+        {
+            /* Wait for a free buffer. */
+            while(!stream->stop && !stream->error && stream->read_offset < end_offset)
+            {
+                for(u32 i = 0; i < GAMECARD_STREAM_BUFFER_COUNT; i++)
+                {
+                    if (stream->buffers[i].state != GameCardStreamBufferState_Free) continue;
+                    buffer = &(stream->buffers[i]);
+                    break;
+                }
+
+                if (buffer) break;
+
+                condvarWait(&(stream->condvar), &g_gameCardStreamMutex);
+            }
+
+            if (!buffer) break;
+
+            /* Queue the next page-aligned read. Reads never span both storage areas. */
+            buffer->offset = stream->read_offset;
+            buffer->size = MIN(end_offset - stream->read_offset, GAMECARD_STREAM_CHUNK_SIZE);
+
+            if (buffer->offset < stream->normal_area_size && (buffer->offset + buffer->size) > stream->normal_area_size) buffer->size = (stream->normal_area_size - buffer->offset);
+
+            buffer->state = GameCardStreamBufferState_Reading;
+            stream->read_offset += buffer->size;
+        }
+
+        /* Bail out if the stream is being stopped, if an error occurred or if the whole range has already been read. */
+        if (!buffer) break;
+
+        /* Read data. Both the offset and size are page-aligned here, so this never goes through the gamecard read buffer. */
+        SCOPED_LOCK(&g_gameCardMutex) success = gamecardReadStorageArea(buffer->data, buffer->size, buffer->offset);
+
+        SCOPED_LOCK(&g_gameCardStreamMutex)
+        {
+            if (success)
+            {
+                buffer->state = GameCardStreamBufferState_Ready;
+            } else {
+                buffer->state = GameCardStreamBufferState_Free;
+                stream->error = true;
+            }
+
+            condvarWakeAll(&(stream->condvar));
+        }
+
+        if (!success) break;
+    }
+
+    threadExit();
+}
+
+static void gamecardStreamFreeBuffers(void)
+{
+    for(u32 i = 0; i < GAMECARD_STREAM_BUFFER_COUNT; i++)
+    {
+        if (g_gameCardStream.buffers[i].data) free(g_gameCardStream.buffers[i].data);
+    }
+
+    memset(&g_gameCardStream, 0, sizeof(GameCardStream));
+}
+
 static bool gamecardGetStorageAreasSizes(void)
 {
     for(u8 i = 0; i < 2; i++)
@@ -0,0 +1,256 @@
+/*
+ * hash_batch.c
+ *
+ * Copyright (c) 2020-2023, DarkMatterCore <pabloacurielz@gmail.com>.
+ *
+ * This file is part of nxdumptool (https://github.com/DarkMatterCore/nxdumptool).
+ *
+ * nxdumptool is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * nxdumptool is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "nxdt_utils.h"
+#include "hash_batch.h"
+
+/* Type definitions. */
+
+typedef struct _HashBatchContext {
+    HashBatchJob *jobs;
+    u32 job_count;
+    u8 algorithm;
+    u32 next_job;                       ///< Index of the next job to be picked up. Protected by the worker mutex.
+    u32 active_jobs;                    ///< Jobs currently being processed by worker threads. Protected by the worker mutex.
+    struct _HashBatchContext *next;     ///< Next batch in the worker thread list.
+} HashBatchContext;
+
+/* Global variables. */
+
+static Mutex g_hashBatchWorkerMutex = 0;
+static CondVar g_hashBatchWorkerJobCondVar = 0, g_hashBatchWorkerDoneCondVar = 0;
+static Thread g_hashBatchWorkerThreads[HASH_BATCH_WORKER_THREAD_COUNT] = {0};
+static u32 g_hashBatchWorkerThreadCount = 0;
+static bool g_hashBatchWorkersRunning = false, g_hashBatchWorkersStop = false;
+static HashBatchContext *g_hashBatchWorkerBatches = NULL;
+
+/* Function prototypes. */
+
+static void hashBatchProcessJobs(HashBatchContext *batch);
+static void hashBatchWorkerThreadFunc(void *arg);
+
+void hashBatchCalculateHash(void *dst, const void *src, size_t size, size_t padded_size, u8 algorithm)
+{
+    static const u8 zero_block[0x400] = {0};
+
+    if (!dst || (!src && size) || algorithm >= HashBatchAlgorithm_Count) return;
+
+    /* Calculate the hash in a single step if no padding is needed. */
+    if (padded_size <= size)
+    {
+        if (algorithm == HashBatchAlgorithm_Sha3256)
+        {
+            sha3256CalculateHash(dst, src, size);
+        } else {
+            sha256CalculateHash(dst, src, size);
+        }
+
+        return;
+    }
+
+    /* Feed zeroes to the hash context until we reach the padded size. */
+    if (algorithm == HashBatchAlgorithm_Sha3256)
+    {
+        Sha3Context sha3_ctx = {0};
+        sha3256ContextCreate(&sha3_ctx);
+        sha3ContextUpdate(&sha3_ctx, src, size);
+
+        for(size_t i = size; i < padded_size; i += sizeof(zero_block)) sha3ContextUpdate(&sha3_ctx, zero_block, MIN(sizeof(zero_block), padded_size - i));
+
+        sha3ContextGetHash(&sha3_ctx, dst);
+    } else {
+        Sha256Context sha256_ctx = {0};
+        sha256ContextCreate(&sha256_ctx);
+        sha256ContextUpdate(&sha256_ctx, src, size);
+
+        for(size_t i = size; i < padded_size; i += sizeof(zero_block)) sha256ContextUpdate(&sha256_ctx, zero_block, MIN(sizeof(zero_block), padded_size - i));
+
+        sha256ContextGetHash(&sha256_ctx, dst);
+    }
+}
+
+bool hashBatchCalculate(HashBatchJob *jobs, u32 job_count, u8 algorithm)
+{
+    if (!jobs || !job_count || algorithm >= HashBatchAlgorithm_Count)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    HashBatchContext batch = { .jobs = jobs, .job_count = job_count, .algorithm = algorithm, .next_job = 0, .active_jobs = 0, .next = NULL };
+    bool use_workers = false;
+    size_t total_size = 0;
+
+    /* Only let the worker threads pick up jobs from this batch if there's enough work to make it worth it. */
+    if (job_count >= HASH_BATCH_PARALLEL_MIN_JOB_COUNT)
+    {
+        for(u32 i = 0; i < job_count; i++) total_size += MAX(jobs[i].size, jobs[i].padded_size);
+    }
+
+    if (total_size >= HASH_BATCH_PARALLEL_MIN_SIZE)
+    {
+        SCOPED_LOCK(&g_hashBatchWorkerMutex)
+        {
+            use_workers = g_hashBatchWorkersRunning;
+            if (!use_workers) break;
+
+            batch.next = g_hashBatchWorkerBatches;
+            g_hashBatchWorkerBatches = &batch;
+
+            condvarWakeAll(&g_hashBatchWorkerJobCondVar);
+        }
+    }
+
+    if (!use_workers)
+    {
+        for(u32 i = 0; i < job_count; i++) hashBatchCalculateHash(jobs[i].hash, jobs[i].src, jobs[i].size, jobs[i].padded_size, algorithm);
+        return true;
+    }
+
+    /* Process jobs on the calling thread as well. */
+    hashBatchProcessJobs(&batch);
+
+    SCOPED_LOCK(&g_hashBatchWorkerMutex)
+    {
+        /* Wait until the worker threads are done with the jobs they picked up. */
+        while(batch.active_jobs) condvarWait(&g_hashBatchWorkerDoneCondVar, &g_hashBatchWorkerMutex);
+
+        /* Remove this batch from the list. */
+        for(HashBatchContext **cur = &g_hashBatchWorkerBatches; *cur; cur = &((*cur)->next))
+        {
+            if (*cur != &batch) continue;
+            *cur = batch.next;
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool hashBatchStartWorkers(void)
+{
+    bool ret = false;
+
+    SCOPED_LOCK(&g_hashBatchWorkerMutex)
+    {
+        ret = g_hashBatchWorkersRunning;
+        if (ret) break;
+
+        g_hashBatchWorkersStop = false;
+
+        /* Core 3 is reserved for HOS. */
+        for(g_hashBatchWorkerThreadCount = 0; g_hashBatchWorkerThreadCount < HASH_BATCH_WORKER_THREAD_COUNT; g_hashBatchWorkerThreadCount++)
+        {
+            if (!utilsCreateThread(&(g_hashBatchWorkerThreads[g_hashBatchWorkerThreadCount]), hashBatchWorkerThreadFunc, NULL, (int)(g_hashBatchWorkerThreadCount % 3)))
+            {
+                LOG_MSG_ERROR("Failed to create hash batch worker thread #%u!", g_hashBatchWorkerThreadCount);
+                break;
+            }
+        }
+
+        ret = g_hashBatchWorkersRunning = (g_hashBatchWorkerThreadCount == HASH_BATCH_WORKER_THREAD_COUNT);
+    }
+
+    /* Stop worker threads that have already been created if something went wrong. */
+    if (!ret) hashBatchStopWorkers();
+
+    return ret;
+}
+
+void hashBatchStopWorkers(void)
+{
+    u32 thread_count = 0;
+
+    SCOPED_LOCK(&g_hashBatchWorkerMutex)
+    {
+        thread_count = g_hashBatchWorkerThreadCount;
+
+        g_hashBatchWorkersRunning = false;
+        g_hashBatchWorkersStop = true;
+        g_hashBatchWorkerThreadCount = 0;
+
+        condvarWakeAll(&g_hashBatchWorkerJobCondVar);
+    }
+
+    /* Batches that are still being processed are completed by their calling threads. */
+    for(u32 i = 0; i < thread_count; i++) utilsJoinThread(&(g_hashBatchWorkerThreads[i]));
+}
+
+static void hashBatchProcessJobs(HashBatchContext *batch)
+{
+    HashBatchJob *job = NULL;
+
+    while(true)
+    {
+        job = NULL;
+
+        /* Pick up the next job. */
+        SCOPED_LOCK(&g_hashBatchWorkerMutex)
+        {
+            if (batch->next_job < batch->job_count) job = &(batch->jobs[batch->next_job++]);
+        }
+
+        if (!job) break;
+
+        hashBatchCalculateHash(job->hash, job->src, job->size, job->padded_size, batch->algorithm);
+    }
+}
+
+static void hashBatchWorkerThreadFunc(void *arg)
+{
+    NX_IGNORE_ARG(arg);
+
+    HashBatchContext *batch = NULL;
+    HashBatchJob *job = NULL;
+
+    while(true)
+    {
+        job = NULL;
+
+        SCOPED_LOCK(&g_hashBatchWorkerMutex)
+        {
+            while(true)
+            {
+                /* Look for a batch with jobs that haven't been picked up yet. */
+                for(batch = g_hashBatchWorkerBatches; batch && batch->next_job >= batch->job_count; batch = batch->next);
+                if (batch || g_hashBatchWorkersStop) break;
+
+                condvarWait(&g_hashBatchWorkerJobCondVar, &g_hashBatchWorkerMutex);
+            }
+
+            if (!batch) break;
+
+            job = &(batch->jobs[batch->next_job++]);
+            batch->active_jobs++;
+        }
+
+        if (!job) break;
+
+        hashBatchCalculateHash(job->hash, job->src, job->size, job->padded_size, batch->algorithm);
+
+        SCOPED_LOCK(&g_hashBatchWorkerMutex)
+        {
+            if (!--batch->active_jobs) condvarWakeAll(&g_hashBatchWorkerDoneCondVar);
+        }
+    }
+
+    threadExit();
+}
@@ -25,19 +25,19 @@
 
 /* Helper macros. */
 
-#define NACP_ADD_FMT_STR_T1(fmt, ...)                                                           utilsAppendFormattedStringToBuffer(&xml_buf, &xml_buf_size, fmt, ##__VA_ARGS__)
-#define NACP_ADD_FMT_STR_T2(fmt, ...)                                                           utilsAppendFormattedStringToBuffer(xml_buf, xml_buf_size, fmt, ##__VA_ARGS__)
-#define NACP_ADD_STR(tag_name, value)                                                           nacpAddStringFieldToAuthoringToolXml(&xml_buf, &xml_buf_size, tag_name, value)
-#define NACP_ADD_ENUM(tag_name, value, str_func)                                                nacpAddEnumFieldToAuthoringToolXml(&xml_buf, &xml_buf_size, tag_name, value, \
+#define NACP_ADD_FMT_STR_T1(fmt, ...)                                                           utilsStringBuilderAppendFormatted(&xml_sb, fmt, ##__VA_ARGS__)
+#define NACP_ADD_FMT_STR_T2(fmt, ...)                                                           utilsStringBuilderAppendFormatted(xml_sb, fmt, ##__VA_ARGS__)
+#define NACP_ADD_STR(tag_name, value)                                                           nacpAddStringFieldToAuthoringToolXml(&xml_sb, tag_name, value)
+#define NACP_ADD_ENUM(tag_name, value, str_func)                                                nacpAddEnumFieldToAuthoringToolXml(&xml_sb, tag_name, value, \
                                                                                                                                    &str_func)
-#define NACP_ADD_BITFLAG(tag_name, flag, flag_width, max_flag_idx, str_func, allow_empty_str)   nacpAddBitflagFieldToAuthoringToolXml(&xml_buf, &xml_buf_size, tag_name, flag, \
+#define NACP_ADD_BITFLAG(tag_name, flag, flag_width, max_flag_idx, str_func, allow_empty_str)   nacpAddBitflagFieldToAuthoringToolXml(&xml_sb, tag_name, flag, \
                                                                                                                                       flag_width, max_flag_idx, &(str_func), \
                                                                                                                                       allow_empty_str)
-#define NACP_ADD_U16(tag_name, value, hex, prefix)                                              nacpAddU16FieldToAuthoringToolXml(&xml_buf, &xml_buf_size, tag_name, value, hex, \
+#define NACP_ADD_U16(tag_name, value, hex, prefix)                                              nacpAddU16FieldToAuthoringToolXml(&xml_sb, tag_name, value, hex, \
                                                                                                                                   prefix)
-#define NACP_ADD_U32(tag_name, value, hex, prefix)                                              nacpAddU32FieldToAuthoringToolXml(&xml_buf, &xml_buf_size, tag_name, value, hex, \
+#define NACP_ADD_U32(tag_name, value, hex, prefix)                                              nacpAddU32FieldToAuthoringToolXml(&xml_sb, tag_name, value, hex, \
                                                                                                                                   prefix)
-#define NACP_ADD_U64(tag_name, value, hex, prefix)                                              nacpAddU64FieldToAuthoringToolXml(&xml_buf, &xml_buf_size, tag_name, value, hex, \
+#define NACP_ADD_U64(tag_name, value, hex, prefix)                                              nacpAddU64FieldToAuthoringToolXml(&xml_sb, tag_name, value, hex, \
                                                                                                                                   prefix)
 
 /* Type definitions. */
@@ -220,17 +220,17 @@ static const char *g_nacpContentsAvailabilityTransitionPolicyStrings[NacpContent
 
 NX_INLINE bool nacpCheckBitflagField(const void *flag, u8 flag_bitcount, u8 idx);
 
-static bool nacpAddStringFieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, const char *value);
-static bool nacpAddEnumFieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, u8 value, NacpStringFunction str_func);
-static bool nacpAddBitflagFieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, const void *flag, u8 flag_width, u8 max_flag_idx, NacpStringFunction str_func, bool allow_empty_str);
-static bool nacpAddU16FieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, u16 value, bool hex, bool prefix);
-static bool nacpAddU32FieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, u32 value, bool hex, bool prefix);
-static bool nacpAddU64FieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, u64 value, bool hex, bool prefix);
+static bool nacpAddStringFieldToAuthoringToolXml(UtilsStringBuilder *xml_sb, const char *tag_name, const char *value);
+static bool nacpAddEnumFieldToAuthoringToolXml(UtilsStringBuilder *xml_sb, const char *tag_name, u8 value, NacpStringFunction str_func);
+static bool nacpAddBitflagFieldToAuthoringToolXml(UtilsStringBuilder *xml_sb, const char *tag_name, const void *flag, u8 flag_width, u8 max_flag_idx, NacpStringFunction str_func, bool allow_empty_str);
+static bool nacpAddU16FieldToAuthoringToolXml(UtilsStringBuilder *xml_sb, const char *tag_name, u16 value, bool hex, bool prefix);
+static bool nacpAddU32FieldToAuthoringToolXml(UtilsStringBuilder *xml_sb, const char *tag_name, u32 value, bool hex, bool prefix);
+static bool nacpAddU64FieldToAuthoringToolXml(UtilsStringBuilder *xml_sb, const char *tag_name, u64 value, bool hex, bool prefix);
 
 bool nacpInitializeContext(NacpContext *out, NcaContext *nca_ctx)
 {
     if (!out || !nca_ctx || !*(nca_ctx->content_id_str) || nca_ctx->content_type != NcmContentType_Control || nca_ctx->content_size < NCA_FULL_HEADER_LENGTH || \
-        (nca_ctx->storage_id != NcmStorageId_GameCard && !nca_ctx->ncm_storage) || (nca_ctx->storage_id == NcmStorageId_GameCard && !nca_ctx->gamecard_offset) || \
+        !contentSourceIsValid(&(nca_ctx->source)) || \
         nca_ctx->header.content_type != NcaContentType_Control || nca_ctx->content_type_ctx || !out)
     {
         LOG_MSG_ERROR("Invalid parameters!");
@@ -453,8 +453,7 @@ bool nacpGenerateAuthoringToolXml(NacpContext *nacp_ctx, u32 version, u32 requir
     Version app_ver = { .value = version };
 
     u8 i = 0, count = 0;
-    char *xml_buf = NULL;
-    u64 xml_buf_size = 0;
+    UtilsStringBuilder xml_sb = {0};
 
     u8 icon_hash[SHA256_HASH_SIZE] = {0};
     char icon_hash_str[SHA256_HASH_SIZE + 1] = {0};
@@ -860,13 +859,13 @@ bool nacpGenerateAuthoringToolXml(NacpContext *nacp_ctx, u32 version, u32 requir
     if (!(success = NACP_ADD_FMT_STR_T1("</Application>"))) goto end;
 
     /* Update NACP context. */
-    nacp_ctx->authoring_tool_xml = xml_buf;
-    nacp_ctx->authoring_tool_xml_size = strlen(xml_buf);
+    nacp_ctx->authoring_tool_xml = xml_sb.str;
+    nacp_ctx->authoring_tool_xml_size = xml_sb.len;
 
 end:
     if (!success)
     {
-        if (xml_buf) free(xml_buf);
+        utilsStringBuilderFree(&xml_sb);
         LOG_MSG_ERROR("Failed to generate NACP AuthoringTool XML!");
     }
 
@@ -1019,9 +1018,9 @@ NX_INLINE bool nacpCheckBitflagField(const void *flag, u8 flag_bitcount, u8 idx)
     return (flag_u8[byte_idx] & bitmask);
 }
 
-static bool nacpAddStringFieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, const char *value)
+static bool nacpAddStringFieldToAuthoringToolXml(UtilsStringBuilder *xml_sb, const char *tag_name, const char *value)
 {
-    if (!xml_buf || !xml_buf_size || !tag_name || !*tag_name || !value)
+    if (!xml_sb || !tag_name || !*tag_name || !value)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
@@ -1030,9 +1029,9 @@ static bool nacpAddStringFieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_si
     return (*value ? NACP_ADD_FMT_STR_T2("  <%s>%s</%s>\n", tag_name, value, tag_name) : NACP_ADD_FMT_STR_T2("  <%s />\n", tag_name));
 }
 
-static bool nacpAddEnumFieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, u8 value, NacpStringFunction str_func)
+static bool nacpAddEnumFieldToAuthoringToolXml(UtilsStringBuilder *xml_sb, const char *tag_name, u8 value, NacpStringFunction str_func)
 {
-    if (!xml_buf || !xml_buf_size || !tag_name || !*tag_name || !str_func)
+    if (!xml_sb || !tag_name || !*tag_name || !str_func)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
@@ -1041,13 +1040,13 @@ static bool nacpAddEnumFieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size
     return NACP_ADD_FMT_STR_T2("  <%s>%s</%s>\n", tag_name, str_func(value), tag_name);
 }
 
-static bool nacpAddBitflagFieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, const void *flag, u8 flag_width, u8 max_flag_idx, NacpStringFunction str_func, bool allow_empty_str)
+static bool nacpAddBitflagFieldToAuthoringToolXml(UtilsStringBuilder *xml_sb, const char *tag_name, const void *flag, u8 flag_width, u8 max_flag_idx, NacpStringFunction str_func, bool allow_empty_str)
 {
     u8 flag_bitcount = 0, i = 0, count = 0;
     const u8 *flag_u8 = (const u8*)flag;
     bool success = false, empty_flag = true;
 
-    if (!xml_buf || !xml_buf_size || !tag_name || !*tag_name || !flag || !flag_width || (flag_width > 1 && !IS_POWER_OF_TWO(flag_width)) || flag_width > 0x10 || \
+    if (!xml_sb || !tag_name || !*tag_name || !flag || !flag_width || (flag_width > 1 && !IS_POWER_OF_TWO(flag_width)) || flag_width > 0x10 || \
         (flag_bitcount = (flag_width * 8)) < max_flag_idx || !str_func)
     {
         LOG_MSG_ERROR("Invalid parameters!");
@@ -1084,9 +1083,9 @@ end:
     return success;
 }
 
-static bool nacpAddU16FieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, u16 value, bool hex, bool prefix)
+static bool nacpAddU16FieldToAuthoringToolXml(UtilsStringBuilder *xml_sb, const char *tag_name, u16 value, bool hex, bool prefix)
 {
-    if (!xml_buf || !xml_buf_size || !tag_name || !*tag_name)
+    if (!xml_sb || !tag_name || !*tag_name)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
@@ -1097,9 +1096,9 @@ static bool nacpAddU16FieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size,
     return NACP_ADD_FMT_STR_T2(str, tag_name, value, tag_name);
 }
 
-static bool nacpAddU32FieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, u32 value, bool hex, bool prefix)
+static bool nacpAddU32FieldToAuthoringToolXml(UtilsStringBuilder *xml_sb, const char *tag_name, u32 value, bool hex, bool prefix)
 {
-    if (!xml_buf || !xml_buf_size || !tag_name || !*tag_name)
+    if (!xml_sb || !tag_name || !*tag_name)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
@@ -1110,9 +1109,9 @@ static bool nacpAddU32FieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size,
     return NACP_ADD_FMT_STR_T2(str, tag_name, value, tag_name);
 }
 
-static bool nacpAddU64FieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, u64 value, bool hex, bool prefix)
+static bool nacpAddU64FieldToAuthoringToolXml(UtilsStringBuilder *xml_sb, const char *tag_name, u64 value, bool hex, bool prefix)
 {
-    if (!xml_buf || !xml_buf_size || !tag_name || !*tag_name)
+    if (!xml_sb || !tag_name || !*tag_name)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
@@ -26,13 +26,52 @@
 #include "rsa.h"
 #include "gamecard.h"
 #include "title.h"
+#include "hash_batch.h"
 
 #define NCA_CRYPTO_BUFFER_SIZE  0x800000    /* 8 MiB. */
+#define NCA_CRYPTO_BUFFER_COUNT 4           /* Only the first buffer is allocated at startup. The rest are allocated on demand. */
+
+#define NCA_HEADER_CACHE_MAX_ENTRY_COUNT    128
+#define NCA_HEADER_CACHE_MAGIC              0x4E484332                  /* "NHC2". */
+#define NCA_HEADER_CACHE_PATH               DEVOPTAB_SDMC_DEVICE APP_BASE_PATH "nca_header_cache.bin"
+
+/* Type definitions. */
+
+/// Holds a raw NCA header (plus all of its NCA FS section headers) that has already been read.
+/// Decrypting the header is cheap, so only the encrypted data is kept. This also means no plaintext key area data ever gets written to the SD card.
+/// The cache file can be tampered with, so the main signature is always verified again after a cache hit.
+typedef struct {
+    NcmContentId content_id;
+    u64 content_size;
+    u64 last_used;                                  ///< Used to evict the least recently used entry. Not meaningful in the cache file.
+    u8 encrypted_header[NCA_FULL_HEADER_LENGTH];
+} NcaHeaderCacheEntry;
+
+/// Header for the NCA header cache file. Cache entries are stored right after it.
+typedef struct {
+    u32 magic;                                      ///< "NHC2".
+    u32 entry_count;
+    u8 entries_hash[SHA256_HASH_SIZE];              ///< SHA-256 checksum calculated over all cache entries.
+} NcaHeaderCacheFileHeader;
+
+/// Used by ncaReadFsSectionV() to read merged spans.
+typedef struct {
+    NcaFsSectionContext *ctx;
+    u8 *crypto_buf;
+} NcaFsSectionReadSpanArgs;
 
 /* Global variables. */
 
-static u8 *g_ncaCryptoBuffer = NULL;
+static u8 *g_ncaCryptoBuffers[NCA_CRYPTO_BUFFER_COUNT] = {0};
+static bool g_ncaCryptoBufferLeased[NCA_CRYPTO_BUFFER_COUNT] = {0};
 static Mutex g_ncaCryptoBufferMutex = 0;
+static CondVar g_ncaCryptoBufferCondVar = 0;
+
+static Mutex g_ncaHeaderCacheMutex = 0;
+static NcaHeaderCacheEntry *g_ncaHeaderCacheEntries = NULL;
+static u32 g_ncaHeaderCacheEntryCount = 0;
+static u64 g_ncaHeaderCacheTick = 0;
+static bool g_ncaHeaderCacheLoaded = false, g_ncaHeaderCacheDirty = false;
 
 /// Used to verify the NCA header main signature.
 static const u8 g_ncaHeaderMainSignaturePublicExponent[3] = { 0x01, 0x00, 0x01 };
@@ -129,7 +168,16 @@ static const u8 g_nca0KeyAreaHash[SHA256_HASH_SIZE] = {
 
 NX_INLINE bool ncaIsFsInfoEntryValid(NcaFsInfo *fs_info);
 
+static u8 *ncaLeaseCryptoBuffer(void);
+static void ncaReturnCryptoBuffer(u8 *buf);
+
+static bool _ncaInitializeContext(NcaContext *out, u8 storage_id, const ContentSource *source, const NcmContentMetaKey *meta_key, const NcmContentInfo *content_info, Ticket *tik);
+
 static bool ncaReadDecryptedHeader(NcaContext *ctx);
+
+static bool ncaGetCachedEncryptedHeader(NcaContext *ctx, u8 *out);
+static void ncaAddEncryptedHeaderToCache(NcaContext *ctx, const u8 *encrypted_header);
+static void ncaLoadHeaderCache(void);
 static bool ncaKeyAreaCrypt(NcaContext *ctx, bool encrypt);
 
 static bool ncaVerifyMainSignature(NcaContext *ctx);
@@ -141,16 +189,18 @@ NX_INLINE bool ncaCheckRightsIdAvailability(NcaContext *ctx);
 static bool ncaInitializeFsSectionContext(NcaContext *nca_ctx, u32 section_idx);
 static bool ncaFsSectionValidateHashDataBoundaries(NcaFsSectionContext *ctx);
 
-static bool _ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset);
+static bool _ncaReadFsSection(NcaFsSectionContext *ctx, u8 *crypto_buf, void *out, u64 read_size, u64 offset);
+static bool ncaReadFsSectionSpan(void *arg, void *out, u64 read_size, u64 offset);
+static int ncaReadRequestSortFunction(const void *a, const void *b);
 static bool ncaFsSectionCheckPlaintextHashRegionAccess(NcaFsSectionContext *ctx, u64 offset, u64 size, NcaRegion *out_region);
 
-static bool _ncaReadAesCtrExStorage(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u32 ctr_val, bool decrypt);
+static bool _ncaReadAesCtrExStorage(NcaFsSectionContext *ctx, u8 *crypto_buf, void *out, u64 read_size, u64 offset, u32 ctr_val, bool decrypt);
 
 static void ncaCalculateLayerHash(void *dst, const void *src, size_t size, bool use_sha3);
-static bool ncaGenerateHashDataPatch(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 data_offset, void *out, bool is_integrity_patch);
+static bool ncaGenerateHashDataPatch(NcaFsSectionContext *ctx, u8 *crypto_buf, const void *data, u64 data_size, u64 data_offset, void *out, bool is_integrity_patch);
 static bool ncaWritePatchToMemoryBuffer(NcaContext *ctx, const void *patch, u64 patch_size, u64 patch_offset, void *buf, u64 buf_size, u64 buf_offset);
 
-static void *ncaGenerateEncryptedFsSectionBlock(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 data_offset, u64 *out_block_size, u64 *out_block_offset);
+static void *ncaGenerateEncryptedFsSectionBlock(NcaFsSectionContext *ctx, u8 *crypto_buf, const void *data, u64 data_size, u64 data_offset, u64 *out_block_size, u64 *out_block_offset);
 
 bool ncaAllocateCryptoBuffer(void)
 {
@@ -158,8 +208,8 @@ bool ncaAllocateCryptoBuffer(void)
 
     SCOPED_LOCK(&g_ncaCryptoBufferMutex)
     {
-        if (!g_ncaCryptoBuffer) g_ncaCryptoBuffer = malloc(NCA_CRYPTO_BUFFER_SIZE);
-        ret = (g_ncaCryptoBuffer != NULL);
+        if (!g_ncaCryptoBuffers[0]) g_ncaCryptoBuffers[0] = malloc(NCA_CRYPTO_BUFFER_SIZE);
+        ret = (g_ncaCryptoBuffers[0] != NULL);
     }
 
     return ret;
@@ -169,16 +219,21 @@ void ncaFreeCryptoBuffer(void)
 {
     SCOPED_LOCK(&g_ncaCryptoBufferMutex)
     {
-        if (!g_ncaCryptoBuffer) break;
-        free(g_ncaCryptoBuffer);
-        g_ncaCryptoBuffer = NULL;
+        for(u32 i = 0; i < NCA_CRYPTO_BUFFER_COUNT; i++)
+        {
+            if (!g_ncaCryptoBuffers[i]) continue;
+            free(g_ncaCryptoBuffers[i]);
+            g_ncaCryptoBuffers[i] = NULL;
+            g_ncaCryptoBufferLeased[i] = false;
+        }
     }
 }
 
 bool ncaInitializeContext(NcaContext *out, u8 storage_id, u8 hfs_partition_type, const NcmContentMetaKey *meta_key, const NcmContentInfo *content_info, Ticket *tik)
 {
     NcmContentStorage *ncm_storage = NULL;
-    u8 valid_fs_section_cnt = 0;
+    ContentSource source = {0};
+    u64 content_size = 0;
 
     if (!out || (storage_id != NcmStorageId_GameCard && !(ncm_storage = titleGetNcmStorageByStorageId(storage_id))) || \
         (storage_id == NcmStorageId_GameCard && (hfs_partition_type < HashFileSystemPartitionType_Root || hfs_partition_type >= HashFileSystemPartitionType_Count)) || \
@@ -188,111 +243,86 @@ bool ncaInitializeContext(NcaContext *out, u8 storage_id, u8 hfs_partition_type,
         return false;
     }
 
-    /* Clear output NCA context. */
-    memset(out, 0, sizeof(NcaContext));
-
-    /* Fill NCA context. */
-    out->storage_id = storage_id;
-    out->ncm_storage = (out->storage_id != NcmStorageId_GameCard ? ncm_storage : NULL);
+    ncmContentInfoSizeToU64(content_info, &content_size);
 
-    out->title_id = meta_key->id;
-    out->title_version.value = meta_key->version;
-    out->title_type = meta_key->type;
-
-    memcpy(&(out->content_id), &(content_info->content_id), sizeof(NcmContentId));
-    utilsGenerateHexString(out->content_id_str, sizeof(out->content_id_str), out->content_id.c, sizeof(out->content_id.c), false);
-
-    utilsGenerateHexString(out->hash_str, sizeof(out->hash_str), out->hash, sizeof(out->hash), false);  /* Placeholder, needs to be manually calculated. */
-
-    out->content_type = content_info->content_type;
-    out->id_offset = content_info->id_offset;
-
-    ncmContentInfoSizeToU64(content_info, &(out->content_size));
-    utilsGenerateFormattedSizeString((double)out->content_size, out->content_size_str, sizeof(out->content_size_str));
-
-    if (out->content_size < NCA_FULL_HEADER_LENGTH)
-    {
-        LOG_MSG_ERROR("Invalid size for NCA \"%s\"!", out->content_id_str);
-        return false;
-    }
-
-    if (out->storage_id == NcmStorageId_GameCard)
+    if (storage_id == NcmStorageId_GameCard)
     {
         /* Generate gamecard NCA filename. */
-        char nca_filename[0x30] = {0};
-        sprintf(nca_filename, "%s.%s", out->content_id_str, out->content_type == NcmContentType_Meta ? "cnmt.nca" : "nca");
+        char content_id_str[0x21] = {0}, nca_filename[0x30] = {0};
+        u64 gamecard_offset = 0;
+
+        utilsGenerateHexString(content_id_str, sizeof(content_id_str), content_info->content_id.c, sizeof(content_info->content_id.c), false);
+        sprintf(nca_filename, "%s.%s", content_id_str, content_info->content_type == NcmContentType_Meta ? "cnmt.nca" : "nca");
 
         /* Retrieve gamecard NCA offset. */
-        if (!gamecardGetHashFileSystemEntryInfoByName(hfs_partition_type, nca_filename, &(out->gamecard_offset), NULL))
+        if (!gamecardGetHashFileSystemEntryInfoByName(hfs_partition_type, nca_filename, &gamecard_offset, NULL))
         {
             LOG_MSG_ERROR("Error retrieving offset for \"%s\" entry in secure hash FS partition!", nca_filename);
             return false;
         }
-    }
-
-    /* Read decrypted NCA header and NCA FS section headers. */
-    if (!ncaReadDecryptedHeader(out))
-    {
-        LOG_MSG_ERROR("Failed to read decrypted NCA \"%s\" header!", out->content_id_str);
-        return false;
-    }
-
-    if (out->rights_id_available)
-    {
-        Ticket tmp_tik = {0};
-        Ticket *usable_tik = (tik ? tik : &tmp_tik);
 
-        /* Retrieve ticket. */
-        /* This will return true if it has already been retrieved. */
-        if (tikRetrieveTicketByRightsId(usable_tik, &(out->header.rights_id), out->key_generation, out->storage_id == NcmStorageId_GameCard))
+        if (!contentSourceInitializeGameCard(&source, gamecard_offset, content_size))
         {
-            /* Copy decrypted titlekey. */
-            memcpy(out->titlekey, usable_tik->dec_titlekey, sizeof(usable_tik->dec_titlekey));
-            out->titlekey_retrieved = true;
-        } else {
-            /* We must proceed even if we have no ticket. The user may just want to copy a raw NCA. */
-            LOG_MSG_ERROR("Error retrieving ticket for NCA \"%s\"!", out->content_id_str);
+            LOG_MSG_ERROR("Failed to initialize gamecard content source for NCA \"%s\"!", content_id_str);
+            return false;
+        }
+    } else {
+        if (!contentSourceInitializeNcm(&source, ncm_storage, &(content_info->content_id), content_size))
+        {
+            LOG_MSG_ERROR("Failed to initialize ncm content source!");
+            return false;
         }
     }
 
-    /* Parse NCA FS sections. */
-    for(u8 i = 0; i < NCA_FS_HEADER_COUNT; i++)
+    return _ncaInitializeContext(out, storage_id, &source, meta_key, content_info, tik);
+}
+
+bool ncaInitializeContextFromContentSource(NcaContext *out, const ContentSource *source, const NcmContentMetaKey *meta_key, const NcmContentInfo *content_info, Ticket *tik)
+{
+    u64 content_size = 0;
+
+    if (!out || !contentSourceIsValid(source) || !meta_key || !content_info || content_info->content_type >= NcmContentType_DeltaFragment)
     {
-        /* Increase valid NCA FS section count if the FS section is valid. */
-        if (ncaInitializeFsSectionContext(out, i)) valid_fs_section_cnt++;
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
     }
 
-    if (!valid_fs_section_cnt) LOG_MSG_ERROR("Unable to identify any valid FS sections in NCA \"%s\"!", out->content_id_str);
+    /* Make sure the content source size matches the provided content info. */
+    ncmContentInfoSizeToU64(content_info, &content_size);
+    if (content_size != source->size)
+    {
+        LOG_MSG_ERROR("Content size mismatch! (0x%lX != 0x%lX).", content_size, source->size);
+        return false;
+    }
 
-    return (valid_fs_section_cnt > 0);
+    return _ncaInitializeContext(out, NcmStorageId_None, source, meta_key, content_info, tik);
 }
 
 bool ncaReadContentFile(NcaContext *ctx, void *out, u64 read_size, u64 offset)
 {
-    if (!ctx || !*(ctx->content_id_str) || (ctx->storage_id != NcmStorageId_GameCard && !ctx->ncm_storage) || (ctx->storage_id == NcmStorageId_GameCard && !ctx->gamecard_offset) || !out || \
-        !read_size || (offset + read_size) > ctx->content_size)
+    if (!ctx || !*(ctx->content_id_str) || !contentSourceIsValid(&(ctx->source)) || !out || !read_size || (offset + read_size) > ctx->content_size)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
     }
 
-    Result rc = 0;
-    bool ret = false;
+    bool ret = contentSourceRead(&(ctx->source), out, read_size, offset);
+    if (!ret) LOG_MSG_ERROR("Failed to read 0x%lX bytes block at offset 0x%lX from NCA \"%s\"! (%s).", read_size, offset, ctx->content_id_str, contentSourceGetName(&(ctx->source)));
+
+    return ret;
+}
 
-    if (ctx->storage_id != NcmStorageId_GameCard)
+bool ncaReadContentFileAsync(NcaContext *ctx, void *out, u64 read_size, u64 offset, ContentSourceReadCallback callback, void *callback_arg)
+{
+    if (!ctx || !*(ctx->content_id_str) || !contentSourceIsValid(&(ctx->source)) || !out || !read_size || (offset + read_size) > ctx->content_size || !callback)
     {
-        /* Retrieve NCA data normally. */
-        /* This strips NAX0 crypto from SD card NCAs (not used on eMMC NCAs). */
-        rc = ncmContentStorageReadContentIdFile(ctx->ncm_storage, out, read_size, &(ctx->content_id), offset);
-        ret = R_SUCCEEDED(rc);
-        if (!ret) LOG_MSG_ERROR("Failed to read 0x%lX bytes block at offset 0x%lX from NCA \"%s\"! (ncm) (0x%X).", read_size, offset, ctx->content_id_str, rc);
-    } else {
-        /* Retrieve NCA data using raw gamecard reads. */
-        /* Fixes NCA read issues with gamecards under HOS < 4.0.0 when using ncmContentStorageReadContentIdFile(). */
-        ret = gamecardReadStorage(out, read_size, ctx->gamecard_offset + offset);
-        if (!ret) LOG_MSG_ERROR("Failed to read 0x%lX bytes block at offset 0x%lX from NCA \"%s\"! (gamecard).", read_size, offset, ctx->content_id_str);
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
     }
 
+    bool ret = contentSourceReadAsync(&(ctx->source), out, read_size, offset, callback, callback_arg);
+    if (!ret) LOG_MSG_ERROR("Failed to submit 0x%lX bytes block read at offset 0x%lX from NCA \"%s\"! (%s).", read_size, offset, ctx->content_id_str, contentSourceGetName(&(ctx->source)));
+
     return ret;
 }
 
@@ -339,22 +369,174 @@ bool ncaGetFsSectionHashTargetExtents(NcaFsSectionContext *ctx, u64 *out_offset,
 
 bool ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset)
 {
+    if (!ctx)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    bool ret = false;
+
+    SCOPED_LOCK(&(ctx->crypto_mutex))
+    {
+        u8 *crypto_buf = ncaLeaseCryptoBuffer();
+        ret = _ncaReadFsSection(ctx, crypto_buf, out, read_size, offset);
+        ncaReturnCryptoBuffer(crypto_buf);
+    }
+
+    return ret;
+}
+
+bool ncaReadFsSectionV(NcaFsSectionContext *ctx, const NcaReadRequest *requests, u32 request_count)
+{
+    if (!ctx || !requests || !request_count)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
     bool ret = false;
-    SCOPED_LOCK(&g_ncaCryptoBufferMutex) ret = _ncaReadFsSection(ctx, out, read_size, offset);
+
+    SCOPED_LOCK(&(ctx->crypto_mutex))
+    {
+        /* Lease a single crypto buffer for all merged spans. */
+        NcaFsSectionReadSpanArgs args = { .ctx = ctx, .crypto_buf = ncaLeaseCryptoBuffer() };
+        ret = ncaProcessReadRequests(requests, request_count, ncaReadFsSectionSpan, &args);
+        ncaReturnCryptoBuffer(args.crypto_buf);
+    }
+
     return ret;
 }
 
+bool ncaProcessReadRequests(const NcaReadRequest *requests, u32 request_count, NcaReadSpanFunction read_func, void *read_arg)
+{
+    if (!requests || !request_count || !read_func)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    NcaReadRequest *sorted = NULL;
+    u8 *span_buf = NULL;
+    u64 span_buf_size = 0;
+    bool success = false;
+
+    for(u32 i = 0; i < request_count; i++)
+    {
+        if (!requests[i].out || !requests[i].size)
+        {
+            LOG_MSG_ERROR("Invalid read request #%u!", i);
+            return false;
+        }
+    }
+
+    /* Fast path: nothing to merge. */
+    if (request_count == 1) return read_func(read_arg, requests[0].out, requests[0].size, requests[0].offset);
+
+    /* Sort a copy of the read requests by offset. */
+    sorted = calloc(request_count, sizeof(NcaReadRequest));
+    if (!sorted)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for sorted read requests!");
+        return false;
+    }
+
+    memcpy(sorted, requests, request_count * sizeof(NcaReadRequest));
+    qsort(sorted, request_count, sizeof(NcaReadRequest), ncaReadRequestSortFunction);
+
+    for(u32 i = 0; i < request_count;)
+    {
+        u64 span_start = sorted[i].offset, span_end = (sorted[i].offset + sorted[i].size);
+        u32 j = (i + 1);
+
+        /* Merge overlapping and nearby requests, as long as the span doesn't get too big. */
+        for(; j < request_count; j++)
+        {
+            u64 req_end = (sorted[j].offset + sorted[j].size);
+            u64 new_span_end = MAX(span_end, req_end);
+
+            if (sorted[j].offset > (span_end + NCA_READ_V_MAX_GAP_SIZE) || (new_span_end - span_start) > NCA_READ_V_MAX_SPAN_SIZE) break;
+
+            span_end = new_span_end;
+        }
+
+        if (j == (i + 1))
+        {
+            /* Single request. Read it straight into its output buffer. */
+            if (!read_func(read_arg, sorted[i].out, sorted[i].size, sorted[i].offset)) goto end;
+        } else {
+            u64 span_size = (span_end - span_start);
+
+            /* Reallocate span buffer (if needed). */
+            if (span_size > span_buf_size)
+            {
+                u8 *tmp_span_buf = realloc(span_buf, span_size);
+                if (!tmp_span_buf)
+                {
+                    LOG_MSG_ERROR("Failed to allocate 0x%lX bytes for span buffer!", span_size);
+                    goto end;
+                }
+
+                span_buf = tmp_span_buf;
+                span_buf_size = span_size;
+            }
+
+            /* Read the whole span at once, then scatter its data. */
+            if (!read_func(read_arg, span_buf, span_size, span_start)) goto end;
+
+            for(u32 k = i; k < j; k++) memcpy(sorted[k].out, span_buf + (sorted[k].offset - span_start), sorted[k].size);
+        }
+
+        i = j;
+    }
+
+    success = true;
+
+end:
+    if (span_buf) free(span_buf);
+
+    free(sorted);
+
+    return success;
+}
+
 bool ncaReadAesCtrExStorage(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u32 ctr_val, bool decrypt)
 {
+    if (!ctx)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
     bool ret = false;
-    SCOPED_LOCK(&g_ncaCryptoBufferMutex) ret = _ncaReadAesCtrExStorage(ctx, out, read_size, offset, ctr_val, decrypt);
+
+    SCOPED_LOCK(&(ctx->crypto_mutex))
+    {
+        u8 *crypto_buf = ncaLeaseCryptoBuffer();
+        ret = _ncaReadAesCtrExStorage(ctx, crypto_buf, out, read_size, offset, ctr_val, decrypt);
+        ncaReturnCryptoBuffer(crypto_buf);
+    }
+
     return ret;
 }
 
 bool ncaGenerateHierarchicalSha256Patch(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 data_offset, NcaHierarchicalSha256Patch *out)
 {
+    if (!ctx)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
     bool ret = false;
-    SCOPED_LOCK(&g_ncaCryptoBufferMutex) ret = ncaGenerateHashDataPatch(ctx, data, data_size, data_offset, out, false);
+
+    SCOPED_LOCK(&(ctx->crypto_mutex))
+    {
+        u8 *crypto_buf = ncaLeaseCryptoBuffer();
+        ret = ncaGenerateHashDataPatch(ctx, crypto_buf, data, data_size, data_offset, out, false);
+        ncaReturnCryptoBuffer(crypto_buf);
+    }
+
     return ret;
 }
 
@@ -378,8 +560,21 @@ void ncaWriteHierarchicalSha256PatchToMemoryBuffer(NcaContext *ctx, NcaHierarchi
 
 bool ncaGenerateHierarchicalIntegrityPatch(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 data_offset, NcaHierarchicalIntegrityPatch *out)
 {
+    if (!ctx)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
     bool ret = false;
-    SCOPED_LOCK(&g_ncaCryptoBufferMutex) ret = ncaGenerateHashDataPatch(ctx, data, data_size, data_offset, out, true);
+
+    SCOPED_LOCK(&(ctx->crypto_mutex))
+    {
+        u8 *crypto_buf = ncaLeaseCryptoBuffer();
+        ret = ncaGenerateHashDataPatch(ctx, crypto_buf, data, data_size, data_offset, out, true);
+        ncaReturnCryptoBuffer(crypto_buf);
+    }
+
     return ret;
 }
 
@@ -574,6 +769,67 @@ const char *ncaGetFsSectionTypeName(NcaFsSectionContext *ctx)
     return str;
 }
 
+static u8 *ncaLeaseCryptoBuffer(void)
+{
+    u8 *buf = NULL;
+
+    SCOPED_LOCK(&g_ncaCryptoBufferMutex)
+    {
+        /* Don't proceed if the crypto buffer pool hasn't been initialized. */
+        if (!g_ncaCryptoBuffers[0]) break;
+
+        while(!buf)
+        {
+            /* Look for an allocated buffer that isn't currently leased. */
+            for(u32 i = 0; i < NCA_CRYPTO_BUFFER_COUNT; i++)
+            {
+                if (!g_ncaCryptoBuffers[i] || g_ncaCryptoBufferLeased[i]) continue;
+                g_ncaCryptoBufferLeased[i] = true;
+                buf = g_ncaCryptoBuffers[i];
+                break;
+            }
+
+            if (buf) break;
+
+            /* Allocate an additional buffer if we still have room for it. */
+            for(u32 i = 1; i < NCA_CRYPTO_BUFFER_COUNT; i++)
+            {
+                if (g_ncaCryptoBuffers[i]) continue;
+
+                g_ncaCryptoBuffers[i] = malloc(NCA_CRYPTO_BUFFER_SIZE);
+                if (g_ncaCryptoBuffers[i])
+                {
+                    g_ncaCryptoBufferLeased[i] = true;
+                    buf = g_ncaCryptoBuffers[i];
+                }
+
+                break;
+            }
+
+            /* Wait until another thread returns its buffer. */
+            if (!buf) condvarWait(&g_ncaCryptoBufferCondVar, &g_ncaCryptoBufferMutex);
+        }
+    }
+
+    return buf;
+}
+
+static void ncaReturnCryptoBuffer(u8 *buf)
+{
+    if (!buf) return;
+
+    SCOPED_LOCK(&g_ncaCryptoBufferMutex)
+    {
+        for(u32 i = 0; i < NCA_CRYPTO_BUFFER_COUNT; i++)
+        {
+            if (g_ncaCryptoBuffers[i] != buf) continue;
+            g_ncaCryptoBufferLeased[i] = false;
+            condvarWakeOne(&g_ncaCryptoBufferCondVar);
+            break;
+        }
+    }
+}
+
 NX_INLINE bool ncaIsFsInfoEntryValid(NcaFsInfo *fs_info)
 {
     if (!fs_info) return false;
@@ -581,6 +837,85 @@ NX_INLINE bool ncaIsFsInfoEntryValid(NcaFsInfo *fs_info)
     return (memcmp(&tmp_fs_info, fs_info, sizeof(NcaFsInfo)) != 0);
 }
 
+static bool _ncaInitializeContext(NcaContext *out, u8 storage_id, const ContentSource *source, const NcmContentMetaKey *meta_key, const NcmContentInfo *content_info, Ticket *tik)
+{
+    u8 valid_fs_section_cnt = 0;
+
+    /* Clear output NCA context. */
+    memset(out, 0, sizeof(NcaContext));
+
+    /* Fill NCA context. */
+    out->storage_id = storage_id;
+    memcpy(&(out->source), source, sizeof(ContentSource));
+
+    /* Kept for compatibility purposes. */
+    if (out->source.type == ContentSourceType_Ncm)
+    {
+        out->ncm_storage = out->source.ncm.storage;
+    } else
+    if (out->source.type == ContentSourceType_GameCard)
+    {
+        out->gamecard_offset = out->source.gamecard.offset;
+    }
+
+    out->title_id = meta_key->id;
+    out->title_version.value = meta_key->version;
+    out->title_type = meta_key->type;
+
+    memcpy(&(out->content_id), &(content_info->content_id), sizeof(NcmContentId));
+    utilsGenerateHexString(out->content_id_str, sizeof(out->content_id_str), out->content_id.c, sizeof(out->content_id.c), false);
+
+    utilsGenerateHexString(out->hash_str, sizeof(out->hash_str), out->hash, sizeof(out->hash), false);  /* Placeholder, needs to be manually calculated. */
+
+    out->content_type = content_info->content_type;
+    out->id_offset = content_info->id_offset;
+
+    ncmContentInfoSizeToU64(content_info, &(out->content_size));
+    utilsGenerateFormattedSizeString((double)out->content_size, out->content_size_str, sizeof(out->content_size_str));
+
+    if (out->content_size < NCA_FULL_HEADER_LENGTH)
+    {
+        LOG_MSG_ERROR("Invalid size for NCA \"%s\"!", out->content_id_str);
+        return false;
+    }
+
+    /* Read decrypted NCA header and NCA FS section headers. */
+    if (!ncaReadDecryptedHeader(out))
+    {
+        LOG_MSG_ERROR("Failed to read decrypted NCA \"%s\" header!", out->content_id_str);
+        return false;
+    }
+
+    if (out->rights_id_available)
+    {
+        Ticket tmp_tik = {0};
+        Ticket *usable_tik = (tik ? tik : &tmp_tik);
+
+        /* Retrieve ticket. */
+        /* This will return true if it has already been retrieved. */
+        if (tikRetrieveTicketByRightsId(usable_tik, &(out->header.rights_id), out->key_generation, out->storage_id == NcmStorageId_GameCard))
+        {
+            /* Copy decrypted titlekey. */
+            memcpy(out->titlekey, usable_tik->dec_titlekey, sizeof(usable_tik->dec_titlekey));
+            out->titlekey_retrieved = true;
+        } else {
+            /* We must proceed even if we have no ticket. The user may just want to copy a raw NCA. */
+            LOG_MSG_ERROR("Error retrieving ticket for NCA \"%s\"!", out->content_id_str);
+        }
+    }
+
+    /* Parse NCA FS sections. */
+    for(u8 i = 0; i < NCA_FS_HEADER_COUNT; i++)
+    {
+        /* Increase valid NCA FS section count if the FS section is valid. */
+        if (ncaInitializeFsSectionContext(out, i)) valid_fs_section_cnt++;
+    }
+
+    if (!valid_fs_section_cnt) LOG_MSG_ERROR("Unable to identify any valid FS sections in NCA \"%s\"!", out->content_id_str);
+
+    return (valid_fs_section_cnt > 0);
+}
+
 static bool ncaReadDecryptedHeader(NcaContext *ctx)
 {
     if (!ctx || !*(ctx->content_id_str) || ctx->content_size < NCA_FULL_HEADER_LENGTH)
@@ -594,19 +929,29 @@ static bool ncaReadDecryptedHeader(NcaContext *ctx)
     const u8 *header_key = keysGetNcaHeaderKey();
     Aes128XtsContext hdr_aes_ctx = {0}, nca0_fs_header_ctx = {0};
 
+    u8 raw_header[NCA_FULL_HEADER_LENGTH] = {0};
+    bool use_cache = false, cached = false;
+
     if (!header_key)
     {
         LOG_MSG_ERROR("Failed to retrieve NCA header key!");
         return false;
     }
 
-    /* Read NCA header. */
-    if (!ncaReadContentFile(ctx, &(ctx->encrypted_header), sizeof(NcaHeader), 0))
+    /* The header cache is keyed by content ID and size, which can't be trusted for local files (e.g. a tampered or corrupted dump with a genuine content ID). */
+    /* Headers from local files are always read from storage, and never added to the cache. */
+    use_cache = (ctx->source.type != ContentSourceType_File);
+
+    /* Check if we have already read this NCA header. If not, read the NCA header and all NCA2/NCA3 FS section headers in a single step. */
+    cached = (use_cache && ncaGetCachedEncryptedHeader(ctx, raw_header));
+    if (!cached && !ncaReadContentFile(ctx, raw_header, sizeof(raw_header), 0))
     {
         LOG_MSG_ERROR("Failed to read NCA \"%s\" header!", ctx->content_id_str);
         return false;
     }
 
+    memcpy(&(ctx->encrypted_header), raw_header, sizeof(NcaHeader));
+
     /* Prepare NCA header AES-128-XTS context. */
     aes128XtsContextCreate(&hdr_aes_ctx, header_key, header_key + AES_128_KEY_SIZE, false);
 
@@ -647,9 +992,12 @@ static bool ncaReadDecryptedHeader(NcaContext *ctx)
         /* Don't proceed if this NCA FS section isn't populated. */
         if (!ncaIsFsInfoEntryValid(fs_info)) continue;
 
-        /* Read NCA FS section header. */
+        /* Read NCA FS section header. NCA2/NCA3 FS section headers have already been read alongside the NCA header. */
         u64 fs_header_offset = (ctx->format_version != NcaVersion_Nca0 ? (sizeof(NcaHeader) + (i * sizeof(NcaFsHeader))) : NCA_FS_SECTOR_OFFSET(fs_info->start_sector));
-        if (!ncaReadContentFile(ctx, &(fs_ctx->encrypted_header), sizeof(NcaFsHeader), fs_header_offset))
+        if (ctx->format_version != NcaVersion_Nca0)
+        {
+            memcpy(&(fs_ctx->encrypted_header), raw_header + fs_header_offset, sizeof(NcaFsHeader));
+        } else if (!ncaReadContentFile(ctx, &(fs_ctx->encrypted_header), sizeof(NcaFsHeader), fs_header_offset))
         {
             LOG_MSG_ERROR("Failed to read NCA%u \"%s\" FS section header #%u at offset 0x%lX!", ctx->format_version, ctx->content_id_str, i, fs_header_offset);
             return false;
@@ -670,9 +1018,169 @@ static bool ncaReadDecryptedHeader(NcaContext *ctx)
         }
     }
 
+    /* Add this NCA header to the cache. NCA0 FS section headers aren't stored right after the NCA header, so we won't bother with them. */
+    if (use_cache && !cached && ctx->format_version != NcaVersion_Nca0) ncaAddEncryptedHeaderToCache(ctx, raw_header);
+
     return true;
 }
 
+static bool ncaGetCachedEncryptedHeader(NcaContext *ctx, u8 *out)
+{
+    bool found = false;
+
+    SCOPED_LOCK(&g_ncaHeaderCacheMutex)
+    {
+        /* Load cache file on first use. */
+        if (!g_ncaHeaderCacheLoaded) ncaLoadHeaderCache();
+
+        for(u32 i = 0; i < g_ncaHeaderCacheEntryCount; i++)
+        {
+            NcaHeaderCacheEntry *cache_entry = &(g_ncaHeaderCacheEntries[i]);
+            if (cache_entry->content_size != ctx->content_size || memcmp(&(cache_entry->content_id), &(ctx->content_id), sizeof(NcmContentId)) != 0) continue;
+
+            memcpy(out, cache_entry->encrypted_header, sizeof(cache_entry->encrypted_header));
+            cache_entry->last_used = ++g_ncaHeaderCacheTick;
+
+            found = true;
+            break;
+        }
+    }
+
+    return found;
+}
+
+static void ncaAddEncryptedHeaderToCache(NcaContext *ctx, const u8 *encrypted_header)
+{
+    SCOPED_LOCK(&g_ncaHeaderCacheMutex)
+    {
+        NcaHeaderCacheEntry *cache_entry = NULL;
+
+        if (!g_ncaHeaderCacheLoaded) ncaLoadHeaderCache();
+
+        /* Allocate memory for the cache entries, if needed. */
+        if (!g_ncaHeaderCacheEntries)
+        {
+            g_ncaHeaderCacheEntries = calloc(NCA_HEADER_CACHE_MAX_ENTRY_COUNT, sizeof(NcaHeaderCacheEntry));
+            if (!g_ncaHeaderCacheEntries) break;
+        }
+
+        /* Use a new entry if possible. Otherwise, evict the least recently used one. */
+        if (g_ncaHeaderCacheEntryCount < NCA_HEADER_CACHE_MAX_ENTRY_COUNT)
+        {
+            cache_entry = &(g_ncaHeaderCacheEntries[g_ncaHeaderCacheEntryCount++]);
+        } else {
+            cache_entry = &(g_ncaHeaderCacheEntries[0]);
+
+            for(u32 i = 1; i < g_ncaHeaderCacheEntryCount; i++)
+            {
+                if (g_ncaHeaderCacheEntries[i].last_used < cache_entry->last_used) cache_entry = &(g_ncaHeaderCacheEntries[i]);
+            }
+        }
+
+        memset(cache_entry, 0, sizeof(NcaHeaderCacheEntry));
+        memcpy(&(cache_entry->content_id), &(ctx->content_id), sizeof(NcmContentId));
+        cache_entry->content_size = ctx->content_size;
+        cache_entry->last_used = ++g_ncaHeaderCacheTick;
+        memcpy(cache_entry->encrypted_header, encrypted_header, sizeof(cache_entry->encrypted_header));
+
+        g_ncaHeaderCacheDirty = true;
+    }
+}
+
+/* Must be called with the cache mutex held. */
+static void ncaLoadHeaderCache(void)
+{
+    FILE *cache_file = NULL;
+    NcaHeaderCacheFileHeader file_header = {0};
+    u8 entries_hash[SHA256_HASH_SIZE] = {0};
+    size_t entries_size = 0;
+
+    /* Only try once per session. A missing or invalid cache file just means we'll start with an empty cache. */
+    g_ncaHeaderCacheLoaded = true;
+
+    cache_file = fopen(NCA_HEADER_CACHE_PATH, "rb");
+    if (!cache_file) return;
+
+    if (fread(&file_header, 1, sizeof(NcaHeaderCacheFileHeader), cache_file) != sizeof(NcaHeaderCacheFileHeader) || __builtin_bswap32(file_header.magic) != NCA_HEADER_CACHE_MAGIC || \
+        !file_header.entry_count || file_header.entry_count > NCA_HEADER_CACHE_MAX_ENTRY_COUNT)
+    {
+        LOG_MSG_DEBUG("Invalid NCA header cache file header. Ignoring it.");
+        goto end;
+    }
+
+    g_ncaHeaderCacheEntries = calloc(NCA_HEADER_CACHE_MAX_ENTRY_COUNT, sizeof(NcaHeaderCacheEntry));
+    if (!g_ncaHeaderCacheEntries)
+    {
+        LOG_MSG_ERROR("Unable to allocate memory for the NCA header cache!");
+        goto end;
+    }
+
+    /* Read cache entries and validate them. */
+    entries_size = (file_header.entry_count * sizeof(NcaHeaderCacheEntry));
+    if (fread(g_ncaHeaderCacheEntries, 1, entries_size, cache_file) != entries_size) goto end;
+
+    sha256CalculateHash(entries_hash, g_ncaHeaderCacheEntries, entries_size);
+    if (memcmp(entries_hash, file_header.entries_hash, SHA256_HASH_SIZE) != 0)
+    {
+        LOG_MSG_DEBUG("NCA header cache file checksum mismatch. Ignoring it.");
+        memset(g_ncaHeaderCacheEntries, 0, entries_size);
+        goto end;
+    }
+
+    for(u32 i = 0; i < file_header.entry_count; i++) g_ncaHeaderCacheEntries[i].last_used = 0;
+
+    g_ncaHeaderCacheEntryCount = file_header.entry_count;
+
+    LOG_MSG_DEBUG("Loaded %u entries from the NCA header cache file.", g_ncaHeaderCacheEntryCount);
+
+end:
+    fclose(cache_file);
+}
+
+void ncaCloseHeaderCache(void)
+{
+    SCOPED_LOCK(&g_ncaHeaderCacheMutex)
+    {
+        /* Write cache file if needed. */
+        if (g_ncaHeaderCacheDirty && g_ncaHeaderCacheEntries && g_ncaHeaderCacheEntryCount)
+        {
+            NcaHeaderCacheFileHeader file_header = {0};
+            size_t entries_size = (g_ncaHeaderCacheEntryCount * sizeof(NcaHeaderCacheEntry));
+            FILE *cache_file = NULL;
+
+            file_header.magic = __builtin_bswap32(NCA_HEADER_CACHE_MAGIC);
+            file_header.entry_count = g_ncaHeaderCacheEntryCount;
+            sha256CalculateHash(file_header.entries_hash, g_ncaHeaderCacheEntries, entries_size);
+
+            utilsCreateDirectoryTree(NCA_HEADER_CACHE_PATH, false);
+
+            cache_file = fopen(NCA_HEADER_CACHE_PATH, "wb");
+            if (cache_file)
+            {
+                if (fwrite(&file_header, 1, sizeof(NcaHeaderCacheFileHeader), cache_file) != sizeof(NcaHeaderCacheFileHeader) || \
+                    fwrite(g_ncaHeaderCacheEntries, 1, entries_size, cache_file) != entries_size) LOG_MSG_ERROR("Failed to write NCA header cache file!");
+
+                fclose(cache_file);
+
+                /* Commit SD card filesystem changes. */
+                utilsCommitSdCardFileSystemChanges();
+            } else {
+                LOG_MSG_ERROR("Failed to open \"%s\" for writing!", NCA_HEADER_CACHE_PATH);
+            }
+        }
+
+        if (g_ncaHeaderCacheEntries)
+        {
+            free(g_ncaHeaderCacheEntries);
+            g_ncaHeaderCacheEntries = NULL;
+        }
+
+        g_ncaHeaderCacheEntryCount = 0;
+        g_ncaHeaderCacheTick = 0;
+        g_ncaHeaderCacheLoaded = g_ncaHeaderCacheDirty = false;
+    }
+}
+
 static bool ncaKeyAreaCrypt(NcaContext *ctx, bool encrypt)
 {
     if (!ctx)
@@ -1135,9 +1643,9 @@ static bool ncaFsSectionValidateHashDataBoundaries(NcaFsSectionContext *ctx)
     return success;
 }
 
-static bool _ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset)
+static bool _ncaReadFsSection(NcaFsSectionContext *ctx, u8 *crypto_buf, void *out, u64 read_size, u64 offset)
 {
-    if (!g_ncaCryptoBuffer || !ctx || !ctx->enabled || !ctx->nca_ctx || ctx->section_idx >= NCA_FS_HEADER_COUNT || ctx->section_offset < sizeof(NcaHeader) || \
+    if (!crypto_buf || !ctx || !ctx->enabled || !ctx->nca_ctx || ctx->section_idx >= NCA_FS_HEADER_COUNT || ctx->section_offset < sizeof(NcaHeader) || \
         ctx->section_type >= NcaFsSectionType_Invalid || ctx->encryption_type == NcaEncryptionType_Auto || ctx->encryption_type >= NcaEncryptionType_Count || \
         !out || !read_size || (offset + read_size) > ctx->section_size)
     {
@@ -1161,8 +1669,7 @@ static bool _ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size
 
     bool ret = false;
 
-    if (!*(nca_ctx->content_id_str) || (nca_ctx->storage_id != NcmStorageId_GameCard && !nca_ctx->ncm_storage) || \
-        (nca_ctx->storage_id == NcmStorageId_GameCard && !nca_ctx->gamecard_offset) || \
+    if (!*(nca_ctx->content_id_str) || !contentSourceIsValid(&(nca_ctx->source)) || \
         (nca_ctx->format_version != NcaVersion_Nca0 && nca_ctx->format_version != NcaVersion_Nca2 && nca_ctx->format_version != NcaVersion_Nca3) || \
         (content_offset + read_size) > nca_ctx->content_size)
     {
@@ -1179,7 +1686,7 @@ static bool _ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size
         /* It may be plaintext or not depending on the returned hash region properties. */
         block_size = (plaintext_first ? plaintext_area.size : (plaintext_area.offset - offset));
 
-        if ((plaintext_first && !ncaReadContentFile(nca_ctx, out, block_size, content_offset)) || (!plaintext_first && !_ncaReadFsSection(ctx, out, block_size, offset)))
+        if ((plaintext_first && !ncaReadContentFile(nca_ctx, out, block_size, content_offset)) || (!plaintext_first && !_ncaReadFsSection(ctx, crypto_buf, out, block_size, offset)))
         {
             LOG_MSG_ERROR("Failed to read 0x%lX bytes data block at offset 0x%lX from NCA \"%s\" FS section #%u! (plaintext hash region) (#1).", block_size, content_offset, \
                           nca_ctx->content_id_str, ctx->section_idx);
@@ -1194,7 +1701,7 @@ static bool _ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size
 
         /* Read second chunk. */
         /* It may be plaintext or not depending on the returned hash region properties. */
-        if (read_size && ((plaintext_first && !_ncaReadFsSection(ctx, (u8*)out + block_size, read_size, offset)) || \
+        if (read_size && ((plaintext_first && !_ncaReadFsSection(ctx, crypto_buf, (u8*)out + block_size, read_size, offset)) || \
             (!plaintext_first && !ncaReadContentFile(nca_ctx, (u8*)out + block_size, read_size, content_offset))))
         {
             LOG_MSG_ERROR("Failed to read 0x%lX bytes data block at offset 0x%lX from NCA \"%s\" FS section #%u! (plaintext hash region) (#2).", read_size, content_offset, \
@@ -1260,7 +1767,7 @@ static bool _ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size
     out_chunk_size = (block_size > NCA_CRYPTO_BUFFER_SIZE ? (NCA_CRYPTO_BUFFER_SIZE - data_start_offset) : read_size);
 
     /* Read data. */
-    if (!ncaReadContentFile(nca_ctx, g_ncaCryptoBuffer, chunk_size, block_start_offset))
+    if (!ncaReadContentFile(nca_ctx, crypto_buf, chunk_size, block_start_offset))
     {
         LOG_MSG_ERROR("Failed to read 0x%lX bytes encrypted data block at offset 0x%lX from NCA \"%s\" FS section #%u! (unaligned).", chunk_size, block_start_offset, nca_ctx->content_id_str, \
                       ctx->section_idx);
@@ -1272,7 +1779,7 @@ static bool _ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size
     {
         sector_num = ((nca_ctx->format_version != NcaVersion_Nca0 ? offset : (content_offset - sizeof(NcaHeader))) / NCA_AES_XTS_SECTOR_SIZE);
 
-        crypt_res = aes128XtsNintendoCrypt(&(ctx->xts_decrypt_ctx), g_ncaCryptoBuffer, g_ncaCryptoBuffer, chunk_size, sector_num, NCA_AES_XTS_SECTOR_SIZE, false);
+        crypt_res = aes128XtsNintendoCrypt(&(ctx->xts_decrypt_ctx), crypto_buf, crypto_buf, chunk_size, sector_num, NCA_AES_XTS_SECTOR_SIZE, false);
         if (crypt_res != chunk_size)
         {
             LOG_MSG_ERROR("Failed to AES-XTS decrypt 0x%lX bytes data block at offset 0x%lX from NCA \"%s\" FS section #%u! (unaligned).", chunk_size, block_start_offset, nca_ctx->content_id_str, \
@@ -1284,15 +1791,15 @@ static bool _ncaReadFsSection(NcaFsSectionContext *ctx, void *out, u64 read_size
     {
         aes128CtrUpdatePartialCtr(ctx->ctr, ALIGN_DOWN(iv_offset, AES_BLOCK_SIZE));
         aes128CtrContextResetCtr(&(ctx->ctr_ctx), ctx->ctr);
-        aes128CtrCrypt(&(ctx->ctr_ctx), g_ncaCryptoBuffer, g_ncaCryptoBuffer, chunk_size);
+        aes128CtrCrypt(&(ctx->ctr_ctx), crypto_buf, crypto_buf, chunk_size);
     }
 
     /* Copy decrypted data. */
-    memcpy(out, g_ncaCryptoBuffer + data_start_offset, out_chunk_size);
+    memcpy(out, crypto_buf + data_start_offset, out_chunk_size);
 
     /* Perform another read if required. */
     if (sparse_virtual_offset && block_size > NCA_CRYPTO_BUFFER_SIZE) ctx->cur_sparse_virtual_offset += out_chunk_size;
-    ret = (block_size > NCA_CRYPTO_BUFFER_SIZE ? _ncaReadFsSection(ctx, (u8*)out + out_chunk_size, read_size - out_chunk_size, offset + out_chunk_size) : true);
+    ret = (block_size > NCA_CRYPTO_BUFFER_SIZE ? _ncaReadFsSection(ctx, crypto_buf, (u8*)out + out_chunk_size, read_size - out_chunk_size, offset + out_chunk_size) : true);
 
 end:
     if (ctx->has_sparse_layer) ctx->cur_sparse_virtual_offset = 0;
@@ -1330,9 +1837,32 @@ static bool ncaFsSectionCheckPlaintextHashRegionAccess(NcaFsSectionContext *ctx,
     return ret;
 }
 
-static bool _ncaReadAesCtrExStorage(NcaFsSectionContext *ctx, void *out, u64 read_size, u64 offset, u32 ctr_val, bool decrypt)
+static bool ncaReadFsSectionSpan(void *arg, void *out, u64 read_size, u64 offset)
+{
+    NcaFsSectionReadSpanArgs *args = (NcaFsSectionReadSpanArgs*)arg;
+    return _ncaReadFsSection(args->ctx, args->crypto_buf, out, read_size, offset);
+}
+
+static int ncaReadRequestSortFunction(const void *a, const void *b)
+{
+    const NcaReadRequest *req_1 = (const NcaReadRequest*)a;
+    const NcaReadRequest *req_2 = (const NcaReadRequest*)b;
+
+    if (req_1->offset < req_2->offset)
+    {
+        return -1;
+    } else
+    if (req_1->offset > req_2->offset)
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+static bool _ncaReadAesCtrExStorage(NcaFsSectionContext *ctx, u8 *crypto_buf, void *out, u64 read_size, u64 offset, u32 ctr_val, bool decrypt)
 {
-    if (!g_ncaCryptoBuffer || !ctx || !ctx->enabled || !ctx->nca_ctx || ctx->section_idx >= NCA_FS_HEADER_COUNT || ctx->section_offset < sizeof(NcaHeader) || \
+    if (!crypto_buf || !ctx || !ctx->enabled || !ctx->nca_ctx || ctx->section_idx >= NCA_FS_HEADER_COUNT || ctx->section_offset < sizeof(NcaHeader) || \
         ctx->section_type != NcaFsSectionType_PatchRomFs || (ctx->encryption_type != NcaEncryptionType_None && ctx->encryption_type != NcaEncryptionType_AesCtrEx && \
         ctx->encryption_type != NcaEncryptionType_AesCtrExSkipLayerHash) || !out || !read_size || (offset + read_size) > ctx->section_size)
     {
@@ -1348,7 +1878,7 @@ static bool _ncaReadAesCtrExStorage(NcaFsSectionContext *ctx, void *out, u64 rea
 
     bool ret = false;
 
-    if (!*(nca_ctx->content_id_str) || (nca_ctx->storage_id != NcmStorageId_GameCard && !nca_ctx->ncm_storage) || (nca_ctx->storage_id == NcmStorageId_GameCard && !nca_ctx->gamecard_offset) || \
+    if (!*(nca_ctx->content_id_str) || !contentSourceIsValid(&(nca_ctx->source)) || \
         (content_offset + read_size) > nca_ctx->content_size)
     {
         LOG_MSG_ERROR("Invalid NCA header parameters!");
@@ -1387,7 +1917,7 @@ static bool _ncaReadAesCtrExStorage(NcaFsSectionContext *ctx, void *out, u64 rea
     out_chunk_size = (block_size > NCA_CRYPTO_BUFFER_SIZE ? (NCA_CRYPTO_BUFFER_SIZE - data_start_offset) : read_size);
 
     /* Read data. */
-    if (!ncaReadContentFile(nca_ctx, g_ncaCryptoBuffer, chunk_size, block_start_offset))
+    if (!ncaReadContentFile(nca_ctx, crypto_buf, chunk_size, block_start_offset))
     {
         LOG_MSG_ERROR("Failed to read 0x%lX bytes encrypted data block at offset 0x%lX from NCA \"%s\" FS section #%u! (unaligned).", chunk_size, block_start_offset, nca_ctx->content_id_str, \
                       ctx->section_idx);
@@ -1397,12 +1927,12 @@ static bool _ncaReadAesCtrExStorage(NcaFsSectionContext *ctx, void *out, u64 rea
     /* Decrypt data. */
     aes128CtrUpdatePartialCtrEx(ctx->ctr, ctr_val, block_start_offset);
     aes128CtrContextResetCtr(&(ctx->ctr_ctx), ctx->ctr);
-    aes128CtrCrypt(&(ctx->ctr_ctx), g_ncaCryptoBuffer, g_ncaCryptoBuffer, chunk_size);
+    aes128CtrCrypt(&(ctx->ctr_ctx), crypto_buf, crypto_buf, chunk_size);
 
     /* Copy decrypted data. */
-    memcpy(out, g_ncaCryptoBuffer + data_start_offset, out_chunk_size);
+    memcpy(out, crypto_buf + data_start_offset, out_chunk_size);
 
-    ret = (block_size > NCA_CRYPTO_BUFFER_SIZE ? _ncaReadAesCtrExStorage(ctx, (u8*)out + out_chunk_size, read_size - out_chunk_size, offset + out_chunk_size, ctr_val, decrypt) : true);
+    ret = (block_size > NCA_CRYPTO_BUFFER_SIZE ? _ncaReadAesCtrExStorage(ctx, crypto_buf, (u8*)out + out_chunk_size, read_size - out_chunk_size, offset + out_chunk_size, ctr_val, decrypt) : true);
 
 end:
     return ret;
@@ -1419,7 +1949,7 @@ static void ncaCalculateLayerHash(void *dst, const void *src, size_t size, bool
 }
 
 /* In this function, the term "layer" is used as a generic way to refer to both HierarchicalSha256 hash regions and HierarchicalIntegrity verification levels. */
-static bool ncaGenerateHashDataPatch(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 data_offset, void *out, bool is_integrity_patch)
+static bool ncaGenerateHashDataPatch(NcaFsSectionContext *ctx, u8 *crypto_buf, const void *data, u64 data_size, u64 data_offset, void *out, bool is_integrity_patch)
 {
     NcaContext *nca_ctx = NULL;
     NcaHierarchicalSha256Patch *hierarchical_sha256_patch = (!is_integrity_patch ? ((NcaHierarchicalSha256Patch*)out) : NULL);
@@ -1433,6 +1963,9 @@ static bool ncaGenerateHashDataPatch(NcaFsSectionContext *ctx, const void *data,
     u8 *parent_layer_block = NULL, *cur_layer_block = NULL;
     u64 last_layer_size = 0;
 
+    HashBatchJob *hash_jobs = NULL;
+    u32 hash_job_count = 0;
+
     bool use_sha3 = false, success = false;
 
     if (!ctx || !ctx->enabled || ctx->has_sparse_layer || ctx->has_compression_layer || !(nca_ctx = ctx->nca_ctx) || \
@@ -1541,7 +2074,7 @@ static bool ncaGenerateHashDataPatch(NcaFsSectionContext *ctx, const void *data,
         }
 
         /* Read current layer block. */
-        if (!_ncaReadFsSection(ctx, cur_layer_block, cur_layer_read_size, cur_layer_read_start_offset))
+        if (!_ncaReadFsSection(ctx, crypto_buf, cur_layer_block, cur_layer_read_size, cur_layer_read_start_offset))
         {
             LOG_MSG_ERROR("Failed to read 0x%lX bytes long hierarchical layer #%u data block from offset 0x%lX! (current).", cur_layer_read_size, i - 1, cur_layer_read_start_offset);
             goto end;
@@ -1562,20 +2095,36 @@ static bool ncaGenerateHashDataPatch(NcaFsSectionContext *ctx, const void *data,
             }
 
             /* Read parent layer block. */
-            if (!_ncaReadFsSection(ctx, parent_layer_block, parent_layer_read_size, parent_layer_offset + parent_layer_read_start_offset))
+            if (!_ncaReadFsSection(ctx, crypto_buf, parent_layer_block, parent_layer_read_size, parent_layer_offset + parent_layer_read_start_offset))
             {
                 LOG_MSG_ERROR("Failed to read 0x%lX bytes long hierarchical layer #%u data block from offset 0x%lX! (parent).", parent_layer_read_size, i - 2, parent_layer_read_start_offset);
                 goto end;
             }
 
+            /* Allocate memory for our hash jobs. All blocks from the current layer are hashed at once. */
+            hash_job_count = (u32)(ALIGN_UP(cur_layer_read_size, hash_block_size) / hash_block_size);
+            hash_jobs = calloc(hash_job_count, sizeof(HashBatchJob));
+            if (!hash_jobs)
+            {
+                LOG_MSG_ERROR("Unable to allocate memory for %u hierarchical layer #%u hash jobs!", hash_job_count, i - 1);
+                goto end;
+            }
+
             /* HierarchicalSha256: size is truncated for blocks smaller than the hash block size. */
-            /* HierarchicalIntegrity: size *isn't* truncated for blocks smaller than the hash block size, so we just keep using the same hash block size throughout the loop. */
+            /* HierarchicalIntegrity: size *isn't* truncated for blocks smaller than the hash block size, so we just keep using the same hash block size for all jobs. */
             /*                        For these specific cases, the rest of the block should be filled with zeroes (already taken care of by using calloc()). */
             for(u64 j = 0, k = 0; j < cur_layer_read_size; j += hash_block_size, k++)
             {
-                if (!is_integrity_patch && hash_block_size > (cur_layer_read_size - j)) hash_block_size = (cur_layer_read_size - j);
-                ncaCalculateLayerHash(parent_layer_block + (k * SHA256_HASH_SIZE), cur_layer_block + j, hash_block_size, use_sha3);
+                hash_jobs[k].src = (cur_layer_block + j);
+                hash_jobs[k].size = ((!is_integrity_patch && hash_block_size > (cur_layer_read_size - j)) ? (cur_layer_read_size - j) : hash_block_size);
             }
+
+            if (!hashBatchCalculate(hash_jobs, hash_job_count, use_sha3 ? HashBatchAlgorithm_Sha3256 : HashBatchAlgorithm_Sha256)) goto end;
+
+            for(u32 k = 0; k < hash_job_count; k++) memcpy(parent_layer_block + (k * SHA256_HASH_SIZE), hash_jobs[k].hash, SHA256_HASH_SIZE);
+
+            free(hash_jobs);
+            hash_jobs = NULL;
         } else {
             /* Recalculate master hash from the HashData area. */
             u8 *master_hash = (!is_integrity_patch ? ctx->header.hash_data.hierarchical_sha256_data.master_hash : ctx->header.hash_data.integrity_meta_info.master_hash);
@@ -1585,7 +2134,7 @@ static bool ncaGenerateHashDataPatch(NcaFsSectionContext *ctx, const void *data,
         if (!ctx->skip_hash_layer_crypto || i == layer_count)
         {
             /* Reencrypt current layer block (if needed). */
-            cur_layer_patch->data = ncaGenerateEncryptedFsSectionBlock(ctx, cur_layer_block + cur_layer_read_patch_offset, cur_data_size, cur_layer_offset + cur_data_offset, \
+            cur_layer_patch->data = ncaGenerateEncryptedFsSectionBlock(ctx, crypto_buf, cur_layer_block + cur_layer_read_patch_offset, cur_data_size, cur_layer_offset + cur_data_offset, \
                                                                         &(cur_layer_patch->size), &(cur_layer_patch->offset));
             if (!cur_layer_patch->data)
             {
@@ -1635,6 +2184,8 @@ static bool ncaGenerateHashDataPatch(NcaFsSectionContext *ctx, const void *data,
     success = true;
 
 end:
+    if (hash_jobs) free(hash_jobs);
+
     if (cur_layer_block) free(cur_layer_block);
 
     if (parent_layer_block) free(parent_layer_block);
@@ -1680,12 +2231,12 @@ static bool ncaWritePatchToMemoryBuffer(NcaContext *ctx, const void *patch, u64
 /// Output size and offset are guaranteed to be aligned to the AES sector size used by the encryption type from the FS section.
 /// Output offset is relative to the start of the NCA content file, making it easier to use the output encrypted block to seamlessly replace data while dumping a NCA.
 /// This function doesn't support Patch RomFS sections, nor sections with Sparse and/or Compressed storage.
-static void *ncaGenerateEncryptedFsSectionBlock(NcaFsSectionContext *ctx, const void *data, u64 data_size, u64 data_offset, u64 *out_block_size, u64 *out_block_offset)
+static void *ncaGenerateEncryptedFsSectionBlock(NcaFsSectionContext *ctx, u8 *crypto_buf, const void *data, u64 data_size, u64 data_offset, u64 *out_block_size, u64 *out_block_offset)
 {
     u8 *out = NULL;
     bool success = false;
 
-    if (!g_ncaCryptoBuffer || !ctx || !ctx->enabled || ctx->has_sparse_layer || ctx->has_compression_layer || !ctx->nca_ctx || ctx->section_idx >= NCA_FS_HEADER_COUNT || \
+    if (!crypto_buf || !ctx || !ctx->enabled || ctx->has_sparse_layer || ctx->has_compression_layer || !ctx->nca_ctx || ctx->section_idx >= NCA_FS_HEADER_COUNT || \
         ctx->section_offset < sizeof(NcaHeader) || ctx->hash_type <= NcaHashType_None || ctx->hash_type == NcaHashType_AutoSha3 || ctx->hash_type >= NcaHashType_Count || \
         ctx->encryption_type == NcaEncryptionType_Auto || ctx->encryption_type == NcaEncryptionType_AesCtrEx || ctx->encryption_type >= NcaEncryptionType_AesCtrExSkipLayerHash || \
         ctx->section_type >= NcaFsSectionType_Invalid || !data || !data_size || (data_offset + data_size) > ctx->section_size || !out_block_size || !out_block_offset)
@@ -1703,7 +2254,7 @@ static void *ncaGenerateEncryptedFsSectionBlock(NcaFsSectionContext *ctx, const
     u64 block_start_offset = 0, block_end_offset = 0, block_size = 0;
     u64 plain_chunk_offset = 0;
 
-    if (!*(nca_ctx->content_id_str) || (nca_ctx->storage_id != NcmStorageId_GameCard && !nca_ctx->ncm_storage) || (nca_ctx->storage_id == NcmStorageId_GameCard && !nca_ctx->gamecard_offset) || \
+    if (!*(nca_ctx->content_id_str) || !contentSourceIsValid(&(nca_ctx->source)) || \
         (nca_ctx->format_version != NcaVersion_Nca0 && nca_ctx->format_version != NcaVersion_Nca2 && nca_ctx->format_version != NcaVersion_Nca3) || (content_offset + data_size) > nca_ctx->content_size)
     {
         LOG_MSG_ERROR("Invalid NCA header parameters!");
@@ -1769,7 +2320,7 @@ static void *ncaGenerateEncryptedFsSectionBlock(NcaFsSectionContext *ctx, const
     }
 
     /* Read decrypted data using aligned offset and size. */
-    if (!_ncaReadFsSection(ctx, out, block_size, block_start_offset))
+    if (!_ncaReadFsSection(ctx, crypto_buf, out, block_size, block_start_offset))
     {
         LOG_MSG_ERROR("Failed to read decrypted NCA \"%s\" FS section #%u data block!", nca_ctx->content_id_str, ctx->section_idx);
         goto end;
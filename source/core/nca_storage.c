@@ -21,6 +21,7 @@
 
 #include "nxdt_utils.h"
 #include "nca_storage.h"
+#include "hash_batch.h"
 
 /* Function prototypes. */
 
@@ -28,6 +29,18 @@ static bool ncaStorageInitializeBucketTreeContext(BucketTreeContext **out, NcaFs
 static bool ncaStorageSetPatchOriginalSubStorage(NcaStorageContext *patch_ctx, NcaStorageContext *base_ctx);
 static bool ncaStorageInitializeCompressedStorageBucketTreeContext(NcaStorageContext *out, NcaFsSectionContext *nca_fs_ctx);
 
+static bool ncaStorageReadSpan(void *arg, void *out, u64 read_size, u64 offset);
+
+static bool ncaStorageReadBaseStorage(NcaStorageContext *ctx, void *out, u64 read_size, u64 offset);
+static bool ncaStorageReadVerifiedStorage(NcaStorageContext *ctx, void *out, u64 read_size, u64 offset);
+static bool ncaStorageReadVerifiedHashTargetLayer(NcaStorageContext *ctx, void *out, u64 read_size, u64 offset);
+
+static bool ncaStorageGetVerifiedHashLayerData(NcaStorageContext *ctx, u32 layer_index, void *out, u64 read_size, u64 offset);
+static bool ncaStorageVerifyHashLayerBlock(NcaStorageContext *ctx, u32 layer_index, u64 block_index, const void *data, u64 data_size);
+static NcaStorageHashBlockCacheEntry *ncaStorageGetHashBlockCacheEntry(NcaStorageHashVerificationContext *hash_ctx, u32 layer_index, u64 block_index);
+
+static void ncaStorageFreeHashVerificationContext(NcaStorageHashVerificationContext *hash_ctx);
+
 bool ncaStorageInitializeContext(NcaStorageContext *out, NcaFsSectionContext *nca_fs_ctx, NcaStorageContext *base_ctx)
 {
     if (!out || !nca_fs_ctx || !nca_fs_ctx->enabled || (nca_fs_ctx->section_type == NcaFsSectionType_PatchRomFs && \
@@ -149,27 +162,131 @@ bool ncaStorageRead(NcaStorageContext *ctx, void *out, u64 read_size, u64 offset
         return false;
     }
 
-    bool success = false;
+    return (ctx->hash_verification_ctx ? ncaStorageReadVerifiedStorage(ctx, out, read_size, offset) : ncaStorageReadBaseStorage(ctx, out, read_size, offset));
+}
 
-    switch(ctx->base_storage_type)
+bool ncaStorageReadV(NcaStorageContext *ctx, const NcaReadRequest *requests, u32 request_count)
+{
+    if (!ncaStorageIsValidContext(ctx) || !requests || !request_count)
     {
-        case NcaStorageBaseStorageType_Regular:
-            success = ncaReadFsSection(ctx->nca_fs_ctx, out, read_size, offset);
-            break;
-        case NcaStorageBaseStorageType_Sparse:
-            success = bktrReadStorage(ctx->sparse_storage, out, read_size, offset);
-            break;
-        case NcaStorageBaseStorageType_Indirect:
-            success = bktrReadStorage(ctx->indirect_storage, out, read_size, offset);
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    /* Regular base storage offsets are NCA FS section offsets, so we can just forward the whole list. */
+    if (ctx->base_storage_type == NcaStorageBaseStorageType_Regular && !ctx->hash_verification_ctx) return ncaReadFsSectionV(ctx->nca_fs_ctx, requests, request_count);
+
+    return ncaProcessReadRequests(requests, request_count, ncaStorageReadSpan, ctx);
+}
+
+bool ncaStorageSetHashVerification(NcaStorageContext *ctx, bool enable)
+{
+    if (!ncaStorageIsValidContext(ctx))
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    NcaFsSectionContext *nca_fs_ctx = ctx->nca_fs_ctx;
+    NcaStorageHashVerificationContext *hash_ctx = NULL;
+    u32 layer_count = 0;
+    bool is_integrity = false, success = false;
+
+    /* Free hash verification context if we're disabling hash verification. */
+    if (!enable)
+    {
+        ncaStorageFreeHashVerificationContext(ctx->hash_verification_ctx);
+        ctx->hash_verification_ctx = NULL;
+        return true;
+    }
+
+    /* Return right away if hash verification has already been enabled. */
+    if (ctx->hash_verification_ctx) return true;
+
+    /* Sparse: hash layers cover data that isn't available in the sparse NCA, so it can't be verified. */
+    /* Compressed: the compressed storage only provides access to the hash target layer. */
+    if (ctx->base_storage_type != NcaStorageBaseStorageType_Regular && ctx->base_storage_type != NcaStorageBaseStorageType_Indirect)
+    {
+        LOG_MSG_ERROR("Hash verification isn't supported by this base storage type! (%u).", ctx->base_storage_type);
+        return false;
+    }
+
+    /* Get hash layer count. */
+    switch(nca_fs_ctx->hash_type)
+    {
+        case NcaHashType_HierarchicalSha256:
+        case NcaHashType_HierarchicalSha3256:
+            layer_count = nca_fs_ctx->header.hash_data.hierarchical_sha256_data.hash_region_count;
             break;
-        case NcaStorageBaseStorageType_Compressed:
-            success = bktrReadStorage(ctx->compressed_storage, out, read_size, offset);
+        case NcaHashType_HierarchicalIntegrity:
+        case NcaHashType_HierarchicalIntegritySha3:
+            layer_count = (nca_fs_ctx->header.hash_data.integrity_meta_info.info_level_hash.max_level_count - 1);
+            if (layer_count != NCA_IVFC_LEVEL_COUNT) layer_count = 0;
+            is_integrity = true;
             break;
         default:
             break;
     }
 
-    if (!success) LOG_MSG_ERROR("Failed to read 0x%lX-byte long block from offset 0x%lX in base storage! (type: %u).", read_size, offset, ctx->base_storage_type);
+    if (layer_count < 2 || layer_count > NCA_STORAGE_MAX_HASH_LAYER_COUNT)
+    {
+        LOG_MSG_ERROR("Hash verification isn't supported by this NCA FS section! (hash type %u, layer count %u).", nca_fs_ctx->hash_type, layer_count);
+        return false;
+    }
+
+    /* Allocate memory for the hash verification context. */
+    hash_ctx = calloc(1, sizeof(NcaStorageHashVerificationContext));
+    if (!hash_ctx)
+    {
+        LOG_MSG_ERROR("Unable to allocate memory for the hash verification context!");
+        goto end;
+    }
+
+    hash_ctx->hash_algorithm = ((nca_fs_ctx->hash_type == NcaHashType_HierarchicalSha3256 || nca_fs_ctx->hash_type == NcaHashType_HierarchicalIntegritySha3) ? \
+                                HashBatchAlgorithm_Sha3256 : HashBatchAlgorithm_Sha256);
+    hash_ctx->zero_pad_blocks = is_integrity;
+    hash_ctx->layer_count = layer_count;
+
+    /* Retrieve hash layer properties. */
+    for(u32 i = 0; i < layer_count; i++)
+    {
+        NcaStorageHashLayer *layer = &(hash_ctx->layers[i]);
+
+        if (!is_integrity)
+        {
+            NcaHierarchicalSha256Data *hash_data = &(nca_fs_ctx->header.hash_data.hierarchical_sha256_data);
+            layer->offset = hash_data->hash_region[i].offset;
+            layer->size = hash_data->hash_region[i].size;
+            layer->block_size = hash_data->hash_block_size;
+        } else {
+            NcaHierarchicalIntegrityVerificationLevelInformation *lvl_info = &(nca_fs_ctx->header.hash_data.integrity_meta_info.info_level_hash.level_information[i]);
+            layer->offset = lvl_info->offset;
+            layer->size = lvl_info->size;
+            layer->block_size = NCA_IVFC_BLOCK_SIZE(lvl_info->block_order);
+        }
+
+        /* Validate hash layer properties. Each parent layer must hold a hash for every block from its child layer. */
+        if (layer->block_size <= 1 || !layer->size || (layer->offset + layer->size) > nca_fs_ctx->section_size || \
+            (i > 0 && hash_ctx->layers[i - 1].size < (ALIGN_UP(layer->size, layer->block_size) / layer->block_size) * SHA256_HASH_SIZE))
+        {
+            LOG_MSG_ERROR("Invalid hierarchical hash layer! (%u).", i);
+            goto end;
+        }
+    }
+
+    memcpy(hash_ctx->master_hash, (!is_integrity ? nca_fs_ctx->header.hash_data.hierarchical_sha256_data.master_hash : nca_fs_ctx->header.hash_data.integrity_meta_info.master_hash), \
+           SHA256_HASH_SIZE);
+
+    mutexInit(&(hash_ctx->cache_mutex));
+
+    /* Update output context. */
+    ctx->hash_verification_ctx = hash_ctx;
+
+    /* Update return value. */
+    success = true;
+
+end:
+    if (!success && hash_ctx) ncaStorageFreeHashVerificationContext(hash_ctx);
 
     return success;
 }
@@ -222,6 +339,8 @@ void ncaStorageFreeContext(NcaStorageContext *ctx)
         free(ctx->compressed_storage);
     }
 
+    if (ctx->hash_verification_ctx) ncaStorageFreeHashVerificationContext(ctx->hash_verification_ctx);
+
     memset(ctx, 0, sizeof(NcaStorageContext));
 }
 
@@ -374,3 +493,305 @@ end:
 
     return success;
 }
+
+static bool ncaStorageReadSpan(void *arg, void *out, u64 read_size, u64 offset)
+{
+    return ncaStorageRead((NcaStorageContext*)arg, out, read_size, offset);
+}
+
+static bool ncaStorageReadBaseStorage(NcaStorageContext *ctx, void *out, u64 read_size, u64 offset)
+{
+    bool success = false;
+
+    switch(ctx->base_storage_type)
+    {
+        case NcaStorageBaseStorageType_Regular:
+            success = ncaReadFsSection(ctx->nca_fs_ctx, out, read_size, offset);
+            break;
+        case NcaStorageBaseStorageType_Sparse:
+            success = bktrReadStorage(ctx->sparse_storage, out, read_size, offset);
+            break;
+        case NcaStorageBaseStorageType_Indirect:
+            success = bktrReadStorage(ctx->indirect_storage, out, read_size, offset);
+            break;
+        case NcaStorageBaseStorageType_Compressed:
+            success = bktrReadStorage(ctx->compressed_storage, out, read_size, offset);
+            break;
+        default:
+            break;
+    }
+
+    if (!success) LOG_MSG_ERROR("Failed to read 0x%lX-byte long block from offset 0x%lX in base storage! (type: %u).", read_size, offset, ctx->base_storage_type);
+
+    return success;
+}
+
+static bool ncaStorageReadVerifiedStorage(NcaStorageContext *ctx, void *out, u64 read_size, u64 offset)
+{
+    NcaStorageHashVerificationContext *hash_ctx = ctx->hash_verification_ctx;
+    NcaStorageHashLayer *target_layer = &(hash_ctx->layers[hash_ctx->layer_count - 1]);
+
+    u8 *out_u8 = (u8*)out;
+    u64 read_end_offset = (offset + read_size);
+    u64 target_start_offset = target_layer->offset, target_end_offset = (target_layer->offset + target_layer->size);
+
+    /* Only data from the hash target layer is verified. Any other areas are read as-is. */
+    if (offset < target_start_offset && !ncaStorageReadBaseStorage(ctx, out_u8, MIN(read_end_offset, target_start_offset) - offset, offset)) return false;
+
+    if (offset < target_end_offset && read_end_offset > target_start_offset)
+    {
+        u64 block_start_offset = MAX(offset, target_start_offset), block_end_offset = MIN(read_end_offset, target_end_offset);
+        if (!ncaStorageReadVerifiedHashTargetLayer(ctx, out_u8 + (block_start_offset - offset), block_end_offset - block_start_offset, block_start_offset)) return false;
+    }
+
+    if (read_end_offset > target_end_offset)
+    {
+        u64 block_start_offset = MAX(offset, target_end_offset);
+        if (!ncaStorageReadBaseStorage(ctx, out_u8 + (block_start_offset - offset), read_end_offset - block_start_offset, block_start_offset)) return false;
+    }
+
+    return true;
+}
+
+static bool ncaStorageReadVerifiedHashTargetLayer(NcaStorageContext *ctx, void *out, u64 read_size, u64 offset)
+{
+    NcaStorageHashVerificationContext *hash_ctx = ctx->hash_verification_ctx;
+    u32 target_layer_index = (hash_ctx->layer_count - 1);
+    NcaStorageHashLayer *target_layer = &(hash_ctx->layers[target_layer_index]);
+
+    u64 block_size = target_layer->block_size;
+    u64 layer_offset = (offset - target_layer->offset);
+    u64 aligned_start_offset = ALIGN_DOWN(layer_offset, block_size);
+    u64 aligned_end_offset = MIN(ALIGN_UP(layer_offset + read_size, block_size), target_layer->size);
+    u64 aligned_size = (aligned_end_offset - aligned_start_offset);
+    u64 block_count = (ALIGN_UP(aligned_size, block_size) / block_size);
+
+    u8 *data_buf = NULL, *expected_hashes = NULL;
+    bool use_out_buf = (aligned_start_offset == layer_offset && aligned_size == read_size);
+
+    HashBatchJob *jobs = NULL;
+    bool success = false, locked_success = false;
+
+    /* Read full data blocks straight into the output buffer, if possible. */
+    data_buf = (use_out_buf ? (u8*)out : malloc(aligned_size));
+    if (!data_buf)
+    {
+        LOG_MSG_ERROR("Unable to allocate 0x%lX bytes for the data block buffer!", aligned_size);
+        goto end;
+    }
+
+    if (!ncaStorageReadBaseStorage(ctx, data_buf, aligned_size, target_layer->offset + aligned_start_offset)) goto end;
+
+    /* Allocate memory for the expected hashes and the hash jobs. */
+    expected_hashes = malloc(block_count * SHA256_HASH_SIZE);
+    jobs = calloc(block_count, sizeof(HashBatchJob));
+    if (!expected_hashes || !jobs)
+    {
+        LOG_MSG_ERROR("Unable to allocate memory for %lu data block hashes!", block_count);
+        goto end;
+    }
+
+    /* Retrieve verified hashes for all data blocks from the parent layer. */
+    SCOPED_LOCK(&(hash_ctx->cache_mutex))
+    {
+        locked_success = ncaStorageGetVerifiedHashLayerData(ctx, target_layer_index - 1, expected_hashes, block_count * SHA256_HASH_SIZE, \
+                                                            (aligned_start_offset / block_size) * SHA256_HASH_SIZE);
+    }
+
+    if (!locked_success) goto end;
+
+    /* Hash all data blocks at once. */
+    /* HierarchicalSha256: hashes for partial blocks are calculated using the truncated block size. */
+    /* HierarchicalIntegrity: partial blocks are hashed as if the rest of the block was filled with zeroes. */
+    for(u64 i = 0; i < block_count; i++)
+    {
+        u64 block_offset = (i * block_size);
+        jobs[i].src = (data_buf + block_offset);
+        jobs[i].size = MIN(block_size, aligned_size - block_offset);
+        jobs[i].padded_size = (hash_ctx->zero_pad_blocks ? block_size : 0);
+    }
+
+    if (!hashBatchCalculate(jobs, (u32)block_count, hash_ctx->hash_algorithm)) goto end;
+
+    /* Verify data blocks. */
+    for(u64 i = 0; i < block_count; i++)
+    {
+        if (memcmp(jobs[i].hash, expected_hashes + (i * SHA256_HASH_SIZE), SHA256_HASH_SIZE) != 0)
+        {
+            LOG_MSG_ERROR("Data block checksum mismatch! (0x%lX-byte long block at offset 0x%lX).", jobs[i].size, target_layer->offset + aligned_start_offset + (i * block_size));
+            goto end;
+        }
+    }
+
+    /* Copy verified data to the output buffer, if needed. */
+    if (!use_out_buf) memcpy(out, data_buf + (layer_offset - aligned_start_offset), read_size);
+
+    /* Update return value. */
+    success = true;
+
+end:
+    if (jobs) free(jobs);
+
+    if (expected_hashes) free(expected_hashes);
+
+    if (!use_out_buf && data_buf) free(data_buf);
+
+    return success;
+}
+
+/* Must be called with the cache mutex held. */
+static bool ncaStorageGetVerifiedHashLayerData(NcaStorageContext *ctx, u32 layer_index, void *out, u64 read_size, u64 offset)
+{
+    NcaStorageHashVerificationContext *hash_ctx = ctx->hash_verification_ctx;
+    NcaStorageHashLayer *layer = &(hash_ctx->layers[layer_index]);
+    u8 *out_u8 = (u8*)out;
+    bool success = false;
+
+    if ((offset + read_size) > layer->size)
+    {
+        LOG_MSG_ERROR("Hash layer read out of bounds! (layer %u, offset 0x%lX, size 0x%lX).", layer_index, offset, read_size);
+        return false;
+    }
+
+    if (!layer_index)
+    {
+        /* Read and verify the whole master layer on first use. The master hash is calculated over the whole layer. */
+        if (!hash_ctx->master_layer)
+        {
+            u8 *master_layer = malloc(layer->size);
+            u8 master_hash[SHA256_HASH_SIZE] = {0};
+
+            if (!master_layer)
+            {
+                LOG_MSG_ERROR("Unable to allocate 0x%lX bytes for the master hash layer!", layer->size);
+                return false;
+            }
+
+            if (!ncaStorageReadBaseStorage(ctx, master_layer, layer->size, layer->offset))
+            {
+                free(master_layer);
+                return false;
+            }
+
+            hashBatchCalculateHash(master_hash, master_layer, layer->size, 0, hash_ctx->hash_algorithm);
+            if (memcmp(master_hash, hash_ctx->master_hash, SHA256_HASH_SIZE) != 0)
+            {
+                LOG_MSG_ERROR("Master hash layer checksum mismatch!");
+                free(master_layer);
+                return false;
+            }
+
+            hash_ctx->master_layer = master_layer;
+        }
+
+        memcpy(out, hash_ctx->master_layer + offset, read_size);
+        return true;
+    }
+
+    /* Process each hash layer block. */
+    while(read_size)
+    {
+        u64 block_index = (offset / layer->block_size);
+        u64 block_offset = (block_index * layer->block_size);
+        u64 block_size = MIN(layer->block_size, layer->size - block_offset);
+        u64 cur_read_size = MIN(block_size - (offset - block_offset), read_size);
+
+        NcaStorageHashBlockCacheEntry *cache_entry = ncaStorageGetHashBlockCacheEntry(hash_ctx, layer_index, block_index);
+
+        /* Read and verify this block if it isn't cached. */
+        if (!cache_entry->data || cache_entry->layer_index != layer_index || cache_entry->block_index != block_index)
+        {
+            /* Reuse the evicted entry's buffer, if possible. */
+            if (cache_entry->data_size < block_size)
+            {
+                u8 *tmp_data = realloc(cache_entry->data, block_size);
+                if (!tmp_data)
+                {
+                    LOG_MSG_ERROR("Unable to allocate 0x%lX bytes for hash layer #%u block cache entry!", block_size, layer_index);
+                    goto end;
+                }
+
+                cache_entry->data = tmp_data;
+                cache_entry->data_size = block_size;
+            }
+
+            /* Invalidate the cache entry until the block has been verified, and mark it as the most recently used one. */
+            /* This keeps it from being evicted while its parent layer blocks are looked up. */
+            cache_entry->layer_index = UINT32_MAX;
+            cache_entry->last_used = ++(hash_ctx->cache_tick);
+
+            if (!ncaStorageReadBaseStorage(ctx, cache_entry->data, block_size, layer->offset + block_offset) || \
+                !ncaStorageVerifyHashLayerBlock(ctx, layer_index, block_index, cache_entry->data, block_size)) goto end;
+
+            cache_entry->layer_index = layer_index;
+            cache_entry->block_index = block_index;
+        }
+
+        cache_entry->last_used = ++(hash_ctx->cache_tick);
+
+        memcpy(out_u8, cache_entry->data + (offset - block_offset), cur_read_size);
+
+        out_u8 += cur_read_size;
+        offset += cur_read_size;
+        read_size -= cur_read_size;
+    }
+
+    /* Update return value. */
+    success = true;
+
+end:
+    return success;
+}
+
+/* Must be called with the cache mutex held. */
+static bool ncaStorageVerifyHashLayerBlock(NcaStorageContext *ctx, u32 layer_index, u64 block_index, const void *data, u64 data_size)
+{
+    NcaStorageHashVerificationContext *hash_ctx = ctx->hash_verification_ctx;
+    u64 block_size = hash_ctx->layers[layer_index].block_size;
+    u8 expected_hash[SHA256_HASH_SIZE] = {0}, calculated_hash[SHA256_HASH_SIZE] = {0};
+
+    /* Retrieve the expected hash from the parent layer. */
+    if (!ncaStorageGetVerifiedHashLayerData(ctx, layer_index - 1, expected_hash, SHA256_HASH_SIZE, block_index * SHA256_HASH_SIZE)) return false;
+
+    hashBatchCalculateHash(calculated_hash, data, data_size, hash_ctx->zero_pad_blocks ? block_size : 0, hash_ctx->hash_algorithm);
+    if (memcmp(calculated_hash, expected_hash, SHA256_HASH_SIZE) != 0)
+    {
+        LOG_MSG_ERROR("Hash layer #%u block #%lu checksum mismatch!", layer_index, block_index);
+        return false;
+    }
+
+    return true;
+}
+
+/* Must be called with the cache mutex held. */
+static NcaStorageHashBlockCacheEntry *ncaStorageGetHashBlockCacheEntry(NcaStorageHashVerificationContext *hash_ctx, u32 layer_index, u64 block_index)
+{
+    NcaStorageHashBlockCacheEntry *lru_entry = NULL;
+
+    for(u32 i = 0; i < NCA_STORAGE_HASH_BLOCK_CACHE_ENTRY_COUNT; i++)
+    {
+        NcaStorageHashBlockCacheEntry *cache_entry = &(hash_ctx->cache[i]);
+
+        /* Return right away if we found a match. */
+        if (cache_entry->data && cache_entry->layer_index == layer_index && cache_entry->block_index == block_index) return cache_entry;
+
+        /* Keep track of the least recently used entry. Unused entries always come first. */
+        if (!lru_entry || (lru_entry->data && (!cache_entry->data || cache_entry->last_used < lru_entry->last_used))) lru_entry = cache_entry;
+    }
+
+    return lru_entry;
+}
+
+static void ncaStorageFreeHashVerificationContext(NcaStorageHashVerificationContext *hash_ctx)
+{
+    if (!hash_ctx) return;
+
+    for(u32 i = 0; i < NCA_STORAGE_HASH_BLOCK_CACHE_ENTRY_COUNT; i++)
+    {
+        if (hash_ctx->cache[i].data) free(hash_ctx->cache[i].data);
+    }
+
+    if (hash_ctx->master_layer) free(hash_ctx->master_layer);
+
+    free(hash_ctx);
+}
@@ -24,8 +24,8 @@
 
 /* Function prototypes. */
 
-static bool nsoGetModuleName(NsoContext *nso_ctx);
-static u8 *nsoGetRodataSegment(NsoContext *nso_ctx);
+static bool nsoGetModuleName(NsoContext *nso_ctx, const u8 *module_name_block);
+static u8 *nsoGetModuleNameAndRodataSegment(NsoContext *nso_ctx);
 static bool nsoGetModuleInfoName(NsoContext *nso_ctx, u8 *rodata_buf);
 static bool nsoGetSectionFromRodataSegment(NsoContext *nso_ctx, u8 *rodata_buf, u8 **section_ptr, u64 section_offset, u64 section_size);
 
@@ -132,11 +132,8 @@ bool nsoInitializeContext(NsoContext *out, PartitionFileSystemContext *pfs_ctx,
         goto end;
     }
 
-    /* Get module name. */
-    if (!nsoGetModuleName(out)) goto end;
-
-    /* Get .rodata segment. */
-    if (!(rodata_buf = nsoGetRodataSegment(out))) goto end;
+    /* Get module name and .rodata segment. The module name is stored in the NSO context, while the .rodata segment buffer is returned to us. */
+    if (!(rodata_buf = nsoGetModuleNameAndRodataSegment(out))) goto end;
 
     /* Get module info name. */
     if (!nsoGetModuleInfoName(out, rodata_buf)) goto end;
@@ -168,23 +165,14 @@ end:
     return success;
 }
 
-static bool nsoGetModuleName(NsoContext *nso_ctx)
+static bool nsoGetModuleName(NsoContext *nso_ctx, const u8 *module_name_block)
 {
-    if (nso_ctx->nso_header.module_name_offset < sizeof(NsoHeader) || nso_ctx->nso_header.module_name_size <= 1) return true;
-
-    NsoModuleName module_name = {0};
-
-    /* Get module name. */
-    if (!pfsReadEntryData(nso_ctx->pfs_ctx, nso_ctx->pfs_entry, &module_name, sizeof(NsoModuleName), nso_ctx->nso_header.module_name_offset))
-    {
-        LOG_MSG_ERROR("Failed to read NSO \"%s\" module name length!", nso_ctx->nso_filename);
-        return false;
-    }
+    const NsoModuleName *module_name = (const NsoModuleName*)module_name_block;
 
     /* Verify module name length. */
-    if (module_name.name_length != ((u8)nso_ctx->nso_header.module_name_size - 1))
+    if (module_name->name_length != ((u8)nso_ctx->nso_header.module_name_size - 1))
     {
-        LOG_MSG_ERROR("NSO \"%s\" module name length mismatch! (0x%02X != 0x%02X).", nso_ctx->nso_filename, module_name.name_length, (u8)nso_ctx->nso_header.module_name_size - 1);
+        LOG_MSG_ERROR("NSO \"%s\" module name length mismatch! (0x%02X != 0x%02X).", nso_ctx->nso_filename, module_name->name_length, (u8)nso_ctx->nso_header.module_name_size - 1);
         return false;
     }
 
@@ -196,17 +184,13 @@ static bool nsoGetModuleName(NsoContext *nso_ctx)
         return false;
     }
 
-    /* Read module name string. */
-    if (!pfsReadEntryData(nso_ctx->pfs_ctx, nso_ctx->pfs_entry, nso_ctx->module_name, module_name.name_length, nso_ctx->nso_header.module_name_offset + 1))
-    {
-        LOG_MSG_ERROR("Failed to read NSO \"%s\" module name string!", nso_ctx->nso_filename);
-        return false;
-    }
+    /* Copy module name string. */
+    memcpy(nso_ctx->module_name, module_name->name, module_name->name_length);
 
     return true;
 }
 
-static u8 *nsoGetRodataSegment(NsoContext *nso_ctx)
+static u8 *nsoGetModuleNameAndRodataSegment(NsoContext *nso_ctx)
 {
     int lz4_res = 0;
     bool compressed = (nso_ctx->nso_header.flags & NsoFlags_RoCompress), verify = (nso_ctx->nso_header.flags & NsoFlags_RoHash);
@@ -219,6 +203,12 @@ static u8 *nsoGetRodataSegment(NsoContext *nso_ctx)
 
     u8 rodata_hash[SHA256_HASH_SIZE] = {0};
 
+    u8 *module_name_block = NULL;
+    bool has_module_name = (nso_ctx->nso_header.module_name_offset >= sizeof(NsoHeader) && nso_ctx->nso_header.module_name_size > 1);
+
+    NcaReadRequest requests[2] = {0};
+    u32 request_count = 0;
+
     bool success = false;
 
     /* Allocate memory for the .rodata buffer. */
@@ -230,13 +220,32 @@ static u8 *nsoGetRodataSegment(NsoContext *nso_ctx)
 
     rodata_read_ptr = (compressed ? (rodata_buf + (rodata_buf_size - nso_ctx->nso_header.rodata_file_size)) : rodata_buf);
 
-    /* Read .rodata segment data. */
-    if (!pfsReadEntryData(nso_ctx->pfs_ctx, nso_ctx->pfs_entry, rodata_read_ptr, rodata_read_size, nso_ctx->nso_header.rodata_segment_info.file_offset))
+    requests[request_count++] = (NcaReadRequest){ .out = rodata_read_ptr, .size = rodata_read_size, .offset = nso_ctx->nso_header.rodata_segment_info.file_offset };
+
+    if (has_module_name)
+    {
+        /* Allocate memory for the module name block. */
+        if (!(module_name_block = calloc(nso_ctx->nso_header.module_name_size, sizeof(u8))))
+        {
+            LOG_MSG_ERROR("Failed to allocate memory for NSO \"%s\" module name block!", nso_ctx->nso_filename);
+            goto end;
+        }
+
+        requests[request_count++] = (NcaReadRequest){ .out = module_name_block, .size = nso_ctx->nso_header.module_name_size, .offset = nso_ctx->nso_header.module_name_offset };
+    }
+
+    /* Read .rodata segment data and module name block using a single vectored read call. */
+    /* The module name block is stored right after the NSO header, while the .rodata segment comes after the .text segment. These are usually too far apart */
+    /* to be merged, so this typically ends up issuing two separate storage requests. */
+    if (!pfsReadEntryDataV(nso_ctx->pfs_ctx, nso_ctx->pfs_entry, requests, request_count))
     {
-        LOG_MSG_ERROR("Failed to read .rodata segment in NSO \"%s\"!", nso_ctx->nso_filename);
+        LOG_MSG_ERROR("Failed to read .rodata segment / module name in NSO \"%s\"!", nso_ctx->nso_filename);
         goto end;
     }
 
+    /* Get module name. */
+    if (has_module_name && !nsoGetModuleName(nso_ctx, module_name_block)) goto end;
+
     if (compressed)
     {
         /* Decompress .rodata segment in-place. */
@@ -262,6 +271,8 @@ static u8 *nsoGetRodataSegment(NsoContext *nso_ctx)
     success = true;
 
 end:
+    if (module_name_block) free(module_name_block);
+
     if (!success && rodata_buf)
     {
         free(rodata_buf);
@@ -23,10 +23,43 @@
 
 #if (LOG_LEVEL >= LOG_LEVEL_DEBUG) && (LOG_LEVEL < LOG_LEVEL_NONE)
 
+#define LOG_RING_SLOT_COUNT     0x100                           /* Must be a power of two. */
+#define LOG_RING_DATA_SIZE      0x400                           /* Formatted message + binary data (if any). Bigger log messages are written synchronously. */
+#define LOG_RECORD_BUF_SIZE     (0x400 + (LOG_RING_DATA_SIZE * 3) + 8)
+
+/* Type definitions. */
+
+/// Log ring buffer slot. Holds a single log message whose header (timestamp, level, source location) hasn't been formatted yet.
+/// 'file_name' and 'func_name' always point to string literals (__FILE__ / __func__), so they remain valid until the slot is consumed.
+typedef struct {
+    atomic_size_t seq;                                          ///< Slot sequence number. Used to determine if the slot is free or ready to be consumed.
+    struct timespec ts;
+    const char *file_name;
+    const char *func_name;
+    int line;
+    u8 level;
+    bool save;                                                  ///< Set to true if this message should be saved as the last log message.
+    u16 msg_len;
+    u16 bin_data_size;                                          ///< Binary data is placed right after the message, and converted to a hex string by the flusher.
+    char data[LOG_RING_DATA_SIZE];
+} LogRingSlot;
+
 /* Global variables. */
 
 static Mutex g_logMutex = 0;
 
+/* Lock-free multi-producer ring buffer. Only consumed while holding the log mutex. */
+static LogRingSlot g_logRing[LOG_RING_SLOT_COUNT] = {0};
+static atomic_size_t g_logRingEnqueuePos = 0, g_logRingDequeuePos = 0;
+static atomic_bool g_logRingInitialized = false;
+
+static Thread g_logFlusherThread = {0};
+static UEvent g_logFlusherEvent = {0};
+static atomic_bool g_logFlusherRunning = false, g_logFlusherStop = false;
+static bool g_logFlusherStarting = false, g_logFlusherFailed = false, g_logFlusherClosed = false;
+
+static char g_logRecordBuffer[LOG_RECORD_BUF_SIZE] = {0};
+
 static char *g_lastLogMsg = NULL;
 
 static FsFile g_logFile = {0};
@@ -52,6 +85,16 @@ static void _logWriteFormattedStringToLogFile(bool save, u8 level, const char *f
 
 static void _logFlushLogFile(void);
 
+static bool logStartAsyncBackend(void);
+static void logStopAsyncBackend(void);
+static void logFlusherThreadFunc(void *arg);
+
+static bool logEnqueueMessage(u8 level, bool save, const char *file_name, int line, const char *func_name, const void *bin_data, size_t bin_data_size, const char *fmt, va_list args);
+static bool logIsRingBufferEmpty(void);
+static void _logDrainRingBuffer(void);
+static void _logWriteRingSlotToLogFile(LogRingSlot *slot);
+static void _logWriteBinaryDataToLogFile(const void *data, size_t data_size);
+
 static bool logAllocateLogBuffer(void);
 static bool logOpenLogFile(void);
 
@@ -59,14 +102,34 @@ static void logWriteStringToNxLink(const char *str);
 
 void logWriteStringToLogFile(const char *src)
 {
-    SCOPED_LOCK(&g_logMutex) _logWriteStringToLogFile(src);
+    /* Raw strings are written synchronously. Pending messages from the ring buffer are written first to preserve ordering. */
+    SCOPED_LOCK(&g_logMutex)
+    {
+        _logDrainRingBuffer();
+        _logWriteStringToLogFile(src);
+    }
 }
 
 __attribute__((format(printf, 5, 6))) void logWriteFormattedStringToLogFile(u8 level, const char *file_name, int line, const char *func_name, const char *fmt, ...)
 {
-    va_list args;
+    if (level < LOG_LEVEL || !file_name || !*file_name || !func_name || !*func_name || !fmt || !*fmt) return;
+
+    va_list args, args_copy;
     va_start(args, fmt);
-    SCOPED_LOCK(&g_logMutex) _logWriteFormattedStringToLogFile(true, level, file_name, line, func_name, fmt, args);
+    va_copy(args_copy, args);
+
+    /* Try to push this message to the ring buffer. This doesn't involve any locking, and the rest of the work is handled by the flusher thread. */
+    /* If the message is too big, or if the ring buffer is full, we'll just write it ourselves. */
+    if (!logEnqueueMessage(level, true, file_name, line, func_name, NULL, 0, fmt, args))
+    {
+        SCOPED_LOCK(&g_logMutex)
+        {
+            _logDrainRingBuffer();
+            _logWriteFormattedStringToLogFile(true, level, file_name, line, func_name, fmt, args_copy);
+        }
+    }
+
+    va_end(args_copy);
     va_end(args);
 }
 
@@ -140,43 +203,47 @@ __attribute__((format(printf, 7, 8))) void logWriteBinaryDataToLogFile(const voi
 {
     if (!data || !data_size || level < LOG_LEVEL || !file_name || !*file_name || !func_name || !*func_name || !fmt || !*fmt) return;
 
-    va_list args;
-    size_t data_str_size = ((data_size * 2) + 3);
-    char *data_str = NULL;
-
-    /* Allocate memory for the hex string representation of the provided binary data. */
-    data_str = calloc(data_str_size, sizeof(char));
-    if (!data_str) goto end;
-
-    /* Generate hex string representation. */
-    utilsGenerateHexString(data_str, data_str_size, data, data_size, true);
-    strcat(data_str, CRLF);
+    va_list args, args_copy;
+    va_start(args, fmt);
+    va_copy(args_copy, args);
 
-    SCOPED_LOCK(&g_logMutex)
+    /* Binary data is copied to the ring buffer as-is. Its hex string representation is generated by the flusher thread. */
+    if (!logEnqueueMessage(level, false, file_name, line, func_name, data, data_size, fmt, args))
     {
-        /* Write formatted string. */
-        va_start(args, fmt);
-        _logWriteFormattedStringToLogFile(false, level, file_name, line, func_name, fmt, args);
-        va_end(args);
+        SCOPED_LOCK(&g_logMutex)
+        {
+            _logDrainRingBuffer();
 
-        /* Write hex string representation. */
-        _logWriteStringToLogFile(data_str);
+            /* Write formatted string. */
+            _logWriteFormattedStringToLogFile(false, level, file_name, line, func_name, fmt, args_copy);
+
+            /* Write hex string representation. */
+            _logWriteBinaryDataToLogFile(data, data_size);
+        }
     }
 
-end:
-    if (data_str) free(data_str);
+    va_end(args_copy);
+    va_end(args);
 }
 
 void logFlushLogFile(void)
 {
-    SCOPED_LOCK(&g_logMutex) _logFlushLogFile();
+    SCOPED_LOCK(&g_logMutex)
+    {
+        _logDrainRingBuffer();
+        _logFlushLogFile();
+    }
 }
 
 void logCloseLogFile(void)
 {
+    /* Stop the flusher thread. This must be done without holding the log mutex, since the flusher thread needs it. */
+    logStopAsyncBackend();
+
     SCOPED_LOCK(&g_logMutex)
     {
-        /* Flush log buffer. */
+        /* Write pending messages and flush log buffer. */
+        _logDrainRingBuffer();
         _logFlushLogFile();
 
         /* Close logfile. */
@@ -214,6 +281,8 @@ char *logGetLastMessage(void)
 
     SCOPED_LOCK(&g_logMutex)
     {
+        /* The last log message is only updated while consuming the ring buffer. */
+        _logDrainRingBuffer();
         if (g_lastLogMsg) ret = strdup(g_lastLogMsg);
     }
 
@@ -418,6 +487,252 @@ static void _logFlushLogFile(void)
     }
 }
 
+static bool logStartAsyncBackend(void)
+{
+    if (atomic_load(&g_logFlusherRunning)) return true;
+
+    bool ret = false;
+
+    SCOPED_LOCK(&g_logMutex)
+    {
+        if ((ret = atomic_load(&g_logFlusherRunning))) break;
+
+        /* Initialize ring buffer slots. This is only done once, since messages may be pushed to the ring buffer while the flusher thread isn't running. */
+        if (!atomic_load(&g_logRingInitialized))
+        {
+            for(size_t i = 0; i < LOG_RING_SLOT_COUNT; i++) atomic_store_explicit(&(g_logRing[i].seq), i, memory_order_relaxed);
+            atomic_store(&g_logRingEnqueuePos, 0);
+            atomic_store(&g_logRingDequeuePos, 0);
+            atomic_store(&g_logRingInitialized, true);
+        }
+
+        /* utilsCreateThread() may log messages by itself, so we need to make sure we don't end up here again while the thread is being created. */
+        /* Don't restart the flusher thread after logCloseLogFile() has been called, since nothing would ever join it. */
+        if (g_logFlusherStarting || g_logFlusherFailed || g_logFlusherClosed) break;
+
+        g_logFlusherStarting = true;
+
+        ueventCreate(&g_logFlusherEvent, true);
+        atomic_store(&g_logFlusherStop, false);
+
+        /* Messages are synchronously written from now on if we fail to create the flusher thread. */
+        g_logFlusherFailed = !utilsCreateThread(&g_logFlusherThread, logFlusherThreadFunc, NULL, 1);
+        g_logFlusherStarting = false;
+
+        ret = !g_logFlusherFailed;
+        atomic_store(&g_logFlusherRunning, ret);
+    }
+
+    return ret;
+}
+
+static void logStopAsyncBackend(void)
+{
+    bool running = false;
+
+    SCOPED_LOCK(&g_logMutex)
+    {
+        running = atomic_load(&g_logFlusherRunning);
+        atomic_store(&g_logFlusherRunning, false);
+
+        /* Messages logged past this point are synchronously written. */
+        g_logFlusherClosed = true;
+    }
+
+    if (!running) return;
+
+    atomic_store(&g_logFlusherStop, true);
+    ueventSignal(&g_logFlusherEvent);
+    utilsJoinThread(&g_logFlusherThread);
+}
+
+static void logFlusherThreadFunc(void *arg)
+{
+    NX_IGNORE_ARG(arg);
+
+    while(!atomic_load(&g_logFlusherStop))
+    {
+        /* Wait until the ring buffer is half full, or until the flush interval elapses. */
+        waitSingle(waiterForUEvent(&g_logFlusherEvent), LOG_FLUSH_INTERVAL);
+
+        if (logIsRingBufferEmpty()) continue;
+
+        /* Move all pending messages to the log buffer. It's only written to the logfile once it fills up, or if a flush is explicitly requested. */
+        SCOPED_LOCK(&g_logMutex) _logDrainRingBuffer();
+    }
+
+    threadExit();
+}
+
+static bool logEnqueueMessage(u8 level, bool save, const char *file_name, int line, const char *func_name, const void *bin_data, size_t bin_data_size, const char *fmt, va_list args)
+{
+#if LOG_FORCE_FLUSH == 1
+    /* Messages must be written right away. */
+    NX_IGNORE_ARG(level);
+    NX_IGNORE_ARG(save);
+    NX_IGNORE_ARG(file_name);
+    NX_IGNORE_ARG(line);
+    NX_IGNORE_ARG(func_name);
+    NX_IGNORE_ARG(bin_data);
+    NX_IGNORE_ARG(bin_data_size);
+    NX_IGNORE_ARG(fmt);
+    NX_IGNORE_ARG(args);
+    return false;
+#else
+    char msg[LOG_RING_DATA_SIZE];
+    struct timespec now = {0};
+    LogRingSlot *slot = NULL;
+    int msg_len = 0;
+
+    /* Get current time with nanosecond precision. Everything else in the log message header is formatted by the flusher thread. */
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    /* Format the message right away, since its arguments may not outlive this call. */
+    msg_len = vsnprintf(msg, sizeof(msg), fmt, args);
+    if (msg_len <= 0 || (size_t)msg_len >= sizeof(msg) || ((size_t)msg_len + bin_data_size) > LOG_RING_DATA_SIZE) return false;
+
+    if (!logStartAsyncBackend()) return false;
+
+    /* Reserve a ring buffer slot. */
+    size_t pos = atomic_load_explicit(&g_logRingEnqueuePos, memory_order_relaxed);
+
+    while(true)
+    {
+        slot = &(g_logRing[pos & (LOG_RING_SLOT_COUNT - 1)]);
+
+        size_t seq = atomic_load_explicit(&(slot->seq), memory_order_acquire);
+        intptr_t diff = ((intptr_t)seq - (intptr_t)pos);
+
+        if (!diff)
+        {
+            if (atomic_compare_exchange_weak_explicit(&g_logRingEnqueuePos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) break;
+        } else
+        if (diff < 0)
+        {
+            /* Ring buffer is full. */
+            return false;
+        } else {
+            pos = atomic_load_explicit(&g_logRingEnqueuePos, memory_order_relaxed);
+        }
+    }
+
+    /* Fill slot. */
+    slot->ts = now;
+    slot->file_name = file_name;
+    slot->func_name = func_name;
+    slot->line = line;
+    slot->level = level;
+    slot->save = save;
+    slot->msg_len = (u16)msg_len;
+    slot->bin_data_size = (u16)bin_data_size;
+
+    memcpy(slot->data, msg, (size_t)msg_len);
+    if (bin_data_size) memcpy(slot->data + msg_len, bin_data, bin_data_size);
+
+    /* Publish slot. */
+    atomic_store_explicit(&(slot->seq), pos + 1, memory_order_release);
+
+    /* Wake up the flusher thread once the ring buffer is half full. */
+    if (((pos + 1) - atomic_load_explicit(&g_logRingDequeuePos, memory_order_relaxed)) == (LOG_RING_SLOT_COUNT / 2)) ueventSignal(&g_logFlusherEvent);
+
+    return true;
+#endif  /* LOG_FORCE_FLUSH == 1 */
+}
+
+static bool logIsRingBufferEmpty(void)
+{
+    if (!atomic_load(&g_logRingInitialized)) return true;
+
+    size_t pos = atomic_load_explicit(&g_logRingDequeuePos, memory_order_relaxed);
+    return (atomic_load_explicit(&(g_logRing[pos & (LOG_RING_SLOT_COUNT - 1)].seq), memory_order_acquire) != (pos + 1));
+}
+
+static void _logDrainRingBuffer(void)
+{
+    if (!atomic_load(&g_logRingInitialized)) return;
+
+    size_t pos = atomic_load_explicit(&g_logRingDequeuePos, memory_order_relaxed);
+
+    while(true)
+    {
+        LogRingSlot *slot = &(g_logRing[pos & (LOG_RING_SLOT_COUNT - 1)]);
+        if (atomic_load_explicit(&(slot->seq), memory_order_acquire) != (pos + 1)) break;
+
+        _logWriteRingSlotToLogFile(slot);
+
+        /* Release slot. */
+        atomic_store_explicit(&(slot->seq), pos + LOG_RING_SLOT_COUNT, memory_order_release);
+        atomic_store_explicit(&g_logRingDequeuePos, ++pos, memory_order_relaxed);
+    }
+}
+
+static void _logWriteRingSlotToLogFile(LogRingSlot *slot)
+{
+    struct tm ts = {0};
+    size_t record_len = 0, header_max_len = (LOG_RECORD_BUF_SIZE - ((size_t)slot->msg_len + ((size_t)slot->bin_data_size * 2) + 5));
+    int header_len = 0;
+
+    /* Get local time. */
+    localtime_r(&(slot->ts.tv_sec), &ts);
+    ts.tm_year += 1900;
+    ts.tm_mon++;
+
+    /* Generate log message header. */
+    header_len = snprintf(g_logRecordBuffer, header_max_len, g_logStrFormat, ts.tm_year, ts.tm_mon, ts.tm_mday, ts.tm_hour, ts.tm_min, ts.tm_sec, slot->ts.tv_nsec, g_logLevelNames[slot->level], \
+                          slot->file_name, slot->line, slot->func_name);
+    if (header_len <= 0) return;
+
+    record_len = MIN((size_t)header_len, header_max_len - 1);
+
+    /* Append message. */
+    memcpy(g_logRecordBuffer + record_len, slot->data, slot->msg_len);
+    record_len += slot->msg_len;
+
+    memcpy(g_logRecordBuffer + record_len, CRLF, 2);
+    record_len += 2;
+
+    /* Append hex string representation of the binary data, if available. */
+    if (slot->bin_data_size)
+    {
+        utilsGenerateHexString(g_logRecordBuffer + record_len, LOG_RECORD_BUF_SIZE - record_len, slot->data + slot->msg_len, slot->bin_data_size, true);
+        record_len += ((size_t)slot->bin_data_size * 2);
+
+        memcpy(g_logRecordBuffer + record_len, CRLF, 2);
+        record_len += 2;
+    }
+
+    g_logRecordBuffer[record_len] = '\0';
+
+    /* Save log message (if needed). */
+    if (slot->save)
+    {
+        if (g_lastLogMsg) free(g_lastLogMsg);
+
+        size_t func_name_len = strlen(slot->func_name);
+
+        g_lastLogMsg = calloc(func_name_len + 2 + (size_t)slot->msg_len + 1, sizeof(char));
+        if (g_lastLogMsg) sprintf(g_lastLogMsg, "%s: %.*s", slot->func_name, (int)slot->msg_len, slot->data);
+    }
+
+    _logWriteStringToLogFile(g_logRecordBuffer);
+}
+
+static void _logWriteBinaryDataToLogFile(const void *data, size_t data_size)
+{
+    const u8 *data_u8 = (const u8*)data;
+    char hex_str[0x201] = {0};
+
+    /* Generate the hex string representation in chunks, which avoids allocating a buffer for the whole thing. */
+    for(size_t offset = 0; offset < data_size; offset += ((sizeof(hex_str) - 1) / 2))
+    {
+        size_t chunk_size = MIN(data_size - offset, (sizeof(hex_str) - 1) / 2);
+        utilsGenerateHexString(hex_str, sizeof(hex_str), data_u8 + offset, chunk_size, true);
+        _logWriteStringToLogFile(hex_str);
+    }
+
+    _logWriteStringToLogFile(CRLF);
+}
+
 static bool logAllocateLogBuffer(void)
 {
     if (g_logBuffer) return true;
@@ -26,6 +26,9 @@
 #include "gamecard.h"
 #include "services.h"
 #include "nca.h"
+#include "bktr.h"
+#include "hash_batch.h"
+#include "tik.h"
 #include "usb.h"
 #include "title.h"
 #include "bfttf.h"
@@ -217,6 +220,23 @@ bool utilsInitializeResources(void)
             break;
         }
 
+        /* Start content source read engine. This is optional: asynchronous reads are carried out synchronously if it isn't running. */
+        if (!contentSourceStartReadEngine(CONTENT_SOURCE_READ_ENGINE_DEFAULT_QUEUE_DEPTH)) LOG_MSG_WARNING("Failed to start content source read engine! Asynchronous reads will be synchronous.");
+
+        /* Start hash batch worker threads. */
+        if (!hashBatchStartWorkers())
+        {
+            LOG_MSG_ERROR("Failed to start hash batch worker threads!");
+            break;
+        }
+
+        /* Start Bucket Tree LZ4 decompression worker threads. */
+        if (!bktrStartLz4DecompressionWorkers())
+        {
+            LOG_MSG_ERROR("Failed to start LZ4 decompression worker threads!");
+            break;
+        }
+
         /* Initialize gamecard interface. */
         if (!gamecardInitialize()) break;
 
@@ -311,6 +331,9 @@ void utilsCloseResources(void)
         /* Unmount application RomFS. */
         romfsExit();
 
+        /* Close ES ticket system savefiles. */
+        tikCloseEsSystemSavefiles();
+
         /* Unmount eMMC BIS System partition. */
         utilsUnmountEmmcBisSystemPartitionStorage();
 
@@ -320,6 +343,9 @@ void utilsCloseResources(void)
         /* Deinitialize BFTTF interface. */
         bfttfExit();
 
+        /* Stop content source read engine. */
+        contentSourceStopReadEngine();
+
         /* Deinitialize title interface. */
         titleExit();
 
@@ -329,6 +355,18 @@ void utilsCloseResources(void)
         /* Free NCA crypto buffer. */
         ncaFreeCryptoBuffer();
 
+        /* Write and free NCA header cache. */
+        ncaCloseHeaderCache();
+
+        /* Stop Bucket Tree LZ4 decompression worker threads. */
+        bktrStopLz4DecompressionWorkers();
+
+        /* Stop hash batch worker threads. */
+        hashBatchStopWorkers();
+
+        /* Free Bucket Tree LZ4 block cache. */
+        bktrFreeLz4BlockCache();
+
         /* Close USB Mass Storage interface. */
         umsExit();
 
@@ -588,6 +626,72 @@ end:
     return success;
 }
 
+__attribute__((format(printf, 2, 3))) bool utilsStringBuilderAppendFormatted(UtilsStringBuilder *sb, const char *fmt, ...)
+{
+    if (!sb || !fmt || !*fmt)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    va_list args, args_copy;
+    int formatted_str_len = 0;
+    bool success = false;
+
+    va_start(args, fmt);
+    va_copy(args_copy, args);
+
+    /* Try to format the string straight into the available buffer space. Most of the time, this is all we need. */
+    size_t avail_size = (sb->str ? (sb->size - sb->len) : 0);
+
+    formatted_str_len = vsnprintf(sb->str ? (sb->str + sb->len) : NULL, avail_size, fmt, args);
+    if (formatted_str_len < 0)
+    {
+        LOG_MSG_ERROR("Failed to generate formatted string!");
+        goto end;
+    }
+
+    if ((size_t)formatted_str_len >= avail_size)
+    {
+        /* Grow buffer. Its size is at least doubled, which keeps the amortized cost of each append operation constant. */
+        size_t new_size = (sb->size ? (sb->size * 2) : 0x400);
+        size_t req_size = (sb->len + (size_t)formatted_str_len + 1);
+        if (new_size < req_size) new_size = req_size;
+
+        char *tmp_str = realloc(sb->str, new_size);
+        if (!tmp_str)
+        {
+            LOG_MSG_ERROR("Failed to resize string builder buffer to 0x%lX byte(s).", new_size);
+            if (sb->str) sb->str[sb->len] = '\0';
+            goto end;
+        }
+
+        sb->str = tmp_str;
+        sb->size = new_size;
+
+        vsnprintf(sb->str + sb->len, sb->size - sb->len, fmt, args_copy);
+    }
+
+    /* Update string length. */
+    sb->len += (size_t)formatted_str_len;
+
+    /* Update output flag. */
+    success = true;
+
+end:
+    va_end(args_copy);
+    va_end(args);
+
+    return success;
+}
+
+void utilsStringBuilderFree(UtilsStringBuilder *sb)
+{
+    if (!sb) return;
+    if (sb->str) free(sb->str);
+    memset(sb, 0, sizeof(UtilsStringBuilder));
+}
+
 void utilsReplaceIllegalCharacters(char *str, bool ascii_only)
 {
     size_t str_size = 0, cur_pos = 0;
@@ -156,6 +156,48 @@ bool pfsReadEntryData(PartitionFileSystemContext *ctx, PartitionFileSystemEntry
     return true;
 }
 
+bool pfsReadEntryDataV(PartitionFileSystemContext *ctx, PartitionFileSystemEntry *fs_entry, const NcaReadRequest *requests, u32 request_count)
+{
+    if (!pfsIsValidContext(ctx) || !fs_entry || !fs_entry->size || (fs_entry->offset + fs_entry->size) > ctx->size || !requests || !request_count)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    NcaReadRequest *storage_requests = NULL;
+    bool success = false;
+
+    storage_requests = calloc(request_count, sizeof(NcaReadRequest));
+    if (!storage_requests)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for NCA storage read requests!");
+        return false;
+    }
+
+    /* Convert entry offsets to NCA FS section offsets. */
+    for(u32 i = 0; i < request_count; i++)
+    {
+        if (!requests[i].out || !requests[i].size || (requests[i].offset + requests[i].size) > fs_entry->size)
+        {
+            LOG_MSG_ERROR("Invalid read request #%u!", i);
+            goto end;
+        }
+
+        storage_requests[i].out = requests[i].out;
+        storage_requests[i].size = requests[i].size;
+        storage_requests[i].offset = (ctx->offset + ctx->header_size + fs_entry->offset + requests[i].offset);
+    }
+
+    /* Read entry data. */
+    success = ncaStorageReadV(&(ctx->storage_ctx), storage_requests, request_count);
+    if (!success) LOG_MSG_ERROR("Failed to read Partition FS entry data!");
+
+end:
+    free(storage_requests);
+
+    return success;
+}
+
 bool pfsGetEntryIndexByName(PartitionFileSystemContext *ctx, const char *name, u32 *out_idx)
 {
     PartitionFileSystemEntry *fs_entry = NULL;
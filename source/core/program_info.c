@@ -27,8 +27,8 @@
 
 /* Helper macros. */
 
-#define PI_ADD_FMT_STR_T1(fmt, ...) utilsAppendFormattedStringToBuffer(&xml_buf, &xml_buf_size, fmt, ##__VA_ARGS__)
-#define PI_ADD_FMT_STR_T2(fmt, ...) utilsAppendFormattedStringToBuffer(xml_buf, xml_buf_size, fmt, ##__VA_ARGS__)
+#define PI_ADD_FMT_STR_T1(fmt, ...) utilsStringBuilderAppendFormatted(&xml_sb, fmt, ##__VA_ARGS__)
+#define PI_ADD_FMT_STR_T2(fmt, ...) utilsStringBuilderAppendFormatted(xml_sb, fmt, ##__VA_ARGS__)
 
 /* Global variables. */
 
@@ -47,21 +47,21 @@ static const char *g_facAccessibilityStrings[] = {
 /* Function prototypes. */
 
 static bool programInfoGetSdkVersionAndBuildTypeFromSdkNso(ProgramInfoContext *program_info_ctx, char **sdk_version, char **build_type);
-static bool programInfoAddNsoApiListToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, ProgramInfoContext *program_info_ctx, const char *api_list_tag, const char *api_entry_prefix, \
+static bool programInfoAddNsoApiListToAuthoringToolXml(UtilsStringBuilder *xml_sb, ProgramInfoContext *program_info_ctx, const char *api_list_tag, const char *api_entry_prefix, \
                                                        const char *sdk_prefix);
 static bool programInfoIsApiInfoEntryValid(const char *sdk_prefix, size_t sdk_prefix_len, char *sdk_entry, char **sdk_entry_vender, int *sdk_entry_vender_len, char **sdk_entry_name, bool nnsdk);
 
-static bool programInfoAddStringFieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, const char *value);
+static bool programInfoAddStringFieldToAuthoringToolXml(UtilsStringBuilder *xml_sb, const char *tag_name, const char *value);
 
-static bool programInfoAddNsoSymbolsToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, ProgramInfoContext *program_info_ctx);
+static bool programInfoAddNsoSymbolsToAuthoringToolXml(UtilsStringBuilder *xml_sb, ProgramInfoContext *program_info_ctx);
 static bool programInfoIsElfSymbolValid(u8 *dynsym_ptr, char *dynstr_base_ptr, u64 dynstr_size, bool is_64bit, char **symbol_str);
 
-static bool programInfoAddFsAccessControlDataToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, ProgramInfoContext *program_info_ctx);
+static bool programInfoAddFsAccessControlDataToAuthoringToolXml(UtilsStringBuilder *xml_sb, ProgramInfoContext *program_info_ctx);
 
 bool programInfoInitializeContext(ProgramInfoContext *out, NcaContext *nca_ctx)
 {
     if (!out || !nca_ctx || !*(nca_ctx->content_id_str) || nca_ctx->content_type != NcmContentType_Program || nca_ctx->content_size < NCA_FULL_HEADER_LENGTH || \
-        (nca_ctx->storage_id != NcmStorageId_GameCard && !nca_ctx->ncm_storage) || (nca_ctx->storage_id == NcmStorageId_GameCard && !nca_ctx->gamecard_offset) || \
+        !contentSourceIsValid(&(nca_ctx->source)) || \
         nca_ctx->header.content_type != NcaContentType_Program || nca_ctx->content_type_ctx || !out)
     {
         LOG_MSG_ERROR("Invalid parameters!");
@@ -166,8 +166,7 @@ bool programInfoGenerateAuthoringToolXml(ProgramInfoContext *program_info_ctx)
         return false;
     }
 
-    char *xml_buf = NULL;
-    u64 xml_buf_size = 0;
+    UtilsStringBuilder xml_sb = {0};
 
     char *sdk_version = NULL, *build_type = NULL;
     bool is_64bit = (program_info_ctx->npdm_ctx.meta_header->flags.is_64bit_instruction == 1);
@@ -212,7 +211,7 @@ bool programInfoGenerateAuthoringToolXml(ProgramInfoContext *program_info_ctx)
                            "<ProgramInfo>\n")) goto end;
 
     /* SdkVersion. */
-    if (!programInfoAddStringFieldToAuthoringToolXml(&xml_buf, &xml_buf_size, "SdkVersion", sdk_version)) goto end;
+    if (!programInfoAddStringFieldToAuthoringToolXml(&xml_sb, "SdkVersion", sdk_version)) goto end;
 
     if (!PI_ADD_FMT_STR_T1("  <ToolVersion />\n"                        /* Impossible to get. */ \
                            "  <NxAddonVersion>%s</NxAddonVersion>\n" \
@@ -222,7 +221,7 @@ bool programInfoGenerateAuthoringToolXml(ProgramInfoContext *program_info_ctx)
                            is_64bit ? 64 : 32)) goto end;
 
     /* BuildType. */
-    if (!programInfoAddStringFieldToAuthoringToolXml(&xml_buf, &xml_buf_size, "BuildType", build_type)) goto end;
+    if (!programInfoAddStringFieldToAuthoringToolXml(&xml_sb, "BuildType", build_type)) goto end;
 
     if (!PI_ADD_FMT_STR_T1("  <EnableDeadStrip />\n"                                /* Impossible to get. */ \
                            "  <EnableDeadStripSpecified />\n"                       /* Impossible to get. */ \
@@ -237,22 +236,22 @@ bool programInfoGenerateAuthoringToolXml(ProgramInfoContext *program_info_ctx)
                            program_info_ctx->npdm_ctx.acid_header->flags.unqualified_approval ? g_trueString : g_falseString)) goto end;
 
     /* MiddlewareList. */
-    if (!programInfoAddNsoApiListToAuthoringToolXml(&xml_buf, &xml_buf_size, program_info_ctx, "Middleware", "Module", "SDK MW")) goto end;
+    if (!programInfoAddNsoApiListToAuthoringToolXml(&xml_sb, program_info_ctx, "Middleware", "Module", "SDK MW")) goto end;
 
     /* DebugApiList. */
-    if (!programInfoAddNsoApiListToAuthoringToolXml(&xml_buf, &xml_buf_size, program_info_ctx, "DebugApi", "Api", "SDK Debug")) goto end;
+    if (!programInfoAddNsoApiListToAuthoringToolXml(&xml_sb, program_info_ctx, "DebugApi", "Api", "SDK Debug")) goto end;
 
     /* PrivateApiList. */
-    if (!programInfoAddNsoApiListToAuthoringToolXml(&xml_buf, &xml_buf_size, program_info_ctx, "PrivateApi", "Api", "SDK Private")) goto end;
+    if (!programInfoAddNsoApiListToAuthoringToolXml(&xml_sb, program_info_ctx, "PrivateApi", "Api", "SDK Private")) goto end;
 
     /* GuidelineApiList. */
-    if (!programInfoAddNsoApiListToAuthoringToolXml(&xml_buf, &xml_buf_size, program_info_ctx, "GuidelineApi", "Api", "SDK Guideline")) goto end;
+    if (!programInfoAddNsoApiListToAuthoringToolXml(&xml_sb, program_info_ctx, "GuidelineApi", "Api", "SDK Guideline")) goto end;
 
     /* UnresolvedApiList. */
-    if (!programInfoAddNsoSymbolsToAuthoringToolXml(&xml_buf, &xml_buf_size, program_info_ctx)) goto end;
+    if (!programInfoAddNsoSymbolsToAuthoringToolXml(&xml_sb, program_info_ctx)) goto end;
 
     /* FsAccessControlData. */
-    if (!programInfoAddFsAccessControlDataToAuthoringToolXml(&xml_buf, &xml_buf_size, program_info_ctx)) goto end;
+    if (!programInfoAddFsAccessControlDataToAuthoringToolXml(&xml_sb, program_info_ctx)) goto end;
 
     if (!(success = PI_ADD_FMT_STR_T1("  <EnableGlobalDestructor />\n"          /* Impossible to get. */ \
                                       "  <EnableGlobalDestructorSpecified />\n" /* Impossible to get. */ \
@@ -263,8 +262,8 @@ bool programInfoGenerateAuthoringToolXml(ProgramInfoContext *program_info_ctx)
                                       "</ProgramInfo>"))) goto end;
 
     /* Update ProgramInfo context. */
-    program_info_ctx->authoring_tool_xml = xml_buf;
-    program_info_ctx->authoring_tool_xml_size = strlen(xml_buf);
+    program_info_ctx->authoring_tool_xml = xml_sb.str;
+    program_info_ctx->authoring_tool_xml_size = xml_sb.len;
 
 end:
     if (npdm_acid_b64) free(npdm_acid_b64);
@@ -275,7 +274,7 @@ end:
 
     if (!success)
     {
-        if (xml_buf) free(xml_buf);
+        utilsStringBuilderFree(&xml_sb);
         LOG_MSG_ERROR("Failed to generate ProgramInfo AuthoringTool XML!");
     }
 
@@ -358,7 +357,7 @@ end:
     return success;
 }
 
-static bool programInfoAddNsoApiListToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, ProgramInfoContext *program_info_ctx, const char *api_list_tag, const char *api_entry_prefix, \
+static bool programInfoAddNsoApiListToAuthoringToolXml(UtilsStringBuilder *xml_sb, ProgramInfoContext *program_info_ctx, const char *api_list_tag, const char *api_entry_prefix, \
                                                        const char *sdk_prefix)
 {
     size_t sdk_prefix_len = 0;
@@ -366,7 +365,7 @@ static bool programInfoAddNsoApiListToAuthoringToolXml(char **xml_buf, u64 *xml_
     char *sdk_entry = NULL, *sdk_entry_vender = NULL, *sdk_entry_name = NULL;
     bool success = false, api_list_exists = false;
 
-    if (!xml_buf || !xml_buf_size || !program_info_ctx || !program_info_ctx->nso_count || !program_info_ctx->nso_ctx || !api_list_tag || !*api_list_tag || !api_entry_prefix || \
+    if (!xml_sb || !program_info_ctx || !program_info_ctx->nso_count || !program_info_ctx->nso_ctx || !api_list_tag || !*api_list_tag || !api_entry_prefix || \
         !*api_entry_prefix || !sdk_prefix || !(sdk_prefix_len = strlen(sdk_prefix)))
     {
         LOG_MSG_ERROR("Invalid parameters!");
@@ -458,9 +457,9 @@ static bool programInfoIsApiInfoEntryValid(const char *sdk_prefix, size_t sdk_pr
     return true;
 }
 
-static bool programInfoAddStringFieldToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, const char *tag_name, const char *value)
+static bool programInfoAddStringFieldToAuthoringToolXml(UtilsStringBuilder *xml_sb, const char *tag_name, const char *value)
 {
-    if (!xml_buf || !xml_buf_size || !tag_name || !*tag_name)
+    if (!xml_sb || !tag_name || !*tag_name)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
@@ -469,9 +468,9 @@ static bool programInfoAddStringFieldToAuthoringToolXml(char **xml_buf, u64 *xml
     return ((value && *value) ? PI_ADD_FMT_STR_T2("  <%s>%s</%s>\n", tag_name, value, tag_name) : PI_ADD_FMT_STR_T2("  <%s />\n", tag_name));
 }
 
-static bool programInfoAddNsoSymbolsToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, ProgramInfoContext *program_info_ctx)
+static bool programInfoAddNsoSymbolsToAuthoringToolXml(UtilsStringBuilder *xml_sb, ProgramInfoContext *program_info_ctx)
 {
-    if (!xml_buf || !xml_buf_size || !program_info_ctx || !program_info_ctx->npdm_ctx.meta_header || !program_info_ctx->nso_count || !program_info_ctx->nso_ctx)
+    if (!xml_sb || !program_info_ctx || !program_info_ctx->npdm_ctx.meta_header || !program_info_ctx->nso_count || !program_info_ctx->nso_ctx)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
@@ -561,14 +560,14 @@ static bool programInfoIsElfSymbolValid(u8 *dynsym_ptr, char *dynstr_base_ptr, u
     return is_valid;
 }
 
-static bool programInfoAddFsAccessControlDataToAuthoringToolXml(char **xml_buf, u64 *xml_buf_size, ProgramInfoContext *program_info_ctx)
+static bool programInfoAddFsAccessControlDataToAuthoringToolXml(UtilsStringBuilder *xml_sb, ProgramInfoContext *program_info_ctx)
 {
     NpdmFsAccessControlData *aci_fac_data = NULL;
     NpdmFsAccessControlDataSaveDataOwnerBlock *save_data_owner_block = NULL;
     u64 *save_data_owner_ids = NULL;
     bool success = false, sdo_data_available = false;
 
-    if (!xml_buf || !xml_buf_size || !program_info_ctx || !(aci_fac_data = program_info_ctx->npdm_ctx.aci_fac_data))
+    if (!xml_sb || !program_info_ctx || !(aci_fac_data = program_info_ctx->npdm_ctx.aci_fac_data))
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
@@ -37,6 +37,7 @@ bool romfsInitializeContext(RomFileSystemContext *out, NcaFsSectionContext *base
 {
     u64 dir_bucket_offset = 0, dir_table_offset = 0;
     u64 file_bucket_offset = 0, file_table_offset = 0;
+    NcaReadRequest table_requests[4] = {0};
     NcaContext *base_nca_ctx = NULL, *patch_nca_ctx = NULL;
     bool dump_fs_header = false, success = false;
 
@@ -109,7 +110,7 @@ bool romfsInitializeContext(RomFileSystemContext *out, NcaFsSectionContext *base
         goto end;
     }
 
-    /* Read directory bucket. */
+    /* Get directory bucket properties. */
     dir_bucket_offset = (is_nca0_romfs ? (u64)out->header.old_format.directory_bucket_offset : out->header.cur_format.directory_bucket_offset);
     out->dir_bucket_size = (is_nca0_romfs ? (u64)out->header.old_format.directory_bucket_size : out->header.cur_format.directory_bucket_size);
 
@@ -127,13 +128,7 @@ bool romfsInitializeContext(RomFileSystemContext *out, NcaFsSectionContext *base
         goto end;
     }
 
-    if (!ncaStorageRead(out->default_storage_ctx, out->dir_bucket, out->dir_bucket_size, out->offset + dir_bucket_offset))
-    {
-        LOG_MSG_ERROR("Failed to read RomFS directory bucket!");
-        goto end;
-    }
-
-    /* Read directory entries table. */
+    /* Get directory entries table properties. */
     dir_table_offset = (is_nca0_romfs ? (u64)out->header.old_format.directory_entry_offset : out->header.cur_format.directory_entry_offset);
     out->dir_table_size = (is_nca0_romfs ? (u64)out->header.old_format.directory_entry_size : out->header.cur_format.directory_entry_size);
 
@@ -151,13 +146,7 @@ bool romfsInitializeContext(RomFileSystemContext *out, NcaFsSectionContext *base
         goto end;
     }
 
-    if (!ncaStorageRead(out->default_storage_ctx, out->dir_table, out->dir_table_size, out->offset + dir_table_offset))
-    {
-        LOG_MSG_ERROR("Failed to read RomFS directory entries table!");
-        goto end;
-    }
-
-    /* Read file bucket. */
+    /* Get file bucket properties. */
     file_bucket_offset = (is_nca0_romfs ? (u64)out->header.old_format.file_bucket_offset : out->header.cur_format.file_bucket_offset);
     out->file_bucket_size = (is_nca0_romfs ? (u64)out->header.old_format.file_bucket_size : out->header.cur_format.file_bucket_size);
 
@@ -175,13 +164,7 @@ bool romfsInitializeContext(RomFileSystemContext *out, NcaFsSectionContext *base
         goto end;
     }
 
-    if (!ncaStorageRead(out->default_storage_ctx, out->file_bucket, out->file_bucket_size, out->offset + file_bucket_offset))
-    {
-        LOG_MSG_ERROR("Failed to read RomFS file bucket!");
-        goto end;
-    }
-
-    /* Read file entries table. */
+    /* Get file entries table properties. */
     file_table_offset = (is_nca0_romfs ? (u64)out->header.old_format.file_entry_offset : out->header.cur_format.file_entry_offset);
     out->file_table_size = (is_nca0_romfs ? (u64)out->header.old_format.file_entry_size : out->header.cur_format.file_entry_size);
 
@@ -199,9 +182,15 @@ bool romfsInitializeContext(RomFileSystemContext *out, NcaFsSectionContext *base
         goto end;
     }
 
-    if (!ncaStorageRead(out->default_storage_ctx, out->file_table, out->file_table_size, out->offset + file_table_offset))
+    /* Read all RomFS tables at once. These are usually stored right next to each other, so they'll most likely be merged into a single read. */
+    table_requests[0] = (NcaReadRequest){ .out = out->dir_bucket,  .size = out->dir_bucket_size,  .offset = (out->offset + dir_bucket_offset)  };
+    table_requests[1] = (NcaReadRequest){ .out = out->dir_table,   .size = out->dir_table_size,   .offset = (out->offset + dir_table_offset)   };
+    table_requests[2] = (NcaReadRequest){ .out = out->file_bucket, .size = out->file_bucket_size, .offset = (out->offset + file_bucket_offset) };
+    table_requests[3] = (NcaReadRequest){ .out = out->file_table,  .size = out->file_table_size,  .offset = (out->offset + file_table_offset)  };
+
+    if (!ncaStorageReadV(out->default_storage_ctx, table_requests, MAX_ELEMENTS(table_requests)))
     {
-        LOG_MSG_ERROR("Failed to read RomFS file entries table!");
+        LOG_MSG_ERROR("Failed to read RomFS directory/file tables!");
         goto end;
     }
 
@@ -38,6 +38,146 @@ static inline u8 save_bitmap_check_bit(const void *buffer, size_t bit_offset)
     return (*((u8*)buffer + (bit_offset >> 3)) & (1 << (bit_offset & 7)));
 }
 
+static bool save_file_read(FIL *file, void *buffer, u64 offset, size_t count)
+{
+    UINT br = 0;
+    FRESULT fr;
+
+    fr = f_lseek(file, offset);
+    if (fr || f_tell(file) != offset)
+    {
+        LOG_MSG_ERROR("Failed to seek to offset 0x%lX in savefile! (%u).", offset, fr);
+        return false;
+    }
+
+    fr = f_read(file, buffer, count, &br);
+    if (fr || br != count)
+    {
+        LOG_MSG_ERROR("Failed to read 0x%lX bytes chunk from offset 0x%lX in savefile! (%u).", count, offset, fr);
+        return false;
+    }
+
+    return true;
+}
+
+static bool save_block_cache_init(save_block_cache_t *cache, FIL *file)
+{
+    if (!cache || !file)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    memset(cache, 0, sizeof(save_block_cache_t));
+
+    cache->data = malloc(SAVE_BLOCK_CACHE_BLOCK_COUNT * SAVE_BLOCK_CACHE_BLOCK_SIZE);
+    if (!cache->data)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for savefile block cache!");
+        return false;
+    }
+
+    cache->file = file;
+
+    return true;
+}
+
+static void save_block_cache_free(save_block_cache_t *cache)
+{
+    if (cache->data) free(cache->data);
+    memset(cache, 0, sizeof(save_block_cache_t));
+}
+
+static u32 save_block_cache_read(save_block_cache_t *cache, void *buffer, u64 offset, size_t count)
+{
+    if (!cache || !cache->file || !cache->data || !buffer || !count)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return 0;
+    }
+
+    u64 file_size = f_size(cache->file);
+    if (offset >= file_size || count > (file_size - offset))
+    {
+        LOG_MSG_ERROR("Read request exceeds savefile size! (0x%lX, 0x%lX).", offset, count);
+        return 0;
+    }
+
+    u64 in_pos = offset;
+    u32 out_pos = 0;
+    u32 remaining = count;
+
+    while(remaining)
+    {
+        u64 block_offset = ALIGN_DOWN(in_pos, SAVE_BLOCK_CACHE_BLOCK_SIZE);
+        u32 block_pos = (u32)(in_pos - block_offset);
+
+        /* Block-aligned reads spanning at least a full block bypass the cache (e.g. duplex layers and allocation tables). */
+        /* Savefiles are never written to, so it doesn't matter if some of these blocks have already been cached. */
+        if (!block_pos && remaining >= SAVE_BLOCK_CACHE_BLOCK_SIZE)
+        {
+            u32 bytes_to_read = ALIGN_DOWN(remaining, SAVE_BLOCK_CACHE_BLOCK_SIZE);
+            if (!save_file_read(cache->file, (u8*)buffer + out_pos, in_pos, bytes_to_read)) return out_pos;
+
+            out_pos += bytes_to_read;
+            in_pos += bytes_to_read;
+            remaining -= bytes_to_read;
+
+            continue;
+        }
+
+        /* Look for this block in our cache. Evict the least recently used one if it's not there. */
+        save_block_cache_entry_t *entry = NULL, *victim = NULL;
+        u32 entry_idx = 0;
+
+        for(u32 i = 0; i < SAVE_BLOCK_CACHE_BLOCK_COUNT; i++)
+        {
+            save_block_cache_entry_t *cur_entry = &(cache->entries[i]);
+
+            if (cur_entry->valid && cur_entry->offset == block_offset)
+            {
+                entry = cur_entry;
+                entry_idx = i;
+                break;
+            }
+
+            if (!victim || (victim->valid && (!cur_entry->valid || cur_entry->last_use < victim->last_use)))
+            {
+                victim = cur_entry;
+                entry_idx = i;
+            }
+        }
+
+        u8 *block_data = NULL;
+
+        if (!entry)
+        {
+            entry = victim;
+            entry->valid = false;
+            entry->offset = block_offset;
+            entry->size = (u32)MIN(file_size - block_offset, SAVE_BLOCK_CACHE_BLOCK_SIZE);
+
+            block_data = (cache->data + (entry_idx * SAVE_BLOCK_CACHE_BLOCK_SIZE));
+            if (!save_file_read(cache->file, block_data, block_offset, entry->size)) return out_pos;
+
+            entry->valid = true;
+        } else {
+            block_data = (cache->data + (entry_idx * SAVE_BLOCK_CACHE_BLOCK_SIZE));
+        }
+
+        entry->last_use = ++(cache->use_counter);
+
+        u32 bytes_to_read = ((entry->size - block_pos) < remaining ? (entry->size - block_pos) : remaining);
+        memcpy((u8*)buffer + out_pos, block_data + block_pos, bytes_to_read);
+
+        out_pos += bytes_to_read;
+        in_pos += bytes_to_read;
+        remaining -= bytes_to_read;
+    }
+
+    return out_pos;
+}
+
 static bool save_duplex_storage_init(duplex_storage_ctx_t *ctx, duplex_fs_layer_info_t *layer, void *bitmap, u64 bitmap_size)
 {
     if (!ctx || !layer || !layer->data_a || !layer->data_b || !layer->info.block_size_power || !bitmap || !bitmap_size)
@@ -239,7 +379,7 @@ static remap_entry_ctx_t *save_remap_get_map_entry(remap_storage_ctx_t *ctx, u64
 
 static u32 save_remap_read(remap_storage_ctx_t *ctx, void *buffer, u64 offset, size_t count)
 {
-    if (!ctx || (ctx->type == STORAGE_BYTES && !ctx->file) || (ctx->type == STORAGE_DUPLEX && !ctx->duplex) || (ctx->type != STORAGE_BYTES && ctx->type != STORAGE_DUPLEX) || !buffer || !count)
+    if (!ctx || (ctx->type == STORAGE_BYTES && !ctx->block_cache) || (ctx->type == STORAGE_DUPLEX && !ctx->duplex) || (ctx->type != STORAGE_BYTES && ctx->type != STORAGE_DUPLEX) || !buffer || !count)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return 0;
@@ -256,8 +396,7 @@ static u32 save_remap_read(remap_storage_ctx_t *ctx, void *buffer, u64 offset, s
     u32 out_pos = 0;
     u32 remaining = count;
 
-    UINT br = 0;
-    FRESULT fr;
+    u32 br = 0;
 
     while(remaining)
     {
@@ -267,17 +406,10 @@ static u32 save_remap_read(remap_storage_ctx_t *ctx, void *buffer, u64 offset, s
         switch (ctx->type)
         {
             case STORAGE_BYTES:
-                fr = f_lseek(ctx->file, ctx->base_storage_offset + entry->physical_offset + entry_pos);
-                if (fr || f_tell(ctx->file) != (ctx->base_storage_offset + entry->physical_offset + entry_pos))
-                {
-                    LOG_MSG_ERROR("Failed to seek to offset 0x%lX in savefile! (%u).", ctx->base_storage_offset + entry->physical_offset + entry_pos, fr);
-                    return out_pos;
-                }
-
-                fr = f_read(ctx->file, (u8*)buffer + out_pos, bytes_to_read, &br);
-                if (fr || br != bytes_to_read)
+                br = save_block_cache_read(ctx->block_cache, (u8*)buffer + out_pos, ctx->base_storage_offset + entry->physical_offset + entry_pos, bytes_to_read);
+                if (br != bytes_to_read)
                 {
-                    LOG_MSG_ERROR("Failed to read %u bytes chunk from offset 0x%lX in savefile! (%u).", bytes_to_read, ctx->base_storage_offset + entry->physical_offset + entry_pos, fr);
+                    LOG_MSG_ERROR("Failed to read %u bytes chunk from offset 0x%lX in savefile!", bytes_to_read, ctx->base_storage_offset + entry->physical_offset + entry_pos);
                     return (out_pos + br);
                 }
 
@@ -423,6 +555,15 @@ static bool save_ivfc_storage_init(hierarchical_integrity_verification_storage_c
 
         ctx->level_validities[i - 1] = level_data->block_validities;
         if (i > 1) level_data->next_level = &ctx->integrity_storages[i - 2];
+
+        /* Scratch buffers are allocated once per level, so IVFC reads don't need to allocate memory. */
+        level_data->sector_buffer = malloc(level_data->sector_size);
+        level_data->hash_buffer = malloc(SAVE_IVFC_HASH_BUFFER_SIZE);
+        if (!level_data->sector_buffer || !level_data->hash_buffer)
+        {
+            LOG_MSG_ERROR("Failed to allocate memory for scratch buffers in IVFC level #%u!", i);
+            goto end;
+        }
     }
 
     ctx->data_level = &levels[ivfc->num_levels - 1];
@@ -440,11 +581,22 @@ end:
         {
             integrity_verification_storage_ctx_t *level_data = &ctx->integrity_storages[i - 1];
 
+            if (level_data->sector_buffer)
+            {
+                free(level_data->sector_buffer);
+                level_data->sector_buffer = NULL;
+            }
+
+            if (level_data->hash_buffer)
+            {
+                free(level_data->hash_buffer);
+                level_data->hash_buffer = NULL;
+            }
+
             if (level_data->block_validities)
             {
                 free(level_data->block_validities);
                 level_data->block_validities = NULL;
-                ctx->level_validities[i - 1] = NULL;
             } else {
                 break;
             }
@@ -456,29 +608,21 @@ end:
 
 static size_t save_ivfc_level_fread(ivfc_level_save_ctx_t *ctx, void *buffer, u64 offset, size_t count)
 {
-    if (!ctx || (ctx->type == STORAGE_BYTES && !ctx->save_ctx->file) || (ctx->type != STORAGE_BYTES && ctx->type != STORAGE_REMAP && ctx->type != STORAGE_JOURNAL) || !buffer || !count)
+    if (!ctx || (ctx->type == STORAGE_BYTES && !ctx->save_ctx->block_cache.data) || (ctx->type != STORAGE_BYTES && ctx->type != STORAGE_REMAP && ctx->type != STORAGE_JOURNAL) || !buffer || !count)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return 0;
     }
 
-    UINT br = 0;
-    FRESULT fr;
+    u32 br = 0;
 
     switch (ctx->type)
     {
         case STORAGE_BYTES:
-            fr = f_lseek(ctx->save_ctx->file, ctx->hash_offset + offset);
-            if (fr || f_tell(ctx->save_ctx->file) != (ctx->hash_offset + offset))
-            {
-                LOG_MSG_ERROR("Failed to seek to offset 0x%lX in savefile! (%u).", ctx->hash_offset + offset, fr);
-                return (size_t)br;
-            }
-
-            fr = f_read(ctx->save_ctx->file, buffer, count, &br);
-            if (fr || br != count)
+            br = save_block_cache_read(&ctx->save_ctx->block_cache, buffer, ctx->hash_offset + offset, count);
+            if (br != count)
             {
-                LOG_MSG_ERROR("Failed to read IVFC level data from offset 0x%lX in savefile! (%u).", ctx->hash_offset + offset, fr);
+                LOG_MSG_ERROR("Failed to read IVFC level data from offset 0x%lX in savefile!", ctx->hash_offset + offset);
                 return (size_t)br;
             }
 
@@ -510,83 +654,119 @@ static size_t save_ivfc_level_fread(ivfc_level_save_ctx_t *ctx, void *buffer, u6
 
 static bool save_ivfc_storage_read(integrity_verification_storage_ctx_t *ctx, void *buffer, u64 offset, size_t count, u32 verify)
 {
-    if (!ctx || !ctx->sector_size || (!ctx->next_level && !ctx->hash_storage && !ctx->base_storage) || !buffer || !count)
+    if (!ctx || !ctx->sector_size || (!ctx->next_level && !ctx->hash_storage && !ctx->base_storage) || !ctx->sector_buffer || !ctx->hash_buffer || !buffer || !count)
     {
         LOG_MSG_ERROR("Invalid parameters!");
         return false;
     }
 
-    if (count > ctx->sector_size)
-    {
-        LOG_MSG_ERROR("IVFC read exceeds sector size!");
-        return false;
-    }
+    u8 *out = (u8*)buffer;
+    u64 sector_size = ctx->sector_size, end_offset = (offset + count);
+    u64 first_block_index = (offset / sector_size), last_block_index = ((end_offset - 1) / sector_size);
+    u32 max_run_sector_count = (SAVE_IVFC_HASH_BUFFER_SIZE / SHA256_HASH_SIZE);
 
-    u64 block_index = (offset / ctx->sector_size);
+    u8 zeroes[SHA256_HASH_SIZE] = {0};
 
-    if (ctx->block_validities[block_index] == VALIDITY_INVALID && verify)
+    if (last_block_index >= ctx->sector_count)
     {
-        LOG_MSG_ERROR("Hash error from previous check found at offset 0x%lX, count 0x%lX!", offset, count);
+        LOG_MSG_ERROR("IVFC read exceeds level size! (0x%lX, 0x%lX).", offset, count);
         return false;
     }
 
-    u8 hash_buffer[0x20] = {0};
-    u8 zeroes[0x20] = {0};
-    u64 hash_pos = (block_index * 0x20);
-
-    if (ctx->next_level)
+    /* Process sectors in runs. The parent level hashes and the data for each run are retrieved in one go. */
+    for(u64 run_block_index = first_block_index; run_block_index <= last_block_index; run_block_index += max_run_sector_count)
     {
-        if (!save_ivfc_storage_read(ctx->next_level, hash_buffer, hash_pos, 0x20, verify))
+        u32 run_sector_count = (u32)MIN(last_block_index - run_block_index + 1, max_run_sector_count);
+        u64 run_data_start = MAX(offset, run_block_index * sector_size);
+        u64 run_data_end = MIN(end_offset, (run_block_index + run_sector_count) * sector_size);
+        u32 run_hash_size = (run_sector_count * SHA256_HASH_SIZE);
+
+        if (verify)
         {
-            LOG_MSG_ERROR("Failed to read hash from next IVFC level!");
-            return false;
+            for(u32 i = 0; i < run_sector_count; i++)
+            {
+                if (ctx->block_validities[run_block_index + i] != VALIDITY_INVALID) continue;
+                LOG_MSG_ERROR("Hash error from previous check found at offset 0x%lX, count 0x%lX!", (run_block_index + i) * sector_size, sector_size);
+                return false;
+            }
         }
-    } else {
-        if (save_ivfc_level_fread(ctx->hash_storage, hash_buffer, hash_pos, 0x20) != 0x20)
+
+        if (ctx->next_level)
         {
-            LOG_MSG_ERROR("Failed to read hash from hash storage!");
+            if (!save_ivfc_storage_read(ctx->next_level, ctx->hash_buffer, run_block_index * SHA256_HASH_SIZE, run_hash_size, verify))
+            {
+                LOG_MSG_ERROR("Failed to read hashes from next IVFC level!");
+                return false;
+            }
+        } else {
+            if (save_ivfc_level_fread(ctx->hash_storage, ctx->hash_buffer, run_block_index * SHA256_HASH_SIZE, run_hash_size) != run_hash_size)
+            {
+                LOG_MSG_ERROR("Failed to read hashes from hash storage!");
+                return false;
+            }
+        }
+
+        if (save_ivfc_level_fread(ctx->base_storage, out + (run_data_start - offset), run_data_start, run_data_end - run_data_start) != (run_data_end - run_data_start))
+        {
+            LOG_MSG_ERROR("Failed to read IVFC level from base storage!");
             return false;
         }
-    }
 
-    if (!memcmp(hash_buffer, zeroes, 0x20))
-    {
-        memset(buffer, 0, count);
-        ctx->block_validities[block_index] = VALIDITY_VALID;
-        return true;
-    }
+        for(u32 i = 0; i < run_sector_count; i++)
+        {
+            u64 block_index = (run_block_index + i);
+            u8 *hash = (ctx->hash_buffer + (i * SHA256_HASH_SIZE));
 
-    if (save_ivfc_level_fread(ctx->base_storage, buffer, offset, count) != count)
-    {
-        LOG_MSG_ERROR("Failed to read IVFC level from base storage!");
-        return false;
-    }
+            u64 sector_start = (block_index * sector_size);
+            u64 data_start = MAX(run_data_start, sector_start);
+            u64 data_end = MIN(run_data_end, sector_start + sector_size);
+            u8 *data = (out + (data_start - offset));
 
-    if (!(verify && ctx->block_validities[block_index] == VALIDITY_UNCHECKED)) return true;
+            /* Sectors with an empty hash are always filled with zeroes. */
+            if (!memcmp(hash, zeroes, SHA256_HASH_SIZE))
+            {
+                memset(data, 0, data_end - data_start);
+                ctx->block_validities[block_index] = VALIDITY_VALID;
+                continue;
+            }
 
-    u8 hash[0x20] = {0};
+            if (!(verify && ctx->block_validities[block_index] == VALIDITY_UNCHECKED)) continue;
 
-    u8 *data_buffer = calloc(1, ctx->sector_size + 0x20);
-    if (!data_buffer)
-    {
-        LOG_MSG_ERROR("Failed to allocate memory for data buffer!");
-        return false;
-    }
+            /* Sectors that were only partially read are read in their entirety into our scratch buffer, so they can be verified. */
+            const u8 *sector = data;
 
-    memcpy(data_buffer, ctx->salt, 0x20);
-    memcpy(data_buffer + 0x20, buffer, ctx->sector_size);
+            if ((data_end - data_start) != sector_size)
+            {
+                u64 sector_read_size = MIN(ctx->_length - sector_start, sector_size);
 
-    sha256CalculateHash(hash, data_buffer, ctx->sector_size + 0x20);
-    hash[0x1F] |= 0x80;
+                if (sector_read_size < sector_size) memset(ctx->sector_buffer + sector_read_size, 0, sector_size - sector_read_size);
 
-    free(data_buffer);
+                if (save_ivfc_level_fread(ctx->base_storage, ctx->sector_buffer, sector_start, sector_read_size) != sector_read_size)
+                {
+                    LOG_MSG_ERROR("Failed to read IVFC sector from base storage!");
+                    return false;
+                }
 
-    ctx->block_validities[block_index] = (!memcmp(hash_buffer, hash, 0x20) ? VALIDITY_VALID : VALIDITY_INVALID);
+                sector = ctx->sector_buffer;
+            }
 
-    if (ctx->block_validities[block_index] == VALIDITY_INVALID && verify)
-    {
-        LOG_MSG_ERROR("Hash error from current check found at offset 0x%lX, count 0x%lX!", offset, count);
-        return false;
+            Sha256Context sha256_ctx = {0};
+            u8 calc_hash[SHA256_HASH_SIZE] = {0};
+
+            sha256ContextCreate(&sha256_ctx);
+            sha256ContextUpdate(&sha256_ctx, ctx->salt, sizeof(ctx->salt));
+            sha256ContextUpdate(&sha256_ctx, sector, sector_size);
+            sha256ContextGetHash(&sha256_ctx, calc_hash);
+            calc_hash[0x1F] |= 0x80;
+
+            ctx->block_validities[block_index] = (!memcmp(hash, calc_hash, SHA256_HASH_SIZE) ? VALIDITY_VALID : VALIDITY_INVALID);
+
+            if (ctx->block_validities[block_index] == VALIDITY_INVALID)
+            {
+                LOG_MSG_ERROR("Hash error from current check found at offset 0x%lX, count 0x%lX!", sector_start, sector_size);
+                return false;
+            }
+        }
     }
 
     return true;
@@ -809,21 +989,12 @@ u32 save_allocation_table_storage_read(allocation_table_storage_ctx_t *ctx, void
         u32 remaining_in_segment = ((iterator.current_segment_size * ctx->block_size) - segment_pos);
         u32 bytes_to_read = (remaining < remaining_in_segment ? remaining : remaining_in_segment);
 
-        u32 sector_size = ctx->base_storage->integrity_storages[3].sector_size;
-        u32 chunk_remaining = bytes_to_read;
-
-        for(u32 i = 0; i < bytes_to_read; i += sector_size)
+        /* The whole segment chunk is requested at once. The IVFC storage takes care of splitting it into sector runs. */
+        if (!save_ivfc_storage_read(&ctx->base_storage->integrity_storages[3], (u8*)buffer + out_pos, physical_offset, bytes_to_read, \
+                                    ctx->base_storage->data_level->save_ctx->tool_ctx.action & ACTION_VERIFY))
         {
-            u32 bytes_to_request = (chunk_remaining < sector_size ? chunk_remaining : sector_size);
-
-            if (!save_ivfc_storage_read(&ctx->base_storage->integrity_storages[3], (u8*)buffer + out_pos + i, physical_offset + i, bytes_to_request, \
-                                        ctx->base_storage->data_level->save_ctx->tool_ctx.action & ACTION_VERIFY))
-            {
-                LOG_MSG_ERROR("Failed to read %u bytes chunk from IVFC storage at physical offset 0x%lX!", bytes_to_request, physical_offset + i);
-                return (out_pos + bytes_to_read - chunk_remaining);
-            }
-
-            chunk_remaining -= bytes_to_request;
+            LOG_MSG_ERROR("Failed to read %u bytes chunk from IVFC storage at physical offset 0x%lX!", bytes_to_read, physical_offset);
+            return out_pos;
         }
 
         out_pos += bytes_to_read;
@@ -1267,32 +1438,33 @@ bool save_process(save_ctx_t *ctx)
 
     ctx->header_cmac_validity = (!memcmp(cmac, &ctx->header.cmac, 0x10) ? VALIDITY_VALID : VALIDITY_INVALID);
 
+    /* Initialize savefile block cache. */
+    if (!save_block_cache_init(&ctx->block_cache, ctx->file))
+    {
+        LOG_MSG_ERROR("Failed to initialize savefile block cache!");
+        return success;
+    }
+
     /* Initialize remap storages. */
     ctx->data_remap_storage.type = STORAGE_BYTES;
     ctx->data_remap_storage.base_storage_offset = ctx->header.layout.file_map_data_offset;
     ctx->data_remap_storage.header = &ctx->header.main_remap_header;
     ctx->data_remap_storage.file = ctx->file;
+    ctx->data_remap_storage.block_cache = &ctx->block_cache;
 
     ctx->data_remap_storage.map_entries = calloc(sizeof(remap_entry_ctx_t), ctx->data_remap_storage.header->map_entry_count);
     if (!ctx->data_remap_storage.map_entries)
     {
         LOG_MSG_ERROR("Failed to allocate memory for data remap storage entries!");
-        return success;
-    }
-
-    fr = f_lseek(ctx->file, ctx->header.layout.file_map_entry_offset);
-    if (fr || f_tell(ctx->file) != ctx->header.layout.file_map_entry_offset)
-    {
-        LOG_MSG_ERROR("Failed to seek to file map entry offset 0x%lX in savefile! (%u).", ctx->header.layout.file_map_entry_offset, fr);
-        return success;
+        goto end;
     }
 
+    /* Map entries are read through the block cache, which avoids issuing a tiny read for each one of them. */
     for(u32 i = 0; i < ctx->data_remap_storage.header->map_entry_count; i++)
     {
-        fr = f_read(ctx->file, &ctx->data_remap_storage.map_entries[i], 0x20, &br);
-        if (fr || br != 0x20)
+        if (save_block_cache_read(&ctx->block_cache, &ctx->data_remap_storage.map_entries[i], ctx->header.layout.file_map_entry_offset + (i * 0x20), 0x20) != 0x20)
         {
-            LOG_MSG_ERROR("Failed to read data remap storage entry #%u! (%u).", i, fr);
+            LOG_MSG_ERROR("Failed to read data remap storage entry #%u!", i);
             goto end;
         }
 
@@ -1417,19 +1589,11 @@ bool save_process(save_ctx_t *ctx)
         goto end;
     }
 
-    fr = f_lseek(ctx->file, ctx->header.layout.meta_map_entry_offset);
-    if (fr || f_tell(ctx->file) != ctx->header.layout.meta_map_entry_offset)
-    {
-        LOG_MSG_ERROR("Failed to seek to meta map entry offset 0x%lX in savefile! (%u).", ctx->header.layout.meta_map_entry_offset, fr);
-        goto end;
-    }
-
     for(u32 i = 0; i < ctx->meta_remap_storage.header->map_entry_count; i++)
     {
-        fr = f_read(ctx->file, &ctx->meta_remap_storage.map_entries[i], 0x20, &br);
-        if (fr || br != 0x20)
+        if (save_block_cache_read(&ctx->block_cache, &ctx->meta_remap_storage.map_entries[i], ctx->header.layout.meta_map_entry_offset + (i * 0x20), 0x20) != 0x20)
         {
-            LOG_MSG_ERROR("Failed to read meta remap storage entry #%u! (%u).", i, fr);
+            LOG_MSG_ERROR("Failed to read meta remap storage entry #%u!", i);
             goto end;
         }
 
@@ -1680,10 +1844,24 @@ void save_free_contexts(save_ctx_t *ctx)
 
     for(u32 i = 0; i < ctx->header.data_ivfc_header.num_levels - 1; i++)
     {
-        if (ctx->core_data_ivfc_storage.integrity_storages[i].block_validities)
+        integrity_verification_storage_ctx_t *level_data = &ctx->core_data_ivfc_storage.integrity_storages[i];
+
+        if (level_data->block_validities)
+        {
+            free(level_data->block_validities);
+            level_data->block_validities = NULL;
+        }
+
+        if (level_data->sector_buffer)
+        {
+            free(level_data->sector_buffer);
+            level_data->sector_buffer = NULL;
+        }
+
+        if (level_data->hash_buffer)
         {
-            free(ctx->core_data_ivfc_storage.integrity_storages[i].block_validities);
-            ctx->core_data_ivfc_storage.integrity_storages[i].block_validities = NULL;
+            free(level_data->hash_buffer);
+            level_data->hash_buffer = NULL;
         }
     }
 
@@ -1697,10 +1875,24 @@ void save_free_contexts(save_ctx_t *ctx)
     {
         for(u32 i = 0; i < ctx->header.fat_ivfc_header.num_levels - 1; i++)
         {
-            if (ctx->fat_ivfc_storage.integrity_storages[i].block_validities)
+            integrity_verification_storage_ctx_t *level_data = &ctx->fat_ivfc_storage.integrity_storages[i];
+
+            if (level_data->block_validities)
             {
-                free(ctx->fat_ivfc_storage.integrity_storages[i].block_validities);
-                ctx->fat_ivfc_storage.integrity_storages[i].block_validities = NULL;
+                free(level_data->block_validities);
+                level_data->block_validities = NULL;
+            }
+
+            if (level_data->sector_buffer)
+            {
+                free(level_data->sector_buffer);
+                level_data->sector_buffer = NULL;
+            }
+
+            if (level_data->hash_buffer)
+            {
+                free(level_data->hash_buffer);
+                level_data->hash_buffer = NULL;
             }
         }
     }
@@ -1716,6 +1908,8 @@ void save_free_contexts(save_ctx_t *ctx)
         free(ctx->fat_storage);
         ctx->fat_storage = NULL;
     }
+
+    save_block_cache_free(&ctx->block_cache);
 }
 
 save_ctx_t *save_open_savefile(const char *path, u32 action)
@@ -40,6 +40,8 @@
 #define TIK_COMMON_CERT_NAME            "XS00000020"
 #define TIK_DEV_CERT_ISSUER             "CA00000004"
 
+#define TIK_LIST_INDEX_MIN_CAPACITY     0x40
+
 /* Type definitions. */
 
 /// Used to parse ticket_list.bin entries.
@@ -52,6 +54,23 @@ typedef struct {
 
 NXDT_ASSERT(TikListEntry, 0x20);
 
+/// Used to build a rights ID -> ticket offset hash table from ticket_list.bin entries.
+typedef struct {
+    FsRightsId rights_id;
+    u64 ticket_offset;  ///< Ticket offset within ticket.bin.
+    bool occupied;
+} TikListIndexEntry;
+
+/// Holds an opened ES system savefile and the ticket_list.bin index built from it.
+/// Both are kept around across ticket lookups to avoid reopening the savefile and rescanning ticket_list.bin every time.
+typedef struct {
+    save_ctx_t *save_ctx;
+    TikListIndexEntry *entries; ///< Open addressing hash table. Uses linear probing.
+    u32 capacity;               ///< Always a power of two.
+    u32 count;
+    u8 header_cmacs[2][0x10];   ///< CMACs from both savefile headers, taken right before the savefile was opened. Used to detect savefile changes.
+} TikEsSaveDataIndex;
+
 /// 9.x+ CTR key entry in ES .data segment. Used to store CTR key/IV data for encrypted volatile tickets in ticket.bin and/or encrypted entries in ticket_list.bin.
 /// This is always stored in pairs. The first entry holds the key/IV for the encrypted volatile ticket, while the second entry holds the key/IV for the encrypted entry in ticket_list.bin.
 /// First index in this list is always 0.
@@ -75,6 +94,7 @@ NXDT_ASSERT(TikEsCtrKeyPattern9x, 0x28);
 /* Global variables. */
 
 static Mutex g_esTikSaveMutex = 0;
+static TikEsSaveDataIndex g_esTikSaveDataIndexes[TikTitleKeyType_Count] = {0};
 
 #if LOG_LEVEL <= LOG_LEVEL_ERROR
 static const char *g_tikTitleKeyTypeStrings[] = {
@@ -104,7 +124,16 @@ static bool tikGetDecryptedTitleKey(void *dst, const void *src, u8 key_generatio
 static bool tikGetTitleKeyTypeFromRightsId(const FsRightsId *id, u8 *out);
 static bool tikRetrieveRightsIdsByTitleKeyType(FsRightsId **out, u32 *out_count, bool personalized);
 
-static bool tikGetTicketEntryOffsetFromTicketList(save_ctx_t *save_ctx, u8 *buf, u64 buf_size, const FsRightsId *id, u8 titlekey_type, u64 *out_offset);
+static bool tikOpenEsSaveDataIndex(u8 titlekey_type);
+static void tikCloseEsSaveDataIndex(u8 titlekey_type);
+static bool tikIsEsSaveDataIndexOutdated(u8 titlekey_type);
+static bool tikReadEsSaveDataHeaderCmacs(u8 titlekey_type, u8 out[2][0x10]);
+
+static bool tikBuildTicketListIndex(TikEsSaveDataIndex *index, u8 titlekey_type);
+static bool tikInsertTicketListIndexEntry(TikEsSaveDataIndex *index, const FsRightsId *id, u64 ticket_offset);
+static bool tikGetTicketEntryOffsetFromTicketListIndex(TikEsSaveDataIndex *index, const FsRightsId *id, u64 *out_offset);
+NX_INLINE u32 tikGetTicketListIndexHash(const FsRightsId *id, u32 capacity);
+
 static bool tikRetrieveTicketEntryFromTicketBin(save_ctx_t *save_ctx, u8 *buf, u64 buf_size, const FsRightsId *id, u8 titlekey_type, u64 ticket_offset);
 static bool tikDecryptVolatileTicket(u8 *buf, u64 ticket_offset);
 
@@ -267,6 +296,14 @@ bool tikConvertPersonalizedTicketToCommonTicket(Ticket *tik, u8 **out_raw_cert_c
     return true;
 }
 
+void tikCloseEsSystemSavefiles(void)
+{
+    SCOPED_LOCK(&g_esTikSaveMutex)
+    {
+        for(u8 i = TikTitleKeyType_Common; i < TikTitleKeyType_Count; i++) tikCloseEsSaveDataIndex(i);
+    }
+}
+
 static bool tikRetrieveTicketFromGameCardByRightsId(Ticket *dst, const FsRightsId *id)
 {
     if (!dst || !id)
@@ -320,18 +357,17 @@ static bool tikRetrieveTicketFromEsSaveDataByRightsId(Ticket *dst, const FsRight
 
     u8 titlekey_type = 0;
 
-    save_ctx_t *save_ctx = NULL;
+    TikEsSaveDataIndex *index = NULL;
 
-    u64 buf_size = (SIGNED_TIK_MAX_SIZE * 0x100);
     u8 *buf = NULL;
     u64 ticket_offset = 0;
 
-    bool success = false;
+    bool found = false, success = false;
 
     /* Allocate memory to retrieve the ticket. */
-    if (!(buf = malloc(buf_size)))
+    if (!(buf = malloc(SIGNED_TIK_MAX_SIZE)))
     {
-        LOG_MSG_ERROR("Unable to allocate 0x%lX bytes block for temporary read buffer!", buf_size);
+        LOG_MSG_ERROR("Unable to allocate 0x%X bytes block for temporary read buffer!", SIGNED_TIK_MAX_SIZE);
         goto end;
     }
 
@@ -342,24 +378,42 @@ static bool tikRetrieveTicketFromEsSaveDataByRightsId(Ticket *dst, const FsRight
         goto end;
     }
 
-    /* Open ES common/personalized system savefile. */
-    if (!(save_ctx = save_open_savefile(titlekey_type == TikTitleKeyType_Common ? TIK_COMMON_SAVEFILE_PATH : TIK_PERSONALIZED_SAVEFILE_PATH, 0)))
+    index = &(g_esTikSaveDataIndexes[titlekey_type]);
+
+    /* Get ticket entry offset from our ticket_list.bin index. */
+    /* If it can't be found, the ticket may have been installed after the index was built, so we'll rebuild it once. */
+    /* This is only done if the savefile has actually been modified since then. Otherwise, lookups for missing tickets would rebuild the index every time. */
+    for(u8 i = 0; i < 2 && !found; i++)
     {
-        LOG_MSG_ERROR("Failed to open ES %s ticket system savefile!", g_tikTitleKeyTypeStrings[titlekey_type]);
-        goto end;
+        if (i > 0)
+        {
+            if (!tikIsEsSaveDataIndexOutdated(titlekey_type)) break;
+            tikCloseEsSaveDataIndex(titlekey_type);
+        }
+
+        if (!tikOpenEsSaveDataIndex(titlekey_type))
+        {
+            LOG_MSG_ERROR("Failed to open ES %s ticket system savefile!", g_tikTitleKeyTypeStrings[titlekey_type]);
+            goto end;
+        }
+
+        found = tikGetTicketEntryOffsetFromTicketListIndex(index, id, &ticket_offset);
     }
 
-    /* Get ticket entry offset from ticket_list.bin. */
-    if (!tikGetTicketEntryOffsetFromTicketList(save_ctx, buf, buf_size, id, titlekey_type, &ticket_offset))
+    if (!found)
     {
         LOG_MSG_ERROR("Unable to find an entry with a matching Rights ID in \"%s\" from ES %s ticket system save!", TIK_LIST_STORAGE_PATH, g_tikTitleKeyTypeStrings[titlekey_type]);
         goto end;
     }
 
     /* Get ticket entry from ticket.bin. */
-    if (!tikRetrieveTicketEntryFromTicketBin(save_ctx, buf, buf_size, id, titlekey_type, ticket_offset))
+    if (!tikRetrieveTicketEntryFromTicketBin(index->save_ctx, buf, SIGNED_TIK_MAX_SIZE, id, titlekey_type, ticket_offset))
     {
         LOG_MSG_ERROR("Unable to find a matching %s ticket entry for the provided Rights ID!", g_tikTitleKeyTypeStrings[titlekey_type]);
+
+        /* Our index may be outdated. Make sure it gets rebuilt on the next lookup. */
+        tikCloseEsSaveDataIndex(titlekey_type);
+
         goto end;
     }
 
@@ -374,8 +428,6 @@ static bool tikRetrieveTicketFromEsSaveDataByRightsId(Ticket *dst, const FsRight
     memcpy(dst->data, buf, dst->size);
 
 end:
-    if (save_ctx) save_close_savefile(save_ctx);
-
     if (buf) free(buf);
 
     return success;
@@ -644,16 +696,111 @@ end:
     return success;
 }
 
-static bool tikGetTicketEntryOffsetFromTicketList(save_ctx_t *save_ctx, u8 *buf, u64 buf_size, const FsRightsId *id, u8 titlekey_type, u64 *out_offset)
+static bool tikOpenEsSaveDataIndex(u8 titlekey_type)
+{
+    TikEsSaveDataIndex *index = &(g_esTikSaveDataIndexes[titlekey_type]);
+
+    /* Check if we have already opened this savefile. */
+    if (index->save_ctx && index->entries) return true;
+
+    /* Free index beforehand. */
+    tikCloseEsSaveDataIndex(titlekey_type);
+
+    /* Take a snapshot of the savefile header CMACs before opening it. Any changes made past this point will be detected by tikIsEsSaveDataIndexOutdated(). */
+    /* If this fails, the snapshot stays zeroed out and the index will be considered outdated on the next lookup miss. */
+    tikReadEsSaveDataHeaderCmacs(titlekey_type, index->header_cmacs);
+
+    /* Open ES common/personalized system savefile. */
+    if (!(index->save_ctx = save_open_savefile(titlekey_type == TikTitleKeyType_Common ? TIK_COMMON_SAVEFILE_PATH : TIK_PERSONALIZED_SAVEFILE_PATH, 0)))
+    {
+        LOG_MSG_ERROR("Failed to open ES %s ticket system savefile!", g_tikTitleKeyTypeStrings[titlekey_type]);
+        return false;
+    }
+
+    /* Build ticket_list.bin index. */
+    if (!tikBuildTicketListIndex(index, titlekey_type))
+    {
+        LOG_MSG_ERROR("Failed to build \"%s\" index for ES %s ticket system save!", TIK_LIST_STORAGE_PATH, g_tikTitleKeyTypeStrings[titlekey_type]);
+        tikCloseEsSaveDataIndex(titlekey_type);
+        return false;
+    }
+
+    return true;
+}
+
+static void tikCloseEsSaveDataIndex(u8 titlekey_type)
 {
-    if (!save_ctx || !buf || !buf_size || (buf_size % sizeof(TikListEntry)) != 0 || !id || titlekey_type >= TikTitleKeyType_Count || !out_offset)
+    TikEsSaveDataIndex *index = &(g_esTikSaveDataIndexes[titlekey_type]);
+
+    if (index->save_ctx) save_close_savefile(index->save_ctx);
+    if (index->entries) free(index->entries);
+
+    memset(index, 0, sizeof(TikEsSaveDataIndex));
+}
+
+static bool tikIsEsSaveDataIndexOutdated(u8 titlekey_type)
+{
+    TikEsSaveDataIndex *index = &(g_esTikSaveDataIndexes[titlekey_type]);
+    u8 header_cmacs[2][0x10] = {0};
+
+    /* Play it safe if we can't read the savefile headers. */
+    if (!tikReadEsSaveDataHeaderCmacs(titlekey_type, header_cmacs)) return true;
+
+    /* Savefile headers are rewritten (and their CMACs updated) every time the savefile is committed. */
+    return (memcmp(header_cmacs, index->header_cmacs, sizeof(header_cmacs)) != 0);
+}
+
+static bool tikReadEsSaveDataHeaderCmacs(u8 titlekey_type, u8 out[2][0x10])
+{
+    const char *path = (titlekey_type == TikTitleKeyType_Common ? TIK_COMMON_SAVEFILE_PATH : TIK_PERSONALIZED_SAVEFILE_PATH);
+    FIL save_fd = {0};
+    FRESULT fr = FR_OK;
+    UINT br = 0;
+    bool success = false;
+
+    /* Use a separate file descriptor. The one from our savefile context may hold stale cached data. */
+    fr = f_open(&save_fd, path, FA_READ | FA_OPEN_EXISTING);
+    if (fr != FR_OK)
     {
-        LOG_MSG_ERROR("Invalid parameters!");
+        LOG_MSG_ERROR("Failed to open \"%s\" savefile from BIS System partition! (%u).", path, fr);
         return false;
     }
 
+    /* Read the CMAC from both savefile headers. Each one is located at the start of its own header block. */
+    for(u8 i = 0; i < 2; i++)
+    {
+        fr = f_lseek(&save_fd, (FSIZE_t)i * SAVE_HEADER_SIZE);
+        if (fr != FR_OK || f_tell(&save_fd) != ((FSIZE_t)i * SAVE_HEADER_SIZE))
+        {
+            LOG_MSG_ERROR("Failed to seek to header %c in \"%s\" savefile! (%u).", 'A' + i, path, fr);
+            goto end;
+        }
+
+        fr = f_read(&save_fd, out[i], 0x10, &br);
+        if (fr != FR_OK || br != 0x10)
+        {
+            LOG_MSG_ERROR("Failed to read header %c CMAC from \"%s\" savefile! (%u).", 'A' + i, path, fr);
+            goto end;
+        }
+    }
+
+    success = true;
+
+end:
+    f_close(&save_fd);
+
+    if (!success) memset(out, 0, sizeof(u8) * 2 * 0x10);
+
+    return success;
+}
+
+static bool tikBuildTicketListIndex(TikEsSaveDataIndex *index, u8 titlekey_type)
+{
     allocation_table_storage_ctx_t fat_storage = {0};
-    u64 ticket_list_bin_size = 0, br = 0, total_br = 0;
+    u64 ticket_list_bin_size = 0, max_entry_count = 0, br = 0, total_br = 0;
+
+    u64 buf_size = (SIGNED_TIK_MAX_SIZE * 0x100);
+    u8 *buf = NULL;
 
     u8 last_rights_id[0x10] = {0};
     memset(last_rights_id, 0xFF, sizeof(last_rights_id));
@@ -661,7 +808,7 @@ static bool tikGetTicketEntryOffsetFromTicketList(save_ctx_t *save_ctx, u8 *buf,
     bool last_entry_found = false, success = false;
 
     /* Get FAT storage info for the ticket_list.bin stored within the opened system savefile. */
-    if (!save_get_fat_storage_from_file_entry_by_path(save_ctx, TIK_LIST_STORAGE_PATH, &fat_storage, &ticket_list_bin_size))
+    if (!save_get_fat_storage_from_file_entry_by_path(index->save_ctx, TIK_LIST_STORAGE_PATH, &fat_storage, &ticket_list_bin_size))
     {
         LOG_MSG_ERROR("Failed to locate \"%s\" in ES %s ticket system save!", TIK_LIST_STORAGE_PATH, g_tikTitleKeyTypeStrings[titlekey_type]);
         goto end;
@@ -674,7 +821,26 @@ static bool tikGetTicketEntryOffsetFromTicketList(save_ctx_t *save_ctx, u8 *buf,
         goto end;
     }
 
-    /* Look for an entry matching our rights ID in ticket_list.bin. */
+    /* Allocate memory for our hash table. Keep its load factor at 50% or lower. */
+    max_entry_count = (ticket_list_bin_size / sizeof(TikListEntry));
+
+    index->capacity = TIK_LIST_INDEX_MIN_CAPACITY;
+    while(index->capacity < (max_entry_count * 2)) index->capacity <<= 1;
+
+    if (!(index->entries = calloc(index->capacity, sizeof(TikListIndexEntry))))
+    {
+        LOG_MSG_ERROR("Unable to allocate memory for %u-entry \"%s\" index!", index->capacity, TIK_LIST_STORAGE_PATH);
+        goto end;
+    }
+
+    /* Allocate memory for our read buffer. */
+    if (!(buf = malloc(buf_size)))
+    {
+        LOG_MSG_ERROR("Unable to allocate 0x%lX bytes block for temporary read buffer!", buf_size);
+        goto end;
+    }
+
+    /* Add all ticket_list.bin entries to our index. */
     while(total_br < ticket_list_bin_size)
     {
         /* Update chunk size, if needed. */
@@ -684,7 +850,7 @@ static bool tikGetTicketEntryOffsetFromTicketList(save_ctx_t *save_ctx, u8 *buf,
         if ((br = save_allocation_table_storage_read(&fat_storage, buf, total_br, buf_size)) != buf_size)
         {
             LOG_MSG_ERROR("Failed to read 0x%lX bytes chunk at offset 0x%lX from \"%s\" in ES %s ticket system save!", buf_size, total_br, TIK_LIST_STORAGE_PATH, g_tikTitleKeyTypeStrings[titlekey_type]);
-            break;
+            goto end;
         }
 
         /* Process individual ticket list entries. */
@@ -702,25 +868,86 @@ static bool tikGetTicketEntryOffsetFromTicketList(save_ctx_t *save_ctx, u8 *buf,
                 break;
             }
 
-            /* Check if this is the entry we're looking for. */
-            if (!memcmp(entry->rights_id.c, id->c, sizeof(id->c)))
+            /* Add this entry to our index. */
+            /* (entry_offset / sizeof(TikListEntry)) * SIGNED_TIK_MAX_SIZE */
+            if (!tikInsertTicketListIndexEntry(index, &(entry->rights_id), entry_offset << 5))
             {
-                /* Jackpot. */
-                *out_offset = (entry_offset << 5); /* (entry_offset / sizeof(TikListEntry)) * SIGNED_TIK_MAX_SIZE */
-                success = true;
-                break;
+                LOG_MSG_ERROR("Failed to add entry at offset 0x%lX from \"%s\" to our index!", entry_offset, TIK_LIST_STORAGE_PATH);
+                goto end;
             }
         }
 
         total_br += br;
 
-        if (last_entry_found || success) break;
+        if (last_entry_found) break;
     }
 
+    success = true;
+
+    LOG_MSG_DEBUG("Indexed %u entries from \"%s\" in ES %s ticket system save.", index->count, TIK_LIST_STORAGE_PATH, g_tikTitleKeyTypeStrings[titlekey_type]);
+
 end:
+    if (buf) free(buf);
+
     return success;
 }
 
+static bool tikInsertTicketListIndexEntry(TikEsSaveDataIndex *index, const FsRightsId *id, u64 ticket_offset)
+{
+    if (index->count >= (index->capacity - 1)) return false;
+
+    u32 mask = (index->capacity - 1), pos = tikGetTicketListIndexHash(id, index->capacity);
+
+    while(index->entries[pos].occupied)
+    {
+        /* Keep the first entry if a rights ID is listed more than once. */
+        if (!memcmp(index->entries[pos].rights_id.c, id->c, sizeof(id->c))) return true;
+        pos = ((pos + 1) & mask);
+    }
+
+    TikListIndexEntry *entry = &(index->entries[pos]);
+
+    memcpy(&(entry->rights_id), id, sizeof(FsRightsId));
+    entry->ticket_offset = ticket_offset;
+    entry->occupied = true;
+
+    index->count++;
+
+    return true;
+}
+
+static bool tikGetTicketEntryOffsetFromTicketListIndex(TikEsSaveDataIndex *index, const FsRightsId *id, u64 *out_offset)
+{
+    if (!index->entries || !index->capacity) return false;
+
+    u32 mask = (index->capacity - 1), pos = tikGetTicketListIndexHash(id, index->capacity);
+
+    while(index->entries[pos].occupied)
+    {
+        if (!memcmp(index->entries[pos].rights_id.c, id->c, sizeof(id->c)))
+        {
+            /* Jackpot. */
+            *out_offset = index->entries[pos].ticket_offset;
+            return true;
+        }
+
+        pos = ((pos + 1) & mask);
+    }
+
+    return false;
+}
+
+NX_INLINE u32 tikGetTicketListIndexHash(const FsRightsId *id, u32 capacity)
+{
+    u64 hi = 0, lo = 0;
+
+    memcpy(&hi, id->c, sizeof(u64));
+    memcpy(&lo, id->c + sizeof(u64), sizeof(u64));
+
+    /* Fibonacci hashing. 'capacity' is always a power of two. */
+    return (u32)(((hi ^ lo) * 0x9E3779B97F4A7C15ULL) >> (64 - __builtin_ctz(capacity)));
+}
+
 static bool tikRetrieveTicketEntryFromTicketBin(save_ctx_t *save_ctx, u8 *buf, u64 buf_size, const FsRightsId *id, u8 titlekey_type, u64 ticket_offset)
 {
     if (!save_ctx || !buf || buf_size < SIGNED_TIK_MAX_SIZE || !id || titlekey_type >= TikTitleKeyType_Count || (ticket_offset % SIGNED_TIK_MAX_SIZE) != 0)
@@ -31,6 +31,8 @@
 
 #define NCM_CMT_APP_OFFSET                  0x7A
 
+#define TITLE_METADATA_INDEX_MIN_CAPACITY   0x40
+
 /* Type definitions. */
 
 typedef struct {
@@ -46,6 +48,14 @@ typedef struct {
     u32 title_count;
 } TitleStorage;
 
+/// Used by titleUpdateTitleInfoLinkedLists() to group sibling title info entries.
+typedef struct {
+    TitleInfo *title_info;
+    u64 group_id;   ///< Title ID for user applications and patches. Application ID for add-on contents and add-on content patches.
+    u32 order;      ///< Position of this entry across all title storages.
+    bool link;      ///< Set to false if this entry must not be linked to its previous sibling (e.g. orphan titles). It may still be linked to its next sibling.
+} TitleLinkEntry;
+
 /* Global variables. */
 
 static Mutex g_titleMutex = 0;
@@ -59,6 +69,10 @@ static NsApplicationControlData *g_nsAppControlData = NULL;
 static TitleApplicationMetadata **g_systemMetadata = NULL, **g_userMetadata = NULL;
 static u32 g_systemMetadataCount = 0, g_userMetadataCount = 0;
 
+/* Open addressing hash table with pointers to user application metadata entries, keyed by title ID. Used because g_userMetadata is sorted by name. */
+static TitleApplicationMetadata **g_userMetadataIndex = NULL;
+static u32 g_userMetadataIndexCapacity = 0;
+
 static TitleStorage g_titleStorage[TITLE_STORAGE_COUNT] = {0};
 
 static TitleInfo **g_orphanTitleInfo = NULL;
@@ -552,6 +566,10 @@ static bool titleRetrieveUserApplicationMetadataByTitleId(u64 title_id, TitleApp
 
 NX_INLINE TitleApplicationMetadata *titleFindApplicationMetadataByTitleId(u64 title_id, bool is_system, u32 extra_app_count);
 
+static void titleRebuildUserApplicationMetadataIndex(void);
+NX_INLINE void titleFreeUserApplicationMetadataIndex(void);
+NX_INLINE u32 titleGetTitleIdHash(u64 title_id, u32 capacity);
+
 NX_INLINE u64 titleGetApplicationIdByContentMetaKey(const NcmContentMetaKey *meta_key);
 
 static bool titleGenerateTitleInfoEntriesForTitleStorage(TitleStorage *title_storage);
@@ -568,6 +586,7 @@ static bool titleRefreshGameCardTitleInfo(void);
 
 static bool titleIsUserApplicationContentAvailable(u64 app_id);
 static TitleInfo *_titleGetInfoFromStorageByTitleId(u8 storage_id, u64 title_id);
+static TitleInfo *titleFindInfoInStorageByTitleId(TitleStorage *title_storage, u64 title_id);
 
 static TitleInfo *titleDuplicateTitleInfoFull(TitleInfo *title_info, TitleInfo *previous, TitleInfo *next);
 static TitleInfo *titleDuplicateTitleInfo(TitleInfo *title_info);
@@ -575,6 +594,7 @@ static TitleInfo *titleDuplicateTitleInfo(TitleInfo *title_info);
 static int titleSystemTitleMetadataEntrySortFunction(const void *a, const void *b);
 static int titleUserApplicationMetadataEntrySortFunction(const void *a, const void *b);
 static int titleInfoEntrySortFunction(const void *a, const void *b);
+static int titleLinkEntrySortFunction(const void *a, const void *b);
 
 static char *titleGetPatchVersionString(TitleInfo *title_info);
 
@@ -1301,6 +1321,8 @@ NX_INLINE void titleFreeApplicationMetadata(void)
 
     g_systemMetadata = g_userMetadata = NULL;
     g_systemMetadataCount = g_userMetadataCount = 0;
+
+    titleFreeUserApplicationMetadataIndex();
 }
 
 static bool titleReallocateApplicationMetadata(u32 extra_app_count, bool is_system, bool free_entries)
@@ -1759,6 +1781,9 @@ static bool titleGenerateMetadataEntriesFromNsRecords(void)
     /* Sort application metadata entries by name. */
     if (g_userMetadataCount > 1) qsort(g_userMetadata, g_userMetadataCount, sizeof(TitleApplicationMetadata*), &titleUserApplicationMetadataEntrySortFunction);
 
+    /* Rebuild title ID index. */
+    titleRebuildUserApplicationMetadataIndex();
+
     /* Update flag. */
     success = true;
 
@@ -1893,9 +1918,46 @@ NX_INLINE TitleApplicationMetadata *titleFindApplicationMetadataByTitleId(u64 ti
     if (!title_id || (is_system && (!g_systemMetadata || !g_systemMetadataCount)) || (!is_system && (!g_userMetadata || !g_userMetadataCount))) return NULL;
 
     TitleApplicationMetadata **cached_app_metadata = (is_system ? g_systemMetadata : g_userMetadata);
-    u32 cached_app_metadata_count = ((is_system ? g_systemMetadataCount : g_userMetadataCount) + extra_app_count);
+    u32 cached_app_metadata_count = (is_system ? g_systemMetadataCount : g_userMetadataCount);
+    u32 start_idx = 0;
 
-    for(u32 i = 0; i < cached_app_metadata_count; i++)
+    if (is_system)
+    {
+        /* System metadata entries are sorted by title ID. Perform a binary search. */
+        u32 low = 0, high = cached_app_metadata_count;
+
+        while(low < high)
+        {
+            u32 half = (low + ((high - low) / 2));
+
+            if (cached_app_metadata[half]->title_id < title_id)
+            {
+                low = (half + 1);
+            } else {
+                high = half;
+            }
+        }
+
+        if (low < cached_app_metadata_count && cached_app_metadata[low]->title_id == title_id) return cached_app_metadata[low];
+
+        start_idx = cached_app_metadata_count;
+    } else
+    if (g_userMetadataIndex)
+    {
+        /* Look up user application metadata in our index. */
+        u32 mask = (g_userMetadataIndexCapacity - 1), pos = titleGetTitleIdHash(title_id, g_userMetadataIndexCapacity);
+
+        while(g_userMetadataIndex[pos])
+        {
+            if (g_userMetadataIndex[pos]->title_id == title_id) return g_userMetadataIndex[pos];
+            pos = ((pos + 1) & mask);
+        }
+
+        start_idx = cached_app_metadata_count;
+    }
+
+    /* Look for the provided title ID in the remaining entries, which includes entries that haven't been indexed yet. */
+    for(u32 i = start_idx; i < (cached_app_metadata_count + extra_app_count); i++)
     {
         TitleApplicationMetadata *cur_app_metadata = cached_app_metadata[i];
         if (cur_app_metadata && cur_app_metadata->title_id == title_id) return cur_app_metadata;
@@ -1904,6 +1966,55 @@ NX_INLINE TitleApplicationMetadata *titleFindApplicationMetadataByTitleId(u64 ti
     return NULL;
 }
 
+static void titleRebuildUserApplicationMetadataIndex(void)
+{
+    u32 capacity = TITLE_METADATA_INDEX_MIN_CAPACITY;
+
+    /* Free index beforehand. */
+    titleFreeUserApplicationMetadataIndex();
+
+    if (!g_userMetadata || !g_userMetadataCount) return;
+
+    /* Keep the load factor at 50% or lower. */
+    while(capacity < (g_userMetadataCount * 2)) capacity <<= 1;
+
+    /* Allocate memory for the index. We'll just fall back to linear lookups if this fails. */
+    g_userMetadataIndex = calloc(capacity, sizeof(TitleApplicationMetadata*));
+    if (!g_userMetadataIndex)
+    {
+        LOG_MSG_ERROR("Failed to allocate memory for user application metadata index! (%u element[s]).", capacity);
+        return;
+    }
+
+    g_userMetadataIndexCapacity = capacity;
+
+    /* Add all user application metadata entries. Keep the first entry if a title ID shows up more than once. */
+    for(u32 i = 0; i < g_userMetadataCount; i++)
+    {
+        TitleApplicationMetadata *cur_app_metadata = g_userMetadata[i];
+        if (!cur_app_metadata) continue;
+
+        u32 mask = (capacity - 1), pos = titleGetTitleIdHash(cur_app_metadata->title_id, capacity);
+
+        while(g_userMetadataIndex[pos] && g_userMetadataIndex[pos]->title_id != cur_app_metadata->title_id) pos = ((pos + 1) & mask);
+
+        if (!g_userMetadataIndex[pos]) g_userMetadataIndex[pos] = cur_app_metadata;
+    }
+}
+
+NX_INLINE void titleFreeUserApplicationMetadataIndex(void)
+{
+    if (g_userMetadataIndex) free(g_userMetadataIndex);
+    g_userMetadataIndex = NULL;
+    g_userMetadataIndexCapacity = 0;
+}
+
+NX_INLINE u32 titleGetTitleIdHash(u64 title_id, u32 capacity)
+{
+    /* Fibonacci hashing. 'capacity' is always a power of two. */
+    return (u32)((title_id * 0x9E3779B97F4A7C15ULL) >> (64 - __builtin_ctz(capacity)));
+}
+
 NX_INLINE u64 titleGetApplicationIdByContentMetaKey(const NcmContentMetaKey *meta_key)
 {
     if (!meta_key) return 0;
@@ -2209,9 +2320,27 @@ end:
 
 static void titleUpdateTitleInfoLinkedLists(void)
 {
+    TitleLinkEntry *link_entries = NULL;
+    u32 total = 0, link_entry_count = 0;
+
     /* Free orphan title info entries. */
     titleFreeOrphanTitleInfoEntries();
 
+    /* Get the total number of title info entries we need to process. */
+    for(u8 i = NcmStorageId_GameCard; i <= NcmStorageId_SdCard; i++)
+    {
+        if (i == NcmStorageId_BuiltInSystem) continue;
+
+        TitleStorage *title_storage = &(g_titleStorage[TITLE_STORAGE_INDEX(i)]);
+        if (title_storage->titles) total += title_storage->title_count;
+    }
+
+    if (!total) return;
+
+    /* Allocate memory for our link entries. Titles will still be flagged as orphans if this fails. */
+    link_entries = calloc(total, sizeof(TitleLinkEntry));
+    if (!link_entries) LOG_MSG_ERROR("Failed to allocate memory for %u title link entries!", total);
+
     /* Loop through all available title storages. */
     for(u8 i = NcmStorageId_GameCard; i <= NcmStorageId_SdCard; i++)
     {
@@ -2242,11 +2371,13 @@ static void titleUpdateTitleInfoLinkedLists(void)
                 continue;
             }
 
+            bool link = true;
+            u64 app_id = titleGetApplicationIdByContentMetaKey(&(child_info->meta_key));
+
             if (child_info->meta_key.type != NcmContentMetaType_Application && !child_info->app_metadata)
             {
                 /* We're dealing with a patch, an add-on content or an add-on content patch. */
                 /* We'll just retrieve a pointer to the first matching user application entry and use it to set a pointer to an application metadata entry. */
-                u64 app_id = titleGetApplicationIdByContentMetaKey(&(child_info->meta_key));
                 TitleInfo *parent = _titleGetInfoFromStorageByTitleId(NcmStorageId_Any, app_id);
                 if (parent)
                 {
@@ -2254,46 +2385,45 @@ static void titleUpdateTitleInfoLinkedLists(void)
                     child_info->app_metadata = parent->app_metadata;
                 } else {
                     /* Add orphan title info entry since we have no application metadata. */
+                    /* Orphan titles aren't linked to their previous sibling, but they may still be linked to their next sibling. */
                     titleAddOrphanTitleInfoEntry(child_info);
-                    continue;
+                    link = false;
                 }
             }
 
-            /* Locate previous user application, patch, add-on content or add-on content patch entry. */
-            /* If it's found, we will update both its next pointer and the previous pointer from the current entry. */
-            for(u8 k = i; k >= NcmStorageId_GameCard; k--)
-            {
-                /* Don't process system titles. And don't proceed if we're currently dealing with the first entry from a storage. */
-                if (k == NcmStorageId_BuiltInSystem || (k == i && j == 0)) continue;
+            if (!link_entries) continue;
 
-                TitleStorage *prev_title_storage = &(g_titleStorage[TITLE_STORAGE_INDEX(k)]);
-                TitleInfo **prev_titles = prev_title_storage->titles;
-                u32 prev_title_count = prev_title_storage->title_count;
-                u32 start_idx = (k == i ? j : prev_title_count);
+            /* Add-on contents and add-on content patches that don't belong to their application ID don't have any siblings. */
+            if ((child_info->meta_key.type == NcmContentMetaType_AddOnContent && !titleCheckIfAddOnContentIdBelongsToApplicationId(app_id, child_info->meta_key.id)) || \
+                (child_info->meta_key.type == NcmContentMetaType_DataPatch && !titleCheckIfDataPatchIdBelongsToApplicationId(app_id, child_info->meta_key.id))) continue;
 
-                /* Don't proceed if the current storage holds no titles. */
-                if (!prev_titles || !prev_title_count) continue;
+            /* Add link entry. */
+            TitleLinkEntry *link_entry = &(link_entries[link_entry_count]);
+            link_entry->title_info = child_info;
+            link_entry->group_id = ((child_info->meta_key.type == NcmContentMetaType_Application || child_info->meta_key.type == NcmContentMetaType_Patch) ? child_info->meta_key.id : app_id);
+            link_entry->order = link_entry_count++;
+            link_entry->link = link;
+        }
+    }
 
-                for(u32 l = start_idx; l > 0; l--)
-                {
-                    TitleInfo *prev_info = prev_titles[l - 1];
-                    if (!prev_info) continue;
+    if (!link_entries) return;
 
-                    if (prev_info->meta_key.type == child_info->meta_key.type && \
-                        (((child_info->meta_key.type == NcmContentMetaType_Application || child_info->meta_key.type == NcmContentMetaType_Patch) && prev_info->meta_key.id == child_info->meta_key.id) || \
-                        (child_info->meta_key.type == NcmContentMetaType_AddOnContent && titleCheckIfAddOnContentIdsAreSiblings(prev_info->meta_key.id, child_info->meta_key.id)) || \
-                        (child_info->meta_key.type == NcmContentMetaType_DataPatch && titleCheckIfDataPatchIdsAreSiblings(prev_info->meta_key.id, child_info->meta_key.id))))
-                    {
-                        prev_info->next = child_info;
-                        child_info->previous = prev_info;
-                        break;
-                    }
-                }
+    /* Sort link entries by title type, group ID and order. This places sibling entries right next to each other. */
+    if (link_entry_count > 1) qsort(link_entries, link_entry_count, sizeof(TitleLinkEntry), &titleLinkEntrySortFunction);
 
-                if (child_info->previous) break;
-            }
-        }
+    /* Link each entry to its previous sibling. */
+    for(u32 i = 1; i < link_entry_count; i++)
+    {
+        TitleLinkEntry *prev_entry = &(link_entries[i - 1]);
+        TitleLinkEntry *cur_entry = &(link_entries[i]);
+
+        if (!cur_entry->link || prev_entry->title_info->meta_key.type != cur_entry->title_info->meta_key.type || prev_entry->group_id != cur_entry->group_id) continue;
+
+        prev_entry->title_info->next = cur_entry->title_info;
+        cur_entry->title_info->previous = prev_entry->title_info;
     }
+
+    free(link_entries);
 }
 
 static bool titleCreateGameCardInfoThread(void)
@@ -2447,6 +2577,9 @@ static bool titleRefreshGameCardTitleInfo(void)
         /* Sort application metadata entries by name. */
         if (g_userMetadataCount > 1) qsort(g_userMetadata, g_userMetadataCount, sizeof(TitleApplicationMetadata*), &titleUserApplicationMetadataEntrySortFunction);
 
+        /* Rebuild title ID index. */
+        titleRebuildUserApplicationMetadataIndex();
+
         /* Update linked lists for user applications, patches and add-on contents. */
         /* This will take care of orphan titles we might now have application metadata for. */
         titleUpdateTitleInfoLinkedLists();
@@ -2525,20 +2658,7 @@ static TitleInfo *_titleGetInfoFromStorageByTitleId(u8 storage_id, u64 title_id)
 
     for(u8 i = start_idx; i <= max_val; i++)
     {
-        TitleStorage *title_storage = &(g_titleStorage[i]);
-        if (!title_storage->titles || !*(title_storage->titles) || !title_storage->title_count) continue;
-
-        for(u32 j = 0; j < title_storage->title_count; j++)
-        {
-            TitleInfo *title_info = title_storage->titles[j];
-            if (title_info && title_info->meta_key.id == title_id)
-            {
-                out = title_info;
-                break;
-            }
-        }
-
-        if (out) break;
+        if ((out = titleFindInfoInStorageByTitleId(&(g_titleStorage[i]), title_id))) break;
     }
 
     if (!out) LOG_MSG_DEBUG("Unable to find title info entry with ID \"%016lX\" in %s.", title_id, titleGetNcmStorageIdName(storage_id));
@@ -2546,6 +2666,30 @@ static TitleInfo *_titleGetInfoFromStorageByTitleId(u8 storage_id, u64 title_id)
     return out;
 }
 
+static TitleInfo *titleFindInfoInStorageByTitleId(TitleStorage *title_storage, u64 title_id)
+{
+    TitleInfo **titles = title_storage->titles;
+    u32 title_count = title_storage->title_count, low = 0, high = title_count;
+
+    if (!titles || !*titles || !title_count) return NULL;
+
+    /* Title info entries are sorted by title ID, version and storage ID. */
+    /* Perform a binary search to find the first entry with a matching title ID. */
+    while(low < high)
+    {
+        u32 half = (low + ((high - low) / 2));
+
+        if (titles[half]->meta_key.id < title_id)
+        {
+            low = (half + 1);
+        } else {
+            high = half;
+        }
+    }
+
+    return ((low < title_count && titles[low]->meta_key.id == title_id) ? titles[low] : NULL);
+}
+
 static TitleInfo *titleDuplicateTitleInfoFull(TitleInfo *title_info, TitleInfo *previous, TitleInfo *next)
 {
     if (!titleIsValidInfoBlock(title_info))
@@ -2739,6 +2883,41 @@ static int titleInfoEntrySortFunction(const void *a, const void *b)
     return 0;
 }
 
+static int titleLinkEntrySortFunction(const void *a, const void *b)
+{
+    const TitleLinkEntry *link_entry_1 = (const TitleLinkEntry*)a;
+    const TitleLinkEntry *link_entry_2 = (const TitleLinkEntry*)b;
+
+    if (link_entry_1->title_info->meta_key.type < link_entry_2->title_info->meta_key.type)
+    {
+        return -1;
+    } else
+    if (link_entry_1->title_info->meta_key.type > link_entry_2->title_info->meta_key.type)
+    {
+        return 1;
+    }
+
+    if (link_entry_1->group_id < link_entry_2->group_id)
+    {
+        return -1;
+    } else
+    if (link_entry_1->group_id > link_entry_2->group_id)
+    {
+        return 1;
+    }
+
+    if (link_entry_1->order < link_entry_2->order)
+    {
+        return -1;
+    } else
+    if (link_entry_1->order > link_entry_2->order)
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
 static char *titleGetPatchVersionString(TitleInfo *title_info)
 {
     NcmContentInfo *nacp_content = NULL;
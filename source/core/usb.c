@@ -25,8 +25,8 @@
 #include "nxdt_utils.h"
 #include "usb.h"
 
-#define USB_ABI_VERSION_MAJOR       1
-#define USB_ABI_VERSION_MINOR       2
+#define USB_ABI_VERSION_MAJOR       2
+#define USB_ABI_VERSION_MINOR       0
 #define USB_ABI_VERSION             ((USB_ABI_VERSION_MAJOR << 4) | USB_ABI_VERSION_MINOR)
 
 #define USB_CMD_HEADER_MAGIC        0x4E584454                  /* "NXDT". */
@@ -34,6 +34,12 @@
 #define USB_TRANSFER_ALIGNMENT      0x1000                      /* 4 KiB. */
 #define USB_TRANSFER_TIMEOUT        10                          /* 10 seconds. */
 
+#define USB_WRITE_QUEUE_DEPTH       4                           /* Max number of in-flight URBs on the input (write) endpoint. Must not exceed the usb:ds report entry count (8). */
+#define USB_FILE_STREAM_MAX_COUNT   0x20                        /* Max number of file streams that can be open at the same time. */
+#define USB_FILE_STREAM_BATCH_SIZE  (USB_TRANSFER_BUFFER_SIZE - sizeof(UsbCommandHeader))
+
+#define USB_WRITE_SLOT_SIZE         0x200000                    /* 2 MiB. Bounce slot size used for unaligned file data. Aligned to all supported endpoint max packet sizes. */
+
 #define USB_DEV_VID                 0x057E                      /* VID officially used by Nintendo in usb:ds. */
 #define USB_DEV_PID                 0x3000                      /* PID officially used by Nintendo in usb:ds. */
 #define USB_DEV_BCD_REL             0x0100                      /* Device release number. Always 1.0. */
@@ -64,7 +70,8 @@ typedef enum {
     UsbCommandType_EndSession           = 4,
     UsbCommandType_StartExtractedFsDump = 5,
     UsbCommandType_EndExtractedFsDump   = 6,
-    UsbCommandType_Count                = 7     ///< Total values supported by this enum.
+    UsbCommandType_SendFileStreamBatch  = 7,
+    UsbCommandType_Count                = 8     ///< Total values supported by this enum.
 } UsbCommandType;
 
 typedef struct {
@@ -105,6 +112,32 @@ typedef struct {
 
 NXDT_ASSERT(UsbCommandStartExtractedFsDump, 0x310);
 
+/// SendFileStreamBatch command blocks hold a variable number of framed packets, each one made of a UsbFileStreamPacketHeader followed by its payload.
+/// Packets from different file streams may be interleaved. The host device replies with a single status block once the whole batch has been processed.
+typedef enum {
+    UsbFileStreamPacketType_OpenFile = 0,   ///< Payload: UsbFileStreamOpenFile + filename (no NULL terminator). A zero-sized file is closed right away.
+    UsbFileStreamPacketType_FileData = 1,   ///< Payload: file data. The file is closed once all of its data has been received.
+    UsbFileStreamPacketType_Count    = 2    ///< Total values supported by this enum.
+} UsbFileStreamPacketType;
+
+typedef struct {
+    u32 stream_id;
+    u8 type;                ///< UsbFileStreamPacketType.
+    u8 reserved_1[0x3];
+    u32 payload_size;
+    u8 reserved_2[0x4];
+} UsbFileStreamPacketHeader;
+
+NXDT_ASSERT(UsbFileStreamPacketHeader, 0x10);
+
+typedef struct {
+    u64 file_size;
+    u32 filename_length;
+    u8 reserved[0x4];
+} UsbFileStreamOpenFile;
+
+NXDT_ASSERT(UsbFileStreamOpenFile, 0x10);
+
 typedef enum {
     ///< Expected response code.
     UsbStatusType_Success               = 0,
@@ -133,6 +166,33 @@ typedef struct {
 
 NXDT_ASSERT(UsbStatus, 0x10);
 
+/// Device-side state for an open file stream.
+typedef struct {
+    u32 id;
+    u64 remaining_size;
+} UsbFileStream;
+
+/// URB status values reported by usb:ds.
+typedef enum {
+    UsbUrbStatus_Invalid   = 0,
+    UsbUrbStatus_Pending   = 1,
+    UsbUrbStatus_Running   = 2,
+    UsbUrbStatus_Finished  = 3,
+    UsbUrbStatus_Cancelled = 4,
+    UsbUrbStatus_Failed    = 5
+} UsbUrbStatus;
+
+/// Write request posted to the input endpoint.
+typedef struct {
+    u32 urb_id;
+    void *buf;                          ///< Page aligned buffer used by the URB. Either a bounce slot or a buffer handed off by the caller.
+    u32 size;
+    bool success;                       ///< Set by the reaper thread once the URB has been retired.
+    void *callback_data;                ///< Original buffer passed to the completion callback.
+    UsbTransferDoneCallback callback;   ///< Only set for buffers handed off by the caller.
+    void *callback_arg;
+} UsbWriteRequest;
+
 /// Imported from libusb, with some adjustments.
 enum usb_bos_type {
     USB_BT_WIRELESS_USB_DEVICE_CAPABILITY = 1,
@@ -210,12 +270,38 @@ static u8 *g_usbTransferBuffer = NULL;
 static u64 g_usbTransferRemainingSize = 0, g_usbTransferWrittenSize = 0;
 static u16 g_usbEndpointMaxPacketSize = 0;
 
+static bool g_usbExtractedFsDumpMode = false;
+static UsbFileStream g_usbFileStreams[USB_FILE_STREAM_MAX_COUNT] = {0};
+static u32 g_usbFileStreamCount = 0, g_usbFileStreamNextId = 0, g_usbFileStreamBatchSize = 0;
+static u32 g_usbFileStreamHostCount = 0;   /* Number of file streams known to be open on the host device as of the last flushed batch. */
+
+static Mutex g_usbWriteQueueMutex = 0;
+static CondVar g_usbWriteQueueCondVar = 0;
+static UsbWriteRequest g_usbWriteQueue[USB_WRITE_QUEUE_DEPTH] = {0};
+static u32 g_usbWriteQueueHead = 0, g_usbWriteQueueCount = 0;
+static bool g_usbWriteQueueError = false;
+static u8 *g_usbWriteSlotBuffer = NULL;
+
+static Thread g_usbWriteReaperThread = {0};
+static UEvent g_usbWriteReaperKickEvent = {0}, g_usbWriteReaperExitEvent = {0};
+static atomic_bool g_usbWriteReaperThreadCreated = false;
+
 /* Function prototypes. */
 
 static bool usbCreateDetectionThread(void);
 static void usbDestroyDetectionThread(void);
 static void usbDetectionThreadFunc(void *arg);
 
+static bool usbCreateWriteReaperThread(void);
+static void usbDestroyWriteReaperThread(void);
+static void usbWriteReaperThreadFunc(void *arg);
+static u32 usbWriteQueueRetireCompleted(const UsbDsReportData *report_data, UsbWriteRequest *out_requests);
+static u32 usbWriteQueueRetireAll(UsbWriteRequest *out_requests);
+static void usbWriteQueueRunCallbacks(UsbWriteRequest *requests, u32 count);
+
+static bool usbEnqueueWrite(void *data, u32 size, bool copy, UsbTransferDoneCallback callback, void *callback_arg);
+static bool usbWaitForQueuedWrites(void);
+
 static bool usbStartSession(void);
 static void usbEndSession(void);
 
@@ -234,6 +320,12 @@ static bool usbInitializeComms1x(void);
 static void usbCloseComms(void);
 
 static bool _usbSendFileProperties(u64 file_size, const char *filename, u32 nsp_header_size, bool enforce_nsp_mode);
+static bool _usbSendFileData(void *data, u64 data_size, UsbTransferDoneCallback callback, void *callback_arg);
+
+static bool usbAppendFileStreamPacket(u32 stream_id, u8 type, const void *payload_header, u32 payload_header_size, const void *payload, u32 payload_size);
+static bool usbFlushFileStreamBatch(void);
+static UsbFileStream *usbGetFileStream(u32 stream_id);
+static void usbResetFileStreams(void);
 
 NX_INLINE bool usbIsHostAvailable(void);
 
@@ -280,6 +372,14 @@ bool usbInitialize(void)
         /* Create user-mode USB timeout event. */
         ueventCreate(&g_usbTimeoutEvent, true);
 
+        /* Create user-mode write reaper events. */
+        ueventCreate(&g_usbWriteReaperKickEvent, true);
+        ueventCreate(&g_usbWriteReaperExitEvent, true);
+
+        /* Create USB write reaper thread. This must be done before creating the USB detection thread. */
+        atomic_store(&g_usbWriteReaperThreadCreated, usbCreateWriteReaperThread());
+        if (!atomic_load(&g_usbWriteReaperThreadCreated)) break;
+
         /* Create USB detection thread. */
         atomic_store(&g_usbDetectionThreadCreated, usbCreateDetectionThread());
         if (!atomic_load(&g_usbDetectionThreadCreated)) break;
@@ -300,6 +400,13 @@ void usbExit(void)
         atomic_store(&g_usbDetectionThreadCreated, false);
     }
 
+    /* Destroy USB write reaper thread. Any URBs still in flight are cancelled. */
+    if (atomic_load(&g_usbWriteReaperThreadCreated))
+    {
+        usbDestroyWriteReaperThread();
+        atomic_store(&g_usbWriteReaperThreadCreated, false);
+    }
+
     /* Now we can safely lock. */
     SCOPED_LOCK(&g_usbInterfaceMutex)
     {
@@ -367,96 +474,22 @@ bool usbSendNspProperties(u64 nsp_size, const char *filename, u32 nsp_header_siz
 bool usbSendFileData(void *data, u64 data_size)
 {
     bool ret = false;
+    SCOPED_LOCK(&g_usbInterfaceMutex) ret = _usbSendFileData(data, data_size, NULL, NULL);
+    return ret;
+}
 
-    SCOPED_LOCK(&g_usbInterfaceMutex)
-    {
-        void *buf = NULL;
-        bool zlt_required = false;
-
-        if (!g_usbTransferBuffer || !g_usbInterfaceInit || !g_usbHostAvailable || !g_usbSessionStarted || !g_usbTransferRemainingSize || !data || !data_size || \
-            data_size > USB_TRANSFER_BUFFER_SIZE || data_size > g_usbTransferRemainingSize)
-        {
-            LOG_MSG_ERROR("Invalid parameters!");
-            goto end;
-        }
-
-        /* Optimization for buffers that already are page aligned. */
-        if (IS_ALIGNED((u64)data, USB_TRANSFER_ALIGNMENT))
-        {
-            buf = data;
-        } else {
-            buf = g_usbTransferBuffer;
-            memcpy(buf, data, data_size);
-        }
-
-        /* Determine if we'll need to set a Zero Length Termination (ZLT) packet. */
-        /* This is automatically handled by usbDsEndpoint_PostBufferAsync(), depending on the ZLT setting from the input (write) endpoint. */
-        /* First, check if this is the last data chunk for this file. */
-        if ((g_usbTransferRemainingSize - data_size) == 0)
-        {
-            /* Enable ZLT if the last chunk size is aligned to the USB endpoint max packet size. */
-            if (IS_ALIGNED(data_size, g_usbEndpointMaxPacketSize))
-            {
-                zlt_required = true;
-                usbSetZltPacket(true);
-                LOG_MSG_DEBUG("ZLT enabled. Last chunk size: 0x%lX bytes.", data_size);
-            }
-        } else {
-            /* Disable ZLT if this is the first of multiple data chunks. */
-            if (!g_usbTransferWrittenSize)
-            {
-                usbSetZltPacket(false);
-                LOG_MSG_DEBUG("ZLT disabled (first chunk).");
-            }
-        }
-
-        /* Send data chunk. */
-        if (!(ret = usbWrite(buf, data_size)))
-        {
-            LOG_MSG_ERROR("Failed to write 0x%lX bytes long file data chunk from offset 0x%lX! (total size: 0x%lX).", data_size, g_usbTransferWrittenSize, \
-                                                                                                                      g_usbTransferRemainingSize + g_usbTransferWrittenSize);
-            goto end;
-        }
-
-        g_usbTransferRemainingSize -= data_size;
-        g_usbTransferWrittenSize += data_size;
-
-        /* Check if this is the last chunk. */
-        if (!g_usbTransferRemainingSize)
-        {
-            /* Check response from host device. */
-            if (!(ret = usbRead(g_usbTransferBuffer, sizeof(UsbStatus))))
-            {
-                LOG_MSG_ERROR("Failed to read 0x%lX bytes long status block!", sizeof(UsbStatus));
-                goto end;
-            }
-
-            UsbStatus *cmd_status = (UsbStatus*)g_usbTransferBuffer;
-
-            if (!(ret = (cmd_status->magic == __builtin_bswap32(USB_CMD_HEADER_MAGIC))))
-            {
-                LOG_MSG_ERROR("Invalid status block magic word! (0x%08X).", __builtin_bswap32(cmd_status->magic));
-                goto end;
-            }
-
-            ret = (cmd_status->status == UsbStatusType_Success);
-#if LOG_LEVEL <= LOG_LEVEL_INFO
-            if (!ret) usbLogStatusDetail(cmd_status->status);
-#endif
-        }
-
-end:
-        /* Disable ZLT if it was previously enabled. */
-        if (zlt_required) usbSetZltPacket(false);
+bool usbSendFileDataAsync(void *data, u64 data_size, UsbTransferDoneCallback callback, void *callback_arg)
+{
+    bool ret = false;
 
-        /* Reset variables in case of errors. */
-        if (!ret)
-        {
-            g_usbTransferRemainingSize = g_usbTransferWrittenSize = 0;
-            g_nspTransferMode = false;
-        }
+    if (!callback)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
     }
 
+    SCOPED_LOCK(&g_usbInterfaceMutex) ret = _usbSendFileData(data, data_size, callback, callback_arg);
+
     return ret;
 }
 
@@ -464,11 +497,22 @@ void usbCancelFileTransfer(void)
 {
     SCOPED_LOCK(&g_usbInterfaceMutex)
     {
-        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || (!g_usbTransferRemainingSize && !g_nspTransferMode)) break;
+        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || (!g_usbTransferRemainingSize && !g_nspTransferMode && \
+            !g_usbFileStreamCount && !g_usbFileStreamBatchSize)) break;
+
+        /* Check if the host device actually has something to cancel. If the only pending state is an unflushed file stream batch, */
+        /* no file stream has reached the host device yet and a CancelFileTransfer command would be rejected as malformed. */
+        bool send_cancel = (g_usbTransferRemainingSize || g_nspTransferMode || g_usbFileStreamHostCount);
 
-        /* Reset variables right away. */
+        /* Reset variables right away. Any pending file stream packets are discarded. */
         g_usbTransferRemainingSize = g_usbTransferWrittenSize = 0;
-        g_nspTransferMode = false;
+        g_nspTransferMode = g_usbExtractedFsDumpMode = false;
+        usbResetFileStreams();
+
+        /* Wait for queued file data chunks to be retired. */
+        usbWaitForQueuedWrites();
+
+        if (!send_cancel) break;
 
         /* Prepare command data. */
         usbPrepareCommandHeader(UsbCommandType_CancelFileTransfer, 0);
@@ -524,24 +568,148 @@ bool usbStartExtractedFsDump(u64 extracted_fs_size, const char *extracted_fs_roo
         snprintf(cmd_block->extracted_fs_root_path, sizeof(cmd_block->extracted_fs_root_path), "%s", extracted_fs_root_path);
 
         /* Send command. */
-        ret = usbSendCommand();
+        ret = g_usbExtractedFsDumpMode = usbSendCommand();
+
+        /* Reset file stream state. */
+        usbResetFileStreams();
+        g_usbFileStreamNextId = 0;
     }
 
     return ret;
 }
 
-void usbEndExtractedFsDump(void)
+bool usbEndExtractedFsDump(void)
 {
+    bool ret = false;
+
     SCOPED_LOCK(&g_usbInterfaceMutex)
     {
         if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || g_usbTransferRemainingSize || g_nspTransferMode) break;
 
+        /* Send any pending file stream packets. */
+        ret = usbFlushFileStreamBatch();
+        if (!ret) LOG_MSG_ERROR("Failed to send pending file stream packets!");
+
+        if (g_usbFileStreamCount)
+        {
+            LOG_MSG_ERROR("%u file stream(s) still open!", g_usbFileStreamCount);
+            ret = false;
+        }
+
+        g_usbExtractedFsDumpMode = false;
+        usbResetFileStreams();
+
         /* Prepare command data. */
         usbPrepareCommandHeader(UsbCommandType_EndExtractedFsDump, 0);
 
-        /* Send command. We don't care about the result here. */
-        usbSendCommand();
+        /* Send command. */
+        if (!usbSendCommand()) ret = false;
     }
+
+    return ret;
+}
+
+bool usbOpenFileStream(u64 file_size, const char *filename, u32 *out_stream_id)
+{
+    bool ret = false;
+
+    SCOPED_LOCK(&g_usbInterfaceMutex)
+    {
+        UsbFileStreamOpenFile open_file = {0};
+        size_t filename_length = 0;
+
+        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || !g_usbExtractedFsDumpMode || g_usbTransferRemainingSize || \
+            g_nspTransferMode || !filename || !(filename_length = strlen(filename)) || filename_length >= FS_MAX_PATH || !out_stream_id)
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
+
+        /* Zero-sized files are closed by the host device right away, so they don't take up a file stream slot. */
+        if (file_size && g_usbFileStreamCount >= USB_FILE_STREAM_MAX_COUNT)
+        {
+            LOG_MSG_ERROR("Too many open file streams!");
+            break;
+        }
+
+        /* Append OpenFile packet. */
+        open_file.file_size = file_size;
+        open_file.filename_length = (u32)filename_length;
+
+        if (!usbAppendFileStreamPacket(g_usbFileStreamNextId, UsbFileStreamPacketType_OpenFile, &open_file, (u32)sizeof(UsbFileStreamOpenFile), filename, (u32)filename_length))
+        {
+            LOG_MSG_ERROR("Failed to open file stream for \"%s\"!", filename);
+            break;
+        }
+
+        if (file_size)
+        {
+            UsbFileStream *stream = &(g_usbFileStreams[g_usbFileStreamCount++]);
+            stream->id = g_usbFileStreamNextId;
+            stream->remaining_size = file_size;
+        }
+
+        *out_stream_id = g_usbFileStreamNextId++;
+
+        ret = true;
+    }
+
+    return ret;
+}
+
+bool usbSendFileStreamData(u32 stream_id, const void *data, u64 data_size)
+{
+    bool ret = false;
+
+    SCOPED_LOCK(&g_usbInterfaceMutex)
+    {
+        UsbFileStream *stream = NULL;
+        const u8 *data_u8 = (const u8*)data;
+        u64 offset = 0;
+
+        if (!g_usbInterfaceInit || !g_usbTransferBuffer || !g_usbHostAvailable || !g_usbSessionStarted || !g_usbExtractedFsDumpMode || !(stream = usbGetFileStream(stream_id)) || \
+            !data || !data_size || data_size > stream->remaining_size)
+        {
+            LOG_MSG_ERROR("Invalid parameters!");
+            break;
+        }
+
+        /* Split data across as many FileData packets as needed. */
+        while(offset < data_size)
+        {
+            u32 available = (u32)(USB_FILE_STREAM_BATCH_SIZE - g_usbFileStreamBatchSize), packet_size = 0;
+
+            /* Flush the current batch right away if there's not enough room left for a reasonably sized packet. */
+            if (available <= (sizeof(UsbFileStreamPacketHeader) + USB_TRANSFER_ALIGNMENT))
+            {
+                if (!usbFlushFileStreamBatch()) break;
+                available = (u32)USB_FILE_STREAM_BATCH_SIZE;
+            }
+
+            available -= (u32)sizeof(UsbFileStreamPacketHeader);
+            packet_size = (u32)((data_size - offset) > available ? available : (data_size - offset));
+
+            if (!usbAppendFileStreamPacket(stream_id, UsbFileStreamPacketType_FileData, NULL, 0, data_u8 + offset, packet_size)) break;
+
+            offset += packet_size;
+        }
+
+        if (offset < data_size)
+        {
+            LOG_MSG_ERROR("Failed to send 0x%lX bytes long data chunk for file stream #%u!", data_size, stream_id);
+            break;
+        }
+
+        /* Close the file stream if we're done with it. Flushing a batch may have reset the file stream table, so we look it up again. */
+        if ((stream = usbGetFileStream(stream_id)) != NULL)
+        {
+            stream->remaining_size -= data_size;
+            if (!stream->remaining_size) *stream = g_usbFileStreams[--g_usbFileStreamCount];
+            ret = true;
+        }
+    }
+
+    return ret;
 }
 
 static bool usbCreateDetectionThread(void)
@@ -591,9 +759,10 @@ static void usbDetectionThreadFunc(void *arg)
             /* Retrieve current USB connection status. */
             /* Only proceed if we're dealing with a status change. */
             g_usbHostAvailable = usbIsHostAvailable();
-            g_usbSessionStarted = false;
+            g_usbSessionStarted = g_usbExtractedFsDumpMode = false;
             g_usbTransferRemainingSize = g_usbTransferWrittenSize = 0;
             g_usbEndpointMaxPacketSize = 0;
+            usbResetFileStreams();
 
             /* Start a USB session if we're connected to a host device. */
             /* This will essentially hang this thread and all other threads that call USB-related functions until: */
@@ -622,14 +791,303 @@ static void usbDetectionThreadFunc(void *arg)
     {
         /* Close USB session if needed. */
         if (g_usbHostAvailable && g_usbSessionStarted) usbEndSession();
-        g_usbHostAvailable = g_usbSessionStarted = g_usbDetectionThreadExitFlag = false;
+        g_usbHostAvailable = g_usbSessionStarted = g_usbDetectionThreadExitFlag = g_usbExtractedFsDumpMode = false;
         g_usbTransferRemainingSize = g_usbTransferWrittenSize = 0;
         g_usbEndpointMaxPacketSize = 0;
+        usbResetFileStreams();
+    }
+
+    threadExit();
+}
+
+static bool usbCreateWriteReaperThread(void)
+{
+    if (!utilsCreateThread(&g_usbWriteReaperThread, usbWriteReaperThreadFunc, NULL, 1))
+    {
+        LOG_MSG_ERROR("Failed to create USB write reaper thread!");
+        return false;
+    }
+
+    return true;
+}
+
+static void usbDestroyWriteReaperThread(void)
+{
+    /* Signal the exit event to terminate the USB write reaper thread. */
+    ueventSignal(&g_usbWriteReaperExitEvent);
+
+    /* Wait for the USB write reaper thread to exit. */
+    utilsJoinThread(&g_usbWriteReaperThread);
+}
+
+static void usbWriteReaperThreadFunc(void *arg)
+{
+    NX_IGNORE_ARG(arg);
+
+    Result rc = 0;
+    int idx = 0;
+
+    Event *completion_event = &(g_usbEndpointIn->CompletionEvent);
+    UsbDsReportData report_data = {0};
+    UsbWriteRequest retired[USB_WRITE_QUEUE_DEPTH] = {0};
+    u32 retired_count = 0;
+
+    Waiter completion_event_waiter = waiterForEvent(completion_event);
+    Waiter kick_event_waiter = waiterForUEvent(&g_usbWriteReaperKickEvent);
+    Waiter exit_event_waiter = waiterForUEvent(&g_usbWriteReaperExitEvent);
+
+    while(true)
+    {
+        bool pending = false, failed = false;
+
+        SCOPED_LOCK(&g_usbWriteQueueMutex) pending = (g_usbWriteQueueCount > 0);
+
+        if (pending)
+        {
+            /* Only listen to the completion event while URBs are in flight. */
+            /* Synchronous transfers on the input endpoint are only issued with an empty write queue, so they keep exclusive access to it. */
+            rc = waitMulti(&idx, USB_TRANSFER_TIMEOUT * (u64)1000000000, completion_event_waiter, kick_event_waiter, exit_event_waiter);
+            failed = R_FAILED(rc);
+            if (failed) LOG_MSG_ERROR("Timed out waiting for in-flight URBs! (0x%X).", rc);
+        } else {
+            rc = waitMulti(&idx, -1, kick_event_waiter, exit_event_waiter);
+            if (R_FAILED(rc)) continue;
+
+            /* Match the waiter indexes used above. */
+            idx++;
+        }
+
+        if (!failed)
+        {
+            /* Exit event triggered. */
+            if (idx == 2) break;
+
+            /* A new URB was posted. Reevaluate the wait conditions. */
+            if (idx == 1) continue;
+
+            /* Clear the endpoint completion event before retrieving the report data, so we don't miss any URBs that finish in the meantime. */
+            eventClear(completion_event);
+
+            rc = usbDsEndpoint_GetReportData(g_usbEndpointIn, &report_data);
+            if (R_SUCCEEDED(rc))
+            {
+                retired_count = usbWriteQueueRetireCompleted(&report_data, retired);
+                usbWriteQueueRunCallbacks(retired, retired_count);
+                continue;
+            }
+
+            LOG_MSG_ERROR("usbDsEndpoint_GetReportData failed! (0x%X).", rc);
+        }
+
+        /* Cancel all in-flight URBs. */
+        usbDsEndpoint_Cancel(g_usbEndpointIn);
+
+        /* Safety measure: wait until the completion event is triggered again before proceeding. */
+        eventWait(completion_event, USB_TRANSFER_TIMEOUT * (u64)1000000000);
+        eventClear(completion_event);
+
+        retired_count = usbWriteQueueRetireAll(retired);
+        usbWriteQueueRunCallbacks(retired, retired_count);
+
+        /* Signal user-mode USB timeout event. */
+        /* This will "reset" the USB connection by making the detection thread wait until a new session is established. */
+        ueventSignal(&g_usbTimeoutEvent);
+    }
+
+    /* Cancel any URBs that may still be in flight. */
+    bool pending = false;
+    SCOPED_LOCK(&g_usbWriteQueueMutex) pending = (g_usbWriteQueueCount > 0);
+
+    if (pending)
+    {
+        usbDsEndpoint_Cancel(g_usbEndpointIn);
+        eventWait(completion_event, USB_TRANSFER_TIMEOUT * (u64)1000000000);
+        eventClear(completion_event);
+
+        retired_count = usbWriteQueueRetireAll(retired);
+        usbWriteQueueRunCallbacks(retired, retired_count);
     }
 
     threadExit();
 }
 
+static u32 usbWriteQueueRetireCompleted(const UsbDsReportData *report_data, UsbWriteRequest *out_requests)
+{
+    u32 count = 0, report_count = report_data->report_count;
+    bool failed = false;
+
+    if (report_count > MAX_ELEMENTS(report_data->report)) report_count = (u32)MAX_ELEMENTS(report_data->report);
+
+    SCOPED_LOCK(&g_usbWriteQueueMutex)
+    {
+        /* URBs posted to the same endpoint are completed in order, so we only need to look at the oldest one each time. */
+        while(g_usbWriteQueueCount)
+        {
+            UsbWriteRequest *request = &(g_usbWriteQueue[g_usbWriteQueueHead]);
+            const UsbDsReportEntry *entry = NULL;
+
+            for(u32 i = 0; i < report_count; i++)
+            {
+                if (report_data->report[i].id != request->urb_id) continue;
+                entry = &(report_data->report[i]);
+                break;
+            }
+
+            /* Stop if this URB is still in flight. */
+            if (!entry || entry->urb_status < UsbUrbStatus_Finished) break;
+
+            request->success = (entry->urb_status == UsbUrbStatus_Finished && entry->transferredSize == request->size);
+            if (!request->success)
+            {
+                LOG_MSG_ERROR("USB transfer failed! Expected 0x%X bytes, got 0x%X bytes (URB ID %u, status %u).", request->size, entry->transferredSize, request->urb_id, entry->urb_status);
+                if (!g_usbWriteQueueError) failed = true;
+                g_usbWriteQueueError = true;
+            }
+
+            memcpy(&(out_requests[count++]), request, sizeof(UsbWriteRequest));
+
+            g_usbWriteQueueHead = ((g_usbWriteQueueHead + 1) % USB_WRITE_QUEUE_DEPTH);
+            g_usbWriteQueueCount--;
+        }
+
+        /* Cancel the rest of the in-flight URBs if one of them failed. They'll be retired as soon as usb:ds reports them. */
+        /* This is done while holding the write queue lock to make sure no synchronous transfer has been issued in the meantime. */
+        if (failed && g_usbWriteQueueCount) usbDsEndpoint_Cancel(g_usbEndpointIn);
+
+        if (count) condvarWakeAll(&g_usbWriteQueueCondVar);
+    }
+
+    return count;
+}
+
+static u32 usbWriteQueueRetireAll(UsbWriteRequest *out_requests)
+{
+    u32 count = 0;
+
+    SCOPED_LOCK(&g_usbWriteQueueMutex)
+    {
+        for(count = 0; count < g_usbWriteQueueCount; count++)
+        {
+            UsbWriteRequest *request = &(g_usbWriteQueue[(g_usbWriteQueueHead + count) % USB_WRITE_QUEUE_DEPTH]);
+            request->success = false;
+            memcpy(&(out_requests[count]), request, sizeof(UsbWriteRequest));
+        }
+
+        g_usbWriteQueueHead = g_usbWriteQueueCount = 0;
+        if (count) g_usbWriteQueueError = true;
+
+        condvarWakeAll(&g_usbWriteQueueCondVar);
+    }
+
+    return count;
+}
+
+static void usbWriteQueueRunCallbacks(UsbWriteRequest *requests, u32 count)
+{
+    /* Give buffer ownership back to the caller. This is done without holding the write queue lock. */
+    for(u32 i = 0; i < count; i++)
+    {
+        UsbWriteRequest *request = &(requests[i]);
+        if (request->callback) request->callback(request->callback_data, request->success, request->callback_arg);
+    }
+}
+
+static bool usbEnqueueWrite(void *data, u32 size, bool copy, UsbTransferDoneCallback callback, void *callback_arg)
+{
+    Result rc = 0;
+    UsbWriteRequest *request = NULL;
+    u32 idx = 0;
+    bool ret = false;
+
+    if (!data || !size || (copy && (!g_usbWriteSlotBuffer || size > USB_WRITE_SLOT_SIZE)) || (!copy && !IS_ALIGNED((u64)data, USB_TRANSFER_ALIGNMENT)))
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        goto end;
+    }
+
+    /* Wait until a queue entry becomes available. */
+    /* The queue tail can't be taken by anyone else in the meantime: producers are serialized by the USB interface mutex. */
+    SCOPED_LOCK(&g_usbWriteQueueMutex)
+    {
+        while(g_usbWriteQueueCount >= USB_WRITE_QUEUE_DEPTH && !g_usbWriteQueueError) condvarWait(&g_usbWriteQueueCondVar, &g_usbWriteQueueMutex);
+        if (g_usbWriteQueueError) break;
+
+        idx = ((g_usbWriteQueueHead + g_usbWriteQueueCount) % USB_WRITE_QUEUE_DEPTH);
+        ret = true;
+    }
+
+    if (!ret)
+    {
+        LOG_MSG_ERROR("A previously queued USB transfer failed!");
+        goto end;
+    }
+
+    request = &(g_usbWriteQueue[idx]);
+    memset(request, 0, sizeof(UsbWriteRequest));
+
+    /* Copy unaligned data into the bounce slot that belongs to this queue entry. This is done without holding the write queue lock. */
+    if (copy)
+    {
+        request->buf = (g_usbWriteSlotBuffer + (idx * USB_WRITE_SLOT_SIZE));
+        memcpy(request->buf, data, size);
+    } else {
+        request->buf = data;
+    }
+
+    request->size = size;
+    request->callback_data = data;
+    request->callback = callback;
+    request->callback_arg = callback_arg;
+
+    SCOPED_LOCK(&g_usbWriteQueueMutex)
+    {
+        /* The queue may have been flushed while we weren't holding the lock (e.g. by the reaper thread after a timeout). */
+        if (g_usbWriteQueueError || idx != ((g_usbWriteQueueHead + g_usbWriteQueueCount) % USB_WRITE_QUEUE_DEPTH))
+        {
+            LOG_MSG_ERROR("USB write queue was flushed before URB could be posted!");
+            ret = false;
+            break;
+        }
+
+        /* Post URB. */
+        rc = usbDsEndpoint_PostBufferAsync(g_usbEndpointIn, request->buf, request->size, &(request->urb_id));
+        if (R_FAILED(rc))
+        {
+            LOG_MSG_ERROR("usbDsEndpoint_PostBufferAsync failed! (0x%X) (URB ID %u).", rc, request->urb_id);
+            ret = false;
+            break;
+        }
+
+        g_usbWriteQueueCount++;
+    }
+
+    /* Let the reaper thread know there's a new URB in flight. */
+    if (ret) ueventSignal(&g_usbWriteReaperKickEvent);
+
+end:
+    /* Give buffer ownership back to the caller if we failed to hand it off. */
+    if (!ret && callback) callback(data, false, callback_arg);
+
+    return ret;
+}
+
+static bool usbWaitForQueuedWrites(void)
+{
+    bool ret = false;
+
+    SCOPED_LOCK(&g_usbWriteQueueMutex)
+    {
+        /* Always wait for every in-flight URB to be retired, even if one of them already failed. */
+        while(g_usbWriteQueueCount) condvarWait(&g_usbWriteQueueCondVar, &g_usbWriteQueueMutex);
+
+        /* Reset the error flag. The queue is empty at this point. */
+        ret = !g_usbWriteQueueError;
+        g_usbWriteQueueError = false;
+    }
+
+    return ret;
+}
+
 static bool usbStartSession(void)
 {
     UsbCommandStartSession *cmd_block = NULL;
@@ -724,6 +1182,15 @@ static bool usbSendCommand(void)
         goto end;
     }
 
+    /* Commands are transferred synchronously, so make sure no file data chunks are still in flight. */
+    /* Don't send the command if any of them failed, since the host device would otherwise never know about it. */
+    if (!usbWaitForQueuedWrites())
+    {
+        LOG_MSG_ERROR("A previously queued USB transfer failed! Type 0x%X command won't be sent.", cmd);
+        status = UsbStatusType_WriteCommandFailed;
+        goto end;
+    }
+
     /* Write command header first. */
     if (!usbWrite(cmd_header, sizeof(UsbCommandHeader)))
     {
@@ -827,16 +1294,24 @@ static void usbLogStatusDetail(u32 status)
 
 NX_INLINE bool usbAllocateTransferBuffer(void)
 {
-    if (g_usbTransferBuffer) return true;
-    g_usbTransferBuffer = memalign(USB_TRANSFER_ALIGNMENT, USB_TRANSFER_BUFFER_SIZE);
-    return (g_usbTransferBuffer != NULL);
+    if (!g_usbTransferBuffer) g_usbTransferBuffer = memalign(USB_TRANSFER_ALIGNMENT, USB_TRANSFER_BUFFER_SIZE);
+    if (!g_usbWriteSlotBuffer) g_usbWriteSlotBuffer = memalign(USB_TRANSFER_ALIGNMENT, USB_WRITE_QUEUE_DEPTH * USB_WRITE_SLOT_SIZE);
+    return (g_usbTransferBuffer != NULL && g_usbWriteSlotBuffer != NULL);
 }
 
 NX_INLINE void usbFreeTransferBuffer(void)
 {
-    if (!g_usbTransferBuffer) return;
-    free(g_usbTransferBuffer);
-    g_usbTransferBuffer = NULL;
+    if (g_usbTransferBuffer)
+    {
+        free(g_usbTransferBuffer);
+        g_usbTransferBuffer = NULL;
+    }
+
+    if (g_usbWriteSlotBuffer)
+    {
+        free(g_usbWriteSlotBuffer);
+        g_usbWriteSlotBuffer = NULL;
+    }
 }
 
 static bool usbInitializeComms(void)
@@ -1276,6 +1751,13 @@ static bool _usbSendFileProperties(u64 file_size, const char *filename, u32 nsp_
         return false;
     }
 
+    /* Send any pending file stream packets first, since they share the transfer buffer with regular commands. */
+    if (!usbFlushFileStreamBatch())
+    {
+        LOG_MSG_ERROR("Failed to send pending file stream packets!");
+        return false;
+    }
+
     /* Prepare command data. */
     usbPrepareCommandHeader(UsbCommandType_SendFileProperties, (u32)sizeof(UsbCommandSendFileProperties));
 
@@ -1302,6 +1784,210 @@ static bool _usbSendFileProperties(u64 file_size, const char *filename, u32 nsp_
     return ret;
 }
 
+static bool _usbSendFileData(void *data, u64 data_size, UsbTransferDoneCallback callback, void *callback_arg)
+{
+    bool ret = false, zlt_required = false, last_chunk = false, handed_off = false;
+
+    if (!g_usbTransferBuffer || !g_usbInterfaceInit || !g_usbHostAvailable || !g_usbSessionStarted || !g_usbTransferRemainingSize || !data || !data_size || \
+        data_size > USB_TRANSFER_BUFFER_SIZE || data_size > g_usbTransferRemainingSize || (callback && !IS_ALIGNED((u64)data, USB_TRANSFER_ALIGNMENT)))
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        goto end;
+    }
+
+    /* Determine if we'll need to set a Zero Length Termination (ZLT) packet. */
+    /* This is automatically handled by usbDsEndpoint_PostBufferAsync(), depending on the ZLT setting from the input (write) endpoint. */
+    /* First, check if this is the last data chunk for this file. */
+    last_chunk = ((g_usbTransferRemainingSize - data_size) == 0);
+    if (last_chunk)
+    {
+        /* ZLT is only needed if the last chunk size is aligned to the USB endpoint max packet size. */
+        /* It'll be enabled right before posting the last URB. */
+        zlt_required = IS_ALIGNED(data_size, g_usbEndpointMaxPacketSize);
+    } else {
+        /* Disable ZLT if this is the first of multiple data chunks. */
+        if (!g_usbTransferWrittenSize)
+        {
+            usbSetZltPacket(false);
+            LOG_MSG_DEBUG("ZLT disabled (first chunk).");
+        }
+    }
+
+    if (IS_ALIGNED((u64)data, USB_TRANSFER_ALIGNMENT))
+    {
+        /* Optimization for buffers that already are page aligned: post them as-is. */
+        /* The ZLT setting must not change while other URBs are in flight. */
+        if (zlt_required)
+        {
+            if (!(ret = usbWaitForQueuedWrites())) goto end;
+            usbSetZltPacket(true);
+            LOG_MSG_DEBUG("ZLT enabled. Last chunk size: 0x%lX bytes.", data_size);
+        }
+
+        handed_off = true;
+        ret = usbEnqueueWrite(data, (u32)data_size, false, callback, callback_arg);
+
+        /* Buffers that weren't handed off by the caller must be retired before returning. */
+        if (ret && !callback) ret = usbWaitForQueuedWrites();
+    } else {
+        /* Split unaligned data across bounce slots. Slot boundaries are aligned to the endpoint max packet size, so only the last URB may end in a short packet. */
+        for(u64 offset = 0; offset < data_size;)
+        {
+            u32 slot_size = (u32)((data_size - offset) > USB_WRITE_SLOT_SIZE ? USB_WRITE_SLOT_SIZE : (data_size - offset));
+
+            if (zlt_required && (offset + slot_size) == data_size)
+            {
+                if (!(ret = usbWaitForQueuedWrites())) break;
+                usbSetZltPacket(true);
+                LOG_MSG_DEBUG("ZLT enabled. Last chunk size: 0x%lX bytes.", data_size);
+            }
+
+            if (!(ret = usbEnqueueWrite((u8*)data + offset, slot_size, true, NULL, NULL))) break;
+
+            offset += slot_size;
+        }
+    }
+
+    if (!ret)
+    {
+        LOG_MSG_ERROR("Failed to write 0x%lX bytes long file data chunk from offset 0x%lX! (total size: 0x%lX).", data_size, g_usbTransferWrittenSize, \
+                                                                                                                  g_usbTransferRemainingSize + g_usbTransferWrittenSize);
+        goto end;
+    }
+
+    g_usbTransferRemainingSize -= data_size;
+    g_usbTransferWrittenSize += data_size;
+
+    /* Check if this is the last chunk. */
+    if (last_chunk)
+    {
+        /* Wait for all queued chunks to reach the host device. */
+        if (!(ret = usbWaitForQueuedWrites()))
+        {
+            LOG_MSG_ERROR("Failed to write queued file data chunks! (total size: 0x%lX).", g_usbTransferWrittenSize);
+            goto end;
+        }
+
+        /* Check response from host device. */
+        if (!(ret = usbRead(g_usbTransferBuffer, sizeof(UsbStatus))))
+        {
+            LOG_MSG_ERROR("Failed to read 0x%lX bytes long status block!", sizeof(UsbStatus));
+            goto end;
+        }
+
+        UsbStatus *cmd_status = (UsbStatus*)g_usbTransferBuffer;
+
+        if (!(ret = (cmd_status->magic == __builtin_bswap32(USB_CMD_HEADER_MAGIC))))
+        {
+            LOG_MSG_ERROR("Invalid status block magic word! (0x%08X).", __builtin_bswap32(cmd_status->magic));
+            goto end;
+        }
+
+        ret = (cmd_status->status == UsbStatusType_Success);
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+        if (!ret) usbLogStatusDetail(cmd_status->status);
+#endif
+    }
+
+end:
+    /* Make sure no URBs are left in flight before touching the ZLT setting or resetting variables. */
+    if (!ret) usbWaitForQueuedWrites();
+
+    /* Disable ZLT if it was previously enabled. */
+    if (zlt_required) usbSetZltPacket(false);
+
+    /* Reset variables in case of errors. */
+    if (!ret)
+    {
+        g_usbTransferRemainingSize = g_usbTransferWrittenSize = 0;
+        g_nspTransferMode = false;
+    }
+
+    /* Give buffer ownership back to the caller if it was never handed off. */
+    if (callback && !handed_off) callback(data, false, callback_arg);
+
+    return ret;
+}
+
+static bool usbAppendFileStreamPacket(u32 stream_id, u8 type, const void *payload_header, u32 payload_header_size, const void *payload, u32 payload_size)
+{
+    UsbFileStreamPacketHeader packet_header = {0};
+    u32 packet_size = (u32)(sizeof(UsbFileStreamPacketHeader) + payload_header_size + payload_size);
+    u8 *ptr = NULL;
+
+    if (type >= UsbFileStreamPacketType_Count || (payload_header_size && !payload_header) || (payload_size && !payload) || packet_size > USB_FILE_STREAM_BATCH_SIZE)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
+
+    /* Flush the current batch if this packet doesn't fit. */
+    if ((g_usbFileStreamBatchSize + packet_size) > USB_FILE_STREAM_BATCH_SIZE && !usbFlushFileStreamBatch()) return false;
+
+    packet_header.stream_id = stream_id;
+    packet_header.type = type;
+    packet_header.payload_size = (payload_header_size + payload_size);
+
+    /* Packets are appended right after the command header area from the transfer buffer. */
+    /* They're not aligned, so we just copy everything over. */
+    ptr = (g_usbTransferBuffer + sizeof(UsbCommandHeader) + g_usbFileStreamBatchSize);
+
+    memcpy(ptr, &packet_header, sizeof(UsbFileStreamPacketHeader));
+    ptr += sizeof(UsbFileStreamPacketHeader);
+
+    if (payload_header_size)
+    {
+        memcpy(ptr, payload_header, payload_header_size);
+        ptr += payload_header_size;
+    }
+
+    if (payload_size) memcpy(ptr, payload, payload_size);
+
+    g_usbFileStreamBatchSize += packet_size;
+
+    return true;
+}
+
+static bool usbFlushFileStreamBatch(void)
+{
+    bool ret = false;
+
+    if (!g_usbFileStreamBatchSize) return true;
+
+    /* The batch is already placed right where usbSendCommand() expects to find the command block. */
+    usbPrepareCommandHeader(UsbCommandType_SendFileStreamBatch, g_usbFileStreamBatchSize);
+    g_usbFileStreamBatchSize = 0;
+
+    /* Send command. The host device acknowledges the whole batch with a single status block. */
+    ret = usbSendCommand();
+    if (ret)
+    {
+        /* The host device now holds the same set of open file streams we do. */
+        g_usbFileStreamHostCount = g_usbFileStreamCount;
+    } else {
+        LOG_MSG_ERROR("Failed to send file stream batch!");
+        usbResetFileStreams();
+    }
+
+    return ret;
+}
+
+static UsbFileStream *usbGetFileStream(u32 stream_id)
+{
+    for(u32 i = 0; i < g_usbFileStreamCount; i++)
+    {
+        if (g_usbFileStreams[i].id == stream_id) return &(g_usbFileStreams[i]);
+    }
+
+    return NULL;
+}
+
+static void usbResetFileStreams(void)
+{
+    memset(g_usbFileStreams, 0, sizeof(g_usbFileStreams));
+    g_usbFileStreamCount = g_usbFileStreamBatchSize = g_usbFileStreamHostCount = 0;
+}
+
 NX_INLINE bool usbIsHostAvailable(void)
 {
     UsbState state = UsbState_Detached;
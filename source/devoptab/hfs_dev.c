@@ -39,6 +39,7 @@ typedef struct {
     HashFileSystemEntry *hfs_entry; ///< Hash FS entry metadata.
     const char *name;               ///< Entry name.
     u64 offset;                     ///< Current offset within Hash FS entry data.
+    DevoptabReadAheadState readahead;   ///< Sequential access detector.
 } HashFileSystemFileState;
 
 typedef struct {
@@ -61,6 +62,7 @@ static int       hfsdev_dirclose(struct _reent *r, DIR_ITER *dirState);
 static int       hfsdev_statvfs(struct _reent *r, const char *path, struct statvfs *buf);
 
 static const char *hfsdev_get_truncated_path(struct _reent *r, const char *path);
+static bool hfsdev_read_entry_data(void *fs_ctx, void *fs_entry, void *out, u64 read_size, u64 offset);
 
 static void hfsdev_fill_stat(struct stat *st, u32 index, const HashFileSystemEntry *hfs_entry, time_t mount_time);
 
@@ -153,15 +155,18 @@ end:
 static ssize_t hfsdev_read(struct _reent *r, void *fd, char *ptr, size_t len)
 {
     HFS_DEV_INIT_FILE_VARS;
-    HFS_DEV_INIT_FS_ACCESS;
 
     /* Sanity check. */
     if (!file || !ptr || !len) DEVOPTAB_SET_ERROR_AND_EXIT(EINVAL);
 
     //LOG_MSG_DEBUG("Reading 0x%lX byte(s) at offset 0x%lX from \"%s:/%s\".", len, file->offset, dev_ctx->name, file->name);
 
+    /* Don't read past the end of the file. */
+    len = (file->offset < file->hfs_entry->size ? MIN(len, file->hfs_entry->size - file->offset) : 0);
+    if (!len) DEVOPTAB_EXIT;
+
     /* Read file data. */
-    if (!hfsReadEntryData(fs_ctx, file->hfs_entry, ptr, len, file->offset)) DEVOPTAB_SET_ERROR_AND_EXIT(EIO);
+    if (!devoptabReadFileEntryData(dev_ctx, &(file->readahead), file->hfs_entry, file->hfs_entry->size, hfsdev_read_entry_data, ptr, len, file->offset)) DEVOPTAB_SET_ERROR_AND_EXIT(EIO);
 
     /* Adjust offset. */
     file->offset += len;
@@ -399,6 +404,11 @@ end:
     DEVOPTAB_RETURN_INT(0);
 }
 
+static bool hfsdev_read_entry_data(void *fs_ctx, void *fs_entry, void *out, u64 read_size, u64 offset)
+{
+    return hfsReadEntryData((HashFileSystemContext*)fs_ctx, (HashFileSystemEntry*)fs_entry, out, read_size, offset);
+}
+
 static const char *hfsdev_get_truncated_path(struct _reent *r, const char *path)
 {
     const u8 *p = (const u8*)path;
@@ -33,12 +33,26 @@ typedef enum {
     DevoptabDeviceType_Count               = 3  ///< Total values supported by this enum.
 } DevoptabDeviceType;
 
+/// Holds a readahead window from a filesystem entry.
+typedef struct {
+    DevoptabDeviceContext *dev_ctx;     ///< Device the filesystem entry belongs to. NULL if this entry is unused.
+    void *fs_entry;                     ///< Filesystem entry.
+    u64 offset;                         ///< Window offset, relative to the start of the filesystem entry data.
+    u64 size;                           ///< Window size.
+    u8 *data;
+    u64 last_used;                      ///< Used to evict the least recently used entry.
+} DevoptabBlockCacheEntry;
+
 /* Global variables. */
 
 static Mutex g_devoptabMutex = 0;
 static DevoptabDeviceContext g_devoptabDevices[DEVOPTAB_DEVICE_COUNT] = {0};
 static const u32 g_devoptabDeviceCount = MAX_ELEMENTS(g_devoptabDevices);
 
+static Mutex g_devoptabBlockCacheMutex = 0;
+static DevoptabBlockCacheEntry g_devoptabBlockCacheEntries[DEVOPTAB_BLOCK_CACHE_ENTRY_COUNT] = {0};
+static u64 g_devoptabBlockCacheSize = 0, g_devoptabBlockCacheTick = 0;
+
 /* Function prototypes. */
 
 const devoptab_t *pfsdev_get_devoptab();
@@ -48,6 +62,12 @@ const devoptab_t *romfsdev_get_devoptab();
 static bool devoptabMountDevice(void *fs_ctx, const char *name, u8 type);
 static DevoptabDeviceContext *devoptabFindDevice(const char *name);
 static void devoptabResetDevice(DevoptabDeviceContext *dev_ctx);
+static void devoptabClearDevice(DevoptabDeviceContext *dev_ctx);
+
+static u64 devoptabReadFromBlockCache(DevoptabDeviceContext *dev_ctx, void *fs_entry, void *out, u64 read_size, u64 offset);
+static void devoptabAddToBlockCache(DevoptabDeviceContext *dev_ctx, void *fs_entry, u8 *data, u64 size, u64 offset);
+static void devoptabFreeBlockCacheEntry(DevoptabBlockCacheEntry *cache_entry);
+static void devoptabFlushBlockCache(DevoptabDeviceContext *dev_ctx);
 
 bool devoptabMountPartitionFileSystemDevice(PartitionFileSystemContext *pfs_ctx, const char *name)
 {
@@ -125,18 +145,94 @@ void devoptabUnmountAllDevices(void)
     }
 }
 
-void devoptabControlMutex(bool lock)
+bool devoptabAcquireDevice(DevoptabDeviceContext *dev_ctx)
 {
-    bool locked = mutexIsLockedByCurrentThread(&g_devoptabMutex);
+    bool ret = false;
+
+    if (!dev_ctx) return false;
+
+    SCOPED_LOCK(&(dev_ctx->ref_mutex))
+    {
+        /* Don't hand out new references if the device is being unmounted. */
+        if (!dev_ctx->initialized) break;
+
+        dev_ctx->ref_count++;
+        ret = true;
+    }
+
+    return ret;
+}
+
+void devoptabReleaseDevice(DevoptabDeviceContext *dev_ctx)
+{
+    if (!dev_ctx) return;
+
+    SCOPED_LOCK(&(dev_ctx->ref_mutex))
+    {
+        if (dev_ctx->ref_count && !(--dev_ctx->ref_count)) condvarWakeAll(&(dev_ctx->ref_condvar));
+    }
+}
+
+bool devoptabReadFileEntryData(DevoptabDeviceContext *dev_ctx, DevoptabReadAheadState *readahead, void *fs_entry, u64 fs_entry_size, DevoptabReadEntryDataFunction read_func, \
+                               void *out, u64 read_size, u64 offset)
+{
+    if (!dev_ctx || !readahead || !fs_entry || !read_func || !out || !read_size || (offset + read_size) > fs_entry_size)
+    {
+        LOG_MSG_ERROR("Invalid parameters!");
+        return false;
+    }
 
-    if (!locked && lock)
+    u8 *out_u8 = (u8*)out, *window_data = NULL;
+    u64 cached_size = 0, window_size = 0;
+    bool success = false;
+
+    /* Update sequential access detector. The readahead window grows with each sequential read, and it's dropped altogether on random access. */
+    if (offset == readahead->next_offset)
     {
-        mutexLock(&g_devoptabMutex);
-    } else
-    if (locked && !lock)
+        readahead->window_size = (readahead->window_size ? MIN(readahead->window_size * 2, DEVOPTAB_READAHEAD_MAX_SIZE) : DEVOPTAB_READAHEAD_MIN_SIZE);
+    } else {
+        readahead->window_size = 0;
+    }
+
+    readahead->next_offset = (offset + read_size);
+
+    /* Copy as much data as possible from the block cache. */
+    cached_size = devoptabReadFromBlockCache(dev_ctx, fs_entry, out_u8, read_size, offset);
+
+    out_u8 += cached_size;
+    offset += cached_size;
+    read_size -= cached_size;
+
+    if (!read_size) return true;
+
+    /* Read data straight into the output buffer if we're dealing with random access, or if the remaining data doesn't fit in the current readahead window. */
+    if (read_size >= readahead->window_size) return read_func(dev_ctx->fs_ctx, fs_entry, out_u8, read_size, offset);
+
+    /* Read a full readahead window. */
+    window_size = MIN(readahead->window_size, fs_entry_size - offset);
+
+    window_data = malloc(window_size);
+    if (!window_data)
     {
-        mutexUnlock(&g_devoptabMutex);
+        /* Just read the requested data if we can't allocate the window buffer. */
+        return read_func(dev_ctx->fs_ctx, fs_entry, out_u8, read_size, offset);
     }
+
+    if (!read_func(dev_ctx->fs_ctx, fs_entry, window_data, window_size, offset)) goto end;
+
+    memcpy(out_u8, window_data, read_size);
+
+    /* Hand the window buffer over to the block cache. */
+    devoptabAddToBlockCache(dev_ctx, fs_entry, window_data, window_size, offset);
+    window_data = NULL;
+
+    /* Update return value. */
+    success = true;
+
+end:
+    if (window_data) free(window_data);
+
+    return success;
 }
 
 static bool devoptabMountDevice(void *fs_ctx, const char *name, u8 type)
@@ -199,11 +295,13 @@ static bool devoptabMountDevice(void *fs_ctx, const char *name, u8 type)
         goto end;
     }
 
-    /* Update flags. */
-    ret = dev_ctx->initialized = true;
+    /* Update flags. Filesystem operations can take references to this device from now on. */
+    SCOPED_LOCK(&(dev_ctx->ref_mutex)) dev_ctx->initialized = true;
+
+    ret = true;
 
 end:
-    if (!ret) memset(dev_ctx, 0, sizeof(DevoptabDeviceContext));
+    if (!ret) devoptabClearDevice(dev_ctx);
 
     return ret;
 }
@@ -239,10 +337,139 @@ static void devoptabResetDevice(DevoptabDeviceContext *dev_ctx)
 
     char tmp_name[DEVOPTAB_MOUNT_NAME_LENGTH + 2] = {0};
 
+    /* Stop handing out new references, then wait until all in-flight filesystem operations are done. */
+    SCOPED_LOCK(&(dev_ctx->ref_mutex))
+    {
+        dev_ctx->initialized = false;
+        while(dev_ctx->ref_count) condvarWait(&(dev_ctx->ref_condvar), &(dev_ctx->ref_mutex));
+    }
+
     snprintf(tmp_name, MAX_ELEMENTS(tmp_name), "%s:", dev_ctx->name);
     RemoveDevice(tmp_name);
 
-    memset(dev_ctx, 0, sizeof(DevoptabDeviceContext));
+    /* Drop cached data from this device. */
+    devoptabFlushBlockCache(dev_ctx);
+
+    devoptabClearDevice(dev_ctx);
 
     LOG_MSG_DEBUG("Successfully unmounted device \"%s\".", tmp_name);
 }
+
+static void devoptabClearDevice(DevoptabDeviceContext *dev_ctx)
+{
+    /* The reference counting primitives must be left untouched, since other threads may be trying to acquire this device at the same time. */
+    SCOPED_LOCK(&(dev_ctx->ref_mutex))
+    {
+        dev_ctx->initialized = false;
+        memset(dev_ctx->name, 0, sizeof(dev_ctx->name));
+        dev_ctx->mount_time = 0;
+        memset(&(dev_ctx->device), 0, sizeof(devoptab_t));
+        dev_ctx->fs_ctx = NULL;
+    }
+}
+
+static u64 devoptabReadFromBlockCache(DevoptabDeviceContext *dev_ctx, void *fs_entry, void *out, u64 read_size, u64 offset)
+{
+    u8 *out_u8 = (u8*)out;
+    u64 cached_size = 0;
+
+    SCOPED_LOCK(&g_devoptabBlockCacheMutex)
+    {
+        /* Keep looking for cached windows until we find no window that holds the current offset. A single read may span multiple windows. */
+        while(cached_size < read_size)
+        {
+            DevoptabBlockCacheEntry *cache_entry = NULL;
+            u64 cur_offset = (offset + cached_size), cur_size = 0;
+
+            for(u32 i = 0; i < DEVOPTAB_BLOCK_CACHE_ENTRY_COUNT; i++)
+            {
+                DevoptabBlockCacheEntry *cur_entry = &(g_devoptabBlockCacheEntries[i]);
+
+                if (cur_entry->dev_ctx == dev_ctx && cur_entry->fs_entry == fs_entry && cur_offset >= cur_entry->offset && cur_offset < (cur_entry->offset + cur_entry->size))
+                {
+                    cache_entry = cur_entry;
+                    break;
+                }
+            }
+
+            if (!cache_entry) break;
+
+            cur_size = MIN(cache_entry->offset + cache_entry->size - cur_offset, read_size - cached_size);
+            memcpy(out_u8 + cached_size, cache_entry->data + (cur_offset - cache_entry->offset), cur_size);
+
+            cache_entry->last_used = ++g_devoptabBlockCacheTick;
+            cached_size += cur_size;
+        }
+    }
+
+    return cached_size;
+}
+
+static void devoptabAddToBlockCache(DevoptabDeviceContext *dev_ctx, void *fs_entry, u8 *data, u64 size, u64 offset)
+{
+    SCOPED_LOCK(&g_devoptabBlockCacheMutex)
+    {
+        DevoptabBlockCacheEntry *cache_entry = NULL;
+
+        while(true)
+        {
+            DevoptabBlockCacheEntry *lru_entry = NULL;
+
+            /* Look for an unused entry, while keeping track of the least recently used one. */
+            for(u32 i = 0; i < DEVOPTAB_BLOCK_CACHE_ENTRY_COUNT; i++)
+            {
+                DevoptabBlockCacheEntry *cur_entry = &(g_devoptabBlockCacheEntries[i]);
+
+                if (!cur_entry->dev_ctx)
+                {
+                    if (!cache_entry) cache_entry = cur_entry;
+                    continue;
+                }
+
+                if (!lru_entry || cur_entry->last_used < lru_entry->last_used) lru_entry = cur_entry;
+            }
+
+            /* Stop evicting entries as soon as we have a free slot and enough room for the new window. */
+            if (cache_entry && (g_devoptabBlockCacheSize + size) <= DEVOPTAB_BLOCK_CACHE_MAX_SIZE) break;
+
+            /* This can't really happen, since windows are never bigger than the cache. But let's be safe. */
+            if (!lru_entry)
+            {
+                free(data);
+                return;
+            }
+
+            devoptabFreeBlockCacheEntry(lru_entry);
+            cache_entry = NULL;
+        }
+
+        cache_entry->dev_ctx = dev_ctx;
+        cache_entry->fs_entry = fs_entry;
+        cache_entry->offset = offset;
+        cache_entry->size = size;
+        cache_entry->data = data;
+        cache_entry->last_used = ++g_devoptabBlockCacheTick;
+
+        g_devoptabBlockCacheSize += size;
+    }
+}
+
+/* Must be called with the block cache mutex held. */
+static void devoptabFreeBlockCacheEntry(DevoptabBlockCacheEntry *cache_entry)
+{
+    if (cache_entry->data) free(cache_entry->data);
+    g_devoptabBlockCacheSize -= cache_entry->size;
+    memset(cache_entry, 0, sizeof(DevoptabBlockCacheEntry));
+}
+
+static void devoptabFlushBlockCache(DevoptabDeviceContext *dev_ctx)
+{
+    SCOPED_LOCK(&g_devoptabBlockCacheMutex)
+    {
+        for(u32 i = 0; i < DEVOPTAB_BLOCK_CACHE_ENTRY_COUNT; i++)
+        {
+            DevoptabBlockCacheEntry *cache_entry = &(g_devoptabBlockCacheEntries[i]);
+            if (cache_entry->dev_ctx == dev_ctx) devoptabFreeBlockCacheEntry(cache_entry);
+        }
+    }
+}
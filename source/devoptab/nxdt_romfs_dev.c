@@ -40,6 +40,7 @@
 typedef struct {
     RomFileSystemFileEntry *file_entry; ///< RomFS file entry metadata.
     u64 data_offset;                    ///< Current offset within RomFS file entry data.
+    DevoptabReadAheadState readahead;   ///< Sequential access detector.
 } RomFileSystemFileState;
 
 typedef struct {
@@ -64,6 +65,7 @@ static int       romfsdev_dirclose(struct _reent *r, DIR_ITER *dirState);
 static int       romfsdev_statvfs(struct _reent *r, const char *path, struct statvfs *buf);
 
 static const char *romfsdev_get_truncated_path(struct _reent *r, const char *path);
+static bool romfsdev_read_entry_data(void *fs_ctx, void *fs_entry, void *out, u64 read_size, u64 offset);
 
 static void romfsdev_fill_file_stat(struct stat *st, const RomFileSystemContext *fs_ctx, const RomFileSystemFileEntry *file_entry, time_t mount_time);
 static void romfsdev_fill_dir_stat(struct stat *st, RomFileSystemContext *fs_ctx, RomFileSystemDirectoryEntry *dir_entry, time_t mount_time);
@@ -158,7 +160,6 @@ end:
 static ssize_t romfsdev_read(struct _reent *r, void *fd, char *ptr, size_t len)
 {
     ROMFS_DEV_INIT_FILE_VARS;
-    ROMFS_DEV_INIT_FS_ACCESS;
 
     /* Sanity check. */
     if (!file || !ptr || !len) DEVOPTAB_SET_ERROR_AND_EXIT(EINVAL);
@@ -166,8 +167,12 @@ static ssize_t romfsdev_read(struct _reent *r, void *fd, char *ptr, size_t len)
     /*LOG_MSG_DEBUG("Reading 0x%lX byte(s) at offset 0x%lX from file \"%.*s\" in \"%s:\".", len, file->data_offset, (int)file->file_entry->name_length, file->file_entry->name, \
                                                                                           dev_ctx->name);*/
 
+    /* Don't read past the end of the file. */
+    len = (file->data_offset < file->file_entry->size ? MIN(len, file->file_entry->size - file->data_offset) : 0);
+    if (!len) DEVOPTAB_EXIT;
+
     /* Read file data. */
-    if (!romfsReadFileEntryData(fs_ctx, file->file_entry, ptr, len, file->data_offset)) DEVOPTAB_SET_ERROR_AND_EXIT(EIO);
+    if (!devoptabReadFileEntryData(dev_ctx, &(file->readahead), file->file_entry, file->file_entry->size, romfsdev_read_entry_data, ptr, len, file->data_offset)) DEVOPTAB_SET_ERROR_AND_EXIT(EIO);
 
     /* Adjust offset. */
     file->data_offset += len;
@@ -428,6 +433,11 @@ end:
     DEVOPTAB_RETURN_INT(0);
 }
 
+static bool romfsdev_read_entry_data(void *fs_ctx, void *fs_entry, void *out, u64 read_size, u64 offset)
+{
+    return romfsReadFileEntryData((RomFileSystemContext*)fs_ctx, (RomFileSystemFileEntry*)fs_entry, out, read_size, offset);
+}
+
 static const char *romfsdev_get_truncated_path(struct _reent *r, const char *path)
 {
     const u8 *p = (const u8*)path;
@@ -39,6 +39,7 @@ typedef struct {
     PartitionFileSystemEntry *pfs_entry;    ///< Partition FS entry metadata.
     const char *name;                       ///< Entry name.
     u64 offset;                             ///< Current offset within Partition FS entry data.
+    DevoptabReadAheadState readahead;       ///< Sequential access detector.
 } PartitionFileSystemFileState;
 
 typedef struct {
@@ -61,6 +62,7 @@ static int       pfsdev_dirclose(struct _reent *r, DIR_ITER *dirState);
 static int       pfsdev_statvfs(struct _reent *r, const char *path, struct statvfs *buf);
 
 static const char *pfsdev_get_truncated_path(struct _reent *r, const char *path);
+static bool pfsdev_read_entry_data(void *fs_ctx, void *fs_entry, void *out, u64 read_size, u64 offset);
 
 static void pfsdev_fill_stat(struct stat *st, u32 index, const PartitionFileSystemEntry *pfs_entry, time_t mount_time);
 
@@ -153,15 +155,18 @@ end:
 static ssize_t pfsdev_read(struct _reent *r, void *fd, char *ptr, size_t len)
 {
     PFS_DEV_INIT_FILE_VARS;
-    PFS_DEV_INIT_FS_ACCESS;
 
     /* Sanity check. */
     if (!file || !ptr || !len) DEVOPTAB_SET_ERROR_AND_EXIT(EINVAL);
 
     //LOG_MSG_DEBUG("Reading 0x%lX byte(s) at offset 0x%lX from \"%s:/%s\".", len, file->offset, dev_ctx->name, file->name);
 
+    /* Don't read past the end of the file. */
+    len = (file->offset < file->pfs_entry->size ? MIN(len, file->pfs_entry->size - file->offset) : 0);
+    if (!len) DEVOPTAB_EXIT;
+
     /* Read file data. */
-    if (!pfsReadEntryData(fs_ctx, file->pfs_entry, ptr, len, file->offset)) DEVOPTAB_SET_ERROR_AND_EXIT(EIO);
+    if (!devoptabReadFileEntryData(dev_ctx, &(file->readahead), file->pfs_entry, file->pfs_entry->size, pfsdev_read_entry_data, ptr, len, file->offset)) DEVOPTAB_SET_ERROR_AND_EXIT(EIO);
 
     /* Adjust offset. */
     file->offset += len;
@@ -399,6 +404,11 @@ end:
     DEVOPTAB_RETURN_INT(0);
 }
 
+static bool pfsdev_read_entry_data(void *fs_ctx, void *fs_entry, void *out, u64 read_size, u64 offset)
+{
+    return pfsReadEntryData((PartitionFileSystemContext*)fs_ctx, (PartitionFileSystemEntry*)fs_entry, out, read_size, offset);
+}
+
 static const char *pfsdev_get_truncated_path(struct _reent *r, const char *path)
 {
     const u8 *p = (const u8*)path;